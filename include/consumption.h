@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,6 +30,18 @@ extern "C" {
  * CONFIGURATION
  * ============================================================================ */
 
+/**
+ * @brief Raw event retention policy
+ *
+ * Counts are always exact (kept in counters); the policy only decides which
+ * raw events stay in the ring_buffer_size slots.
+ */
+typedef enum {
+    CONSUMPTION_RETENTION_RECENT = 0,   /**< Most recent events (ring, default) */
+    CONSUMPTION_RETENTION_UNIFORM = 1,  /**< Uniform reservoir sample of the open period */
+    CONSUMPTION_RETENTION_HOURLY = 2,   /**< Reservoir sample stratified by the hours a period spans (UTC) */
+} consumption_retention_t;
+
 /**
  * @brief Configuration structure for the consumption module
  */
@@ -40,6 +53,10 @@ typedef struct {
     char api_endpoint[256];           /**< External API endpoint URL */
     char api_key[128];                /**< API authentication key (optional) */
     uint32_t max_retry_attempts;      /**< Max retry attempts for API calls (default: 3) */
+    bool counter_only;                /**< Keep per-product counters only, no raw event ring (default: false) */
+    consumption_retention_t retention; /**< Raw event retention policy (default: RECENT) */
+    bool upload_events;               /**< Include retained raw events in uploads (default: false) */
+    bool heartbeat_frames;            /**< Compact frames for idle and repeated periods (default: false) */
 } consumption_config_t;
 
 /* ============================================================================
@@ -53,8 +70,28 @@ typedef struct {
     uint32_t timestamp;     /**< Unix timestamp */
     uint32_t machine_id;    /**< Machine identifier */
     uint8_t product_id;     /**< Product identifier (1-255) */
+    uint16_t quantity;      /**< Units dispensed (1 for single dispenses) */
 } consumption_event_t;
 
+/**
+ * @brief One entry of a batch dispense report
+ */
+typedef struct {
+    uint32_t timestamp;     /**< Unix timestamp (0 = time of the batch call) */
+    uint8_t product_id;     /**< Product identifier (1-255) */
+    uint16_t quantity;      /**< Units dispensed (>= 1) */
+} consumption_dispense_t;
+
+/**
+ * @brief Retained raw event with its sampling weight
+ */
+typedef struct {
+    uint32_t timestamp;     /**< Unix timestamp */
+    uint8_t product_id;     /**< Product identifier (1-255) */
+    uint16_t quantity;      /**< Units dispensed */
+    float weight;           /**< Events of the open period this sample stands for */
+} consumption_sample_t;
+
 /**
  * @brief Aggregated consumption data
  */
@@ -77,7 +114,9 @@ typedef enum {
     CONSUMPTION_ERROR_NETWORK_UNAVAILABLE = 3,
     CONSUMPTION_ERROR_API_ERROR = 4,
     CONSUMPTION_ERROR_MEMORY_ERROR = 5,
-    CONSUMPTION_ERROR_INVALID_PARAMETER = 6
+    CONSUMPTION_ERROR_INVALID_PARAMETER = 6,
+    CONSUMPTION_ERROR_CANCELLED = 7,
+    CONSUMPTION_ERROR_TIMEOUT = 8
 } consumption_error_t;
 
 /* ============================================================================
@@ -100,6 +139,10 @@ consumption_error_t consumption_init(const consumption_config_t* config);
  *
  * Core function that must be called after successful beverage dispensing.
  * This function must complete in ≤ 5ms and not block the main thread.
+ * Builds with CONSUMPTION_COUNTER_SHARDS > 1 also take dispenses from other
+ * threads than the one that called consumption_init(), when the module is
+ * counter_only with the external API off; otherwise such calls return
+ * CONSUMPTION_ERROR_INVALID_CONFIG.
  *
  * @param machine_id Unique machine identifier
  * @param product_id Product identifier (1-255)
@@ -107,6 +150,30 @@ consumption_error_t consumption_init(const consumption_config_t* config);
  */
 consumption_error_t consumption_on_dispense(uint32_t machine_id, uint8_t product_id);
 
+/**
+ * @brief Record several dispenses reported in bulk
+ *
+ * For controllers that report "N units of product P" or replay a backlog
+ * after a reboot. The batch is validated as a whole before anything is
+ * recorded, ring space is reserved once, counters are updated in bulk and
+ * the sync check runs once per batch. Each entry occupies one ring slot
+ * regardless of its quantity; counts and totals are in units. The clock
+ * is read at most once per batch.
+ *
+ * Counts always go to the open period. A record's timestamp only labels
+ * its raw event and log record: a backlog from before the last sync is
+ * counted in the current period, not in one already uploaded.
+ *
+ * @param machine_id Unique machine identifier
+ * @param records Array of dispense records
+ * @param count Number of records
+ * @return CONSUMPTION_SUCCESS on success, error code otherwise
+ *         (nothing is recorded if any record is invalid)
+ */
+consumption_error_t consumption_on_dispense_batch(uint32_t machine_id,
+                                                 const consumption_dispense_t* records,
+                                                 uint32_t count);
+
 /**
  * @brief Deinitialize the consumption module
  *
@@ -161,6 +228,51 @@ consumption_error_t consumption_get_stats(uint32_t* total_events,
                                         uint32_t* buffered_events,
                                         uint32_t* last_sync);
 
+/**
+ * @brief Point-in-time copy of the module's counters
+ */
+typedef struct {
+    uint32_t machine_id;            /**< Machine identifier */
+    uint32_t timestamp;             /**< When the snapshot was taken */
+    uint32_t total_events;          /**< Lifetime units */
+    uint32_t period_start;          /**< Start of the open period */
+    uint32_t period_events;         /**< Units in the open period */
+    uint32_t buffered_events;       /**< Raw events retained */
+    uint32_t last_sync;             /**< Last successful upload */
+    uint32_t sync_failures;         /**< Consecutive failed uploads */
+    uint32_t product_counts[256];   /**< Open-period units per product ID */
+} consumption_snapshot_t;
+
+/**
+ * @brief Take a snapshot of all counters
+ *
+ * Meant to be called once per tick by readers that must not query the
+ * module per request (e.g. the local query endpoint, consumption_http.h).
+ * Call from the thread that drives the module.
+ *
+ * @param snapshot Snapshot to fill
+ * @return CONSUMPTION_SUCCESS on success
+ */
+consumption_error_t consumption_get_snapshot(consumption_snapshot_t* snapshot);
+
+/**
+ * @brief Get the retained raw events with their sampling weights
+ *
+ * With reservoir retention each sample carries the number of events of the
+ * open period it represents (events seen / samples kept in its stratum), so
+ * summing weights gives an unbiased estimate of any event subset. With
+ * RECENT retention every event has weight 1 and older events are lost once
+ * the ring wraps.
+ *
+ * @param samples Array to fill
+ * @param max_samples Capacity of the array
+ * @param count Pointer to store the number of samples written
+ * @return CONSUMPTION_SUCCESS on success
+ */
+consumption_error_t consumption_get_samples(consumption_sample_t* samples,
+                                          uint32_t max_samples,
+                                          uint32_t* count);
+
 /**
  * @brief Force synchronization of buffered data
  *
@@ -171,6 +283,263 @@ consumption_error_t consumption_get_stats(uint32_t* total_events,
  */
 consumption_error_t consumption_force_sync(void);
 
+/* ============================================================================
+ * ASYNCHRONOUS UPLOAD
+ * ============================================================================ */
+
+/*
+ * For hosts that drive their own non-blocking I/O (see consumption_events.h).
+ * An upload moves the open period's counters aside, so dispenses during the
+ * upload count towards the next period; a failed upload folds them back.
+ * Only one upload is in flight at a time, and consumption_force_sync()
+ * fails while one is.
+ */
+
+/**
+ * @brief Period being uploaded (owned by the module)
+ */
+typedef struct consumption_upload_t consumption_upload_t;
+
+/**
+ * @brief Summary of an upload
+ */
+typedef struct {
+    uint32_t period_start;          /**< Start of the uploaded period */
+    uint32_t period_end;            /**< End of the uploaded period */
+    uint32_t events;                /**< Units in the period */
+    uint32_t bytes;                 /**< Payload bytes produced so far */
+} consumption_upload_info_t;
+
+/**
+ * @brief Called when a sync becomes due
+ */
+typedef void (*consumption_sync_notify_t)(void* ctx);
+
+/**
+ * @brief Replace inline syncs on dispense with a notification
+ *
+ * When a handler is set, dispenses never upload. notify() is called once
+ * when a sync becomes due, and again only after the next
+ * consumption_upload_begin(). It runs on the dispensing thread and must not
+ * block.
+ *
+ * @param notify Handler, or NULL to restore inline syncs
+ * @param ctx Context passed to the handler
+ */
+void consumption_set_sync_handler(consumption_sync_notify_t notify, void* ctx);
+
+/**
+ * @brief Get the time at which the next sync becomes due
+ *
+ * @param timestamp Pointer to store the due time (0 if the external API is off)
+ * @return CONSUMPTION_SUCCESS on success
+ */
+consumption_error_t consumption_get_next_sync(uint32_t* timestamp);
+
+/**
+ * @brief Start uploading the open period
+ *
+ * @param upload Pointer to store the upload, NULL if nothing is due
+ * @return CONSUMPTION_SUCCESS on success, CONSUMPTION_ERROR_API_ERROR if an
+ *         upload is already in flight
+ */
+consumption_error_t consumption_upload_begin(consumption_upload_t** upload);
+
+/**
+ * @brief Pull callback producing the upload's JSON payload
+ *
+ * Matches consumption_network_read_t and the platform stream hook.
+ *
+ * @param buffer Buffer to fill
+ * @param size Capacity of the buffer
+ * @param upload Upload from consumption_upload_begin()
+ * @return Bytes written, 0 at the end of the payload
+ */
+size_t consumption_upload_read(char* buffer, size_t size, void* upload);
+
+/**
+ * @brief Describe an upload in flight
+ *
+ * @param upload Upload from consumption_upload_begin()
+ * @param info Summary to fill
+ * @return CONSUMPTION_SUCCESS on success
+ */
+consumption_error_t consumption_upload_get_info(const consumption_upload_t* upload,
+                                               consumption_upload_info_t* info);
+
+/**
+ * @brief Complete an upload
+ *
+ * On success the period is closed and the state saved; on failure its
+ * counters return to the open period and sync_failures is incremented.
+ *
+ * @param upload Upload from consumption_upload_begin()
+ * @param success Whether the payload was acknowledged
+ * @return CONSUMPTION_SUCCESS if the period was closed
+ */
+consumption_error_t consumption_upload_finish(consumption_upload_t* upload, bool success);
+
+/* ============================================================================
+ * MEMORY FOOTPRINT
+ * ============================================================================ */
+
+/**
+ * @brief Memory-consuming components of the module
+ */
+typedef enum {
+    CONSUMPTION_COMPONENT_STATE = 0,      /**< Module state incl. embedded config */
+    CONSUMPTION_COMPONENT_RING = 1,       /**< Raw event ring buffer */
+    CONSUMPTION_COMPONENT_AGGREGATES = 2, /**< Period aggregates */
+    CONSUMPTION_COMPONENT_SERIALIZER = 3, /**< JSON payload buffers */
+    CONSUMPTION_COMPONENT_NETWORK = 4,    /**< Endpoint/credential storage */
+    CONSUMPTION_COMPONENT_COUNT = 5
+} consumption_component_t;
+
+/**
+ * @brief Memory use of a single component, in bytes
+ */
+typedef struct {
+    uint32_t static_bytes;        /**< .bss/.data owned by the component */
+    uint32_t heap_bytes;          /**< Heap currently allocated */
+    uint32_t peak_stack_bytes;    /**< Largest stack frame contribution */
+    uint32_t budget_bytes;        /**< Configured budget (0 = unlimited) */
+    bool over_budget;             /**< Budget could not be honored */
+} consumption_component_footprint_t;
+
+/**
+ * @brief Memory footprint report
+ */
+typedef struct {
+    consumption_component_footprint_t components[CONSUMPTION_COMPONENT_COUNT];
+    uint32_t total_static_bytes;       /**< Sum of static bytes */
+    uint32_t total_heap_bytes;         /**< Sum of heap bytes */
+    uint32_t total_peak_stack_bytes;   /**< Worst-case stack (largest call path) */
+} consumption_footprint_t;
+
+/**
+ * @brief Report static, heap and peak stack usage per component
+ *
+ * Can be called before consumption_init() to obtain the static and stack
+ * figures; heap figures are zero until the module is initialized.
+ *
+ * @param footprint Pointer to footprint report to fill
+ * @return CONSUMPTION_SUCCESS on success
+ */
+consumption_error_t consumption_get_footprint(consumption_footprint_t* footprint);
+
+/**
+ * @brief Set a hard memory budget for a component
+ *
+ * Budgets degrade gracefully instead of failing:
+ * - RING: the ring is shrunk to the number of events that fit (min. 1).
+ *   Takes effect at the next consumption_init().
+ * - SERIALIZER: caps the chunk the serializer fills per pull (min. 64 bytes).
+ *   Payloads are still sent whole through
+ *   consumption_platform_network_send_stream(); scratch stays at one
+ *   160-byte item. Platforms without streaming get a single send of the
+ *   items that fit the budget (min. 320 bytes), flagged "truncated".
+ * - Fixed-size components (STATE, AGGREGATES, NETWORK) cannot shrink and
+ *   are reported as over_budget.
+ *
+ * @param component Component to constrain
+ * @param budget_bytes Budget in bytes (0 removes the budget)
+ * @return CONSUMPTION_SUCCESS on success, error code otherwise
+ */
+consumption_error_t consumption_set_memory_budget(consumption_component_t component,
+                                                uint32_t budget_bytes);
+
+/* ============================================================================
+ * STORAGE SEALING
+ * ============================================================================ */
+
+#define CONSUMPTION_STORAGE_KEY_SIZE 32
+
+/**
+ * @brief Encrypt and authenticate persisted state (ChaCha20-Poly1305)
+ *
+ * Set before consumption_init(); the key is kept across init like memory
+ * budgets. While a key is set, records that are unsealed, sealed with
+ * another key or modified are treated as corrupted storage and the module
+ * starts with fresh counters. Sync pending data before enabling sealing on
+ * a machine with existing plaintext state.
+ *
+ * @param key CONSUMPTION_STORAGE_KEY_SIZE bytes, NULL to store plaintext
+ * @return CONSUMPTION_SUCCESS on success
+ */
+consumption_error_t consumption_set_storage_key(const uint8_t* key);
+
+/* ============================================================================
+ * REPLICATION LOG
+ * ============================================================================ */
+
+/*
+ * Everything that changes the module state can be observed as an ordered
+ * log: one record per dispensed event, and a checkpoint of the persisted
+ * record (counters and sync cursor) whenever an upload finishes. Applying
+ * the same log to a second instance configured for the same machine, that
+ * does not dispense or upload itself, keeps it a copy ready to take over
+ * (see consumption_replica.h).
+ */
+
+/**
+ * @brief Log record types
+ */
+typedef enum {
+    CONSUMPTION_LOG_DISPENSE = 1,   /**< An event was recorded */
+    CONSUMPTION_LOG_CHECKPOINT = 2  /**< The persisted record changed */
+} consumption_log_type_t;
+
+/**
+ * @brief Log record
+ */
+typedef struct {
+    consumption_log_type_t type;
+    consumption_event_t event;      /**< DISPENSE: the event */
+    const void* state;              /**< CHECKPOINT: persisted record as stored (sealed with a storage key) */
+    uint32_t state_size;            /**< CHECKPOINT: its size */
+} consumption_log_record_t;
+
+/**
+ * @brief Called for each log record, on the thread that caused it
+ */
+typedef void (*consumption_log_handler_t)(const consumption_log_record_t* record, void* ctx);
+
+/**
+ * @brief Observe the replication log
+ *
+ * Like the sync handler, kept across init. The handler runs on the
+ * dispensing or uploading thread, may be called from several dispensing
+ * threads at once, and must not call back into the module.
+ *
+ * @param handler Handler, or NULL to stop
+ * @param ctx Context passed to the handler
+ */
+void consumption_set_log_handler(consumption_log_handler_t handler, void* ctx);
+
+/**
+ * @brief Log a checkpoint of the current state now
+ *
+ * Gives a standby that joins late, or missed records, a base to apply
+ * later records on. Does nothing without a log handler.
+ *
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_CONFIG if not initialized
+ */
+consumption_error_t consumption_log_checkpoint(void);
+
+/**
+ * @brief Apply a record from another instance's log
+ *
+ * Dispenses are recorded without triggering a sync; a checkpoint replaces
+ * the counters and sync cursor and is saved to storage. Nothing is logged.
+ *
+ * @param record Record
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_CONFIG if not initialized,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for another machine's records
+ *         or checkpoints that fail validation
+ */
+consumption_error_t consumption_log_apply(const consumption_log_record_t* record);
+
 /* ============================================================================
  * CONFIGURATION MANAGEMENT
  * ============================================================================ */
@@ -181,6 +550,12 @@ consumption_error_t consumption_force_sync(void);
  * Allows dynamic reconfiguration without restart.
  * Not all parameters may be changeable at runtime.
  *
+ * Changing machine_id first syncs the open period under the old ID (if the
+ * external API is enabled), then starts with fresh counters and an empty
+ * ring, as consumption_init() does for a new machine. Unsent data of the
+ * old machine is dropped. Refused with CONSUMPTION_ERROR_API_ERROR while
+ * an asynchronous upload is in flight.
+ *
  * @param config Pointer to new configuration
  * @return CONSUMPTION_SUCCESS on success, error code otherwise
  */
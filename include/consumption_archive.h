@@ -0,0 +1,255 @@
+/**
+ * @file consumption_archive.h
+ * @brief Columnar event archive and query engine for gateways
+ *
+ * Gateways that receive raw events (payloads uploaded with upload_events)
+ * append them to an archive kept as columns: timestamp, machine ID,
+ * product ID and quantity. Columns are split into segments, and segments
+ * into blocks of 1024 rows with min/max statistics per column.
+ *
+ * Queries filter on a time range, a machine ID range and a product, and
+ * sum events and units, optionally grouped by product and/or hour and cut
+ * to the top N groups. Blocks whose statistics rule the predicates out are
+ * skipped, blocks that match entirely are answered from their statistics
+ * where the grouping allows, and the rest are scanned 1024 rows at a time
+ * by vector kernels. Segments are spread over a thread pool and result
+ * rows are streamed to a callback, so no result set is built.
+ *
+ * @code
+ * consumption_archive_t* archive = consumption_archive_create(NULL);
+ * consumption_archive_append(archive, events, count);
+ *
+ * consumption_query_t query;
+ * consumption_query_default(&query);
+ * query.time_from = day_start;
+ * query.time_to = day_start + 86400;
+ * query.group_by = CONSUMPTION_QUERY_GROUP_PRODUCT;
+ * query.top_n = 10;
+ * consumption_archive_query(archive, &query, on_row, NULL, NULL);
+ * @endcode
+ *
+ * An archive is not thread-safe: append and query from one thread (the
+ * query's worker threads are internal).
+ */
+
+#ifndef CONSUMPTION_ARCHIVE_H
+#define CONSUMPTION_ARCHIVE_H
+
+#include "consumption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define CONSUMPTION_ARCHIVE_BLOCK_ROWS 1024        /**< Rows per block */
+#define CONSUMPTION_QUERY_MAX_HOURS (31 * 24)      /**< Longest range grouped by hour */
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Archive configuration
+ */
+typedef struct {
+    uint32_t segment_rows;          /**< Rows per segment, a multiple of 1024 (default: 65536) */
+    uint32_t threads;               /**< Query threads including the caller, 1-64 (default: 1) */
+} consumption_archive_config_t;
+
+/**
+ * @brief Archive statistics
+ */
+typedef struct {
+    uint64_t rows;                  /**< Events archived */
+    uint32_t segments;              /**< Segments allocated */
+    uint64_t memory_bytes;          /**< Heap held by the archive */
+} consumption_archive_stats_t;
+
+/**
+ * @brief Query grouping
+ */
+typedef enum {
+    CONSUMPTION_QUERY_GROUP_NONE = 0,          /**< One row: the filtered totals */
+    CONSUMPTION_QUERY_GROUP_PRODUCT = 1,       /**< One row per product */
+    CONSUMPTION_QUERY_GROUP_HOUR = 2,          /**< One row per hour */
+    CONSUMPTION_QUERY_GROUP_PRODUCT_HOUR = 3   /**< One row per product and hour */
+} consumption_query_group_t;
+
+/**
+ * @brief Query: predicates, grouping and limit
+ */
+typedef struct {
+    uint32_t time_from;             /**< First timestamp included (default: 0) */
+    uint32_t time_to;               /**< First timestamp excluded, 0 for none (default: 0) */
+    uint32_t machine_from;          /**< Lowest machine ID included (default: 0) */
+    uint32_t machine_to;            /**< Highest machine ID included, 0 for none (default: 0) */
+    uint8_t product_id;             /**< Product, 0 for all (default: 0) */
+    consumption_query_group_t group_by; /**< Grouping (default: NONE) */
+    uint32_t top_n;                 /**< Only the N groups with most units, 0 for all (default: 0) */
+} consumption_query_t;
+
+/**
+ * @brief Result row
+ */
+typedef struct {
+    uint8_t product_id;             /**< Product, 0 unless grouped by product */
+    uint32_t hour_start;            /**< Hour, 0 unless grouped by hour */
+    uint64_t events;                /**< Matching events */
+    uint64_t units;                 /**< Sum of their quantities */
+} consumption_query_row_t;
+
+/**
+ * @brief Result row callback
+ */
+typedef void (*consumption_query_row_cb_t)(const consumption_query_row_t* row, void* user);
+
+/**
+ * @brief Consecutive archived rows, one array per column
+ */
+typedef struct {
+    uint32_t count;                 /**< Rows */
+    const uint32_t* timestamp;      /**< Unix timestamps */
+    const uint32_t* machine_id;     /**< Machine identifiers */
+    const uint8_t* product_id;      /**< Product identifiers */
+    const uint16_t* quantity;       /**< Units */
+} consumption_archive_rows_t;
+
+/**
+ * @brief Scan callback
+ */
+typedef void (*consumption_archive_rows_cb_t)(const consumption_archive_rows_t* rows, void* user);
+
+/**
+ * @brief Query execution statistics
+ */
+typedef struct {
+    uint32_t segments;              /**< Segments visited */
+    uint32_t blocks;                /**< Blocks in those segments */
+    uint32_t blocks_pruned;         /**< Skipped by min/max statistics */
+    uint32_t blocks_covered;        /**< Answered from statistics without a scan */
+    uint64_t rows_scanned;          /**< Rows evaluated by the kernels */
+} consumption_query_stats_t;
+
+/**
+ * @brief Archive (opaque)
+ */
+typedef struct consumption_archive_t consumption_archive_t;
+
+/* ============================================================================
+ * ARCHIVE
+ * ============================================================================ */
+
+/**
+ * @brief Create default archive configuration
+ *
+ * @param config Configuration to initialize
+ */
+void consumption_archive_config_default(consumption_archive_config_t* config);
+
+/**
+ * @brief Create an archive and its query threads
+ *
+ * @param config Configuration, NULL for defaults
+ * @return Archive, or NULL on invalid configuration or allocation failure
+ */
+consumption_archive_t* consumption_archive_create(const consumption_archive_config_t* config);
+
+/**
+ * @brief Append events
+ *
+ * Events may arrive in any order; blocks holding events close in time
+ * prune best.
+ *
+ * @param archive Archive
+ * @param events Events to append
+ * @param count Number of events
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for NULL arguments,
+ *         CONSUMPTION_ERROR_MEMORY_ERROR if a segment could not be
+ *         allocated (earlier events are kept)
+ */
+consumption_error_t consumption_archive_append(consumption_archive_t* archive,
+                                               const consumption_event_t* events, uint32_t count);
+
+/**
+ * @brief Get archive statistics
+ *
+ * @param archive Archive
+ * @param stats Statistics to fill
+ */
+void consumption_archive_get_stats(const consumption_archive_t* archive,
+                                   consumption_archive_stats_t* stats);
+
+/**
+ * @brief Stop the query threads and free the archive
+ *
+ * @param archive Archive, may be NULL
+ */
+void consumption_archive_destroy(consumption_archive_t* archive);
+
+/* ============================================================================
+ * QUERIES
+ * ============================================================================ */
+
+/**
+ * @brief Create a query matching everything, ungrouped
+ *
+ * @param query Query to initialize
+ */
+void consumption_query_default(consumption_query_t* query);
+
+/**
+ * @brief Run a query
+ *
+ * Rows come in product, then hour order, or by units descending with
+ * top_n. Groups without matching events are not reported; an ungrouped
+ * query always reports its one row.
+ *
+ * @param archive Archive
+ * @param query Query
+ * @param on_row Called for each result row on the calling thread
+ * @param user Passed to on_row
+ * @param stats Execution statistics, may be NULL
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for empty ranges, or hour
+ *         grouping without time_to or over more than
+ *         CONSUMPTION_QUERY_MAX_HOURS hours,
+ *         CONSUMPTION_ERROR_MEMORY_ERROR if group tables could not be
+ *         allocated
+ */
+consumption_error_t consumption_archive_query(consumption_archive_t* archive,
+                                              const consumption_query_t* query,
+                                              consumption_query_row_cb_t on_row, void* user,
+                                              consumption_query_stats_t* stats);
+
+/**
+ * @brief Read the raw rows of a time range
+ *
+ * Hands out the archive's columns a block at a time, in append order,
+ * skipping blocks whose statistics lie outside the range. Blocks are
+ * passed whole, so rows outside the range may be included. Scans only
+ * read the archive: several may run on different threads at once, but
+ * not while events are appended.
+ *
+ * @param archive Archive
+ * @param time_from First timestamp wanted
+ * @param time_to First timestamp not wanted, 0 for none
+ * @param on_rows Called per block on the calling thread
+ * @param user Passed to on_rows
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for NULL arguments or an
+ *         empty range
+ */
+consumption_error_t consumption_archive_scan(const consumption_archive_t* archive,
+                                             uint32_t time_from, uint32_t time_to,
+                                             consumption_archive_rows_cb_t on_rows, void* user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_ARCHIVE_H */
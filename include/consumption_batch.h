@@ -0,0 +1,191 @@
+/**
+ * @file consumption_batch.h
+ * @brief Fan-in batching of many machines' aggregates into few uploads
+ *
+ * A gateway uploading one request per machine and period pays a request,
+ * a TLS record and a backend transaction for a few dozen bytes of counts.
+ * A batcher queues closed-period aggregates from any number of machines
+ * and hands them out as one JSON document per upload, bounded by size and
+ * by how long the oldest entry may wait:
+ *
+ *   {"gateway":7,"batch":12,"entries":[{"machine_id":...},...]}
+ *
+ * Entries use the same object as single-machine uploads. The backend
+ * answers per entry; entries it rejects are retried in a later batch on
+ * their own, without resending the ones it accepted, and a failed request
+ * retries its whole batch after a delay.
+ *
+ * @code
+ * consumption_batch_t* batch = consumption_batch_create(&config);
+ * consumption_fleet_collect(fleet, add_to_batch, batch);   // consumption_batch_add()
+ *
+ * if (consumption_batch_ready(batch, now)) {
+ *     uint32_t id;
+ *     size_t len = consumption_batch_take(batch, buffer, sizeof(buffer), &id);
+ *     // POST buffer[0..len), parse per-entry results into accepted[]
+ *     consumption_batch_complete(batch, id, accepted, count, now);  // NULL if the POST failed
+ * }
+ * @endcode
+ *
+ * Times are Unix timestamps in seconds. A batcher is not thread-safe.
+ */
+
+#ifndef CONSUMPTION_BATCH_H
+#define CONSUMPTION_BATCH_H
+
+#include "consumption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Smallest max_bytes; fits the largest single entry */
+#define CONSUMPTION_BATCH_MIN_BYTES 8192
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Batcher configuration
+ */
+typedef struct {
+    uint32_t gateway_id;            /**< Reported in every batch */
+    uint32_t max_bytes;             /**< Payload size limit, >= CONSUMPTION_BATCH_MIN_BYTES (default: 65536) */
+    uint32_t max_delay;             /**< Longest wait of a queued entry, seconds (default: 2) */
+    uint32_t max_entries;           /**< Entries queued or in flight (default: 4096) */
+    uint32_t max_in_flight;         /**< Batches awaiting completion, 1-64 (default: 2) */
+    uint32_t retry_delay;           /**< Wait after a failed request, seconds (default: 10) */
+    uint32_t max_attempts;          /**< Rejections before an entry is dropped, 0 = never (default: 5) */
+} consumption_batch_config_t;
+
+/**
+ * @brief Batcher statistics
+ */
+typedef struct {
+    uint32_t queued;                /**< Entries waiting for a batch */
+    uint32_t in_flight;             /**< Entries in batches awaiting completion */
+    uint64_t batches;               /**< Batches taken */
+    uint64_t failed_batches;        /**< Batches completed as failed requests */
+    uint64_t entries_sent;          /**< Entries put into batches, retries included */
+    uint64_t entries_acked;         /**< Entries accepted */
+    uint64_t entries_rejected;      /**< Entries rejected and requeued or dropped */
+    uint64_t entries_dropped;       /**< Entries dropped after max_attempts */
+    uint64_t bytes;                 /**< Payload bytes taken */
+} consumption_batch_stats_t;
+
+/**
+ * @brief Batcher (opaque)
+ */
+typedef struct consumption_batch_t consumption_batch_t;
+
+/* ============================================================================
+ * BATCHER
+ * ============================================================================ */
+
+/**
+ * @brief Create default batcher configuration
+ *
+ * @param config Configuration to initialize
+ */
+void consumption_batch_config_default(consumption_batch_config_t* config);
+
+/**
+ * @brief Create a batcher
+ *
+ * @param config Configuration, NULL for defaults
+ * @return Batcher, or NULL on invalid configuration or allocation failure
+ */
+consumption_batch_t* consumption_batch_create(const consumption_batch_config_t* config);
+
+/**
+ * @brief Queue a closed period
+ *
+ * The aggregate is serialized now; products with a zero count are left out.
+ *
+ * @param batch Batcher
+ * @param aggregate Closed period of one machine
+ * @param now Current time, starts the entry's max_delay
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for NULL arguments,
+ *         CONSUMPTION_ERROR_STORAGE_FULL when max_entries are held,
+ *         CONSUMPTION_ERROR_MEMORY_ERROR
+ */
+consumption_error_t consumption_batch_add(consumption_batch_t* batch,
+                                          const consumption_aggregate_t* aggregate, uint32_t now);
+
+/**
+ * @brief Whether a batch should be taken now
+ *
+ * True when the queued entries fill max_bytes or the oldest has waited
+ * max_delay, a batch may be put in flight and no retry delay is running.
+ *
+ * @param batch Batcher
+ * @param now Current time
+ * @return Whether to call consumption_batch_take()
+ */
+bool consumption_batch_ready(const consumption_batch_t* batch, uint32_t now);
+
+/**
+ * @brief Earliest time consumption_batch_ready() can become true by waiting
+ *
+ * @param batch Batcher
+ * @param now Current time
+ * @param timestamp Receives the time (now or later), 0 if nothing is queued
+ *                  or a completion is needed first
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for NULL arguments
+ */
+consumption_error_t consumption_batch_next_due(const consumption_batch_t* batch, uint32_t now,
+                                               uint32_t* timestamp);
+
+/**
+ * @brief Build the next batch from the oldest queued entries
+ *
+ * Ignores max_delay, so it also flushes, e.g. at shutdown; only the
+ * in-flight limit applies. Entries whose last request failed go first.
+ *
+ * @param batch Batcher
+ * @param buffer Receives the JSON payload, NUL-terminated
+ * @param size Capacity of buffer, at least max_bytes + 1
+ * @param batch_id Receives the batch ID for consumption_batch_complete()
+ * @return Payload length, 0 if nothing is queued, max_in_flight batches
+ *         are out or size is too small
+ */
+size_t consumption_batch_take(consumption_batch_t* batch, char* buffer, size_t size,
+                              uint32_t* batch_id);
+
+/**
+ * @brief Report the backend's answer to a batch
+ *
+ * @param batch Batcher
+ * @param batch_id Batch
+ * @param accepted Per entry in payload order, NULL if the request failed
+ *                 as a whole
+ * @param count Entries in accepted; must match the batch
+ * @param now Current time
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for an
+ *         unknown batch or a count mismatch
+ */
+consumption_error_t consumption_batch_complete(consumption_batch_t* batch, uint32_t batch_id,
+                                               const bool* accepted, uint32_t count, uint32_t now);
+
+/**
+ * @brief Get batcher statistics
+ *
+ * @param batch Batcher
+ * @param stats Statistics to fill
+ */
+void consumption_batch_get_stats(const consumption_batch_t* batch, consumption_batch_stats_t* stats);
+
+/**
+ * @brief Free a batcher and every entry it holds
+ *
+ * @param batch Batcher, may be NULL
+ */
+void consumption_batch_destroy(consumption_batch_t* batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_BATCH_H */
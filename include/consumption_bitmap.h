@@ -0,0 +1,154 @@
+/**
+ * @file consumption_bitmap.h
+ * @brief Compressed bitmaps (roaring layout) for gateway indexes
+ *
+ * Sets of 32-bit values, typically dense machine ordinals. Values are
+ * grouped by their upper 16 bits into containers; a container holds a
+ * sorted array of the lower 16 bits while it has up to 4096 entries and a
+ * 65536-bit bitset above that, so sparse and dense sets both stay small
+ * and set operations work a container at a time.
+ *
+ * Bitmaps are not thread-safe. Allocation failures are reported as false.
+ */
+
+#ifndef CONSUMPTION_BITMAP_H
+#define CONSUMPTION_BITMAP_H
+
+#include "consumption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Compressed bitmap (opaque)
+ */
+typedef struct consumption_bitmap_t consumption_bitmap_t;
+
+/* ============================================================================
+ * LIFECYCLE
+ * ============================================================================ */
+
+/**
+ * @brief Create an empty bitmap
+ *
+ * @return Bitmap, or NULL if out of memory
+ */
+consumption_bitmap_t* consumption_bitmap_create(void);
+
+/**
+ * @brief Free a bitmap
+ *
+ * @param bitmap Bitmap, may be NULL
+ */
+void consumption_bitmap_destroy(consumption_bitmap_t* bitmap);
+
+/**
+ * @brief Remove all values, keeping the bitmap usable
+ *
+ * @param bitmap Bitmap
+ */
+void consumption_bitmap_clear(consumption_bitmap_t* bitmap);
+
+/**
+ * @brief Make dst a copy of src
+ *
+ * @return false if out of memory (dst is then empty)
+ */
+bool consumption_bitmap_copy(consumption_bitmap_t* dst, const consumption_bitmap_t* src);
+
+/* ============================================================================
+ * VALUES
+ * ============================================================================ */
+
+/**
+ * @brief Add a value
+ *
+ * @return false if out of memory
+ */
+bool consumption_bitmap_add(consumption_bitmap_t* bitmap, uint32_t value);
+
+/**
+ * @brief Remove a value (no-op if absent)
+ */
+void consumption_bitmap_remove(consumption_bitmap_t* bitmap, uint32_t value);
+
+/**
+ * @brief Check whether a value is present
+ */
+bool consumption_bitmap_contains(const consumption_bitmap_t* bitmap, uint32_t value);
+
+/**
+ * @brief Number of values
+ */
+uint32_t consumption_bitmap_cardinality(const consumption_bitmap_t* bitmap);
+
+/**
+ * @brief Copy values in ascending order
+ *
+ * @param bitmap Bitmap
+ * @param values Output array
+ * @param max Capacity of values
+ * @return Values copied (at most max)
+ */
+uint32_t consumption_bitmap_to_array(const consumption_bitmap_t* bitmap, uint32_t* values,
+                                     uint32_t max);
+
+/* ============================================================================
+ * SET OPERATIONS
+ * ============================================================================ */
+
+/**
+ * @brief dst = dst AND src
+ *
+ * @return false if out of memory (dst is then unspecified)
+ */
+bool consumption_bitmap_and(consumption_bitmap_t* dst, const consumption_bitmap_t* src);
+
+/**
+ * @brief dst = dst OR src
+ *
+ * @return false if out of memory (dst is then unspecified)
+ */
+bool consumption_bitmap_or(consumption_bitmap_t* dst, const consumption_bitmap_t* src);
+
+/**
+ * @brief dst = dst AND NOT src
+ *
+ * @return false if out of memory (dst is then unspecified)
+ */
+bool consumption_bitmap_andnot(consumption_bitmap_t* dst, const consumption_bitmap_t* src);
+
+/* ============================================================================
+ * PERSISTENCE
+ * ============================================================================ */
+
+/**
+ * @brief Bytes of heap held by a bitmap
+ */
+size_t consumption_bitmap_memory(const consumption_bitmap_t* bitmap);
+
+/**
+ * @brief Write a bitmap to a buffer (host byte order)
+ *
+ * @param bitmap Bitmap
+ * @param buffer Output, NULL to query the size
+ * @param size Capacity of buffer
+ * @return Serialized size; nothing is written if it exceeds size
+ */
+size_t consumption_bitmap_serialize(const consumption_bitmap_t* bitmap, void* buffer, size_t size);
+
+/**
+ * @brief Read a bitmap written by consumption_bitmap_serialize()
+ *
+ * @param buffer Serialized bitmap
+ * @param len Bytes available
+ * @return Bitmap, or NULL if malformed or out of memory
+ */
+consumption_bitmap_t* consumption_bitmap_deserialize(const void* buffer, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_BITMAP_H */
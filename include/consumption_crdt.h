@@ -0,0 +1,243 @@
+/**
+ * @file consumption_crdt.h
+ * @brief Mergeable counters for redundant gateways
+ *
+ * Gateways that share a site keep per-period unit counters as state-based
+ * grow-only counters (G-counters). Each entry is keyed by (machine,
+ * period, replica) and holds a total and per-product counters; a replica
+ * is whoever counted the units: the machine that uploaded an aggregate,
+ * or a gateway counting on its own. Only that replica ever raises its
+ * entry, so the value of a (machine, period) is the sum of its replicas'
+ * entries, and two entries for the same key merge by taking the larger
+ * value of each counter.
+ *
+ * Merging is commutative, associative and idempotent: gateways exchange
+ * deltas (the counters changed since their last delta) in any order, as
+ * often as they like, with no locks or leader, and end with the same
+ * counters. An aggregate received by both gateways counts once, so either
+ * one can upload exact totals upstream.
+ *
+ * @code
+ * consumption_crdt_t* counters = consumption_crdt_create(NULL);
+ * consumption_crdt_observe(counters, 0, &aggregate);   // as payloads arrive
+ *
+ * uint8_t delta[4096];
+ * size_t len = consumption_crdt_delta(counters, delta, sizeof(delta));
+ * // ... send to the other gateways, which call:
+ * consumption_crdt_merge(other, delta, len);
+ * @endcode
+ *
+ * A counter set is not thread-safe.
+ */
+
+#ifndef CONSUMPTION_CRDT_H
+#define CONSUMPTION_CRDT_H
+
+#include "consumption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+/** Smallest delta buffer that holds any one entry */
+#define CONSUMPTION_CRDT_DELTA_MIN (8 + 5 * 5 + 256 * 6)
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Counter set configuration
+ */
+typedef struct {
+    uint32_t max_entries;           /**< (machine, period, replica) entries (default: 4096) */
+    uint32_t products;              /**< Product IDs kept per entry, 2-256 (default: 256) */
+} consumption_crdt_config_t;
+
+/**
+ * @brief Counter set statistics
+ */
+typedef struct {
+    uint32_t entries;               /**< Entries held */
+    uint32_t pending;               /**< Entries with changes not yet in a delta */
+    uint64_t deltas;                /**< Deltas produced */
+    uint64_t merges;                /**< Deltas merged */
+    uint64_t raised;                /**< Counters raised by merges */
+    uint64_t late;                  /**< Updates refused: period already evicted */
+    uint32_t horizon;               /**< Periods starting before this are evicted */
+    uint32_t memory_bytes;          /**< Heap held by the set */
+} consumption_crdt_stats_t;
+
+/**
+ * @brief Merged aggregate callback
+ */
+typedef void (*consumption_crdt_aggregate_cb_t)(const consumption_aggregate_t* aggregate, void* user);
+
+/**
+ * @brief Counter set (opaque)
+ */
+typedef struct consumption_crdt_t consumption_crdt_t;
+
+/* ============================================================================
+ * COUNTERS
+ * ============================================================================ */
+
+/**
+ * @brief Create default counter set configuration
+ *
+ * @param config Configuration to initialize
+ */
+void consumption_crdt_config_default(consumption_crdt_config_t* config);
+
+/**
+ * @brief Create a counter set; all memory is allocated here
+ *
+ * Takes about max_entries * (products * 4 + 64) bytes, 4.5 MB with the
+ * defaults.
+ *
+ * @param config Configuration, NULL for defaults
+ * @return Counter set, or NULL on invalid configuration or allocation failure
+ */
+consumption_crdt_t* consumption_crdt_create(const consumption_crdt_config_t* config);
+
+/**
+ * @brief Count units as a replica
+ *
+ * For a gateway counting on its own behalf, under a replica ID no other
+ * gateway uses. Products at or above config.products only count in the
+ * total.
+ *
+ * @param crdt Counter set
+ * @param machine_id Machine
+ * @param period_start Period
+ * @param replica_id Counting replica
+ * @param product_id Product (1-255)
+ * @param units Units to add
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for product 0 or an evicted period,
+ *         CONSUMPTION_ERROR_STORAGE_FULL if max_entries are in use
+ */
+consumption_error_t consumption_crdt_add(consumption_crdt_t* crdt, uint32_t machine_id,
+                                         uint32_t period_start, uint32_t replica_id,
+                                         uint8_t product_id, uint32_t units);
+
+/**
+ * @brief Record a machine aggregate
+ *
+ * The aggregate's counters are the replica's counts for its period, so
+ * each counter is raised to the aggregate's value: the same aggregate
+ * received twice, or by two gateways, counts once. Use replica 0 unless a
+ * machine runs several counting processes for one period.
+ *
+ * @param crdt Counter set
+ * @param replica_id Counting replica on the machine
+ * @param aggregate Machine aggregate
+ * @return As consumption_crdt_add()
+ */
+consumption_error_t consumption_crdt_observe(consumption_crdt_t* crdt, uint32_t replica_id,
+                                             const consumption_aggregate_t* aggregate);
+
+/**
+ * @brief Write the changes since the last delta
+ *
+ * Entries are written whole for the counters that changed. Entries that
+ * do not fit stay pending for the next call; a buffer of
+ * CONSUMPTION_CRDT_DELTA_MIN bytes always holds at least one.
+ *
+ * @param crdt Counter set
+ * @param buffer Destination
+ * @param size Capacity of buffer
+ * @return Bytes written, 0 if nothing is pending or size is too small
+ */
+size_t consumption_crdt_delta(consumption_crdt_t* crdt, void* buffer, size_t size);
+
+/**
+ * @brief Mark every entry pending, so the next deltas carry the full state
+ *
+ * For a gateway that (re)joins the site.
+ *
+ * @param crdt Counter set
+ */
+void consumption_crdt_mark_all(consumption_crdt_t* crdt);
+
+/**
+ * @brief Merge a delta from another gateway
+ *
+ * Counters raised by the merge become pending, so deltas travel on to
+ * gateways that did not receive them. Entries for evicted periods are
+ * skipped; products at or above config.products are dropped.
+ *
+ * @param crdt Counter set
+ * @param delta Delta written by consumption_crdt_delta()
+ * @param len Delta size
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER if malformed (nothing is merged),
+ *         CONSUMPTION_ERROR_STORAGE_FULL if some entries could not be
+ *         created (the rest are merged; merging again is harmless)
+ */
+consumption_error_t consumption_crdt_merge(consumption_crdt_t* crdt, const void* delta, size_t len);
+
+/**
+ * @brief Counters of a machine and period, summed over replicas
+ *
+ * @param crdt Counter set
+ * @param machine_id Machine
+ * @param period_start Period
+ * @param aggregate Receives the counters; product_counts[0] is 0
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER if
+ *         nothing was counted for the period
+ */
+consumption_error_t consumption_crdt_read(const consumption_crdt_t* crdt, uint32_t machine_id,
+                                          uint32_t period_start, consumption_aggregate_t* aggregate);
+
+/**
+ * @brief Report every (machine, period) starting before a time, merged
+ *
+ * For the upstream upload that precedes consumption_crdt_evict().
+ *
+ * @param crdt Counter set
+ * @param before First period start excluded
+ * @param on_aggregate Called once per (machine, period), in no particular order
+ * @param user Passed to on_aggregate
+ * @return Aggregates reported
+ */
+uint32_t consumption_crdt_collect(const consumption_crdt_t* crdt, uint32_t before,
+                                  consumption_crdt_aggregate_cb_t on_aggregate, void* user);
+
+/**
+ * @brief Drop periods starting before a time
+ *
+ * Later updates for those periods, local or merged, are refused, so an
+ * evicted period cannot come back with partial counts. Evict only periods
+ * every gateway has reported upstream.
+ *
+ * @param crdt Counter set
+ * @param before First period start kept
+ * @return Entries dropped
+ */
+uint32_t consumption_crdt_evict(consumption_crdt_t* crdt, uint32_t before);
+
+/**
+ * @brief Get counter set statistics
+ *
+ * @param crdt Counter set
+ * @param stats Statistics to fill
+ */
+void consumption_crdt_get_stats(const consumption_crdt_t* crdt, consumption_crdt_stats_t* stats);
+
+/**
+ * @brief Free a counter set
+ *
+ * @param crdt Counter set, may be NULL
+ */
+void consumption_crdt_destroy(consumption_crdt_t* crdt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_CRDT_H */
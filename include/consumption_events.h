@@ -0,0 +1,215 @@
+/**
+ * @file consumption_events.h
+ * @brief Event-loop integration for Consumption Counter Module
+ *
+ * Optional non-blocking sync driver for hosts built around epoll (Linux,
+ * libcurl). Dispenses no longer upload inline; the module exposes one
+ * pollable descriptor instead, which becomes readable when:
+ *
+ * - a sync became due on dispense (eventfd)
+ * - the next deadline passed: sync interval, retry backoff or a curl
+ *   timeout (timerfd)
+ * - an upload socket is ready (curl multi socket callbacks)
+ *
+ * and consumption_process_events() does the pending work without
+ * blocking. The library adds no threads.
+ *
+ * consumption_force_sync_async() requests an upload now; its callback runs
+ * inside consumption_process_events() on the host loop.
+ *
+ * Uploads use libcurl unless the configuration names another transport,
+ * which starts each upload and reports its outcome with
+ * consumption_events_upload_done().
+ *
+ * @code
+ * consumption_init(&config);
+ * consumption_events_init(NULL);
+ * epoll_ctl(loop, EPOLL_CTL_ADD, consumption_events_get_fd(), &ev);
+ * ...
+ * // when the descriptor is readable:
+ * consumption_process_events();
+ * ...
+ * consumption_events_deinit();
+ * consumption_deinit();
+ * @endcode
+ */
+
+#ifndef CONSUMPTION_EVENTS_H
+#define CONSUMPTION_EVENTS_H
+
+#include "consumption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Upload transport driven by the event loop
+ *
+ * start() begins sending an upload, pulling its payload with
+ * consumption_upload_read(), and returns without blocking; once it has
+ * returned true the outcome is reported with consumption_events_upload_done().
+ * abort() (optional) drops the upload in flight, which is then not reported.
+ * Both run on the host loop's thread. A transport waiting on descriptors of
+ * its own adds them to the host loop itself.
+ */
+typedef struct {
+    bool (*start)(consumption_upload_t* upload, void* ctx);
+    void (*abort)(void* ctx);
+    void* ctx;                      /**< Passed to start() and abort() */
+} consumption_events_transport_t;
+
+/**
+ * @brief Event-loop driver configuration
+ */
+typedef struct {
+    uint32_t timeout_ms;            /**< Whole-upload timeout, libcurl (default: 30000) */
+    uint32_t connect_timeout_ms;    /**< Connect timeout, libcurl (default: 10000) */
+    uint32_t retry_delay_ms;        /**< Wait after a failed upload (default: 60000) */
+    const consumption_events_transport_t* transport; /**< NULL for libcurl (default); copied at init */
+} consumption_events_config_t;
+
+/**
+ * @brief Asynchronous force-sync request handle (0 = invalid)
+ */
+typedef uint32_t consumption_sync_handle_t;
+
+/**
+ * @brief Outcome of an asynchronous force-sync
+ */
+typedef struct {
+    consumption_error_t result;     /**< SUCCESS, API_ERROR, NETWORK_UNAVAILABLE, TIMEOUT or CANCELLED */
+    uint32_t period_start;          /**< Uploaded period, 0 if nothing was due */
+    uint32_t period_end;
+    uint32_t events;                /**< Units in the uploaded period */
+    uint32_t bytes;                 /**< Payload bytes sent */
+    uint32_t elapsed_ms;            /**< From the request to its completion */
+    uint32_t merged;                /**< Requests completed by the same upload */
+} consumption_sync_result_t;
+
+/**
+ * @brief Completion callback of an asynchronous force-sync
+ */
+typedef void (*consumption_sync_cb_t)(consumption_sync_handle_t handle,
+                                      const consumption_sync_result_t* result,
+                                      void* user);
+
+/* ============================================================================
+ * EVENT LOOP
+ * ============================================================================ */
+
+/**
+ * @brief Create default event-loop driver configuration
+ *
+ * @param config Configuration to initialize
+ */
+void consumption_events_config_default(consumption_events_config_t* config);
+
+/**
+ * @brief Switch the module to event-loop driven syncs
+ *
+ * The module must be initialized. With libcurl, uploads go to the
+ * configured api_endpoint as chunked HTTP POSTs, with the api_key current
+ * when each upload starts.
+ *
+ * @param config Driver configuration, NULL for defaults
+ * @return CONSUMPTION_SUCCESS on success,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for a transport without start(),
+ *         CONSUMPTION_ERROR_NETWORK_UNAVAILABLE without Linux, or without
+ *         libcurl and no transport
+ */
+consumption_error_t consumption_events_init(const consumption_events_config_t* config);
+
+/**
+ * @brief Get the descriptor to add to the host loop (level-triggered)
+ *
+ * @return File descriptor, or -1 if not initialized
+ */
+int consumption_events_get_fd(void);
+
+/**
+ * @brief Do all pending work without blocking
+ *
+ * Safe to call at any time; does nothing when no work is pending.
+ *
+ * @return CONSUMPTION_SUCCESS on success
+ */
+consumption_error_t consumption_process_events(void);
+
+/**
+ * @brief Report the outcome of an upload started by a configured transport
+ *
+ * Closes the period on success, or returns its counters to the open period
+ * and starts the retry backoff, then completes the attached requests. Call
+ * from the host loop's thread.
+ *
+ * @param success Whether the payload was acknowledged
+ * @return CONSUMPTION_SUCCESS, or CONSUMPTION_ERROR_INVALID_PARAMETER if no
+ *         such upload is in flight
+ */
+consumption_error_t consumption_events_upload_done(bool success);
+
+/* ============================================================================
+ * ASYNCHRONOUS FORCE-SYNC
+ * ============================================================================ */
+
+/**
+ * @brief Request an upload of the open period without blocking
+ *
+ * Like consumption_force_sync() the period is only uploaded once the
+ * aggregation interval has passed; otherwise the callback reports success
+ * with nothing sent. Requests made before or while an upload is in flight
+ * are merged into that single upload, and a pending retry backoff is
+ * skipped. Call from the host loop's thread.
+ *
+ * @param cb Completion callback, run inside consumption_process_events()
+ * @param user Context passed to the callback
+ * @return Request handle, 0 if the driver is not running or too many
+ *         requests are pending
+ */
+consumption_sync_handle_t consumption_force_sync_async(consumption_sync_cb_t cb, void* user);
+
+/**
+ * @brief Give a request a deadline
+ *
+ * When it passes first, the callback reports CONSUMPTION_ERROR_TIMEOUT.
+ * The upload itself continues for any other request and for the period.
+ *
+ * @param handle Request handle
+ * @param timeout_ms Time from now
+ * @return CONSUMPTION_SUCCESS, or CONSUMPTION_ERROR_INVALID_PARAMETER if the
+ *         request already completed
+ */
+consumption_error_t consumption_sync_set_deadline(consumption_sync_handle_t handle,
+                                                  uint32_t timeout_ms);
+
+/**
+ * @brief Cancel a request
+ *
+ * The callback runs before this returns, with CONSUMPTION_ERROR_CANCELLED.
+ * An upload already in flight is not aborted.
+ *
+ * @param handle Request handle
+ * @return CONSUMPTION_SUCCESS, or CONSUMPTION_ERROR_INVALID_PARAMETER if the
+ *         request already completed
+ */
+consumption_error_t consumption_sync_cancel(consumption_sync_handle_t handle);
+
+/**
+ * @brief Abort any upload in flight and restore inline syncs
+ *
+ * An aborted upload's counters return to the open period and pending
+ * requests complete with CONSUMPTION_ERROR_CANCELLED. Call before
+ * consumption_deinit().
+ */
+void consumption_events_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_EVENTS_H */
@@ -0,0 +1,262 @@
+/**
+ * @file consumption_fleet.h
+ * @brief Structure-of-arrays counters for gateways hosting many machines
+ *
+ * A gateway process that counts for thousands of machines keeps their hot
+ * fields (period start, deadline, period and lifetime units) as one array
+ * per field and their product counters as one row per machine, sized to
+ * the products actually counted. Settings are shared profiles
+ * (consumption_profile.h); each machine only keeps its ID, phase and a
+ * profile reference, cold, where counting and closing never look.
+ *
+ * Closing periods is one pass over the hot arrays: deadlines are compared
+ * four machines at a time and due machines roll over together. Counters
+ * are double-buffered, so a due machine switches to its other counter row
+ * and only that row is cleared; groups of 32 machines with nothing due
+ * are skipped. Closed periods stay readable until the machine's next
+ * close.
+ *
+ * @code
+ * consumption_fleet_t* fleet = consumption_fleet_create(NULL);
+ * int32_t m = consumption_fleet_add(fleet, &machine_config, now);
+ * consumption_fleet_dispense(fleet, m, product_id, 1);
+ *
+ * // Once a second, or at the top of the hour:
+ * if (consumption_fleet_close(fleet, now) > 0) {
+ *     consumption_fleet_collect(fleet, upload_aggregate, NULL);
+ * }
+ * @endcode
+ *
+ * A fleet is not thread-safe.
+ */
+
+#ifndef CONSUMPTION_FLEET_H
+#define CONSUMPTION_FLEET_H
+
+#include "consumption.h"
+#include "consumption_profile.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Fleet configuration
+ */
+typedef struct {
+    uint32_t max_machines;          /**< Machines (default: 1024) */
+    uint32_t products;              /**< Product IDs counted per machine, 2-256 (default: 256) */
+    uint32_t max_profiles;          /**< Distinct settings among consumption_fleet_add() machines (default: 16) */
+} consumption_fleet_config_t;
+
+/**
+ * @brief Fleet statistics
+ */
+typedef struct {
+    uint32_t machines;              /**< Machines added */
+    uint32_t last_closed;           /**< Machines closed by the last close */
+    uint64_t periods_closed;        /**< Periods closed in total */
+    uint64_t hot_bytes;             /**< Heap of the hot arrays and product columns */
+    uint64_t cold_bytes;            /**< Heap of the members, ID lookup and own profiles */
+} consumption_fleet_stats_t;
+
+/**
+ * @brief Closed period callback
+ */
+typedef void (*consumption_fleet_aggregate_cb_t)(const consumption_aggregate_t* aggregate, void* user);
+
+/**
+ * @brief Fleet (opaque)
+ */
+typedef struct consumption_fleet_t consumption_fleet_t;
+
+/* ============================================================================
+ * FLEET
+ * ============================================================================ */
+
+/**
+ * @brief Create default fleet configuration
+ *
+ * @param config Configuration to initialize
+ */
+void consumption_fleet_config_default(consumption_fleet_config_t* config);
+
+/**
+ * @brief Create a fleet; all memory is allocated here
+ *
+ * Takes about max_machines * (products * 8 + 36) bytes hot and
+ * max_machines * 24 bytes cold, plus one profile per distinct setting.
+ *
+ * @param config Configuration, NULL for defaults
+ * @return Fleet, or NULL on invalid configuration or allocation failure
+ */
+consumption_fleet_t* consumption_fleet_create(const consumption_fleet_config_t* config);
+
+/**
+ * @brief Add a machine
+ *
+ * The configuration is interned into the fleet's own profiles, so
+ * machines with the same settings share one copy. The first period closes
+ * one aggregation_interval after now.
+ *
+ * @param fleet Fleet
+ * @param config Machine configuration
+ * @param now Start of its first period
+ * @return Machine index, -1 if the machine is already present, the
+ *         interval is 0, the fleet is full or max_profiles distinct
+ *         settings exist
+ */
+int32_t consumption_fleet_add(consumption_fleet_t* fleet, const consumption_config_t* config,
+                              uint32_t now);
+
+/**
+ * @brief Add a machine sharing a caller's profile
+ *
+ * The fleet takes a reference, released by consumption_fleet_destroy(),
+ * which must therefore run before the profile's registry is destroyed.
+ * Periods end at phase + k * aggregation_interval; spreading phases
+ * spreads the closes.
+ *
+ * @param fleet Fleet
+ * @param machine_id Machine
+ * @param profile Settings
+ * @param phase Offset of the period boundaries, seconds
+ * @param now Start of its first period, which may be short
+ * @return Machine index, -1 if the machine is already present, the
+ *         profile's interval is 0 or the fleet is full
+ */
+int32_t consumption_fleet_add_member(consumption_fleet_t* fleet, uint32_t machine_id,
+                                     consumption_profile_t* profile, uint32_t phase, uint32_t now);
+
+/**
+ * @brief Index of a machine
+ *
+ * @param fleet Fleet
+ * @param machine_id Machine
+ * @return Machine index, -1 if unknown
+ */
+int32_t consumption_fleet_find(const consumption_fleet_t* fleet, uint32_t machine_id);
+
+/**
+ * @brief Configuration of a machine: its profile's settings and its ID
+ *
+ * @param fleet Fleet
+ * @param index Machine index
+ * @param config Receives the configuration
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for an unknown index
+ */
+consumption_error_t consumption_fleet_get_config(const consumption_fleet_t* fleet, int32_t index,
+                                                 consumption_config_t* config);
+
+/**
+ * @brief Profile of a machine
+ *
+ * @param fleet Fleet
+ * @param index Machine index
+ * @return Profile, NULL if out of range
+ */
+consumption_profile_t* consumption_fleet_get_profile(const consumption_fleet_t* fleet, int32_t index);
+
+/**
+ * @brief Change the settings of every machine sharing a profile
+ *
+ * Publishes the new settings with consumption_profile_update(); a changed
+ * aggregation_interval applies from each member's next period.
+ *
+ * @param fleet Fleet
+ * @param profile Profile, e.g. from consumption_fleet_get_profile()
+ * @param config New settings; machine_id is ignored
+ * @param network New network settings, NULL for none
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for NULL
+ *         arguments or interval 0, CONSUMPTION_ERROR_MEMORY_ERROR
+ */
+consumption_error_t consumption_fleet_update_profile(consumption_fleet_t* fleet, consumption_profile_t* profile,
+                                                     const consumption_config_t* config,
+                                                     const consumption_network_config_t* network);
+
+/**
+ * @brief Count units for a machine
+ *
+ * Products at or above config.products only count in the total.
+ *
+ * @param fleet Fleet
+ * @param index Machine index
+ * @param product_id Product (1-255)
+ * @param quantity Units
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for an
+ *         unknown index, product 0 or quantity 0
+ */
+consumption_error_t consumption_fleet_dispense(consumption_fleet_t* fleet, int32_t index,
+                                               uint8_t product_id, uint16_t quantity);
+
+/**
+ * @brief Close the period of every machine whose interval has passed
+ *
+ * The next period starts at now and ends at the machine's next boundary
+ * after now, so a late close shortens it instead of shifting the
+ * machine's phase. Each machine's previous closed period is replaced.
+ *
+ * @param fleet Fleet
+ * @param now Current time
+ * @return Machines closed
+ */
+uint32_t consumption_fleet_close(consumption_fleet_t* fleet, uint32_t now);
+
+/**
+ * @brief Report the periods closed by the last consumption_fleet_close()
+ *
+ * @param fleet Fleet
+ * @param on_aggregate Called per machine, in index order
+ * @param user Passed to on_aggregate
+ * @return Aggregates reported
+ */
+uint32_t consumption_fleet_collect(const consumption_fleet_t* fleet,
+                                   consumption_fleet_aggregate_cb_t on_aggregate, void* user);
+
+/**
+ * @brief Counters of a machine's open period
+ *
+ * @param fleet Fleet
+ * @param index Machine index
+ * @param aggregate Receives the counters; period_end is 0
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for an unknown index
+ */
+consumption_error_t consumption_fleet_get_open(const consumption_fleet_t* fleet, int32_t index,
+                                               consumption_aggregate_t* aggregate);
+
+/**
+ * @brief Counters of a machine's last closed period
+ *
+ * @param fleet Fleet
+ * @param index Machine index
+ * @param aggregate Receives the counters
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for an
+ *         unknown index or a machine that has not closed a period yet
+ */
+consumption_error_t consumption_fleet_get_closed(const consumption_fleet_t* fleet, int32_t index,
+                                                 consumption_aggregate_t* aggregate);
+
+/**
+ * @brief Get fleet statistics
+ *
+ * @param fleet Fleet
+ * @param stats Statistics to fill
+ */
+void consumption_fleet_get_stats(const consumption_fleet_t* fleet, consumption_fleet_stats_t* stats);
+
+/**
+ * @brief Free a fleet
+ *
+ * @param fleet Fleet, may be NULL
+ */
+void consumption_fleet_destroy(consumption_fleet_t* fleet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_FLEET_H */
@@ -0,0 +1,162 @@
+/**
+ * @file consumption_http.h
+ * @brief Local HTTP query endpoint for Consumption Counter Module
+ *
+ * Optional lightweight HTTP/1.1 server (Linux, epoll) for on-site
+ * dashboards. Responses are rendered once per consumption_http_refresh()
+ * from a consumption_get_snapshot() copy and then served as-is, so request
+ * handling never touches the module's counters or the dispense path.
+ *
+ * Routes (GET only, keep-alive by default):
+ *
+ * | Path            | Content                                              |
+ * |-----------------|------------------------------------------------------|
+ * | /stats          | JSON counters and sliding-window rates               |
+ * | /products       | JSON open-period units per product                   |
+ * | /snapshot       | JSON stats and products together                     |
+ * | /snapshot.bin   | Binary snapshot (see consumption_http_bin_header_t)  |
+ *
+ * The server is single-threaded: call consumption_http_poll() from the
+ * application loop, or add consumption_http_get_fd() to an outer
+ * poll/epoll set and call consumption_http_poll(server, 0) when readable.
+ */
+
+#ifndef CONSUMPTION_HTTP_H
+#define CONSUMPTION_HTTP_H
+
+#include "consumption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Query endpoint configuration
+ */
+typedef struct {
+    char bind_address[64];          /**< IPv4 address to listen on (default: 127.0.0.1) */
+    uint16_t port;                  /**< TCP port, 0 for an ephemeral port (default: 8080) */
+    uint32_t max_connections;       /**< Concurrent keep-alive connections (default: 64) */
+    uint32_t idle_timeout_ms;       /**< Close idle connections after (default: 30000) */
+} consumption_http_config_t;
+
+/**
+ * @brief Server statistics
+ */
+typedef struct {
+    uint64_t requests;              /**< Requests answered (any status) */
+    uint32_t connections;           /**< Open client connections */
+    uint32_t rejected;              /**< Connections refused at max_connections */
+    uint32_t snapshot_time;         /**< Timestamp of the served snapshot */
+} consumption_http_stats_t;
+
+/**
+ * @brief Header of the /snapshot.bin body (little-endian, packed)
+ *
+ * Followed by product_entries records of 1 byte product ID and 4 bytes
+ * count, for products with a non-zero count only.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;                 /**< 0x534E5343 ("CSNS") */
+    uint16_t version;               /**< 1 */
+    uint16_t product_entries;       /**< Number of product records */
+    uint32_t machine_id;
+    uint32_t timestamp;
+    uint32_t total_events;
+    uint32_t period_start;
+    uint32_t period_events;
+    uint32_t buffered_events;
+    uint32_t last_sync;
+    uint32_t sync_failures;
+    uint32_t rate_1m;               /**< Units per minute x100 over 1 minute */
+    uint32_t rate_5m;               /**< Units per minute x100 over 5 minutes */
+    uint32_t rate_15m;              /**< Units per minute x100 over 15 minutes */
+} consumption_http_bin_header_t;
+
+/**
+ * @brief Query server handle
+ */
+typedef struct consumption_http_server_t consumption_http_server_t;
+
+/* ============================================================================
+ * SERVER
+ * ============================================================================ */
+
+/**
+ * @brief Create default query endpoint configuration
+ *
+ * @param config Configuration to initialize
+ */
+void consumption_http_config_default(consumption_http_config_t* config);
+
+/**
+ * @brief Start listening
+ *
+ * The module must be initialized; an initial snapshot is taken.
+ *
+ * @param config Server configuration
+ * @return Server handle or NULL on error
+ */
+consumption_http_server_t* consumption_http_start(const consumption_http_config_t* config);
+
+/**
+ * @brief Re-render responses from a fresh snapshot
+ *
+ * Call once per application tick. Also updates the sliding-window rates.
+ * Responses in flight keep the snapshot they started with.
+ *
+ * @param server Server handle
+ * @return CONSUMPTION_SUCCESS on success
+ */
+consumption_error_t consumption_http_refresh(consumption_http_server_t* server);
+
+/**
+ * @brief Accept connections and answer pending requests
+ *
+ * @param server Server handle
+ * @param timeout_ms Maximum time to wait for activity (0 = don't wait)
+ * @return Number of requests answered, or -1 on error
+ */
+int consumption_http_poll(consumption_http_server_t* server, int timeout_ms);
+
+/**
+ * @brief Get the epoll descriptor for integration into an outer event loop
+ *
+ * @param server Server handle
+ * @return File descriptor that becomes readable when the server has work
+ */
+int consumption_http_get_fd(const consumption_http_server_t* server);
+
+/**
+ * @brief Get the bound TCP port (useful with port 0)
+ *
+ * @param server Server handle
+ * @return Port in host byte order
+ */
+uint16_t consumption_http_get_port(const consumption_http_server_t* server);
+
+/**
+ * @brief Get server statistics
+ *
+ * @param server Server handle
+ * @param stats Statistics to fill
+ */
+void consumption_http_get_stats(const consumption_http_server_t* server,
+                              consumption_http_stats_t* stats);
+
+/**
+ * @brief Close all connections and free the server
+ *
+ * @param server Server handle
+ */
+void consumption_http_stop(consumption_http_server_t* server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_HTTP_H */
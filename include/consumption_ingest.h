@@ -0,0 +1,119 @@
+/**
+ * @file consumption_ingest.h
+ * @brief Allocation-free parser for uploaded aggregate payloads
+ *
+ * For gateways and backends that receive the module's uploads. The parser
+ * knows one shape, the aggregate object sent by the core and by batch
+ * uploads:
+ *
+ *   {"machine_id":42,"seq":7,"period_start":..,"period_end":..,
+ *    "total_events":5,"products":{"3":2,"200":3}}
+ *
+ * and decodes it straight into a consumption_aggregate_t or a sparse list
+ * of the products present. Other members (heartbeat digests, raw events)
+ * are skipped, as is whitespace. Numbers are read eight digits at a time
+ * and strings and skipped members are scanned sixteen bytes at a time
+ * where the compiler supports it.
+ *
+ * @code
+ * consumption_sparse_aggregate_t entry;
+ * if (consumption_ingest_parse_sparse(body, body_len, &entry) == CONSUMPTION_SUCCESS) {
+ *     for (uint32_t i = 0; i < entry.count; i++) {
+ *         store(entry.machine_id, entry.product_ids[i], entry.counts[i]);
+ *     }
+ * }
+ * @endcode
+ *
+ * The parser keeps no state; calls are thread-safe.
+ */
+
+#ifndef CONSUMPTION_INGEST_H
+#define CONSUMPTION_INGEST_H
+
+#include "consumption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Aggregate with only the products present
+ */
+typedef struct {
+    uint32_t machine_id;            /**< Machine identifier */
+    uint32_t seq;                   /**< Upload sequence number, 0 if absent */
+    uint32_t period_start;          /**< Start of aggregation period */
+    uint32_t period_end;            /**< End of aggregation period */
+    uint32_t total_events;          /**< Total units, 0 if absent */
+    uint32_t count;                 /**< Products listed */
+    uint8_t product_ids[255];       /**< Product IDs, in payload order */
+    uint32_t counts[255];           /**< Count per listed product */
+} consumption_sparse_aggregate_t;
+
+/**
+ * @brief Batch entry callback
+ */
+typedef void (*consumption_ingest_entry_cb_t)(const consumption_sparse_aggregate_t* entry, void* user);
+
+/* ============================================================================
+ * PARSER
+ * ============================================================================ */
+
+/**
+ * @brief Parse one aggregate object
+ *
+ * machine_id, period_start and period_end are required. Counts must be
+ * unsigned 32-bit integers, product IDs 1-255 and listed once, in a single
+ * "products" member.
+ *
+ * @param json Payload, need not be NUL-terminated
+ * @param len Payload length
+ * @param entry Receives the aggregate
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for
+ *         malformed JSON, a missing field or an out-of-range value
+ */
+consumption_error_t consumption_ingest_parse_sparse(const char* json, size_t len,
+                                                    consumption_sparse_aggregate_t* entry);
+
+/**
+ * @brief Parse one aggregate object into the dense form
+ *
+ * As consumption_ingest_parse_sparse(); unlisted products are 0.
+ *
+ * @param json Payload
+ * @param len Payload length
+ * @param aggregate Receives the aggregate
+ * @return As consumption_ingest_parse_sparse()
+ */
+consumption_error_t consumption_ingest_parse(const char* json, size_t len,
+                                             consumption_aggregate_t* aggregate);
+
+/**
+ * @brief Parse a batch upload (consumption_batch.h)
+ *
+ * Entries are reported as they are parsed; on an error, the ones before
+ * it have been reported.
+ *
+ * @param json Payload: {"gateway":..,"batch":..,"entries":[...]}
+ * @param len Payload length
+ * @param gateway_id Receives the gateway, may be NULL
+ * @param batch_id Receives the batch, may be NULL
+ * @param on_entry Called per entry, in order
+ * @param user Passed to on_entry
+ * @param entries Receives the number of entries reported, may be NULL
+ * @return As consumption_ingest_parse_sparse(); "entries" is required
+ */
+consumption_error_t consumption_ingest_parse_batch(const char* json, size_t len,
+                                                   uint32_t* gateway_id, uint32_t* batch_id,
+                                                   consumption_ingest_entry_cb_t on_entry, void* user,
+                                                   uint32_t* entries);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_INGEST_H */
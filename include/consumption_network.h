@@ -63,6 +63,16 @@ typedef struct {
     char client_key_path[256];
 } consumption_network_config_t;
 
+/**
+ * @brief Pull callback for streamed payloads
+ *
+ * @param buffer Buffer to fill
+ * @param size Capacity of the buffer
+ * @param ctx User context
+ * @return Bytes written, 0 at the end of the payload
+ */
+typedef size_t (*consumption_network_read_t)(char* buffer, size_t size, void* ctx);
+
 /* ============================================================================
  * HTTPS CLIENT
  * ============================================================================ */
@@ -96,6 +106,25 @@ consumption_network_error_t consumption_https_post(consumption_https_client_t* c
                                                   size_t data_len,
                                                   long* response_code);
 
+/**
+ * @brief Send HTTPS POST request with a streamed body
+ *
+ * The body is pulled from read_cb() by libcurl and sent with chunked
+ * transfer encoding, so its size is not limited by any buffer.
+ *
+ * @param client HTTPS client handle
+ * @param endpoint API endpoint path (appended to server URL)
+ * @param read_cb Pull callback producing the JSON payload
+ * @param ctx Context for read_cb
+ * @param response_code Pointer to store HTTP response code (can be NULL)
+ * @return CONSUMPTION_NETWORK_SUCCESS on success
+ */
+consumption_network_error_t consumption_https_post_stream(consumption_https_client_t* client,
+                                                         const char* endpoint,
+                                                         consumption_network_read_t read_cb,
+                                                         void* ctx,
+                                                         long* response_code);
+
 /**
  * @brief Deinitialize HTTPS client
  *
@@ -163,6 +192,29 @@ consumption_network_error_t consumption_mqtt_publish(consumption_mqtt_client_t*
                                                    int qos,
                                                    bool retain);
 
+/**
+ * @brief Publish a streamed payload as a sequence of chunk messages
+ *
+ * Chunks of up to 1 KB are published to
+ * "<topic>/<upload_id>/<index>" (index from 0), followed by an end marker
+ * on "<topic>/<upload_id>/end" whose payload is the chunk count. The
+ * receiver concatenates chunks in index order.
+ *
+ * @param client MQTT client handle
+ * @param topic Base topic
+ * @param upload_id Identifier unique per upload (e.g. period end)
+ * @param read_cb Pull callback producing the payload
+ * @param ctx Context for read_cb
+ * @param qos Quality of Service (0, 1, or 2)
+ * @return CONSUMPTION_NETWORK_SUCCESS on success
+ */
+consumption_network_error_t consumption_mqtt_publish_stream(consumption_mqtt_client_t* client,
+                                                          const char* topic,
+                                                          uint32_t upload_id,
+                                                          consumption_network_read_t read_cb,
+                                                          void* ctx,
+                                                          int qos);
+
 /**
  * @brief Subscribe to MQTT topic
  *
@@ -212,6 +264,17 @@ void consumption_mqtt_deinit(consumption_mqtt_client_t* client);
  */
 const char* consumption_network_error_string(consumption_network_error_t error);
 
+/**
+ * @brief Get memory used by the network module
+ *
+ * Heap covers live client handles only; memory allocated internally by
+ * libcurl or libmosquitto is not included.
+ *
+ * @param heap_bytes Pointer to store heap bytes held by clients (can be NULL)
+ * @param peak_stack_bytes Pointer to store worst-case stack buffers (can be NULL)
+ */
+void consumption_network_get_footprint(size_t* heap_bytes, size_t* peak_stack_bytes);
+
 /**
  * @brief Create default HTTPS configuration
  *
@@ -49,7 +49,8 @@ uint32_t consumption_platform_get_timestamp(void);
  * Implementation notes:
  * - Use Flash, EEPROM, or filesystem as appropriate
  * - Should be atomic operation (use wear-leveling if needed)
- * - Size will typically be sizeof(consumption_state_t) + buffer size
+ * - Size is a fixed-size record of about 1 KB (counters and sync cursor);
+ *   raw events are not persisted
  * - Must survive power loss
  */
 bool consumption_platform_storage_read(void* data, size_t size);
@@ -95,6 +96,32 @@ bool consumption_platform_network_send(const char* endpoint,
                                      const char* data,
                                      size_t data_len);
 
+/**
+ * @brief Send a payload that is pulled from a callback
+ *
+ * Used instead of consumption_platform_network_send() when the payload does
+ * not fit the module's serializer buffer (e.g. uploads with raw events).
+ * The transport calls read_cb() repeatedly with its own buffer until it
+ * returns 0, so payloads of any size are sent with constant memory.
+ * Implementation is optional: return false without calling read_cb() if
+ * unsupported, and the module falls back to a single
+ * consumption_platform_network_send() of the items that fit its buffer,
+ * flagged "truncated".
+ *
+ * @param endpoint API endpoint URL
+ * @param read_cb Pull callback, returns bytes written into buffer, 0 at the end
+ * @param ctx Context to pass to read_cb()
+ * @return true on success, false on failure
+ *
+ * Implementation notes:
+ * - HTTP: chunked transfer encoding (e.g. curl CURLOPT_READFUNCTION)
+ * - MQTT: consumption_mqtt_publish_stream() splits into chunk messages
+ * - The payload is regenerated on retry, read_cb() is valid for one call only
+ */
+bool consumption_platform_network_send_stream(const char* endpoint,
+                                            size_t (*read_cb)(char* buffer, size_t size, void* ctx),
+                                            void* ctx);
+
 /* ============================================================================
  * LOGGING (OPTIONAL)
  * ============================================================================ */
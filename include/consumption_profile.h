@@ -0,0 +1,175 @@
+/**
+ * @file consumption_profile.h
+ * @brief Shared, interned configuration profiles for many machine contexts
+ *
+ * A gateway's machines mostly share one endpoint, key and network setup,
+ * yet consumption_config_t and consumption_network_config_t carry about
+ * 2 KB of fixed string fields each machine would otherwise copy. A profile
+ * holds one immutable copy of both; contexts keep a reference plus their
+ * own machine ID and phase.
+ *
+ * Interning the same settings twice returns the same profile with one
+ * more reference, ignoring machine_id and bytes past string terminators.
+ * Updating a profile publishes a new immutable version with one pointer
+ * store, so every member sees either the old or the new settings, never a
+ * mix. Old versions stay valid until consumption_profiles_reclaim().
+ *
+ * @code
+ * consumption_profiles_t* profiles = consumption_profiles_create(16);
+ * consumption_profile_t* cloud = consumption_profile_intern(profiles, &config, &network);
+ * const consumption_config_t* current = consumption_profile_config(cloud);
+ * ...
+ * consumption_profile_update(cloud, &rotated_key_config, &network);
+ * consumption_profile_release(cloud);
+ * @endcode
+ *
+ * Interning, updating, releasing and reclaiming are not thread-safe with
+ * each other; reading a profile's settings and retaining it may happen on
+ * other threads while it is updated.
+ */
+
+#ifndef CONSUMPTION_PROFILE_H
+#define CONSUMPTION_PROFILE_H
+
+#include "consumption.h"
+#include "consumption_network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Profile registry statistics
+ */
+typedef struct {
+    uint32_t profiles;              /**< Live profiles */
+    uint32_t references;            /**< References held across them */
+    uint32_t retired;               /**< Old versions awaiting reclaim */
+    uint64_t interned;              /**< Interns answered by an existing profile */
+    uint64_t bytes;                 /**< Heap of profiles and versions */
+} consumption_profiles_stats_t;
+
+/**
+ * @brief Profile registry (opaque)
+ */
+typedef struct consumption_profiles_t consumption_profiles_t;
+
+/**
+ * @brief Profile (opaque)
+ */
+typedef struct consumption_profile_t consumption_profile_t;
+
+/* ============================================================================
+ * REGISTRY
+ * ============================================================================ */
+
+/**
+ * @brief Create a profile registry
+ *
+ * @param max_profiles Distinct profiles at once, 1-65536
+ * @return Registry, or NULL on invalid size or allocation failure
+ */
+consumption_profiles_t* consumption_profiles_create(uint32_t max_profiles);
+
+/**
+ * @brief Get or create the profile for some settings
+ *
+ * @param profiles Registry
+ * @param config Core settings; machine_id is ignored
+ * @param network Network settings, NULL for none (all zero)
+ * @return Profile holding a new reference, NULL when max_profiles exist
+ *         or on allocation failure
+ */
+consumption_profile_t* consumption_profile_intern(consumption_profiles_t* profiles,
+                                                  const consumption_config_t* config,
+                                                  const consumption_network_config_t* network);
+
+/**
+ * @brief Take another reference
+ *
+ * @param profile Profile
+ * @return profile
+ */
+consumption_profile_t* consumption_profile_retain(consumption_profile_t* profile);
+
+/**
+ * @brief Drop a reference; the last one frees the profile
+ *
+ * @param profile Profile, may be NULL
+ */
+void consumption_profile_release(consumption_profile_t* profile);
+
+/**
+ * @brief Current core settings of a profile
+ *
+ * The pointer stays valid until the next consumption_profiles_reclaim()
+ * after an update, or the profile is freed. machine_id is 0.
+ *
+ * @param profile Profile
+ * @return Settings
+ */
+const consumption_config_t* consumption_profile_config(const consumption_profile_t* profile);
+
+/**
+ * @brief Current network settings of a profile
+ *
+ * @param profile Profile
+ * @return Settings, valid as for consumption_profile_config()
+ */
+const consumption_network_config_t* consumption_profile_network(const consumption_profile_t* profile);
+
+/**
+ * @brief Replace a profile's settings for all its members at once
+ *
+ * The profile keeps its identity; interning the old settings afterwards
+ * creates a new profile.
+ *
+ * @param profile Profile
+ * @param config New core settings; machine_id is ignored
+ * @param network New network settings, NULL for none
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for NULL
+ *         arguments, CONSUMPTION_ERROR_MEMORY_ERROR if the version could not
+ *         be allocated
+ */
+consumption_error_t consumption_profile_update(consumption_profile_t* profile,
+                                               const consumption_config_t* config,
+                                               const consumption_network_config_t* network);
+
+/**
+ * @brief Free the versions replaced by updates
+ *
+ * Call once no reader can still hold a pointer from before the updates,
+ * e.g. between event loop iterations.
+ *
+ * @param profiles Registry
+ * @return Versions freed
+ */
+uint32_t consumption_profiles_reclaim(consumption_profiles_t* profiles);
+
+/**
+ * @brief Get registry statistics
+ *
+ * @param profiles Registry
+ * @param stats Statistics to fill
+ */
+void consumption_profiles_get_stats(const consumption_profiles_t* profiles,
+                                    consumption_profiles_stats_t* stats);
+
+/**
+ * @brief Free a registry and every profile and version in it
+ *
+ * Profiles still referenced become invalid.
+ *
+ * @param profiles Registry, may be NULL
+ */
+void consumption_profiles_destroy(consumption_profiles_t* profiles);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_PROFILE_H */
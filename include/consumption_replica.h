@@ -0,0 +1,220 @@
+/**
+ * @file consumption_replica.h
+ * @brief Log streaming to a hot-standby process (Linux)
+ *
+ * The primary process ships the module's replication log (see
+ * consumption_set_log_handler()) to a standby process configured for the
+ * same machine, which applies it with consumption_log_apply() and keeps
+ * an up-to-date copy of the counters, sync cursor and event ring. When the
+ * primary dies the standby promotes itself and carries on from the last
+ * record it applied.
+ *
+ * Transports:
+ * - Unix stream socket: the standby listens, the primary connects and the
+ *   standby acknowledges once per read batch. A primary that exits or
+ *   crashes closes the socket, so the standby notices at once.
+ * - File: the primary appends to a log file that the standby tails
+ *   (inotify). Nothing is acknowledged; liveness has to come from
+ *   elsewhere.
+ *
+ * In async mode records are written in batches and dispenses only wait
+ * when max_unacked records are in flight; in sync mode every record is
+ * acknowledged by the standby (or synced to the file) before the
+ * dispense returns. A primary that cannot reach its standby keeps
+ * running, counts the records it could not ship, and sends a checkpoint
+ * when the standby is back.
+ *
+ * @code
+ * // Standby process
+ * consumption_init(&config);                    // Same machine_id, own storage
+ * consumption_replica_t* standby = consumption_replica_standby_start(&replica_config);
+ * for (;;) {
+ *     consumption_replica_poll(standby, 100);
+ *     consumption_replica_get_stats(standby, &stats);
+ *     if (stats.disconnects > 0 && !stats.connected) break;   // Primary lost
+ * }
+ * consumption_replica_promote(standby);
+ * consumption_replica_stop(standby);
+ * // ... now dispense and sync as the primary did
+ *
+ * // Primary process
+ * consumption_init(&config);
+ * consumption_replica_t* primary = consumption_replica_primary_start(&replica_config);
+ * // in the main loop, at least every batch_delay_ms:
+ * consumption_replica_poll(primary, 0);
+ * @endcode
+ */
+
+#ifndef CONSUMPTION_REPLICA_H
+#define CONSUMPTION_REPLICA_H
+
+#include "consumption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Replication transport
+ */
+typedef enum {
+    CONSUMPTION_REPLICA_SOCKET = 0,     /**< Unix stream socket, acknowledged */
+    CONSUMPTION_REPLICA_FILE = 1        /**< Appended log file, tailed */
+} consumption_replica_transport_t;
+
+/**
+ * @brief Replication mode
+ */
+typedef enum {
+    CONSUMPTION_REPLICA_ASYNC = 0,      /**< Batched; dispenses do not wait */
+    CONSUMPTION_REPLICA_SYNC = 1        /**< Each record acknowledged (or synced) before returning */
+} consumption_replica_mode_t;
+
+/**
+ * @brief Replication configuration
+ */
+typedef struct {
+    consumption_replica_transport_t transport; /**< Transport (default: SOCKET) */
+    char path[108];                 /**< Socket or log file path (default: /tmp/consumption.wal) */
+    consumption_replica_mode_t mode;/**< Mode (default: ASYNC) */
+    uint32_t batch_records;         /**< Primary: records per write (default: 256) */
+    uint32_t batch_delay_ms;        /**< Primary: oldest unsent record flushed by poll after (default: 5) */
+    uint32_t max_unacked;           /**< Primary, async: records in flight before dispenses wait (default: 65536) */
+    uint32_t ack_timeout_ms;        /**< Primary: drop a standby that stops reading for (default: 1000) */
+} consumption_replica_config_t;
+
+/**
+ * @brief Replication statistics
+ */
+typedef struct {
+    uint64_t records;               /**< Primary: records shipped; standby: records applied */
+    uint64_t acked;                 /**< Primary: records acknowledged, or written to the file */
+    uint64_t batches;               /**< Primary: writes; standby: acknowledgements sent */
+    uint64_t bytes;                 /**< Bytes written or read */
+    uint64_t dropped;               /**< Primary: records logged with no standby connected */
+    uint64_t gaps;                  /**< Standby: breaks in the record sequence */
+    uint32_t rejected;              /**< Standby: records consumption_log_apply() refused */
+    uint32_t connected;             /**< 1 while the peer is connected (socket) */
+    uint32_t disconnects;           /**< Peer connections lost */
+} consumption_replica_stats_t;
+
+/**
+ * @brief Replication endpoint (opaque)
+ */
+typedef struct consumption_replica_t consumption_replica_t;
+
+/* ============================================================================
+ * REPLICATION
+ * ============================================================================ */
+
+/**
+ * @brief Create default replication configuration
+ *
+ * @param config Configuration to initialize
+ */
+void consumption_replica_config_default(consumption_replica_config_t* config);
+
+/**
+ * @brief Start shipping this process's log
+ *
+ * The module must be initialized. Installs the log handler, connects to
+ * the standby (or truncates the log file) and sends a checkpoint. If the
+ * standby is not listening yet, consumption_replica_poll() keeps trying.
+ *
+ * @param config Configuration
+ * @return Replica, or NULL on invalid configuration or error
+ */
+consumption_replica_t* consumption_replica_primary_start(const consumption_replica_config_t* config);
+
+/**
+ * @brief Start receiving another process's log
+ *
+ * The module must be initialized for the primary's machine, with its own
+ * storage, and should neither dispense nor upload until promoted.
+ *
+ * @param config Configuration
+ * @return Replica, or NULL on invalid configuration or error
+ */
+consumption_replica_t* consumption_replica_standby_start(const consumption_replica_config_t* config);
+
+/**
+ * @brief Do pending replication work
+ *
+ * Primary: reconnects, flushes batches older than batch_delay_ms and reads
+ * acknowledgements. Standby: accepts the primary, applies every complete
+ * record received and acknowledges them.
+ *
+ * @param replica Replica
+ * @param timeout_ms Maximum time to wait for activity (0 = don't wait)
+ * @return Records acknowledged (primary) or applied (standby), -1 on error
+ */
+int consumption_replica_poll(consumption_replica_t* replica, int timeout_ms);
+
+/**
+ * @brief Get the epoll descriptor for integration into an outer event loop
+ *
+ * @param replica Replica
+ * @return File descriptor that becomes readable when the replica has work
+ */
+int consumption_replica_get_fd(const consumption_replica_t* replica);
+
+/**
+ * @brief Take over: apply what is left and stop receiving
+ *
+ * @param replica Standby replica
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for a primary
+ */
+consumption_error_t consumption_replica_promote(consumption_replica_t* replica);
+
+/**
+ * @brief Get replication statistics
+ *
+ * @param replica Replica
+ * @param stats Statistics to fill
+ */
+void consumption_replica_get_stats(consumption_replica_t* replica,
+                                   consumption_replica_stats_t* stats);
+
+/**
+ * @brief Flush, close and free
+ *
+ * A primary removes its log handler.
+ *
+ * @param replica Replica, may be NULL
+ */
+void consumption_replica_stop(consumption_replica_t* replica);
+
+/* ============================================================================
+ * LOG FILES
+ * ============================================================================ */
+
+/**
+ * @brief Read a log file written with the FILE transport
+ *
+ * Reports every complete record in log order, e.g. to replay retained
+ * dispenses into consumption_reprocess.h. A record cut short at the end
+ * of the file (the primary is still writing it) is left out. Checkpoint
+ * records point into a buffer that is only valid during the call.
+ *
+ * @param path Log file
+ * @param handler Called per record
+ * @param ctx Passed to handler
+ * @param records Receives the number of records reported, may be NULL
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER if the file cannot be read or
+ *         holds a malformed frame (records before it have been reported),
+ *         CONSUMPTION_ERROR_MEMORY_ERROR
+ */
+consumption_error_t consumption_replica_read_log(const char* path, consumption_log_handler_t handler,
+                                                 void* ctx, uint64_t* records);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_REPLICA_H */
@@ -0,0 +1,195 @@
+/**
+ * @file consumption_reprocess.h
+ * @brief Rebuilding aggregates from retained raw events
+ *
+ * Recomputes closed-period aggregates after the fact, e.g. when the
+ * backend moves from hourly to 15-minute periods or a sync fault lost or
+ * corrupted periods. Raw events come from a gateway's archive
+ * (consumption_archive.h), from replication log files
+ * (consumption_replica_read_log()) or from any other store, and are
+ * summed per machine, product and period of the chosen length and
+ * alignment:
+ *
+ * @code
+ * consumption_reprocess_config_t config;
+ * consumption_reprocess_config_default(&config);
+ * config.interval = 900;                       // 15-minute periods
+ * config.time_from = day_start;
+ * config.time_to = day_start + 86400;
+ * config.threads = 8;
+ * consumption_reprocess_t* reprocess = consumption_reprocess_create(&config);
+ *
+ * consumption_reprocess_add_archive(reprocess, archive);
+ * consumption_reprocess_emit(reprocess, add_to_batch, batch);   // consumption_batch_add()
+ * consumption_reprocess_destroy(reprocess);
+ * @endcode
+ *
+ * The range is split into partitions of consecutive periods, each with
+ * its own counters, so archive scans and the final sort run in parallel
+ * by time range without locking. Aggregates come out as the core would
+ * have uploaded them, ready for consumption_batch_add() or any outbox.
+ *
+ * A reprocessor is not thread-safe; its worker threads are internal.
+ */
+
+#ifndef CONSUMPTION_REPROCESS_H
+#define CONSUMPTION_REPROCESS_H
+
+#include "consumption.h"
+#include "consumption_archive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Reprocessing configuration
+ */
+typedef struct {
+    uint32_t interval;              /**< Period length, seconds (default: 3600) */
+    uint32_t alignment;             /**< Periods start at alignment + k * interval (default: 0) */
+    uint32_t time_from;             /**< First timestamp reprocessed (default: 0) */
+    uint32_t time_to;               /**< First timestamp excluded, required (default: 0) */
+    uint32_t threads;               /**< Threads including the caller, 1-64 (default: 1) */
+} consumption_reprocess_config_t;
+
+/**
+ * @brief Reprocessing statistics
+ */
+typedef struct {
+    uint64_t events;                /**< Events counted */
+    uint64_t skipped;               /**< Events added outside the time range */
+    uint64_t cells;                 /**< Machine, product and period counters held */
+    uint64_t aggregates;            /**< Aggregates emitted */
+    uint32_t partitions;            /**< Time-range partitions */
+    uint64_t memory_bytes;          /**< Heap held by the reprocessor */
+} consumption_reprocess_stats_t;
+
+/**
+ * @brief Rebuilt aggregate callback
+ */
+typedef void (*consumption_reprocess_aggregate_cb_t)(const consumption_aggregate_t* aggregate, void* user);
+
+/**
+ * @brief Reprocessor (opaque)
+ */
+typedef struct consumption_reprocess_t consumption_reprocess_t;
+
+/* ============================================================================
+ * REPROCESSING
+ * ============================================================================ */
+
+/**
+ * @brief Create default reprocessing configuration
+ *
+ * time_to has no usable default and must be set.
+ *
+ * @param config Configuration to initialize
+ */
+void consumption_reprocess_config_default(consumption_reprocess_config_t* config);
+
+/**
+ * @brief Create a reprocessor
+ *
+ * Events in [time_from, time_to) are counted. Periods are not cut at the
+ * range ends, so a range that does not start and end on period
+ * boundaries gives partial first and last periods.
+ *
+ * Counting takes 32 bytes per event until a partition holds 2^20 cells;
+ * beyond that, equal cells are merged whenever its array fills up.
+ *
+ * @param config Configuration
+ * @return Reprocessor, or NULL on invalid configuration (no interval, an
+ *         empty range, a range ending after 2106, or more than 2^26
+ *         periods per thread) or allocation failure
+ */
+consumption_reprocess_t* consumption_reprocess_create(const consumption_reprocess_config_t* config);
+
+/**
+ * @brief Count events
+ *
+ * Events may come in any order and from several sources; an event added
+ * twice is counted twice.
+ *
+ * @param reprocess Reprocessor
+ * @param events Events
+ * @param count Number of events
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for NULL arguments,
+ *         CONSUMPTION_ERROR_MEMORY_ERROR (earlier events are kept)
+ */
+consumption_error_t consumption_reprocess_add(consumption_reprocess_t* reprocess,
+                                              const consumption_event_t* events, uint32_t count);
+
+/**
+ * @brief Count the dispense in a replication log record
+ *
+ * Checkpoint records are ignored, so a whole log can be passed through.
+ *
+ * @param reprocess Reprocessor
+ * @param record Log record
+ * @return As consumption_reprocess_add()
+ */
+consumption_error_t consumption_reprocess_add_log(consumption_reprocess_t* reprocess,
+                                                  const consumption_log_record_t* record);
+
+/**
+ * @brief Count an archive's events in the range
+ *
+ * Each thread scans the archive for one partition's time range at a
+ * time (consumption_archive_scan()), so blocks outside it are skipped.
+ * The archive must not be appended to meanwhile.
+ *
+ * @param reprocess Reprocessor
+ * @param archive Archive
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for NULL arguments,
+ *         CONSUMPTION_ERROR_MEMORY_ERROR (counts are incomplete; discard
+ *         the reprocessor)
+ */
+consumption_error_t consumption_reprocess_add_archive(consumption_reprocess_t* reprocess,
+                                                      const consumption_archive_t* archive);
+
+/**
+ * @brief Emit the rebuilt aggregates and start over
+ *
+ * Aggregates come in period order, then machine order, on the calling
+ * thread; only machines and products with events are reported. The
+ * counters are cleared afterwards, so the reprocessor can take the next
+ * batch of sources.
+ *
+ * @param reprocess Reprocessor
+ * @param on_aggregate Called per machine and period
+ * @param user Passed to on_aggregate
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for NULL arguments
+ */
+consumption_error_t consumption_reprocess_emit(consumption_reprocess_t* reprocess,
+                                               consumption_reprocess_aggregate_cb_t on_aggregate,
+                                               void* user);
+
+/**
+ * @brief Get reprocessing statistics
+ *
+ * @param reprocess Reprocessor
+ * @param stats Statistics to fill
+ */
+void consumption_reprocess_get_stats(const consumption_reprocess_t* reprocess,
+                                     consumption_reprocess_stats_t* stats);
+
+/**
+ * @brief Free a reprocessor
+ *
+ * @param reprocess Reprocessor, may be NULL
+ */
+void consumption_reprocess_destroy(consumption_reprocess_t* reprocess);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_REPROCESS_H */
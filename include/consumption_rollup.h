@@ -0,0 +1,224 @@
+/**
+ * @file consumption_rollup.h
+ * @brief Hierarchical rollup cube for gateways
+ *
+ * Gateways collecting machine aggregates keep per-period unit counters at
+ * three levels (machine, site, region) with a product dimension. Each
+ * aggregate is added once to its machine, site and region cells, so
+ * queries at any level read one precomputed cell: O(products), no matter
+ * how many machines report to a site or region.
+ *
+ * Time is split into buckets of bucket_seconds (an hour by default); the
+ * last `buckets` buckets are kept per node and older ones are evicted as
+ * new buckets arrive, so memory is fixed at creation.
+ *
+ * @code
+ * consumption_rollup_config_t config;
+ * consumption_rollup_config_default(&config);
+ * consumption_rollup_t* cube = consumption_rollup_create(&config);
+ * consumption_rollup_add_machine(cube, 1001, 10, 1);   // machine, site, region
+ * ...
+ * consumption_rollup_add(cube, &aggregate);            // as payloads arrive
+ * uint64_t units;
+ * consumption_rollup_query(cube, CONSUMPTION_ROLLUP_REGION, 1, now, 7, &units);
+ * @endcode
+ */
+
+#ifndef CONSUMPTION_ROLLUP_H
+#define CONSUMPTION_ROLLUP_H
+
+#include "consumption.h"
+#include "consumption_bitmap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Hierarchy levels
+ */
+typedef enum {
+    CONSUMPTION_ROLLUP_MACHINE = 0,
+    CONSUMPTION_ROLLUP_SITE = 1,
+    CONSUMPTION_ROLLUP_REGION = 2,
+    CONSUMPTION_ROLLUP_LEVELS = 3
+} consumption_rollup_level_t;
+
+/**
+ * @brief Rollup cube configuration
+ */
+typedef struct {
+    uint32_t max_machines;          /**< Machines (default: 256) */
+    uint32_t max_sites;             /**< Sites (default: 32) */
+    uint32_t max_regions;           /**< Regions (default: 8) */
+    uint32_t products;              /**< Product IDs kept per cell, 2-256 (default: 256) */
+    uint32_t bucket_seconds;        /**< Bucket length (default: 3600) */
+    uint32_t buckets;               /**< Buckets kept per node (default: 24) */
+    bool index_machines;            /**< Keep a bitmap of active machines per product and bucket (default: false) */
+} consumption_rollup_config_t;
+
+/**
+ * @brief Cube statistics
+ */
+typedef struct {
+    uint32_t nodes[CONSUMPTION_ROLLUP_LEVELS]; /**< Registered machines, sites, regions */
+    uint64_t aggregates;            /**< Aggregates applied */
+    uint64_t duplicates;            /**< Ignored: not newer than the machine's last one */
+    uint64_t late;                  /**< Rejected: bucket already evicted */
+    uint32_t newest_bucket_start;   /**< Start of the newest bucket seen */
+    uint32_t memory_bytes;          /**< Heap held by the cube, including the machine index */
+} consumption_rollup_stats_t;
+
+/**
+ * @brief Rollup cube (opaque)
+ */
+typedef struct consumption_rollup_t consumption_rollup_t;
+
+/* ============================================================================
+ * CUBE
+ * ============================================================================ */
+
+/**
+ * @brief Create default rollup configuration
+ *
+ * @param config Configuration to initialize
+ */
+void consumption_rollup_config_default(consumption_rollup_config_t* config);
+
+/**
+ * @brief Create a cube; all memory is allocated here
+ *
+ * Takes (max_machines + max_sites + max_regions) * buckets * products * 4
+ * bytes of counters, about 7 MB with the defaults.
+ *
+ * @param config Configuration, NULL for defaults
+ * @return Cube, or NULL on invalid configuration or allocation failure
+ */
+consumption_rollup_t* consumption_rollup_create(const consumption_rollup_config_t* config);
+
+/**
+ * @brief Place a machine in the hierarchy
+ *
+ * Sites and regions are created on first use. A site belongs to one
+ * region; registering a machine again with the same site is a no-op.
+ *
+ * @param cube Cube
+ * @param machine_id Machine
+ * @param site_id Site of the machine
+ * @param region_id Region of the site
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER if the machine or site is
+ *         already placed elsewhere,
+ *         CONSUMPTION_ERROR_STORAGE_FULL if a level is at its maximum
+ */
+consumption_error_t consumption_rollup_add_machine(consumption_rollup_t* cube, uint32_t machine_id,
+                                                   uint32_t site_id, uint32_t region_id);
+
+/**
+ * @brief Add a machine aggregate to its machine, site and region
+ *
+ * The aggregate is counted in the bucket holding its period_start.
+ * Aggregates not newer than the machine's last one (retries, duplicates)
+ * are ignored. Products at or above config.products only count in the
+ * total.
+ *
+ * @param cube Cube
+ * @param aggregate Machine aggregate
+ * @return CONSUMPTION_SUCCESS (also for ignored duplicates),
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for unknown machines or
+ *         buckets already evicted,
+ *         CONSUMPTION_ERROR_MEMORY_ERROR if the machine index could not grow
+ *         (the counters are still updated)
+ */
+consumption_error_t consumption_rollup_add(consumption_rollup_t* cube,
+                                           const consumption_aggregate_t* aggregate);
+
+/**
+ * @brief Units of one product at a node in the bucket holding timestamp
+ *
+ * @param cube Cube
+ * @param level Level of the node
+ * @param id Machine, site or region ID
+ * @param timestamp Any time in the bucket
+ * @param product_id Product, 0 for all products
+ * @param units Units counted (0 for evicted or future buckets)
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for
+ *         unknown nodes or products
+ */
+consumption_error_t consumption_rollup_query(const consumption_rollup_t* cube,
+                                             consumption_rollup_level_t level, uint32_t id,
+                                             uint32_t timestamp, uint8_t product_id,
+                                             uint64_t* units);
+
+/**
+ * @brief All product counters of a node in the bucket holding timestamp
+ *
+ * @param cube Cube
+ * @param level Level of the node
+ * @param id Machine, site or region ID
+ * @param timestamp Any time in the bucket
+ * @param counts Receives config.products counters; counts[0] is the total
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for
+ *         unknown nodes
+ */
+consumption_error_t consumption_rollup_get_products(const consumption_rollup_t* cube,
+                                                    consumption_rollup_level_t level, uint32_t id,
+                                                    uint32_t timestamp, uint32_t* counts);
+
+/**
+ * @brief Machines active for a product in the bucket holding timestamp
+ *
+ * Requires config.index_machines. Machines are identified by their index
+ * (registration order, 0-based), so results for different products or
+ * buckets can be combined with consumption_bitmap_and(), _or() and
+ * _andnot(). A machine is active for a product when an aggregate in the
+ * bucket counted it; product 0 means any dispense.
+ *
+ * @param cube Cube
+ * @param product_id Product, 0 for any
+ * @param timestamp Any time in the bucket
+ * @param machines Receives the machine indexes (empty for evicted buckets)
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER without an index or for
+ *         unknown products,
+ *         CONSUMPTION_ERROR_MEMORY_ERROR if the copy failed
+ */
+consumption_error_t consumption_rollup_machines(const consumption_rollup_t* cube, uint8_t product_id,
+                                                uint32_t timestamp, consumption_bitmap_t* machines);
+
+/**
+ * @brief Machine ID for an index returned by consumption_rollup_machines()
+ *
+ * @param cube Cube
+ * @param index Machine index
+ * @param machine_id Receives the machine ID
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER if out of range
+ */
+consumption_error_t consumption_rollup_machine_id(const consumption_rollup_t* cube, uint32_t index,
+                                                  uint32_t* machine_id);
+
+/**
+ * @brief Get cube statistics
+ *
+ * @param cube Cube
+ * @param stats Statistics to fill
+ */
+void consumption_rollup_get_stats(const consumption_rollup_t* cube,
+                                  consumption_rollup_stats_t* stats);
+
+/**
+ * @brief Free a cube
+ *
+ * @param cube Cube, may be NULL
+ */
+void consumption_rollup_destroy(consumption_rollup_t* cube);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_ROLLUP_H */
@@ -0,0 +1,227 @@
+/**
+ * @file consumption_scheduler.h
+ * @brief Deadline-ordered sync scheduler for gateways hosting many machines
+ *
+ * A gateway that uploads on behalf of many machine contexts registers each
+ * one with its sync interval and upstream destination. Contexts wait in a
+ * min-heap per destination ordered by deadline, so a poll only touches
+ * contexts that are due: O(log n) per dispatch, nothing for contexts that
+ * are not.
+ *
+ * Dispatches are limited three ways:
+ * - per destination, by the number of uploads in flight;
+ * - across destinations, by a token bucket (rate per second with a burst),
+ *   so a backlog of overdue contexts after an outage drains at a steady
+ *   rate instead of all at once;
+ * - when several destinations have due contexts and tokens are short,
+ *   they are served in proportion to their weights (start-time fair
+ *   queuing); within a destination the most overdue context goes first.
+ *
+ * @code
+ * consumption_scheduler_t* sched = consumption_scheduler_create(NULL);
+ * int cloud = consumption_scheduler_add_destination(sched, 3, 32);   // weight, in flight
+ * consumption_scheduler_add(sched, machine_id, cloud, 3600, now + machine_id % 3600);
+ *
+ * // Each tick:
+ * uint32_t due[64];
+ * uint32_t n = consumption_scheduler_poll(sched, now, due, 64);
+ * for (uint32_t i = 0; i < n; i++) start_upload(due[i]);
+ * // When an upload ends:
+ * consumption_scheduler_complete(sched, machine_id, success, now);
+ * @endcode
+ *
+ * Times are Unix timestamps in seconds, as elsewhere in the module. A
+ * scheduler is not thread-safe.
+ */
+
+#ifndef CONSUMPTION_SCHEDULER_H
+#define CONSUMPTION_SCHEDULER_H
+
+#include "consumption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief Scheduler configuration
+ */
+typedef struct {
+    uint32_t max_contexts;          /**< Contexts (default: 1024) */
+    uint32_t max_destinations;      /**< Destinations, 1-256 (default: 16) */
+    uint32_t rate;                  /**< Dispatches per second, 0 for no limit (default: 0) */
+    uint32_t burst;                 /**< Dispatches allowed at once (default: 100) */
+    uint32_t retry_min;             /**< First retry after a failure, seconds (default: 10) */
+    uint32_t retry_max;             /**< Longest retry delay, seconds (default: 600) */
+} consumption_scheduler_config_t;
+
+/**
+ * @brief Scheduler statistics
+ */
+typedef struct {
+    uint32_t contexts;              /**< Registered contexts */
+    uint32_t in_flight;             /**< Dispatched, not completed */
+    uint64_t dispatched;            /**< Contexts handed out by polls */
+    uint64_t failed;                /**< Completions reporting failure */
+    uint64_t throttled;             /**< Polls that left due contexts for lack of tokens */
+    uint64_t capped;                /**< Polls that left due contexts at a destination cap */
+    uint32_t max_lateness;          /**< Largest delay past a deadline at dispatch, seconds */
+} consumption_scheduler_stats_t;
+
+/**
+ * @brief Per-destination statistics
+ */
+typedef struct {
+    uint32_t contexts;              /**< Contexts waiting (not in flight) */
+    uint32_t in_flight;             /**< Uploads in flight */
+    uint64_t dispatched;            /**< Contexts dispatched */
+} consumption_scheduler_destination_stats_t;
+
+/**
+ * @brief Scheduler (opaque)
+ */
+typedef struct consumption_scheduler_t consumption_scheduler_t;
+
+/* ============================================================================
+ * SCHEDULER
+ * ============================================================================ */
+
+/**
+ * @brief Create default scheduler configuration
+ *
+ * @param config Configuration to initialize
+ */
+void consumption_scheduler_config_default(consumption_scheduler_config_t* config);
+
+/**
+ * @brief Create a scheduler
+ *
+ * @param config Configuration, NULL for defaults
+ * @return Scheduler, or NULL on invalid configuration or allocation failure
+ */
+consumption_scheduler_t* consumption_scheduler_create(const consumption_scheduler_config_t* config);
+
+/**
+ * @brief Add an upstream destination
+ *
+ * @param sched Scheduler
+ * @param weight Share of dispatches when destinations compete, 1-1000
+ * @param max_in_flight Uploads in flight at once, 0 for no limit
+ * @return Destination index, -1 on invalid weight or when max_destinations exist
+ */
+int consumption_scheduler_add_destination(consumption_scheduler_t* sched, uint32_t weight,
+                                          uint32_t max_in_flight);
+
+/**
+ * @brief Register a context
+ *
+ * @param sched Scheduler
+ * @param context_id Caller's identifier, e.g. the machine ID
+ * @param destination Destination index
+ * @param interval Seconds between syncs
+ * @param first_due First deadline; spread these to avoid synchronized bursts
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER for a duplicate ID, unknown
+ *         destination or zero interval,
+ *         CONSUMPTION_ERROR_STORAGE_FULL when max_contexts are registered,
+ *         CONSUMPTION_ERROR_MEMORY_ERROR if a heap could not grow
+ */
+consumption_error_t consumption_scheduler_add(consumption_scheduler_t* sched, uint32_t context_id,
+                                              uint32_t destination, uint32_t interval,
+                                              uint32_t first_due);
+
+/**
+ * @brief Unregister a context
+ *
+ * A context in flight is dropped when it completes.
+ *
+ * @param sched Scheduler
+ * @param context_id Context
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER if unknown
+ */
+consumption_error_t consumption_scheduler_remove(consumption_scheduler_t* sched, uint32_t context_id);
+
+/**
+ * @brief Hand out due contexts
+ *
+ * Dispatched contexts are in flight until consumption_scheduler_complete().
+ *
+ * @param sched Scheduler
+ * @param now Current time
+ * @param context_ids Receives the IDs of contexts to sync now
+ * @param max Capacity of context_ids
+ * @return Contexts written
+ */
+uint32_t consumption_scheduler_poll(consumption_scheduler_t* sched, uint32_t now,
+                                    uint32_t* context_ids, uint32_t max);
+
+/**
+ * @brief Report the end of a context's upload
+ *
+ * On success the next deadline is one interval after the last one, or
+ * after now if that is already past (one upload covers a backlog). On
+ * failure the context is retried after retry_min, doubling per
+ * consecutive failure up to retry_max.
+ *
+ * @param sched Scheduler
+ * @param context_id Context
+ * @param success Whether the upload was accepted
+ * @param now Current time
+ * @return CONSUMPTION_SUCCESS,
+ *         CONSUMPTION_ERROR_INVALID_PARAMETER if the context is not in flight
+ */
+consumption_error_t consumption_scheduler_complete(consumption_scheduler_t* sched, uint32_t context_id,
+                                                   bool success, uint32_t now);
+
+/**
+ * @brief Earliest time a poll may dispatch something
+ *
+ * Considers deadlines at destinations below their cap and the token
+ * bucket; for arming a timer between polls.
+ *
+ * @param sched Scheduler
+ * @param now Current time
+ * @param timestamp Receives the time (now or later), 0 if nothing can be dispatched
+ *                  until an upload completes
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER for NULL arguments
+ */
+consumption_error_t consumption_scheduler_next_due(const consumption_scheduler_t* sched, uint32_t now,
+                                                   uint32_t* timestamp);
+
+/**
+ * @brief Get scheduler statistics
+ *
+ * @param sched Scheduler
+ * @param stats Statistics to fill
+ */
+void consumption_scheduler_get_stats(const consumption_scheduler_t* sched,
+                                     consumption_scheduler_stats_t* stats);
+
+/**
+ * @brief Get statistics of one destination
+ *
+ * @param sched Scheduler
+ * @param destination Destination index
+ * @param stats Statistics to fill
+ * @return CONSUMPTION_SUCCESS, CONSUMPTION_ERROR_INVALID_PARAMETER if unknown
+ */
+consumption_error_t consumption_scheduler_get_destination_stats(const consumption_scheduler_t* sched,
+                                                                uint32_t destination,
+                                                                consumption_scheduler_destination_stats_t* stats);
+
+/**
+ * @brief Free a scheduler
+ *
+ * @param sched Scheduler, may be NULL
+ */
+void consumption_scheduler_destroy(consumption_scheduler_t* sched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_SCHEDULER_H */
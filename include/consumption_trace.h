@@ -0,0 +1,125 @@
+/**
+ * @file consumption_trace.h
+ * @brief Static tracepoints for the Consumption Counter Module
+ *
+ * USDT (User Statically-Defined Tracing) probes for Linux dynamic tracing
+ * with perf, bpftrace or SystemTap. Build with -DUSE_USDT (requires
+ * <sys/sdt.h> from systemtap-sdt-dev) to compile the probes in; otherwise
+ * every macro expands to nothing and no code is generated.
+ *
+ * An unattached USDT probe is a single NOP instruction, so the probes are
+ * safe to leave enabled in production builds. Every probe has a
+ * semaphore that tracers increment while attached; latency arguments only
+ * read the clock while their probe's semaphore is set.
+ *
+ * Provider: "consumption"
+ *
+ * | Probe                 | Arguments                                          |
+ * |-----------------------|----------------------------------------------------|
+ * | dispense              | machine_id, product_id, buffered_events            |
+ * | ring_overwrite        | machine_id, dropped_product_id, dropped_timestamp  |
+ * | period_close          | machine_id, period_start, period_end, total_events |
+ * | sync_start            | machine_id, period_start, period_end               |
+ * | sync_finish           | machine_id, success, bytes, latency_us             |
+ * | storage_write_start   | bytes                                              |
+ * | storage_write_finish  | bytes, success, latency_us                         |
+ * | network_retry         | machine_id, attempt, max_retry_attempts            |
+ *
+ * Example:
+ * @code
+ * bpftrace -e 'usdt:./libconsumption.so:consumption:sync_finish
+ *              { @latency_us = hist(arg3); }'
+ * @endcode
+ */
+
+#ifndef CONSUMPTION_TRACE_H
+#define CONSUMPTION_TRACE_H
+
+#include <stdint.h>
+
+#ifdef USE_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#include <time.h>
+
+/* Probe semaphores, defined once by CONSUMPTION_TRACE_DEFINE_SEMAPHORES */
+#define CONSUMPTION_TRACE_SEMAPHORE(probe) \
+    unsigned short consumption_##probe##_semaphore \
+        __attribute__((unused)) __attribute__((section(".probes")))
+
+extern CONSUMPTION_TRACE_SEMAPHORE(dispense);
+extern CONSUMPTION_TRACE_SEMAPHORE(ring_overwrite);
+extern CONSUMPTION_TRACE_SEMAPHORE(period_close);
+extern CONSUMPTION_TRACE_SEMAPHORE(sync_start);
+extern CONSUMPTION_TRACE_SEMAPHORE(sync_finish);
+extern CONSUMPTION_TRACE_SEMAPHORE(storage_write_start);
+extern CONSUMPTION_TRACE_SEMAPHORE(storage_write_finish);
+extern CONSUMPTION_TRACE_SEMAPHORE(network_retry);
+
+#define CONSUMPTION_TRACE_DEFINE_SEMAPHORES \
+    CONSUMPTION_TRACE_SEMAPHORE(dispense); \
+    CONSUMPTION_TRACE_SEMAPHORE(ring_overwrite); \
+    CONSUMPTION_TRACE_SEMAPHORE(period_close); \
+    CONSUMPTION_TRACE_SEMAPHORE(sync_start); \
+    CONSUMPTION_TRACE_SEMAPHORE(sync_finish); \
+    CONSUMPTION_TRACE_SEMAPHORE(storage_write_start); \
+    CONSUMPTION_TRACE_SEMAPHORE(storage_write_finish); \
+    CONSUMPTION_TRACE_SEMAPHORE(network_retry);
+
+/** @brief Whether a tracer is attached to the probe */
+#define CONSUMPTION_TRACE_ENABLED(probe) \
+    __builtin_expect(consumption_##probe##_semaphore != 0, 0)
+
+#define CONSUMPTION_TRACE1(probe, a1) \
+    DTRACE_PROBE1(consumption, probe, a1)
+#define CONSUMPTION_TRACE2(probe, a1, a2) \
+    DTRACE_PROBE2(consumption, probe, a1, a2)
+#define CONSUMPTION_TRACE3(probe, a1, a2, a3) \
+    DTRACE_PROBE3(consumption, probe, a1, a2, a3)
+#define CONSUMPTION_TRACE4(probe, a1, a2, a3, a4) \
+    DTRACE_PROBE4(consumption, probe, a1, a2, a3, a4)
+
+/**
+ * @brief Monotonic clock for probe latency arguments
+ *
+ * Only used around slow paths (storage and network I/O), never on the
+ * dispense path.
+ *
+ * @return Monotonic time in microseconds
+ */
+static inline uint64_t consumption_trace_clock_us(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/** @brief Start of a probe's latency argument; 0 (no clock read) while unattached */
+#define CONSUMPTION_TRACE_START_US(probe) \
+    (CONSUMPTION_TRACE_ENABLED(probe) ? consumption_trace_clock_us() : 0)
+
+/** @brief Microseconds since CONSUMPTION_TRACE_START_US(); 0 if it was not taken */
+#define CONSUMPTION_TRACE_SINCE_US(started) \
+    ((started) ? consumption_trace_clock_us() - (started) : 0)
+
+#else /* USE_USDT not defined */
+
+#define CONSUMPTION_TRACE1(probe, a1) \
+    do { (void)(a1); } while (0)
+#define CONSUMPTION_TRACE2(probe, a1, a2) \
+    do { (void)(a1); (void)(a2); } while (0)
+#define CONSUMPTION_TRACE3(probe, a1, a2, a3) \
+    do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+#define CONSUMPTION_TRACE4(probe, a1, a2, a3, a4) \
+    do { (void)(a1); (void)(a2); (void)(a3); (void)(a4); } while (0)
+
+#define CONSUMPTION_TRACE_DEFINE_SEMAPHORES
+#define CONSUMPTION_TRACE_ENABLED(probe) 0
+#define CONSUMPTION_TRACE_START_US(probe) ((uint64_t)0)
+#define CONSUMPTION_TRACE_SINCE_US(started) ((void)(started), (uint64_t)0)
+
+#endif /* USE_USDT */
+
+#endif /* CONSUMPTION_TRACE_H */
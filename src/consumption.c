@@ -7,8 +7,12 @@
  */
 
 #include "consumption.h"
+#include "consumption_crypto.h"
+#include "consumption_trace.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
 
 /* ============================================================================
  * PLATFORM ABSTRACTIONS
@@ -52,6 +56,17 @@ extern bool consumption_platform_network_send(const char* endpoint,
                                             const char* data,
                                             size_t data_len);
 
+/**
+ * @brief Streaming network send for payloads larger than one buffer (optional)
+ * @param endpoint API endpoint URL
+ * @param read_cb Pull callback, returns bytes written into buffer, 0 at the end
+ * @param ctx Context for the callback
+ * @return true on success
+ */
+extern bool consumption_platform_network_send_stream(const char* endpoint,
+                                                   size_t (*read_cb)(char* buffer, size_t size, void* ctx),
+                                                   void* ctx);
+
 /**
  * @brief Logging function (optional)
  * @param level Log level (0=error, 1=warn, 2=info, 3=debug)
@@ -59,110 +74,1313 @@ extern bool consumption_platform_network_send(const char* endpoint,
  */
 extern void consumption_platform_log(int level, const char* message);
 
+/* ============================================================================
+ * INTERNAL CONSTANTS
+ * ============================================================================ */
+
+#define JSON_BUFFER_SIZE 1024     /* Sync payload buffer (stack) */
+#define JSON_MIN_CHUNK 64         /* Smallest serializer buffer under a budget */
+#define STREAM_ITEM_SIZE 160      /* Scratch for one serialized payload item */
+#define JSON_FALLBACK_MIN 320     /* Smallest truncated payload without streaming */
+
+/*
+ * Open-period counters are sharded so concurrent dispensers never touch the
+ * same cache line. Each thread is bound to one shard on its first dispense.
+ * Everything else stays on the thread that called consumption_init(), so
+ * other threads may only dispense into counter-only modules without the
+ * external API. MCU builds keep a single shard and plain increments.
+ */
+#ifndef CONSUMPTION_COUNTER_SHARDS
+#define CONSUMPTION_COUNTER_SHARDS 1
+#endif
+
+/*
+ * Product IDs below this limit are counted in the shards; higher IDs take a
+ * slower unsharded path. Lower it to shrink per-shard memory (4 bytes each).
+ */
+#ifndef CONSUMPTION_COUNTER_PRODUCTS
+#define CONSUMPTION_COUNTER_PRODUCTS 256
+#endif
+
+#if CONSUMPTION_COUNTER_SHARDS > 1
+#define COUNTER_ADD(counter, n) __atomic_fetch_add((counter), (n), __ATOMIC_RELAXED)
+#define COUNTER_TAKE(counter) __atomic_exchange_n((counter), 0, __ATOMIC_RELAXED)
+#define SHARD_ALIGN __attribute__((aligned(64)))
+#else
+#define COUNTER_ADD(counter, n) (*(counter) += (n))
+#define COUNTER_TAKE(counter) counter_take(counter)
+#define SHARD_ALIGN
+#endif
+
+#define SAMPLE_STRATA 24          /* Most hour strata for HOURLY retention */
+
+#define STATE_MAGIC 0x434E5355u   /* "CNSU" */
+#define STATE_VERSION 2u          /* 1.0.0 persisted the raw state struct */
+#define SEALED_MAGIC 0x434E5345u  /* "CNSE": ChaCha20-Poly1305 sealed record */
+#define SEAL_TAG_SIZE 16
+
 /* ============================================================================
  * INTERNAL STRUCTURES
  * ============================================================================ */
 
+/**
+ * @brief Persisted part of the module state
+ *
+ * Only counters and the sync cursor are persisted. The record has a fixed
+ * size and no pointers, so restoring it takes constant time no matter how
+ * much history the machine has accumulated, and the open period's product
+ * counters come back ready to use without rescanning events.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t machine_id;          /* Counters are only valid for this machine */
+    uint32_t total_events;
+    uint32_t last_aggregation;    /* Start of the open period */
+    uint32_t last_sync;
+    uint32_t sync_failures;
+    uint32_t period_events;       /* Events in the open period */
+    uint32_t period_counts[256];  /* Per-product counts in the open period */
+} consumption_persist_t;
+
+/**
+ * @brief Header of a sealed record, authenticated as associated data
+ *
+ * The nonce is the seal time and the write sequence, so it never repeats
+ * under one key unless storage is rolled back within the same second.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t machine_id;
+    uint32_t sealed_at;           /* Nonce, first word */
+    uint32_t reserved;
+    uint64_t seq;                 /* Nonce, last two words */
+    uint8_t tag[SEAL_TAG_SIZE];
+} sealed_header_t;
+
+/**
+ * @brief Persisted record as written when storage sealing is enabled
+ */
+typedef struct {
+    sealed_header_t header;
+    uint8_t body[sizeof(consumption_persist_t)];
+} sealed_record_t;
+
+/**
+ * @brief Per-thread open-period counters, folded into the persisted record
+ */
+typedef struct {
+    uint32_t counts[CONSUMPTION_COUNTER_PRODUCTS];
+} SHARD_ALIGN counter_shard_t;
+
 /**
  * @brief Internal module state
  */
 typedef struct {
     bool initialized;
     consumption_config_t config;
-    uint32_t total_events;
+    consumption_persist_t persist;
+    counter_shard_t shards[CONSUMPTION_COUNTER_SHARDS];
+#if CONSUMPTION_COUNTER_PRODUCTS < 256
+    uint32_t unsharded[256 - CONSUMPTION_COUNTER_PRODUCTS]; /* Higher product IDs, all threads */
+#endif
     uint32_t buffer_head;
     uint32_t buffer_tail;
     uint32_t buffer_count;
+    uint32_t ring_capacity;
     consumption_event_t* event_buffer;
-    uint32_t last_aggregation;
-    uint32_t last_sync;
-    bool sync_in_progress;
+    uint32_t strata;                        /* Reservoir strata: 1, or hours for HOURLY */
+    uint32_t stratum_slots;                 /* Reservoir slots per stratum */
+    uint32_t stratum_seen[SAMPLE_STRATA];   /* Events offered per stratum */
+    uint32_t stratum_kept[SAMPLE_STRATA];   /* Slots filled per stratum */
+    uint32_t stratum_hour[SAMPLE_STRATA];   /* HOURLY: hour (timestamp / 3600) held */
+    uint32_t rng_state;
+    bool sync_pending;                      /* Sync handler notified, no upload begun yet */
+    uint32_t upload_seq;                    /* Frames sent since init */
+    uint32_t last_full_seq;                 /* Last acknowledged aggregate, 0 = none */
+    uint32_t last_full_digest;              /* Its counts digest */
 } consumption_state_t;
 
-/* ============================================================================
- * GLOBAL STATE
- * ============================================================================ */
+/* ============================================================================
+ * GLOBAL STATE
+ * ============================================================================ */
+
+static consumption_state_t g_state = {0};
+
+/* Memory budgets live outside g_state so they survive init and state reloads */
+static uint32_t g_budgets[CONSUMPTION_COMPONENT_COUNT] = {0};
+
+/* Set by consumption_set_sync_handler(); like budgets, kept across init */
+static consumption_sync_notify_t g_sync_notify = NULL;
+static void* g_sync_ctx = NULL;
+
+/* Set by consumption_set_log_handler(); kept across init */
+static consumption_log_handler_t g_log_handler = NULL;
+static void* g_log_ctx = NULL;
+
+/* Storage key as a ready ChaCha20 input block; like budgets, kept across init */
+static struct {
+    bool enabled;
+    uint32_t state[16];           /* Constants and key; counter and nonce per record */
+    uint64_t seq;                 /* Last write sequence used */
+} g_seal = {0};
+
+static sealed_record_t g_sealed;  /* Ciphertext staging for storage I/O */
+
+/* USDT probe semaphores, set by attached tracers (consumption_trace.h) */
+CONSUMPTION_TRACE_DEFINE_SEMAPHORES
+
+#if CONSUMPTION_COUNTER_SHARDS > 1
+static uint32_t g_next_shard = 0;
+static __thread int32_t t_shard = -1;
+static uint32_t g_driver_epoch = 0;         /* Bumped by each init */
+static __thread uint32_t t_driver_epoch = 0; /* Init this thread made, if any */
+#endif
+
+/* ============================================================================
+ * STORAGE SEALING
+ * ============================================================================ */
+
+/*
+ * ChaCha20-Poly1305 (RFC 8439) in portable C. It needs no cipher hardware,
+ * which keeps it equally fast on every target the module runs on; a record
+ * costs a few microseconds, far below one storage write.
+ */
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define CHACHA_QR(a, b, c, d) \
+    a += b; d ^= a; d = ROTL32(d, 16); \
+    c += d; b ^= c; b = ROTL32(b, 12); \
+    a += b; d ^= a; d = ROTL32(d, 8);  \
+    c += d; b ^= c; b = ROTL32(b, 7)
+
+static inline uint32_t load_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void store_le32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/**
+ * @brief Constants ("expand 32-byte k") and key of a ChaCha20 input block
+ */
+static void chacha20_key(uint32_t state[16], const uint8_t key[32]) {
+    state[0] = 0x61707865u;
+    state[1] = 0x3320646eu;
+    state[2] = 0x79622d32u;
+    state[3] = 0x6b206574u;
+    for (int i = 0; i < 8; i++) {
+        state[4 + i] = load_le32(key + 4 * i);
+    }
+}
+
+/**
+ * @brief One 64-byte ChaCha20 keystream block
+ */
+static void chacha20_block(const uint32_t in[16], uint8_t out[64]) {
+    uint32_t x[16];
+    memcpy(x, in, sizeof(x));
+
+    for (int i = 0; i < 10; i++) {
+        CHACHA_QR(x[0], x[4], x[8], x[12]);
+        CHACHA_QR(x[1], x[5], x[9], x[13]);
+        CHACHA_QR(x[2], x[6], x[10], x[14]);
+        CHACHA_QR(x[3], x[7], x[11], x[15]);
+        CHACHA_QR(x[0], x[5], x[10], x[15]);
+        CHACHA_QR(x[1], x[6], x[11], x[12]);
+        CHACHA_QR(x[2], x[7], x[8], x[13]);
+        CHACHA_QR(x[3], x[4], x[9], x[14]);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        store_le32(out + 4 * i, x[i] + in[i]);
+    }
+}
+
+/**
+ * @brief XOR data with the keystream starting at the state's block counter
+ */
+static void chacha20_xor(uint32_t state[16], const uint8_t* in, uint8_t* out, size_t len) {
+    uint8_t block[64];
+
+    while (len > 0) {
+        size_t n = len < sizeof(block) ? len : sizeof(block);
+        chacha20_block(state, block);
+        state[12]++;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = in[i] ^ block[i];
+        }
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Poly1305 accumulator (26-bit limbs)
+ */
+typedef struct {
+    uint32_t r[5];
+    uint32_t h[5];
+    uint32_t pad[4];
+} poly1305_t;
+
+static void poly1305_init(poly1305_t* st, const uint8_t key[32]) {
+    st->r[0] = load_le32(key + 0) & 0x3ffffff;
+    st->r[1] = (load_le32(key + 3) >> 2) & 0x3ffff03;
+    st->r[2] = (load_le32(key + 6) >> 4) & 0x3ffc0ff;
+    st->r[3] = (load_le32(key + 9) >> 6) & 0x3f03fff;
+    st->r[4] = (load_le32(key + 12) >> 8) & 0x00fffff;
+    memset(st->h, 0, sizeof(st->h));
+    for (int i = 0; i < 4; i++) {
+        st->pad[i] = load_le32(key + 16 + 4 * i);
+    }
+}
+
+/**
+ * @brief Absorb data
+ *
+ * padded: a short last block is zero-padded to 16 bytes (AEAD framing);
+ * otherwise it ends with a 1 byte, as for a plain Poly1305 message.
+ */
+static void poly1305_absorb(poly1305_t* st, const uint8_t* m, size_t len, bool padded) {
+    const uint32_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2], r3 = st->r[3], r4 = st->r[4];
+    const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+    uint8_t last[16];
+
+    while (len > 0) {
+        const uint8_t* b = m;
+        uint32_t hibit = 1u << 24;
+        if (len < 16) {
+            memset(last, 0, sizeof(last));
+            memcpy(last, m, len);
+            if (!padded) {
+                last[len] = 1;
+                hibit = 0;
+            }
+            b = last;
+        }
+
+        h0 += load_le32(b + 0) & 0x3ffffff;
+        h1 += (load_le32(b + 3) >> 2) & 0x3ffffff;
+        h2 += (load_le32(b + 6) >> 4) & 0x3ffffff;
+        h3 += (load_le32(b + 9) >> 6) & 0x3ffffff;
+        h4 += (load_le32(b + 12) >> 8) | hibit;
+
+        uint64_t d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 +
+                      (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+        uint64_t d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 +
+                      (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+        uint64_t d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 +
+                      (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+        uint64_t d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 +
+                      (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+        uint64_t d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 +
+                      (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+        uint32_t c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+        d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+        d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+        d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+        d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+        h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+        h1 += c;
+
+        size_t n = len < 16 ? len : 16;
+        m += n;
+        len -= n;
+    }
+
+    st->h[0] = h0; st->h[1] = h1; st->h[2] = h2; st->h[3] = h3; st->h[4] = h4;
+}
+
+static void poly1305_update(poly1305_t* st, const uint8_t* m, size_t len) {
+    poly1305_absorb(st, m, len, true);
+}
+
+static void poly1305_finish(poly1305_t* st, uint8_t tag[16]) {
+    uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+    uint32_t c;
+
+    c = h1 >> 26; h1 &= 0x3ffffff; h2 += c;
+    c = h2 >> 26; h2 &= 0x3ffffff; h3 += c;
+    c = h3 >> 26; h3 &= 0x3ffffff; h4 += c;
+    c = h4 >> 26; h4 &= 0x3ffffff; h0 += c * 5;
+    c = h0 >> 26; h0 &= 0x3ffffff; h1 += c;
+
+    /* h - p, selected in constant time when h >= p */
+    uint32_t g0 = h0 + 5;     c = g0 >> 26; g0 &= 0x3ffffff;
+    uint32_t g1 = h1 + c;     c = g1 >> 26; g1 &= 0x3ffffff;
+    uint32_t g2 = h2 + c;     c = g2 >> 26; g2 &= 0x3ffffff;
+    uint32_t g3 = h3 + c;     c = g3 >> 26; g3 &= 0x3ffffff;
+    uint32_t g4 = h4 + c - (1u << 26);
+    uint32_t mask = (g4 >> 31) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+    h3 = (h3 & ~mask) | (g3 & mask);
+    h4 = (h4 & ~mask) | (g4 & mask);
+
+    /* h + pad mod 2^128 */
+    uint32_t w[4] = {
+        h0 | (h1 << 26),
+        (h1 >> 6) | (h2 << 20),
+        (h2 >> 12) | (h3 << 14),
+        (h3 >> 18) | (h4 << 8),
+    };
+    uint64_t f = 0;
+    for (int i = 0; i < 4; i++) {
+        f = (uint64_t)w[i] + st->pad[i] + (f >> 32);
+        store_le32(tag + 4 * i, (uint32_t)f);
+    }
+}
+
+/**
+ * @brief AEAD tag: Poly1305 keyed by block 0, over AAD and ciphertext
+ */
+static void aead_tag(uint32_t state[16], const uint8_t* aad, size_t aad_len,
+                     const uint8_t* ciphertext, size_t len, uint8_t tag[16]) {
+    uint8_t key_block[64];
+    uint8_t lengths[16];
+    poly1305_t mac;
+
+    chacha20_block(state, key_block);   /* Block 0 keys Poly1305 */
+    state[12]++;
+    poly1305_init(&mac, key_block);
+    memset(key_block, 0, sizeof(key_block));
+
+    poly1305_update(&mac, aad, aad_len);
+    poly1305_update(&mac, ciphertext, len);
+    store_le32(lengths, (uint32_t)aad_len);
+    store_le32(lengths + 4, (uint32_t)((uint64_t)aad_len >> 32));
+    store_le32(lengths + 8, (uint32_t)len);
+    store_le32(lengths + 12, (uint32_t)((uint64_t)len >> 32));
+    poly1305_update(&mac, lengths, sizeof(lengths));
+    poly1305_finish(&mac, tag);
+}
+
+/**
+ * @brief Tag of a sealed record: Poly1305 over header and ciphertext
+ */
+static void seal_tag(uint32_t state[16], const sealed_header_t* header,
+                     const uint8_t* ciphertext, size_t len, uint8_t tag[16]) {
+    aead_tag(state, (const uint8_t*)header, offsetof(sealed_header_t, tag), ciphertext, len, tag);
+}
+
+/**
+ * @brief Per-record cipher input: cached key block plus this record's nonce
+ */
+static void seal_state_for(const sealed_header_t* header, uint32_t state[16]) {
+    memcpy(state, g_seal.state, sizeof(g_seal.state));
+    state[12] = 0;
+    state[13] = header->sealed_at;
+    state[14] = (uint32_t)header->seq;
+    state[15] = (uint32_t)(header->seq >> 32);
+}
+
+/**
+ * @brief Encrypt and authenticate the persisted record into g_sealed
+ */
+static void seal_record(const consumption_persist_t* persist) {
+    uint32_t state[16];
+    sealed_header_t* header = &g_sealed.header;
+
+    memset(header, 0, sizeof(*header));
+    header->magic = SEALED_MAGIC;
+    header->machine_id = persist->machine_id;
+    header->sealed_at = consumption_platform_get_timestamp();
+    header->seq = ++g_seal.seq;
+
+    seal_state_for(header, state);
+    uint32_t mac_state[16];
+    memcpy(mac_state, state, sizeof(state));
+    state[12] = 1;
+    chacha20_xor(state, (const uint8_t*)persist, g_sealed.body, sizeof(g_sealed.body));
+    seal_tag(mac_state, header, g_sealed.body, sizeof(g_sealed.body), header->tag);
+}
+
+/**
+ * @brief Verify g_sealed and decrypt it into the persisted record
+ * @return false if the record is not sealed, or was sealed with another key
+ *         or modified
+ */
+static bool open_record(consumption_persist_t* persist) {
+    uint32_t state[16];
+    uint8_t tag[SEAL_TAG_SIZE];
+    const sealed_header_t* header = &g_sealed.header;
+
+    if (header->magic != SEALED_MAGIC) {
+        return false;
+    }
+
+    seal_state_for(header, state);
+    seal_tag(state, header, g_sealed.body, sizeof(g_sealed.body), tag);
+
+    uint8_t diff = 0;
+    for (int i = 0; i < SEAL_TAG_SIZE; i++) {
+        diff |= (uint8_t)(tag[i] ^ header->tag[i]);
+    }
+    if (diff != 0) {
+        return false;
+    }
+
+    /* state[12] is 1 after the Poly1305 key block */
+    chacha20_xor(state, g_sealed.body, (uint8_t*)persist, sizeof(g_sealed.body));
+    if (header->seq > g_seal.seq) {
+        g_seal.seq = header->seq;
+    }
+    return true;
+}
+
+/* ============================================================================
+ * INTERNAL FUNCTIONS
+ * ============================================================================ */
+
+/**
+ * @brief Hour strata an HOURLY reservoir needs
+ *
+ * A period touches at most ceil(interval / 3600) + 1 clock hours; one
+ * more keeps the next period's first hour apart while an upload of the
+ * last one is in flight.
+ */
+static uint32_t sample_strata_for(const consumption_config_t* config) {
+    if (config->retention != CONSUMPTION_RETENTION_HOURLY) {
+        return 1;
+    }
+    uint32_t hours = config->aggregation_interval / 3600u +
+                     (config->aggregation_interval % 3600u != 0) + 2;
+    return hours < SAMPLE_STRATA ? hours : SAMPLE_STRATA;
+}
+
+/**
+ * @brief Validate configuration
+ */
+static bool validate_config(const consumption_config_t* config) {
+    if (!config) return false;
+    if (config->machine_id == 0) return false;
+    if (config->ring_buffer_size == 0 && !config->counter_only) return false;
+    if (config->ring_buffer_size > 10000) return false; /* Reasonable limit */
+    if (config->retention > CONSUMPTION_RETENTION_HOURLY) return false;
+    if (config->retention != CONSUMPTION_RETENTION_RECENT && config->counter_only) return false;
+    if (config->ring_buffer_size < sample_strata_for(config) && !config->counter_only) return false;
+    return true;
+}
+
+/**
+ * @brief Initialize default configuration
+ */
+static void init_default_config(consumption_config_t* config) {
+    memset(config, 0, sizeof(consumption_config_t));
+    config->enable_external_api = false;
+    config->ring_buffer_size = 1000;
+    config->aggregation_interval = 3600; /* 1 hour */
+    config->max_retry_attempts = 3;
+    strncpy(config->api_endpoint, "https://api.example.com/consumption", sizeof(config->api_endpoint) - 1);
+}
+
+#if CONSUMPTION_COUNTER_SHARDS == 1
+/**
+ * @brief Read and clear a counter (single-shard builds)
+ */
+static inline uint32_t counter_take(uint32_t* counter) {
+    uint32_t value = *counter;
+    *counter = 0;
+    return value;
+}
+#endif
+
+/**
+ * @brief Shard used by the calling thread
+ */
+static inline uint32_t current_shard(void) {
+#if CONSUMPTION_COUNTER_SHARDS > 1
+    if (t_shard < 0) {
+        t_shard = (int32_t)(__atomic_fetch_add(&g_next_shard, 1, __ATOMIC_RELAXED) %
+                            CONSUMPTION_COUNTER_SHARDS);
+    }
+    return (uint32_t)t_shard;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Whether the calling thread may dispense
+ *
+ * Only the thread that called consumption_init() drives the ring and the
+ * uploads. Other threads reach nothing but the counters, so they may
+ * dispense only in counter-only mode with the external API off.
+ */
+static inline bool dispense_allowed(void) {
+#if CONSUMPTION_COUNTER_SHARDS > 1
+    if (t_driver_epoch != g_driver_epoch) {
+        return g_state.config.counter_only && !g_state.config.enable_external_api;
+    }
+#endif
+    return true;
+}
+
+/**
+ * @brief Count dispensed units in the open period
+ */
+static inline void count_dispense(uint32_t shard, uint8_t product_id, uint32_t quantity) {
+#if CONSUMPTION_COUNTER_PRODUCTS < 256
+    if (product_id >= CONSUMPTION_COUNTER_PRODUCTS) {
+        /* Outside the sharded range: one counter shared by all threads */
+        COUNTER_ADD(&g_state.unsharded[product_id - CONSUMPTION_COUNTER_PRODUCTS], quantity);
+        return;
+    }
+#endif
+    COUNTER_ADD(&g_state.shards[shard].counts[product_id], quantity);
+}
+
+/**
+ * @brief Sum all shards into the open-period counters and clear them
+ *
+ * Runs on the driving thread, the only writer of the persisted record;
+ * counters are taken atomically while other threads keep adding to them.
+ */
+static void fold_counters(void) {
+    uint32_t folded = 0;
+
+    for (uint32_t s = 0; s < CONSUMPTION_COUNTER_SHARDS; s++) {
+        uint32_t* counts = g_state.shards[s].counts;
+        for (uint32_t p = 1; p < CONSUMPTION_COUNTER_PRODUCTS; p++) {
+            uint32_t n = COUNTER_TAKE(&counts[p]);
+            if (n > 0) {
+                g_state.persist.period_counts[p] += n;
+                folded += n;
+            }
+        }
+    }
+#if CONSUMPTION_COUNTER_PRODUCTS < 256
+    for (uint32_t p = CONSUMPTION_COUNTER_PRODUCTS; p < 256; p++) {
+        uint32_t n = COUNTER_TAKE(&g_state.unsharded[p - CONSUMPTION_COUNTER_PRODUCTS]);
+        g_state.persist.period_counts[p] += n;
+        folded += n;
+    }
+#endif
+
+    g_state.persist.period_events += folded;
+    g_state.persist.total_events += folded;
+}
+
+/**
+ * @brief Fold counters and produce the persisted record as stored
+ * @return Record size; *record points into module state
+ */
+static size_t encode_state(const void** record) {
+    fold_counters();
+    if (g_seal.enabled) {
+        seal_record(&g_state.persist);
+        *record = &g_sealed;
+        return sizeof(g_sealed);
+    }
+    *record = &g_state.persist;
+    return sizeof(g_state.persist);
+}
+
+static bool write_state(const void* record, size_t size, uint64_t started) {
+    CONSUMPTION_TRACE1(storage_write_start, size);
+
+    bool success = consumption_platform_storage_write(record, size);
+
+    CONSUMPTION_TRACE3(storage_write_finish, size, success, CONSUMPTION_TRACE_SINCE_US(started));
+    return success;
+}
+
+/**
+ * @brief Save state to persistent storage
+ */
+static bool save_state(void) {
+    uint64_t started = CONSUMPTION_TRACE_START_US(storage_write_finish);
+    const void* record;
+    size_t size = encode_state(&record);
+    return write_state(record, size, started);
+}
+
+/**
+ * @brief Load state from persistent storage
+ * @return false if nothing usable was stored for this machine
+ */
+static bool load_state(void) {
+    if (g_seal.enabled) {
+        /* Plaintext records are refused: they could carry forged counters */
+        if (!consumption_platform_storage_read(&g_sealed, sizeof(g_sealed)) ||
+            !open_record(&g_state.persist)) {
+            return false;
+        }
+    } else if (!consumption_platform_storage_read(&g_state.persist, sizeof(g_state.persist))) {
+        return false;
+    }
+
+    return g_state.persist.magic == STATE_MAGIC &&
+           g_state.persist.version == STATE_VERSION &&
+           g_state.persist.machine_id == g_state.config.machine_id;
+}
+
+/**
+ * @brief Start with fresh counters
+ */
+static void reset_state(void) {
+    memset(&g_state.persist, 0, sizeof(g_state.persist));
+    g_state.persist.magic = STATE_MAGIC;
+    g_state.persist.version = STATE_VERSION;
+    g_state.persist.machine_id = g_state.config.machine_id;
+    g_state.persist.last_aggregation = consumption_platform_get_timestamp();
+}
+
+/**
+ * @brief Drop the samples of a closed period
+ *
+ * Keeps what was sampled at or after period_end, the open period's part
+ * of a stratum, and scales the stratum's offered count by the share kept.
+ */
+static void reset_samples(uint32_t period_end) {
+    if (g_state.config.retention == CONSUMPTION_RETENTION_RECENT) {
+        return;
+    }
+
+    for (uint32_t s = 0; s < g_state.strata; s++) {
+        consumption_event_t* slots = &g_state.event_buffer[s * g_state.stratum_slots];
+        uint32_t kept = g_state.stratum_kept[s];
+        uint32_t open = 0;
+        for (uint32_t i = 0; i < kept; i++) {
+            if (slots[i].timestamp >= period_end) {
+                slots[open++] = slots[i];
+            }
+        }
+        if (open < kept) {
+            uint32_t seen = (uint32_t)((uint64_t)g_state.stratum_seen[s] * open / kept);
+            g_state.stratum_seen[s] = (seen > open) ? seen : open;
+            g_state.stratum_kept[s] = open;
+            g_state.buffer_count -= kept - open;
+        }
+    }
+}
+
+/**
+ * @brief Ring capacity after applying the ring memory budget
+ */
+static uint32_t ring_capacity_for_budget(uint32_t requested) {
+    uint32_t budget = g_budgets[CONSUMPTION_COMPONENT_RING];
+    if (budget == 0) {
+        return requested;
+    }
+
+    uint32_t fit = budget / (uint32_t)sizeof(consumption_event_t);
+    if (fit == 0) fit = 1; /* Keep the ring usable */
+    return (fit < requested) ? fit : requested;
+}
+
+/**
+ * @brief Append formatted text to a bounded buffer
+ * @return false (buffer unchanged) if the text does not fit
+ */
+static bool json_append(char* buffer, size_t limit, size_t* len, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(buffer + *len, limit - *len, fmt, args);
+    va_end(args);
+
+    if (written < 0 || (size_t)written >= limit - *len) {
+        buffer[*len] = '\0';
+        return false;
+    }
+
+    *len += (size_t)written;
+    return true;
+}
+
+/**
+ * @brief xorshift32 pseudo-random generator for reservoir sampling
+ */
+static inline uint32_t next_random(void) {
+    uint32_t x = g_state.rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    g_state.rng_state = x;
+    return x;
+}
+
+/**
+ * @brief Offer an event to the reservoir (Algorithm R per stratum)
+ *
+ * HOURLY strata each hold one clock hour; the first event of a later hour
+ * restarts the stratum, and an event older than the hour it holds is
+ * counted but not sampled.
+ */
+static void sample_event(const consumption_event_t* event) {
+    uint32_t stratum = 0;
+    if (g_state.config.retention == CONSUMPTION_RETENTION_HOURLY) {
+        uint32_t hour = event->timestamp / 3600u;
+        stratum = hour % g_state.strata;
+        if (hour != g_state.stratum_hour[stratum]) {
+            if (hour < g_state.stratum_hour[stratum] && g_state.stratum_kept[stratum] > 0) {
+                return;
+            }
+            g_state.buffer_count -= g_state.stratum_kept[stratum];
+            g_state.stratum_seen[stratum] = 0;
+            g_state.stratum_kept[stratum] = 0;
+            g_state.stratum_hour[stratum] = hour;
+        }
+    }
+    uint32_t base = stratum * g_state.stratum_slots;
+    uint32_t seen = ++g_state.stratum_seen[stratum];
+
+    if (g_state.stratum_kept[stratum] < g_state.stratum_slots) {
+        g_state.event_buffer[base + g_state.stratum_kept[stratum]++] = *event;
+        g_state.buffer_count++;
+        return;
+    }
+
+    uint32_t slot = next_random() % seen;
+    if (slot < g_state.stratum_slots) {
+        const consumption_event_t* dropped = &g_state.event_buffer[base + slot];
+        CONSUMPTION_TRACE3(ring_overwrite, g_state.config.machine_id,
+                           dropped->product_id, dropped->timestamp);
+        g_state.event_buffer[base + slot] = *event;
+    }
+}
+
+/**
+ * @brief Position in the retained events, oldest first
+ */
+typedef struct {
+    uint32_t stratum;
+    uint32_t index;
+} sample_cursor_t;
+
+/**
+ * @brief Read the retained event at the cursor and advance it
+ * @return false when all retained events have been read
+ */
+static bool next_sample(sample_cursor_t* cursor, consumption_sample_t* sample) {
+    const consumption_event_t* event;
+
+    if (g_state.config.retention == CONSUMPTION_RETENTION_RECENT) {
+        if (cursor->index >= g_state.buffer_count) {
+            return false;
+        }
+        event = &g_state.event_buffer[(g_state.buffer_tail + cursor->index) % g_state.ring_capacity];
+        sample->weight = 1.0f;
+    } else {
+        uint32_t seen = 0;
+        uint32_t kept = 0;
+        for (; cursor->stratum < g_state.strata; cursor->stratum++, cursor->index = 0) {
+            seen = g_state.stratum_seen[cursor->stratum];
+            kept = g_state.stratum_kept[cursor->stratum];
+            if (cursor->index < kept) break;
+        }
+        if (cursor->stratum >= g_state.strata) {
+            return false;
+        }
+        event = &g_state.event_buffer[cursor->stratum * g_state.stratum_slots + cursor->index];
+        sample->weight = (float)seen / (float)kept;
+    }
+
+    sample->timestamp = event->timestamp;
+    sample->product_id = event->product_id;
+    sample->quantity = event->quantity;
+    cursor->index++;
+    return true;
+}
+
+/**
+ * @brief Add event to ring buffer
+ */
+static consumption_error_t add_event_to_buffer(const consumption_event_t* event) {
+    if (g_state.config.retention != CONSUMPTION_RETENTION_RECENT) {
+        sample_event(event);
+        return CONSUMPTION_SUCCESS;
+    }
+
+    if (g_state.buffer_count >= g_state.ring_capacity) {
+        /* Buffer full, overwrite oldest */
+        const consumption_event_t* dropped = &g_state.event_buffer[g_state.buffer_tail];
+        CONSUMPTION_TRACE3(ring_overwrite, g_state.config.machine_id,
+                           dropped->product_id, dropped->timestamp);
+        g_state.buffer_tail = (g_state.buffer_tail + 1) % g_state.ring_capacity;
+        g_state.buffer_count--;
+    }
+
+    g_state.event_buffer[g_state.buffer_head] = *event;
+    g_state.buffer_head = (g_state.buffer_head + 1) % g_state.ring_capacity;
+    g_state.buffer_count++;
+
+    return CONSUMPTION_SUCCESS;
+}
+
+/* ============================================================================
+ * REPLICATION LOG
+ * ============================================================================ */
+
+static void log_dispense(uint32_t timestamp, uint8_t product_id, uint16_t quantity) {
+    consumption_log_record_t record = {
+        .type = CONSUMPTION_LOG_DISPENSE,
+        .event = {
+            .timestamp = timestamp ? timestamp : consumption_platform_get_timestamp(),
+            .machine_id = g_state.config.machine_id,
+            .product_id = product_id,
+            .quantity = quantity
+        }
+    };
+    g_log_handler(&record, g_log_ctx);
+}
+
+static void log_checkpoint(const void* state, size_t size) {
+    consumption_log_record_t record = {
+        .type = CONSUMPTION_LOG_CHECKPOINT,
+        .state = state,
+        .state_size = (uint32_t)size
+    };
+    g_log_handler(&record, g_log_ctx);
+}
+
+/**
+ * @brief Validate a checkpoint from another instance and decode it
+ */
+static bool decode_state(const void* state, size_t size, consumption_persist_t* persist) {
+    if (g_seal.enabled) {
+        if (size != sizeof(g_sealed)) {
+            return false;
+        }
+        memcpy(&g_sealed, state, size);
+        if (!open_record(persist)) {
+            return false;
+        }
+    } else {
+        if (size != sizeof(*persist)) {
+            return false;
+        }
+        memcpy(persist, state, size);
+    }
+
+    return persist->magic == STATE_MAGIC &&
+           persist->version == STATE_VERSION &&
+           persist->machine_id == g_state.config.machine_id;
+}
+
+/* ============================================================================
+ * UPLOAD STREAM
+ * ============================================================================ */
+
+/*
+ * The sync payload is produced one item (header, product count, event) at a
+ * time into a small scratch buffer and copied out on demand, so a payload of
+ * any size is serialized with constant memory.
+ */
+
+typedef enum {
+    FRAME_AGGREGATE = 0,            /* Full payload */
+    FRAME_HEARTBEAT,                /* Idle period: liveness only */
+    FRAME_REPEAT,                   /* Same counts as the last acknowledged aggregate */
+} frame_kind_t;
+
+typedef enum {
+    STREAM_HEADER = 0,
+    STREAM_PRODUCTS,
+    STREAM_EVENTS,
+    STREAM_DONE,
+} stream_phase_t;
+
+typedef struct {
+    stream_phase_t phase;
+    frame_kind_t kind;
+    uint32_t seq;
+    uint32_t digest;                /* Cumulative counters, compact frames only */
+    uint32_t period_start;
+    uint32_t period_end;
+    uint32_t period_events;
+    const uint32_t* counts;         /* Per-product counts of the period */
+    uint32_t product;               /* Next product ID to emit */
+    sample_cursor_t cursor;         /* Next retained event to emit */
+    bool first;
+    size_t bytes;                   /* Bytes handed out so far */
+    char item[STREAM_ITEM_SIZE];
+    size_t item_len;
+    size_t item_off;
+} upload_stream_t;
+
+static void stream_begin(upload_stream_t* stream, uint32_t period_start, uint32_t period_end,
+                         uint32_t period_events, const uint32_t* counts) {
+    memset(stream, 0, sizeof(*stream));
+    stream->period_start = period_start;
+    stream->period_end = period_end;
+    stream->period_events = period_events;
+    stream->counts = counts;
+    stream->product = 1;
+}
+
+/**
+ * @brief Serialize the next payload item into the scratch buffer
+ * @return false when the payload is complete
+ */
+static bool stream_next_item(upload_stream_t* stream) {
+    size_t len = 0;
+    consumption_sample_t sample;
+
+    switch (stream->phase) {
+        case STREAM_HEADER:
+            if (stream->kind != FRAME_AGGREGATE) {
+                json_append(stream->item, sizeof(stream->item), &len,
+                    "{\"machine_id\":%u,\"seq\":%u,\"period_start\":%u,\"period_end\":%u,",
+                    g_state.config.machine_id, stream->seq, stream->period_start,
+                    stream->period_end);
+                if (stream->kind == FRAME_REPEAT) {
+                    json_append(stream->item, sizeof(stream->item), &len, "\"repeat\":%u,",
+                                g_state.last_full_seq);
+                }
+                json_append(stream->item, sizeof(stream->item), &len, "\"digest\":\"%08x\"}",
+                            stream->digest);
+                stream->phase = STREAM_DONE;
+                break;
+            }
+            json_append(stream->item, sizeof(stream->item), &len,
+                "{\"machine_id\":%u,\"seq\":%u,\"period_start\":%u,\"period_end\":%u,"
+                "\"total_events\":%u,\"products\":{",
+                g_state.config.machine_id, stream->seq, stream->period_start,
+                stream->period_end, stream->period_events);
+            stream->phase = STREAM_PRODUCTS;
+            stream->first = true;
+            break;
+
+        case STREAM_PRODUCTS:
+            while (stream->product < 256 && stream->counts[stream->product] == 0) {
+                stream->product++;
+            }
+            if (stream->product < 256) {
+                json_append(stream->item, sizeof(stream->item), &len,
+                            stream->first ? "\"%u\":%u" : ",\"%u\":%u",
+                            stream->product, stream->counts[stream->product]);
+                stream->product++;
+                stream->first = false;
+            } else if (g_state.config.upload_events) {
+                json_append(stream->item, sizeof(stream->item), &len, "},\"events\":[");
+                stream->phase = STREAM_EVENTS;
+                stream->first = true;
+            } else {
+                json_append(stream->item, sizeof(stream->item), &len, "}}");
+                stream->phase = STREAM_DONE;
+            }
+            break;
+
+        case STREAM_EVENTS:
+            if (next_sample(&stream->cursor, &sample)) {
+                json_append(stream->item, sizeof(stream->item), &len,
+                            stream->first ? "[%u,%u,%u,%.6g]" : ",[%u,%u,%u,%.6g]",
+                            sample.timestamp, sample.product_id, sample.quantity,
+                            (double)sample.weight);
+                stream->first = false;
+            } else {
+                json_append(stream->item, sizeof(stream->item), &len, "]}");
+                stream->phase = STREAM_DONE;
+            }
+            break;
+
+        case STREAM_DONE:
+        default:
+            return false;
+    }
+
+    stream->item_len = len;
+    stream->item_off = 0;
+    return true;
+}
+
+/**
+ * @brief Pull callback: copy up to size payload bytes into buffer
+ * @return Bytes written, 0 at the end of the payload
+ */
+static size_t stream_read(char* buffer, size_t size, void* ctx) {
+    upload_stream_t* stream = (upload_stream_t*)ctx;
+    size_t written = 0;
+
+    while (written < size) {
+        if (stream->item_off == stream->item_len && !stream_next_item(stream)) {
+            break;
+        }
+        size_t n = stream->item_len - stream->item_off;
+        if (n > size - written) n = size - written;
+        memcpy(buffer + written, stream->item + stream->item_off, n);
+        stream->item_off += n;
+        written += n;
+    }
+
+    stream->bytes += written;
+    return written;
+}
+
+static bool stream_finished(const upload_stream_t* stream) {
+    return stream->phase == STREAM_DONE && stream->item_off == stream->item_len;
+}
+
+/**
+ * @brief Serialize as many whole items as fit one buffer, closed as valid JSON
+ *
+ * For transports without streaming: what does not fit is left out and the
+ * payload is flagged "truncated".
+ * @return Payload length
+ */
+static size_t stream_read_truncated(char* buffer, size_t size, upload_stream_t* stream) {
+    static const char products_tail[] = "},\"truncated\":true}";
+    static const char events_tail[] = "],\"truncated\":true}";
+    size_t len = 0;
+
+    for (;;) {
+        stream_phase_t phase = stream->phase;
+        if (!stream_next_item(stream)) {
+            break;
+        }
+        if (len + stream->item_len + sizeof(products_tail) > size) {
+            const char* tail = (phase == STREAM_EVENTS) ? events_tail : products_tail;
+            json_append(buffer, size, &len, "%s", tail);
+            consumption_platform_log(1, "Sync payload exceeds serializer buffer, truncated");
+            break;
+        }
+        memcpy(buffer + len, stream->item, stream->item_len);
+        len += stream->item_len;
+    }
+
+    stream->item_off = stream->item_len;
+    stream->bytes = len;
+    return len;
+}
+
+/* ============================================================================
+ * UPLOAD
+ * ============================================================================
+ *
+ * An upload takes the open period's counters with it, so the open period
+ * restarts at the upload and keeps counting while the payload is in flight.
+ * Blocking syncs and asynchronous transports share this path.
+ */
+
+struct consumption_upload_t {
+    bool active;
+    frame_kind_t kind;
+    uint32_t seq;
+    uint32_t counts_digest;         /* Of the period's counts */
+    uint32_t period_start;
+    uint32_t period_end;
+    uint32_t period_events;
+    uint32_t counts[256];
+    uint64_t started_us;            /* Trace clock at begin */
+    upload_stream_t stream;
+};
+
+static consumption_upload_t g_upload = {0};
+
+/**
+ * @brief FNV-1a over 32-bit words
+ */
+static uint32_t digest_words(uint32_t hash, const uint32_t* words, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        for (int b = 0; b < 32; b += 8) {
+            hash = (hash ^ ((words[i] >> b) & 0xffu)) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+#define DIGEST_INIT 2166136261u
+
+/**
+ * @brief Digest of a period's counts, to spot a repeat of the last aggregate
+ */
+static uint32_t counts_digest(uint32_t events, const uint32_t* counts) {
+    uint32_t hash = digest_words(DIGEST_INIT, &events, 1);
+    for (uint32_t p = 1; p < 256; p++) {
+        if (counts[p] > 0) {
+            uint32_t item[2] = {p, counts[p]};
+            hash = digest_words(hash, item, 2);
+        }
+    }
+    return hash;
+}
+
+/**
+ * @brief Restart the payload of the upload in flight
+ */
+static void upload_stream_begin(void) {
+    stream_begin(&g_upload.stream, g_upload.period_start, g_upload.period_end,
+                 g_upload.period_events, g_upload.counts);
+    g_upload.stream.kind = g_upload.kind;
+    g_upload.stream.seq = g_upload.seq;
+
+    /* Cumulative counters as of this period's end */
+    uint32_t cumulative[2] = {g_state.config.machine_id, g_state.persist.total_events};
+    g_upload.stream.digest = digest_words(DIGEST_INIT, cumulative, 2);
+}
+
+/**
+ * @brief Move the open period into the upload record
+ * @return false if no upload is due
+ */
+static bool upload_begin(void) {
+    g_state.sync_pending = false;
+
+    uint32_t now = consumption_platform_get_timestamp();
+    uint32_t period_start = g_state.persist.last_aggregation;
+
+    if (now - period_start < g_state.config.aggregation_interval) {
+        return false; /* Not enough time passed */
+    }
+
+    /* Open-period counters are maintained on dispense, no event rescan needed */
+    fold_counters();
+    frame_kind_t kind = FRAME_AGGREGATE;
+    uint32_t digest = 0;
+    if (g_state.persist.period_events == 0) {
+        if (!g_state.config.heartbeat_frames) {
+            return false; /* Nothing to send */
+        }
+        kind = FRAME_HEARTBEAT;
+    } else if (g_state.config.heartbeat_frames && !g_state.config.upload_events) {
+        /* With raw events attached no two periods are alike */
+        digest = counts_digest(g_state.persist.period_events, g_state.persist.period_counts);
+        if (g_state.last_full_seq != 0 && digest == g_state.last_full_digest) {
+            kind = FRAME_REPEAT;
+        }
+    }
+
+    if (g_state.persist.sync_failures > 0) {
+        CONSUMPTION_TRACE3(network_retry, g_state.config.machine_id,
+                           g_state.persist.sync_failures, g_state.config.max_retry_attempts);
+    }
+
+    g_upload.active = true;
+    g_upload.kind = kind;
+    g_upload.seq = ++g_state.upload_seq;
+    g_upload.counts_digest = digest;
+    g_upload.period_start = period_start;
+    g_upload.period_end = now;
+    g_upload.period_events = g_state.persist.period_events;
+    memcpy(g_upload.counts, g_state.persist.period_counts, sizeof(g_upload.counts));
 
-static consumption_state_t g_state = {0};
+    g_state.persist.last_aggregation = now;
+    g_state.persist.period_events = 0;
+    memset(g_state.persist.period_counts, 0, sizeof(g_state.persist.period_counts));
 
-/* ============================================================================
- * INTERNAL FUNCTIONS
- * ============================================================================ */
+    g_upload.started_us = CONSUMPTION_TRACE_START_US(sync_finish);
+    CONSUMPTION_TRACE3(sync_start, g_state.config.machine_id, period_start, now);
 
-/**
- * @brief Validate configuration
- */
-static bool validate_config(const consumption_config_t* config) {
-    if (!config) return false;
-    if (config->machine_id == 0) return false;
-    if (config->ring_buffer_size == 0) return false;
-    if (config->ring_buffer_size > 10000) return false; /* Reasonable limit */
+    upload_stream_begin();
     return true;
 }
 
 /**
- * @brief Initialize default configuration
+ * @brief Close the uploaded period, or return its counters to the open one
  */
-static void init_default_config(consumption_config_t* config) {
-    memset(config, 0, sizeof(consumption_config_t));
-    config->enable_external_api = false;
-    config->ring_buffer_size = 1000;
-    config->aggregation_interval = 3600; /* 1 hour */
-    config->max_retry_attempts = 3;
-    strncpy(config->api_endpoint, "https://api.example.com/consumption", sizeof(config->api_endpoint) - 1);
-}
+static consumption_error_t upload_finish(bool success, size_t len) {
+    const uint32_t machine_id = g_state.config.machine_id;
 
-/**
- * @brief Save state to persistent storage
- */
-static bool save_state(void) {
-    return consumption_platform_storage_write(&g_state, sizeof(g_state));
+    CONSUMPTION_TRACE4(sync_finish, machine_id, success, len,
+                       CONSUMPTION_TRACE_SINCE_US(g_upload.started_us));
+
+    g_upload.active = false;
+
+    if (success) {
+        g_state.persist.last_sync = g_upload.period_end;
+        g_state.persist.sync_failures = 0;
+        if (g_upload.kind == FRAME_AGGREGATE) {
+            g_state.last_full_seq = g_upload.seq;
+            g_state.last_full_digest = g_upload.counts_digest;
+        }
+        reset_samples(g_upload.period_end);
+        CONSUMPTION_TRACE4(period_close, machine_id, g_upload.period_start,
+                           g_upload.period_end, g_upload.period_events);
+
+        /* Persist sync state; a standby gets the same record */
+        uint64_t started = CONSUMPTION_TRACE_START_US(storage_write_finish);
+        const void* record;
+        size_t size = encode_state(&record);
+        write_state(record, size, started);
+        if (g_log_handler) {
+            log_checkpoint(record, size);
+        }
+        consumption_platform_log(2, "Consumption data synced successfully");
+        return CONSUMPTION_SUCCESS;
+    }
+
+    /* The failed period and whatever was counted since form the open period */
+    g_state.persist.last_aggregation = g_upload.period_start;
+    g_state.persist.period_events += g_upload.period_events;
+    for (uint32_t p = 1; p < 256; p++) {
+        g_state.persist.period_counts[p] += g_upload.counts[p];
+    }
+    g_state.persist.sync_failures++;
+    if (g_log_handler) {
+        const void* record;
+        size_t size = encode_state(&record);
+        log_checkpoint(record, size);
+    }
+    consumption_platform_log(0, "Failed to sync consumption data");
+    return CONSUMPTION_ERROR_API_ERROR;
 }
 
+static consumption_error_t sync_to_api(void);
+
 /**
- * @brief Load state from persistent storage
+ * @brief Start of the wait for the next sync
+ *
+ * Both the sync interval and the period length must have passed.
  */
-static bool load_state(void) {
-    return consumption_platform_storage_read(&g_state, sizeof(g_state));
+static uint32_t sync_interval_start(void) {
+    uint32_t since = g_state.persist.last_sync;
+    if (g_state.persist.last_aggregation > since) {
+        since = g_state.persist.last_aggregation;
+    }
+    return since;
 }
 
 /**
- * @brief Add event to ring buffer
+ * @brief Make room for n events, dropping the oldest ones if needed
+ * @return Ring index of the first reserved slot
  */
-static consumption_error_t add_event_to_buffer(const consumption_event_t* event) {
-    if (g_state.buffer_count >= g_state.config.ring_buffer_size) {
-        /* Buffer full, overwrite oldest */
-        g_state.buffer_tail = (g_state.buffer_tail + 1) % g_state.config.ring_buffer_size;
-        g_state.buffer_count--;
+static uint32_t reserve_ring_space(uint32_t n) {
+    uint32_t free_slots = g_state.ring_capacity - g_state.buffer_count;
+    if (n > free_slots) {
+        uint32_t dropped = n - free_slots;
+        for (uint32_t i = 0; i < dropped; i++) {
+            const consumption_event_t* event =
+                &g_state.event_buffer[(g_state.buffer_tail + i) % g_state.ring_capacity];
+            CONSUMPTION_TRACE3(ring_overwrite, g_state.config.machine_id,
+                               event->product_id, event->timestamp);
+        }
+        g_state.buffer_tail = (g_state.buffer_tail + dropped) % g_state.ring_capacity;
+        g_state.buffer_count -= dropped;
     }
 
-    g_state.event_buffer[g_state.buffer_head] = *event;
-    g_state.buffer_head = (g_state.buffer_head + 1) % g_state.config.ring_buffer_size;
-    g_state.buffer_count++;
-
-    return CONSUMPTION_SUCCESS;
+    uint32_t first = g_state.buffer_head;
+    g_state.buffer_head = (g_state.buffer_head + n) % g_state.ring_capacity;
+    g_state.buffer_count += n;
+    return first;
 }
 
 /**
- * @brief Aggregate events into summary data
+ * @brief Run a sync if the interval has passed
+ * @param now Current time, read by the caller
  */
-static void aggregate_events(consumption_aggregate_t* aggregate,
-                           uint32_t start_time, uint32_t end_time) {
-    memset(aggregate, 0, sizeof(consumption_aggregate_t));
-    aggregate->machine_id = g_state.config.machine_id;
-    aggregate->period_start = start_time;
-    aggregate->period_end = end_time;
-
-    uint32_t index = g_state.buffer_tail;
-    for (uint32_t i = 0; i < g_state.buffer_count; i++) {
-        const consumption_event_t* event = &g_state.event_buffer[index];
-        if (event->timestamp >= start_time && event->timestamp <= end_time) {
-            aggregate->total_events++;
-            if (event->product_id < 256) {
-                aggregate->product_counts[event->product_id]++;
+static void maybe_sync(uint32_t now) {
+    if (g_state.config.enable_external_api) {
+        if (now - sync_interval_start() >= g_state.config.aggregation_interval) {
+            if (!g_sync_notify) {
+                /* Non-blocking sync attempt */
+                sync_to_api();
+            } else if (!g_state.sync_pending && !g_upload.active) {
+                /* The host's loop uploads; tell it once */
+                g_state.sync_pending = true;
+                g_sync_notify(g_sync_ctx);
             }
         }
-        index = (index + 1) % g_state.config.ring_buffer_size;
     }
 }
 
@@ -174,65 +1392,55 @@ static consumption_error_t sync_to_api(void) {
         return CONSUMPTION_SUCCESS;
     }
 
-    if (g_state.sync_in_progress) {
+    if (g_upload.active) {
         return CONSUMPTION_ERROR_API_ERROR; /* Already in progress */
     }
 
-    g_state.sync_in_progress = true;
-
-    uint32_t now = consumption_platform_get_timestamp();
-    uint32_t period_start = g_state.last_aggregation;
-    uint32_t period_end = now;
-
-    if (period_end - period_start < g_state.config.aggregation_interval) {
-        g_state.sync_in_progress = false;
-        return CONSUMPTION_SUCCESS; /* Not enough time passed */
+    if (!upload_begin()) {
+        return CONSUMPTION_SUCCESS;
     }
 
-    consumption_aggregate_t aggregate;
-    aggregate_events(&aggregate, period_start, period_end);
-
-    if (aggregate.total_events == 0) {
-        g_state.sync_in_progress = false;
-        return CONSUMPTION_SUCCESS; /* Nothing to send */
+    /* The serializer budget caps the scratch buffer, not the payload */
+    char json_buffer[JSON_BUFFER_SIZE];
+    size_t limit = sizeof(json_buffer);
+    uint32_t budget = g_budgets[CONSUMPTION_COMPONENT_SERIALIZER];
+    if (budget > 0 && budget < limit) {
+        limit = (budget > JSON_MIN_CHUNK) ? budget : JSON_MIN_CHUNK;
     }
 
-    /* Create JSON payload */
-    char json_buffer[1024];
-    int len = snprintf(json_buffer, sizeof(json_buffer),
-        "{\"machine_id\":%u,\"period_start\":%u,\"period_end\":%u,\"total_events\":%u",
-        aggregate.machine_id, aggregate.period_start, aggregate.period_end, aggregate.total_events);
+    size_t len = stream_read(json_buffer, limit, &g_upload.stream);
 
-    /* Add product counts */
-    bool first = true;
-    len += snprintf(json_buffer + len, sizeof(json_buffer) - len, ",\"products\":{");
-    for (int i = 1; i < 256; i++) {
-        if (aggregate.product_counts[i] > 0) {
-            if (!first) len += snprintf(json_buffer + len, sizeof(json_buffer) - len, ",");
-            len += snprintf(json_buffer + len, sizeof(json_buffer) - len, "\"%d\":%u", i, aggregate.product_counts[i]);
-            first = false;
+    bool success;
+    if (stream_finished(&g_upload.stream)) {
+        success = consumption_platform_network_send(
+            g_state.config.api_endpoint,
+            json_buffer,
+            len
+        );
+    } else {
+        /* Larger than one buffer: let the transport pull it from the start */
+        upload_stream_begin();
+        success = consumption_platform_network_send_stream(
+            g_state.config.api_endpoint,
+            stream_read,
+            &g_upload.stream
+        );
+        len = g_upload.stream.bytes;
+
+        if (!success && len == 0) {
+            /* Nothing pulled: no streaming on this platform, send what fits */
+            size_t fallback = (limit > JSON_FALLBACK_MIN) ? limit : JSON_FALLBACK_MIN;
+            upload_stream_begin();
+            len = stream_read_truncated(json_buffer, fallback, &g_upload.stream);
+            success = consumption_platform_network_send(
+                g_state.config.api_endpoint,
+                json_buffer,
+                len
+            );
         }
     }
-    len += snprintf(json_buffer + len, sizeof(json_buffer) - len, "}}");
 
-    bool success = consumption_platform_network_send(
-        g_state.config.api_endpoint,
-        json_buffer,
-        (size_t)len
-    );
-
-    g_state.sync_in_progress = false;
-
-    if (success) {
-        g_state.last_sync = now;
-        g_state.last_aggregation = period_end;
-        save_state(); /* Persist sync state */
-        consumption_platform_log(2, "Consumption data synced successfully");
-        return CONSUMPTION_SUCCESS;
-    } else {
-        consumption_platform_log(0, "Failed to sync consumption data");
-        return CONSUMPTION_ERROR_API_ERROR;
-    }
+    return upload_finish(success, len);
 }
 
 /* ============================================================================
@@ -244,33 +1452,52 @@ consumption_error_t consumption_init(const consumption_config_t* config) {
         return CONSUMPTION_SUCCESS; /* Already initialized */
     }
 
-    consumption_config_t default_config;
-    init_default_config(&default_config);
+    if (config && !validate_config(config)) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
 
+    memset(&g_state, 0, sizeof(g_state));
+    memset(&g_upload, 0, sizeof(g_upload));
     if (config) {
-        if (!validate_config(config)) {
-            return CONSUMPTION_ERROR_INVALID_CONFIG;
-        }
         g_state.config = *config;
     } else {
-        g_state.config = default_config;
+        init_default_config(&g_state.config);
     }
 
-    /* Try to load previous state */
+    /* Restore counters and sync cursor; dispenses are accepted right after */
     if (!load_state()) {
-        /* First run or corrupted storage */
-        memset(&g_state, 0, sizeof(g_state));
-        g_state.config = config ? *config : default_config;
-        g_state.last_aggregation = consumption_platform_get_timestamp();
+        /* First run, different machine or corrupted storage */
+        reset_state();
     }
 
-    /* Allocate ring buffer */
-    g_state.event_buffer = (consumption_event_t*)malloc(
-        g_state.config.ring_buffer_size * sizeof(consumption_event_t));
-    if (!g_state.event_buffer) {
-        return CONSUMPTION_ERROR_MEMORY_ERROR;
+    /* Allocate ring buffer, shrunk to the ring budget if one is set */
+    if (!g_state.config.counter_only) {
+        g_state.ring_capacity = ring_capacity_for_budget(g_state.config.ring_buffer_size);
+        if (g_state.ring_capacity < g_state.config.ring_buffer_size) {
+            consumption_platform_log(1, "Ring buffer reduced to fit memory budget");
+        }
+
+        g_state.event_buffer = (consumption_event_t*)malloc(
+            g_state.ring_capacity * sizeof(consumption_event_t));
+        if (!g_state.event_buffer) {
+            return CONSUMPTION_ERROR_MEMORY_ERROR;
+        }
+
+        /* Strata are fixed at init; a budget below one slot per stratum keeps fewer hours */
+        g_state.strata = sample_strata_for(&g_state.config);
+        if (g_state.strata > g_state.ring_capacity) g_state.strata = g_state.ring_capacity;
+        g_state.stratum_slots = g_state.ring_capacity / g_state.strata;
+        memset(g_state.stratum_seen, 0, sizeof(g_state.stratum_seen));
+        memset(g_state.stratum_kept, 0, sizeof(g_state.stratum_kept));
+        memset(g_state.stratum_hour, 0, sizeof(g_state.stratum_hour));
+        g_state.rng_state = (g_state.config.machine_id * 2654435761u) ^
+                            consumption_platform_get_timestamp();
+        if (g_state.rng_state == 0) g_state.rng_state = 0x9E3779B9u;
     }
 
+#if CONSUMPTION_COUNTER_SHARDS > 1
+    t_driver_epoch = ++g_driver_epoch;
+#endif
     g_state.initialized = true;
     consumption_platform_log(2, "Consumption module initialized");
 
@@ -290,28 +1517,116 @@ consumption_error_t consumption_on_dispense(uint32_t machine_id, uint8_t product
         return CONSUMPTION_ERROR_INVALID_PARAMETER;
     }
 
-    consumption_event_t event = {
-        .timestamp = consumption_platform_get_timestamp(),
-        .machine_id = machine_id,
-        .product_id = product_id
-    };
+    if (!dispense_allowed()) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
+
+    /* One clock read serves the event and the sync check */
+    uint32_t now = 0;
+    if (!g_state.config.counter_only || g_state.config.enable_external_api) {
+        now = consumption_platform_get_timestamp();
+    }
 
-    consumption_error_t result = add_event_to_buffer(&event);
-    if (result != CONSUMPTION_SUCCESS) {
-        return result;
+    uint32_t event_timestamp = 0;
+    if (!g_state.config.counter_only) {
+        consumption_event_t event = {
+            .timestamp = now,
+            .machine_id = machine_id,
+            .product_id = product_id,
+            .quantity = 1
+        };
+
+        consumption_error_t result = add_event_to_buffer(&event);
+        if (result != CONSUMPTION_SUCCESS) {
+            return result;
+        }
+        event_timestamp = event.timestamp;
     }
 
-    g_state.total_events++;
+    count_dispense(current_shard(), product_id, 1);
+    CONSUMPTION_TRACE3(dispense, machine_id, product_id, g_state.buffer_count);
+    if (g_log_handler) {
+        log_dispense(g_state.config.counter_only ? 0 : event_timestamp, product_id, 1);
+    }
 
     /* Try to sync if enabled and interval passed */
-    if (g_state.config.enable_external_api) {
-        uint32_t now = consumption_platform_get_timestamp();
-        if (now - g_state.last_sync >= g_state.config.aggregation_interval) {
-            /* Non-blocking sync attempt */
-            sync_to_api();
+    maybe_sync(now);
+
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_on_dispense_batch(uint32_t machine_id,
+                                                 const consumption_dispense_t* records,
+                                                 uint32_t count) {
+    if (!g_state.initialized) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
+
+    if (machine_id != g_state.config.machine_id || (!records && count > 0)) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    /* Validate everything first so a bad batch records nothing */
+    for (uint32_t i = 0; i < count; i++) {
+        if (records[i].product_id == 0 || records[i].quantity == 0) {
+            return CONSUMPTION_ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    if (count == 0) {
+        return CONSUMPTION_SUCCESS;
+    }
+
+    if (!dispense_allowed()) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
+
+    /* One clock read serves the ring, the log and the sync check */
+    uint32_t now = 0;
+    if (!g_state.config.counter_only || g_log_handler || g_state.config.enable_external_api) {
+        now = consumption_platform_get_timestamp();
+    }
+
+    if (g_state.config.retention != CONSUMPTION_RETENTION_RECENT) {
+        for (uint32_t i = 0; i < count; i++) {
+            consumption_event_t event = {
+                .timestamp = records[i].timestamp ? records[i].timestamp : now,
+                .machine_id = machine_id,
+                .product_id = records[i].product_id,
+                .quantity = records[i].quantity
+            };
+            sample_event(&event);
+        }
+    } else if (!g_state.config.counter_only) {
+        /* Only the newest records can survive a batch larger than the ring */
+        uint32_t skip = (count > g_state.ring_capacity) ? count - g_state.ring_capacity : 0;
+        uint32_t index = reserve_ring_space(count - skip);
+
+        for (uint32_t i = skip; i < count; i++) {
+            consumption_event_t* event = &g_state.event_buffer[index];
+            event->timestamp = records[i].timestamp ? records[i].timestamp : now;
+            event->machine_id = machine_id;
+            event->product_id = records[i].product_id;
+            event->quantity = records[i].quantity;
+            if (++index == g_state.ring_capacity) index = 0;
+        }
+    }
+
+    uint32_t shard = current_shard();
+    for (uint32_t i = 0; i < count; i++) {
+        count_dispense(shard, records[i].product_id, records[i].quantity);
+        CONSUMPTION_TRACE3(dispense, machine_id, records[i].product_id, g_state.buffer_count);
+    }
+
+    if (g_log_handler) {
+        for (uint32_t i = 0; i < count; i++) {
+            log_dispense(records[i].timestamp ? records[i].timestamp : now,
+                         records[i].product_id, records[i].quantity);
         }
     }
 
+    maybe_sync(now);
+
     return CONSUMPTION_SUCCESS;
 }
 
@@ -320,6 +1635,11 @@ consumption_error_t consumption_deinit(void) {
         return CONSUMPTION_SUCCESS;
     }
 
+    /* An abandoned asynchronous upload goes back into the open period */
+    if (g_upload.active) {
+        upload_finish(false, 0);
+    }
+
     /* Force final sync if enabled */
     if (g_state.config.enable_external_api) {
         sync_to_api();
@@ -362,13 +1682,70 @@ consumption_error_t consumption_get_stats(uint32_t* total_events,
         return CONSUMPTION_ERROR_INVALID_CONFIG;
     }
 
-    if (total_events) *total_events = g_state.total_events;
+    fold_counters();
+
+    if (total_events) *total_events = g_state.persist.total_events;
     if (buffered_events) *buffered_events = g_state.buffer_count;
-    if (last_sync) *last_sync = g_state.last_sync;
+    if (last_sync) *last_sync = g_state.persist.last_sync;
+
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_get_snapshot(consumption_snapshot_t* snapshot) {
+    if (!g_state.initialized) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
+
+    if (!snapshot) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    fold_counters();
+
+    snapshot->machine_id = g_state.config.machine_id;
+    snapshot->timestamp = consumption_platform_get_timestamp();
+    snapshot->total_events = g_state.persist.total_events;
+    snapshot->period_start = g_state.persist.last_aggregation;
+    snapshot->period_events = g_state.persist.period_events;
+    snapshot->buffered_events = g_state.buffer_count;
+    snapshot->last_sync = g_state.persist.last_sync;
+    snapshot->sync_failures = g_state.persist.sync_failures;
+    memcpy(snapshot->product_counts, g_state.persist.period_counts,
+           sizeof(snapshot->product_counts));
+
+    /* Until it is acknowledged, an upload in flight is still the open period */
+    if (g_upload.active) {
+        snapshot->period_start = g_upload.period_start;
+        snapshot->period_events += g_upload.period_events;
+        for (uint32_t p = 1; p < 256; p++) {
+            snapshot->product_counts[p] += g_upload.counts[p];
+        }
+    }
 
     return CONSUMPTION_SUCCESS;
 }
 
+consumption_error_t consumption_get_samples(consumption_sample_t* samples,
+                                          uint32_t max_samples,
+                                          uint32_t* count) {
+    if (!g_state.initialized) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
+
+    if (!count || (!samples && max_samples > 0)) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    uint32_t written = 0;
+    sample_cursor_t cursor = {0, 0};
+    while (written < max_samples && next_sample(&cursor, &samples[written])) {
+        written++;
+    }
+
+    *count = written;
+    return CONSUMPTION_SUCCESS;
+}
+
 consumption_error_t consumption_force_sync(void) {
     if (!g_state.initialized) {
         return CONSUMPTION_ERROR_INVALID_CONFIG;
@@ -377,16 +1754,283 @@ consumption_error_t consumption_force_sync(void) {
     return sync_to_api();
 }
 
+void consumption_set_sync_handler(consumption_sync_notify_t notify, void* ctx) {
+    g_sync_notify = notify;
+    g_sync_ctx = ctx;
+    g_state.sync_pending = false;
+}
+
+consumption_error_t consumption_get_next_sync(uint32_t* timestamp) {
+    if (!g_state.initialized) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
+
+    if (!timestamp) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    if (!g_state.config.enable_external_api) {
+        *timestamp = 0;
+        return CONSUMPTION_SUCCESS;
+    }
+
+    *timestamp = sync_interval_start() + g_state.config.aggregation_interval;
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_upload_begin(consumption_upload_t** upload) {
+    if (!g_state.initialized) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
+
+    if (!upload) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    *upload = NULL;
+    if (!g_state.config.enable_external_api) {
+        return CONSUMPTION_SUCCESS;
+    }
+
+    if (g_upload.active) {
+        return CONSUMPTION_ERROR_API_ERROR; /* Already in progress */
+    }
+
+    if (upload_begin()) {
+        *upload = &g_upload;
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+size_t consumption_upload_read(char* buffer, size_t size, void* upload) {
+    consumption_upload_t* u = (consumption_upload_t*)upload;
+    if (u != &g_upload || !u->active || !buffer) {
+        return 0;
+    }
+    return stream_read(buffer, size, &u->stream);
+}
+
+consumption_error_t consumption_upload_get_info(const consumption_upload_t* upload,
+                                               consumption_upload_info_t* info) {
+    if (upload != &g_upload || !upload->active || !info) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    info->period_start = upload->period_start;
+    info->period_end = upload->period_end;
+    info->events = upload->period_events;
+    info->bytes = (uint32_t)upload->stream.bytes;
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_upload_finish(consumption_upload_t* upload, bool success) {
+    if (upload != &g_upload || !upload->active) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    return upload_finish(success, upload->stream.bytes);
+}
+
+consumption_error_t consumption_get_footprint(consumption_footprint_t* footprint) {
+    if (!footprint) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    memset(footprint, 0, sizeof(consumption_footprint_t));
+    consumption_component_footprint_t* c = footprint->components;
+
+    /* Endpoint and key strings are accounted to the network component */
+    uint32_t network_strings =
+        (uint32_t)(sizeof(g_state.config.api_endpoint) + sizeof(g_state.config.api_key));
+    c[CONSUMPTION_COMPONENT_STATE].static_bytes =
+        (uint32_t)(sizeof(g_state) + sizeof(g_budgets) + sizeof(g_seal) + sizeof(g_sealed)) -
+        network_strings;
+    c[CONSUMPTION_COMPONENT_NETWORK].static_bytes = network_strings;
+
+    if (g_state.initialized && g_state.event_buffer) {
+        c[CONSUMPTION_COMPONENT_RING].heap_bytes =
+            g_state.ring_capacity * (uint32_t)sizeof(consumption_event_t);
+    }
+
+    /* Open-period counters live in the state; sync_to_api() only adds the JSON buffer */
+    c[CONSUMPTION_COMPONENT_AGGREGATES].static_bytes =
+        (uint32_t)(sizeof(g_state.persist.period_counts) + sizeof(g_state.shards));
+    c[CONSUMPTION_COMPONENT_STATE].static_bytes -= c[CONSUMPTION_COMPONENT_AGGREGATES].static_bytes;
+
+    /* The upload record: counters of the period in flight and the stream */
+    c[CONSUMPTION_COMPONENT_AGGREGATES].static_bytes += (uint32_t)sizeof(g_upload.counts);
+    c[CONSUMPTION_COMPONENT_SERIALIZER].static_bytes =
+        (uint32_t)(sizeof(g_upload) - sizeof(g_upload.counts));
+    c[CONSUMPTION_COMPONENT_SERIALIZER].peak_stack_bytes = JSON_BUFFER_SIZE;
+
+    for (int i = 0; i < CONSUMPTION_COMPONENT_COUNT; i++) {
+        c[i].budget_bytes = g_budgets[i];
+        if (c[i].budget_bytes > 0) {
+            uint32_t used;
+            switch (i) {
+                case CONSUMPTION_COMPONENT_RING:
+                    used = c[i].heap_bytes;
+                    break;
+                case CONSUMPTION_COMPONENT_SERIALIZER:
+                    /* Buffer shrinks to the budget, but never below the minimum chunk */
+                    used = JSON_MIN_CHUNK;
+                    break;
+                default:
+                    used = c[i].static_bytes + c[i].heap_bytes + c[i].peak_stack_bytes;
+                    break;
+            }
+            c[i].over_budget = (used > c[i].budget_bytes);
+        }
+
+        footprint->total_static_bytes += c[i].static_bytes;
+        footprint->total_heap_bytes += c[i].heap_bytes;
+    }
+
+    /* Deepest path is sync_to_api() with its JSON buffer */
+    footprint->total_peak_stack_bytes = c[CONSUMPTION_COMPONENT_SERIALIZER].peak_stack_bytes;
+
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_set_memory_budget(consumption_component_t component,
+                                                uint32_t budget_bytes) {
+    if ((int)component < 0 || component >= CONSUMPTION_COMPONENT_COUNT) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    g_budgets[component] = budget_bytes;
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_set_storage_key(const uint8_t* key) {
+    if (!key) {
+        memset(g_seal.state, 0, sizeof(g_seal.state));
+        g_seal.enabled = false;
+        return CONSUMPTION_SUCCESS;
+    }
+
+    chacha20_key(g_seal.state, key);    /* Fixed for every record */
+    g_seal.enabled = true;
+    return CONSUMPTION_SUCCESS;
+}
+
+void consumption_aead_seal(const uint8_t key[CONSUMPTION_STORAGE_KEY_SIZE], const uint8_t nonce[12],
+                           const uint8_t* aad, size_t aad_len,
+                           const uint8_t* plaintext, size_t len,
+                           uint8_t* ciphertext, uint8_t tag[16]) {
+    uint32_t state[16];
+    uint32_t mac_state[16];
+
+    chacha20_key(state, key);
+    state[12] = 0;
+    for (int i = 0; i < 3; i++) {
+        state[13 + i] = load_le32(nonce + 4 * i);
+    }
+    memcpy(mac_state, state, sizeof(state));
+    state[12] = 1;
+    chacha20_xor(state, plaintext, ciphertext, len);
+    aead_tag(mac_state, aad, aad_len, ciphertext, len, tag);
+}
+
+void consumption_poly1305(const uint8_t key[32], const uint8_t* message, size_t len, uint8_t tag[16]) {
+    poly1305_t mac;
+    poly1305_init(&mac, key);
+    poly1305_absorb(&mac, message, len, false);
+    poly1305_finish(&mac, tag);
+}
+
+void consumption_set_log_handler(consumption_log_handler_t handler, void* ctx) {
+    g_log_handler = handler;
+    g_log_ctx = ctx;
+}
+
+consumption_error_t consumption_log_checkpoint(void) {
+    if (!g_state.initialized) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
+    if (g_log_handler) {
+        const void* record;
+        size_t size = encode_state(&record);
+        log_checkpoint(record, size);
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_log_apply(const consumption_log_record_t* record) {
+    if (!g_state.initialized) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
+    if (!record) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    if (record->type == CONSUMPTION_LOG_DISPENSE) {
+        const consumption_event_t* event = &record->event;
+        if (event->machine_id != g_state.config.machine_id ||
+            event->product_id == 0 || event->quantity == 0) {
+            return CONSUMPTION_ERROR_INVALID_PARAMETER;
+        }
+        if (!g_state.config.counter_only) {
+            add_event_to_buffer(event);
+        }
+        count_dispense(current_shard(), event->product_id, event->quantity);
+        return CONSUMPTION_SUCCESS;
+    }
+
+    if (record->type != CONSUMPTION_LOG_CHECKPOINT || !record->state) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    consumption_persist_t persist;
+    if (!decode_state(record->state, record->state_size, &persist)) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    /* The checkpoint already holds everything counted before it */
+    fold_counters();
+    if (persist.last_sync != g_state.persist.last_sync) {
+        reset_samples(persist.last_sync); /* A period was closed */
+    }
+    g_state.persist = persist;
+
+    /* Stored as received: re-sealing would spend nonces the primary may use */
+    write_state(record->state, record->state_size, CONSUMPTION_TRACE_START_US(storage_write_finish));
+    return CONSUMPTION_SUCCESS;
+}
+
 consumption_error_t consumption_update_config(const consumption_config_t* config) {
     if (!config || !validate_config(config)) {
         return CONSUMPTION_ERROR_INVALID_CONFIG;
     }
 
     /* Some parameters can't be changed at runtime */
-    if (config->ring_buffer_size != g_state.config.ring_buffer_size) {
+    if (config->ring_buffer_size != g_state.config.ring_buffer_size ||
+        config->counter_only != g_state.config.counter_only ||
+        config->retention != g_state.config.retention) {
         return CONSUMPTION_ERROR_INVALID_PARAMETER;
     }
 
+    if (config->machine_id != g_state.config.machine_id) {
+        /* An upload in flight would fold its counters back into the new machine */
+        if (g_upload.active) {
+            return CONSUMPTION_ERROR_API_ERROR;
+        }
+
+        /* Send the old machine's open period, then start fresh as init would */
+        if (g_state.config.enable_external_api) {
+            sync_to_api();
+        }
+        g_state.config.machine_id = config->machine_id;
+        fold_counters();
+        reset_state();
+        g_state.buffer_head = 0;
+        g_state.buffer_tail = 0;
+        g_state.buffer_count = 0;
+        memset(g_state.stratum_seen, 0, sizeof(g_state.stratum_seen));
+        memset(g_state.stratum_kept, 0, sizeof(g_state.stratum_kept));
+        memset(g_state.stratum_hour, 0, sizeof(g_state.stratum_hour));
+        g_state.last_full_seq = 0;
+        g_state.last_full_digest = 0;
+    }
+
     g_state.config = *config;
     save_state();
 
@@ -422,6 +2066,10 @@ const char* consumption_error_string(consumption_error_t error) {
             return "Memory allocation error";
         case CONSUMPTION_ERROR_INVALID_PARAMETER:
             return "Invalid parameter";
+        case CONSUMPTION_ERROR_CANCELLED:
+            return "Cancelled";
+        case CONSUMPTION_ERROR_TIMEOUT:
+            return "Timed out";
         default:
             return "Unknown error";
     }
@@ -0,0 +1,659 @@
+/**
+ * @file consumption_archive.c
+ * @brief Columnar event archive and query engine implementation
+ *
+ * Each segment holds its rows as four column arrays plus one statistics
+ * record per 1024-row block. A query is compiled into range checks of the
+ * form (value - low) <= span, which the kernels evaluate four lanes at a
+ * time with GCC vector extensions (SSE2, NEON) into all-ones / all-zeros
+ * lane masks; sums are taken under the mask, grouped results are scattered
+ * into per-thread group tables and merged once all segments are done.
+ */
+
+#include "consumption_archive.h"
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define BLOCK_ROWS CONSUMPTION_ARCHIVE_BLOCK_ROWS
+#define ARCHIVE_PRODUCTS 256
+#define ARCHIVE_MAX_THREADS 64
+
+#if defined(__GNUC__)
+#define ARCHIVE_VECTOR 1
+typedef uint32_t u32x4 __attribute__((vector_size(16)));
+typedef uint16_t u16x4 __attribute__((vector_size(8)));
+typedef uint8_t u8x4 __attribute__((vector_size(4)));
+#endif
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t rows;
+    uint32_t time_min;
+    uint32_t time_max;
+    uint32_t machine_min;
+    uint32_t machine_max;
+    uint8_t product_min;
+    uint8_t product_max;
+    uint64_t units;
+} block_stats_t;
+
+typedef struct {
+    uint32_t rows;
+    uint32_t* timestamp;
+    uint32_t* machine;
+    uint8_t* product;
+    uint16_t* quantity;
+    block_stats_t* blocks;
+} segment_t;
+
+/**
+ * @brief Query compiled into lane-friendly range checks
+ */
+typedef struct {
+    uint32_t t_lo, t_span;          /* Match: t - t_lo <= t_span */
+    uint32_t m_lo, m_span;          /* Match: m - m_lo <= m_span */
+    uint32_t product, product_mask; /* Match: ((p ^ product) & product_mask) == 0 */
+    consumption_query_group_t group_by;
+    uint32_t hour_base;             /* Hour number of group hour 0 */
+    uint32_t hours;                 /* Hour groups, 1 without hour grouping */
+    uint32_t groups;
+} predicate_t;
+
+typedef struct {
+    uint64_t* events;               /* Per group */
+    uint64_t* units;
+    consumption_query_stats_t stats;
+} partial_t;
+
+typedef struct {
+    consumption_archive_t* archive;
+    uint32_t index;
+} worker_t;
+
+struct consumption_archive_t {
+    consumption_archive_config_t config;
+    segment_t* segments;
+    uint32_t segment_count;
+    uint32_t segment_capacity;
+    uint64_t rows;
+    uint64_t memory_bytes;
+
+    /* Query thread pool: workers 1..threads-1, the caller is worker 0 */
+    pthread_t threads[ARCHIVE_MAX_THREADS];
+    worker_t workers[ARCHIVE_MAX_THREADS];
+    uint32_t started;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    uint32_t generation;
+    uint32_t running;
+    bool stop;
+
+    /* Current query */
+    const predicate_t* predicate;
+    partial_t* partials;
+    uint32_t next_segment;
+};
+
+/* ============================================================================
+ * KERNELS
+ * ============================================================================ */
+
+static inline uint32_t match1(const segment_t* s, uint32_t r, const predicate_t* p) {
+    uint32_t ok = (s->timestamp[r] - p->t_lo <= p->t_span) &
+                  (s->machine[r] - p->m_lo <= p->m_span) &
+                  (((s->product[r] ^ p->product) & p->product_mask) == 0);
+    return 0u - ok;
+}
+
+#ifdef ARCHIVE_VECTOR
+static inline u32x4 match4(const segment_t* s, uint32_t r, const predicate_t* p) {
+    u32x4 t, m;
+    u8x4 p8;
+    memcpy(&t, &s->timestamp[r], sizeof(t));
+    memcpy(&m, &s->machine[r], sizeof(m));
+    memcpy(&p8, &s->product[r], sizeof(p8));
+    u32x4 product = __builtin_convertvector(p8, u32x4);
+    return (u32x4)(t - p->t_lo <= p->t_span) &
+           (u32x4)(m - p->m_lo <= p->m_span) &
+           (u32x4)(((product ^ p->product) & p->product_mask) == 0);
+}
+
+static inline u32x4 quantity4(const segment_t* s, uint32_t r) {
+    u16x4 q;
+    memcpy(&q, &s->quantity[r], sizeof(q));
+    return __builtin_convertvector(q, u32x4);
+}
+#endif
+
+/**
+ * @brief Sum matching events and units of up to one block into one group
+ *
+ * A block's units fit in 32 bits (1024 * 65535), so lanes do not overflow.
+ */
+static void kernel_sum(const segment_t* s, uint32_t start, uint32_t n, const predicate_t* p,
+                       uint64_t* events, uint64_t* units) {
+    uint32_t i = 0, e = 0, u = 0;
+#ifdef ARCHIVE_VECTOR
+    u32x4 ve0 = {0, 0, 0, 0}, ve1 = ve0, vu0 = ve0, vu1 = ve0;
+    for (; i + 8 <= n; i += 8) {
+        u32x4 m0 = match4(s, start + i, p);
+        u32x4 m1 = match4(s, start + i + 4, p);
+        ve0 -= m0;
+        ve1 -= m1;
+        vu0 += quantity4(s, start + i) & m0;
+        vu1 += quantity4(s, start + i + 4) & m1;
+    }
+    ve0 += ve1;
+    vu0 += vu1;
+    e = ve0[0] + ve0[1] + ve0[2] + ve0[3];
+    u = vu0[0] + vu0[1] + vu0[2] + vu0[3];
+#endif
+    for (; i < n; i++) {
+        uint32_t m = match1(s, start + i, p);
+        e += m & 1;
+        u += s->quantity[start + i] & m;
+    }
+    *events += e;
+    *units += u;
+}
+
+/**
+ * @brief Scatter matching rows of up to one block into group tables
+ *
+ * Group = product * stride + offset, plus the row's hour when hourly.
+ * Rows that do not match are added as zero to group 0.
+ */
+static void kernel_groups(const segment_t* s, uint32_t start, uint32_t n, const predicate_t* p,
+                          uint32_t stride, uint32_t offset, bool hourly,
+                          uint64_t* events, uint64_t* units) {
+    uint32_t mask[BLOCK_ROWS];
+    uint32_t i = 0;
+#ifdef ARCHIVE_VECTOR
+    for (; i + 4 <= n; i += 4) {
+        u32x4 m = match4(s, start + i, p);
+        memcpy(&mask[i], &m, sizeof(m));
+    }
+#endif
+    for (; i < n; i++) {
+        mask[i] = match1(s, start + i, p);
+    }
+
+    for (i = 0; i < n; i++) {
+        uint32_t r = start + i;
+        uint32_t g = s->product[r] * stride + offset;
+        if (hourly) {
+            g += s->timestamp[r] / 3600 - p->hour_base;
+        }
+        g &= mask[i];
+        events[g] += mask[i] & 1;
+        units[g] += s->quantity[r] & mask[i];
+    }
+}
+
+/* ============================================================================
+ * SEGMENT SCAN
+ * ============================================================================ */
+
+static bool block_pruned(const block_stats_t* b, const predicate_t* p) {
+    uint64_t t_last = (uint64_t)p->t_lo + p->t_span;
+    uint64_t m_last = (uint64_t)p->m_lo + p->m_span;
+    return b->time_max < p->t_lo || b->time_min > t_last ||
+           b->machine_max < p->m_lo || b->machine_min > m_last ||
+           (p->product_mask && (p->product < b->product_min || p->product > b->product_max));
+}
+
+static bool block_covered(const block_stats_t* b, const predicate_t* p) {
+    return b->time_min >= p->t_lo && b->time_max - p->t_lo <= p->t_span &&
+           b->machine_min >= p->m_lo && b->machine_max - p->m_lo <= p->m_span &&
+           (!p->product_mask || (b->product_min == p->product && b->product_max == p->product));
+}
+
+static void scan_block(const segment_t* s, uint32_t index, const predicate_t* p, partial_t* out) {
+    const block_stats_t* b = &s->blocks[index];
+    const uint32_t start = index * BLOCK_ROWS;
+    const bool hourly = (p->group_by == CONSUMPTION_QUERY_GROUP_HOUR ||
+                         p->group_by == CONSUMPTION_QUERY_GROUP_PRODUCT_HOUR);
+    const bool one_hour = !hourly || b->time_min / 3600 == b->time_max / 3600;
+    const bool one_product = (p->group_by == CONSUMPTION_QUERY_GROUP_NONE ||
+                              p->group_by == CONSUMPTION_QUERY_GROUP_HOUR ||
+                              b->product_min == b->product_max);
+
+    out->stats.blocks++;
+    if (block_pruned(b, p)) {
+        out->stats.blocks_pruned++;
+        return;
+    }
+
+    uint32_t hour = hourly && one_hour ? b->time_min / 3600 - p->hour_base : 0;
+    uint32_t stride = (p->group_by == CONSUMPTION_QUERY_GROUP_PRODUCT ||
+                       p->group_by == CONSUMPTION_QUERY_GROUP_PRODUCT_HOUR) ? p->hours : 0;
+
+    if (one_hour && one_product) {
+        /* One group for the whole block */
+        uint32_t g = b->product_min * stride + hour;
+        if (block_covered(b, p)) {
+            out->events[g] += b->rows;
+            out->units[g] += b->units;
+            out->stats.blocks_covered++;
+            return;
+        }
+        kernel_sum(s, start, b->rows, p, &out->events[g], &out->units[g]);
+    } else {
+        kernel_groups(s, start, b->rows, p, stride, hour, !one_hour, out->events, out->units);
+    }
+    out->stats.rows_scanned += b->rows;
+}
+
+static void run_segments(consumption_archive_t* archive, uint32_t worker) {
+    partial_t* out = &archive->partials[worker];
+    for (;;) {
+        uint32_t index = __atomic_fetch_add(&archive->next_segment, 1, __ATOMIC_RELAXED);
+        if (index >= archive->segment_count) {
+            return;
+        }
+        const segment_t* s = &archive->segments[index];
+        uint32_t blocks = (s->rows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+        out->stats.segments++;
+        for (uint32_t b = 0; b < blocks; b++) {
+            scan_block(s, b, archive->predicate, out);
+        }
+    }
+}
+
+static void* worker_main(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    consumption_archive_t* archive = worker->archive;
+
+    uint32_t seen = 0; /* Generation at creation; a late start still sees the first query */
+    pthread_mutex_lock(&archive->lock);
+    for (;;) {
+        while (!archive->stop && archive->generation == seen) {
+            pthread_cond_wait(&archive->wake, &archive->lock);
+        }
+        if (archive->stop) {
+            break;
+        }
+        seen = archive->generation;
+        pthread_mutex_unlock(&archive->lock);
+
+        run_segments(archive, worker->index);
+
+        pthread_mutex_lock(&archive->lock);
+        if (--archive->running == 0) {
+            pthread_cond_signal(&archive->idle);
+        }
+    }
+    pthread_mutex_unlock(&archive->lock);
+    return NULL;
+}
+
+/* ============================================================================
+ * RESULTS
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t group;
+    uint64_t events;
+    uint64_t units;
+} ranked_t;
+
+static int compare_ranked(const void* a, const void* b) {
+    const ranked_t* x = (const ranked_t*)a;
+    const ranked_t* y = (const ranked_t*)b;
+    if (x->units != y->units) return x->units > y->units ? -1 : 1;
+    if (x->events != y->events) return x->events > y->events ? -1 : 1;
+    return x->group < y->group ? -1 : (x->group > y->group);
+}
+
+static void emit_row(const predicate_t* p, uint32_t group, uint64_t events, uint64_t units,
+                     consumption_query_row_cb_t on_row, void* user) {
+    consumption_query_row_t row = {0};
+    row.events = events;
+    row.units = units;
+    switch (p->group_by) {
+        case CONSUMPTION_QUERY_GROUP_PRODUCT:
+            row.product_id = (uint8_t)group;
+            break;
+        case CONSUMPTION_QUERY_GROUP_HOUR:
+            row.hour_start = (p->hour_base + group) * 3600;
+            break;
+        case CONSUMPTION_QUERY_GROUP_PRODUCT_HOUR:
+            row.product_id = (uint8_t)(group / p->hours);
+            row.hour_start = (p->hour_base + group % p->hours) * 3600;
+            break;
+        default:
+            break;
+    }
+    on_row(&row, user);
+}
+
+static consumption_error_t emit_results(const predicate_t* p, const partial_t* total,
+                                        uint32_t top_n, consumption_query_row_cb_t on_row,
+                                        void* user) {
+    if (p->group_by == CONSUMPTION_QUERY_GROUP_NONE) {
+        emit_row(p, 0, total->events[0], total->units[0], on_row, user);
+        return CONSUMPTION_SUCCESS;
+    }
+    if (top_n == 0) {
+        for (uint32_t g = 0; g < p->groups; g++) {
+            if (total->events[g] > 0) {
+                emit_row(p, g, total->events[g], total->units[g], on_row, user);
+            }
+        }
+        return CONSUMPTION_SUCCESS;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t g = 0; g < p->groups; g++) {
+        count += (total->events[g] > 0);
+    }
+    ranked_t* ranked = (ranked_t*)malloc((count ? count : 1) * sizeof(ranked_t));
+    if (!ranked) {
+        return CONSUMPTION_ERROR_MEMORY_ERROR;
+    }
+    count = 0;
+    for (uint32_t g = 0; g < p->groups; g++) {
+        if (total->events[g] > 0) {
+            ranked[count].group = g;
+            ranked[count].events = total->events[g];
+            ranked[count].units = total->units[g];
+            count++;
+        }
+    }
+    qsort(ranked, count, sizeof(ranked_t), compare_ranked);
+    for (uint32_t i = 0; i < count && i < top_n; i++) {
+        emit_row(p, ranked[i].group, ranked[i].events, ranked[i].units, on_row, user);
+    }
+    free(ranked);
+    return CONSUMPTION_SUCCESS;
+}
+
+/* ============================================================================
+ * ARCHIVE
+ * ============================================================================ */
+
+void consumption_archive_config_default(consumption_archive_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    config->segment_rows = 65536;
+    config->threads = 1;
+}
+
+consumption_archive_t* consumption_archive_create(const consumption_archive_config_t* config) {
+    consumption_archive_config_t defaults;
+    if (!config) {
+        consumption_archive_config_default(&defaults);
+        config = &defaults;
+    }
+    if (config->segment_rows == 0 || config->segment_rows % BLOCK_ROWS != 0 ||
+        config->segment_rows > (1u << 26) ||
+        config->threads == 0 || config->threads > ARCHIVE_MAX_THREADS) {
+        return NULL;
+    }
+
+    consumption_archive_t* archive = (consumption_archive_t*)calloc(1, sizeof(consumption_archive_t));
+    if (!archive) {
+        return NULL;
+    }
+    archive->config = *config;
+    archive->memory_bytes = sizeof(*archive);
+    pthread_mutex_init(&archive->lock, NULL);
+    pthread_cond_init(&archive->wake, NULL);
+    pthread_cond_init(&archive->idle, NULL);
+
+    for (uint32_t i = 1; i < config->threads; i++) {
+        archive->workers[i].archive = archive;
+        archive->workers[i].index = i;
+        if (pthread_create(&archive->threads[i], NULL, worker_main, &archive->workers[i]) != 0) {
+            consumption_archive_destroy(archive);
+            return NULL;
+        }
+        archive->started = i;
+    }
+    return archive;
+}
+
+static segment_t* add_segment(consumption_archive_t* archive) {
+    if (archive->segment_count == archive->segment_capacity) {
+        uint32_t capacity = archive->segment_capacity ? archive->segment_capacity * 2 : 8;
+        segment_t* segments = (segment_t*)realloc(archive->segments, capacity * sizeof(segment_t));
+        if (!segments) return NULL;
+        archive->segments = segments;
+        archive->segment_capacity = capacity;
+        archive->memory_bytes += (capacity - archive->segment_count) * sizeof(segment_t);
+    }
+
+    const uint32_t rows = archive->config.segment_rows;
+    segment_t* s = &archive->segments[archive->segment_count];
+    memset(s, 0, sizeof(*s));
+    s->timestamp = (uint32_t*)malloc(rows * sizeof(uint32_t));
+    s->machine = (uint32_t*)malloc(rows * sizeof(uint32_t));
+    s->product = (uint8_t*)malloc(rows);
+    s->quantity = (uint16_t*)malloc(rows * sizeof(uint16_t));
+    s->blocks = (block_stats_t*)calloc(rows / BLOCK_ROWS, sizeof(block_stats_t));
+    if (!s->timestamp || !s->machine || !s->product || !s->quantity || !s->blocks) {
+        free(s->timestamp);
+        free(s->machine);
+        free(s->product);
+        free(s->quantity);
+        free(s->blocks);
+        return NULL;
+    }
+    archive->segment_count++;
+    archive->memory_bytes += (uint64_t)rows * 11 + (rows / BLOCK_ROWS) * sizeof(block_stats_t);
+    return s;
+}
+
+consumption_error_t consumption_archive_append(consumption_archive_t* archive,
+                                               const consumption_event_t* events, uint32_t count) {
+    if (!archive || (!events && count > 0)) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        segment_t* s = archive->segment_count ? &archive->segments[archive->segment_count - 1] : NULL;
+        if (!s || s->rows == archive->config.segment_rows) {
+            s = add_segment(archive);
+            if (!s) {
+                return CONSUMPTION_ERROR_MEMORY_ERROR;
+            }
+        }
+
+        const consumption_event_t* e = &events[i];
+        uint32_t r = s->rows++;
+        s->timestamp[r] = e->timestamp;
+        s->machine[r] = e->machine_id;
+        s->product[r] = e->product_id;
+        s->quantity[r] = e->quantity;
+
+        block_stats_t* b = &s->blocks[r / BLOCK_ROWS];
+        if (b->rows++ == 0) {
+            b->time_min = b->time_max = e->timestamp;
+            b->machine_min = b->machine_max = e->machine_id;
+            b->product_min = b->product_max = e->product_id;
+        } else {
+            if (e->timestamp < b->time_min) b->time_min = e->timestamp;
+            if (e->timestamp > b->time_max) b->time_max = e->timestamp;
+            if (e->machine_id < b->machine_min) b->machine_min = e->machine_id;
+            if (e->machine_id > b->machine_max) b->machine_max = e->machine_id;
+            if (e->product_id < b->product_min) b->product_min = e->product_id;
+            if (e->product_id > b->product_max) b->product_max = e->product_id;
+        }
+        b->units += e->quantity;
+        archive->rows++;
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+void consumption_archive_get_stats(const consumption_archive_t* archive,
+                                   consumption_archive_stats_t* stats) {
+    if (!archive || !stats) return;
+    memset(stats, 0, sizeof(*stats));
+    stats->rows = archive->rows;
+    stats->segments = archive->segment_count;
+    stats->memory_bytes = archive->memory_bytes;
+}
+
+void consumption_archive_destroy(consumption_archive_t* archive) {
+    if (!archive) return;
+
+    pthread_mutex_lock(&archive->lock);
+    archive->stop = true;
+    pthread_cond_broadcast(&archive->wake);
+    pthread_mutex_unlock(&archive->lock);
+    for (uint32_t i = 1; i <= archive->started; i++) {
+        pthread_join(archive->threads[i], NULL);
+    }
+    pthread_cond_destroy(&archive->idle);
+    pthread_cond_destroy(&archive->wake);
+    pthread_mutex_destroy(&archive->lock);
+
+    for (uint32_t i = 0; i < archive->segment_count; i++) {
+        segment_t* s = &archive->segments[i];
+        free(s->timestamp);
+        free(s->machine);
+        free(s->product);
+        free(s->quantity);
+        free(s->blocks);
+    }
+    free(archive->segments);
+    free(archive);
+}
+
+/* ============================================================================
+ * QUERIES
+ * ============================================================================ */
+
+void consumption_query_default(consumption_query_t* query) {
+    if (!query) return;
+    memset(query, 0, sizeof(*query));
+    query->group_by = CONSUMPTION_QUERY_GROUP_NONE;
+}
+
+consumption_error_t consumption_archive_query(consumption_archive_t* archive,
+                                              const consumption_query_t* query,
+                                              consumption_query_row_cb_t on_row, void* user,
+                                              consumption_query_stats_t* stats) {
+    if (!archive || !query || !on_row ||
+        (query->time_to != 0 && query->time_to <= query->time_from) ||
+        (query->machine_to != 0 && query->machine_to < query->machine_from) ||
+        (int)query->group_by < 0 || query->group_by > CONSUMPTION_QUERY_GROUP_PRODUCT_HOUR) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    predicate_t p;
+    memset(&p, 0, sizeof(p));
+    uint32_t t_last = query->time_to ? query->time_to - 1 : UINT32_MAX;
+    uint32_t m_last = query->machine_to ? query->machine_to : UINT32_MAX;
+    p.t_lo = query->time_from;
+    p.t_span = t_last - query->time_from;
+    p.m_lo = query->machine_from;
+    p.m_span = m_last - query->machine_from;
+    p.product = query->product_id;
+    p.product_mask = query->product_id ? 0xFF : 0;
+    p.group_by = query->group_by;
+    p.hour_base = query->time_from / 3600;
+    p.hours = 1;
+
+    if (p.group_by == CONSUMPTION_QUERY_GROUP_HOUR ||
+        p.group_by == CONSUMPTION_QUERY_GROUP_PRODUCT_HOUR) {
+        if (query->time_to == 0 || t_last / 3600 - p.hour_base >= CONSUMPTION_QUERY_MAX_HOURS) {
+            return CONSUMPTION_ERROR_INVALID_PARAMETER;
+        }
+        p.hours = t_last / 3600 - p.hour_base + 1;
+    }
+    p.groups = p.hours;
+    if (p.group_by == CONSUMPTION_QUERY_GROUP_PRODUCT ||
+        p.group_by == CONSUMPTION_QUERY_GROUP_PRODUCT_HOUR) {
+        p.groups = ARCHIVE_PRODUCTS * p.hours;
+    }
+
+    /* One group table per thread, merged into the first */
+    const uint32_t threads = archive->started + 1;
+    partial_t partials[ARCHIVE_MAX_THREADS];
+    uint64_t* tables = (uint64_t*)calloc((size_t)threads * p.groups * 2, sizeof(uint64_t));
+    if (!tables) {
+        return CONSUMPTION_ERROR_MEMORY_ERROR;
+    }
+    memset(partials, 0, threads * sizeof(partial_t));
+    for (uint32_t t = 0; t < threads; t++) {
+        partials[t].events = &tables[(size_t)t * p.groups * 2];
+        partials[t].units = partials[t].events + p.groups;
+    }
+
+    archive->predicate = &p;
+    archive->partials = partials;
+    archive->next_segment = 0;
+    if (threads > 1) {
+        pthread_mutex_lock(&archive->lock);
+        archive->running = threads - 1;
+        archive->generation++;
+        pthread_cond_broadcast(&archive->wake);
+        pthread_mutex_unlock(&archive->lock);
+    }
+
+    run_segments(archive, 0);
+
+    if (threads > 1) {
+        pthread_mutex_lock(&archive->lock);
+        while (archive->running > 0) {
+            pthread_cond_wait(&archive->idle, &archive->lock);
+        }
+        pthread_mutex_unlock(&archive->lock);
+    }
+
+    partial_t* total = &partials[0];
+    for (uint32_t t = 1; t < threads; t++) {
+        for (uint32_t g = 0; g < p.groups; g++) {
+            total->events[g] += partials[t].events[g];
+            total->units[g] += partials[t].units[g];
+        }
+        total->stats.segments += partials[t].stats.segments;
+        total->stats.blocks += partials[t].stats.blocks;
+        total->stats.blocks_pruned += partials[t].stats.blocks_pruned;
+        total->stats.blocks_covered += partials[t].stats.blocks_covered;
+        total->stats.rows_scanned += partials[t].stats.rows_scanned;
+    }
+    if (stats) {
+        *stats = total->stats;
+    }
+
+    consumption_error_t result = emit_results(&p, total, query->top_n, on_row, user);
+    free(tables);
+    return result;
+}
+
+consumption_error_t consumption_archive_scan(const consumption_archive_t* archive,
+                                             uint32_t time_from, uint32_t time_to,
+                                             consumption_archive_rows_cb_t on_rows, void* user) {
+    if (!archive || !on_rows || (time_to != 0 && time_to <= time_from)) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    const uint32_t t_last = time_to ? time_to - 1 : UINT32_MAX;
+    for (uint32_t i = 0; i < archive->segment_count; i++) {
+        const segment_t* s = &archive->segments[i];
+        const uint32_t blocks = (s->rows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+        for (uint32_t b = 0; b < blocks; b++) {
+            const block_stats_t* stats = &s->blocks[b];
+            if (stats->time_max < time_from || stats->time_min > t_last) {
+                continue;
+            }
+            const uint32_t start = b * BLOCK_ROWS;
+            consumption_archive_rows_t rows = {
+                .count = stats->rows,
+                .timestamp = &s->timestamp[start],
+                .machine_id = &s->machine[start],
+                .product_id = &s->product[start],
+                .quantity = &s->quantity[start]
+            };
+            on_rows(&rows, user);
+        }
+    }
+    return CONSUMPTION_SUCCESS;
+}
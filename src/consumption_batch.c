@@ -0,0 +1,346 @@
+/**
+ * @file consumption_batch.c
+ * @brief Fan-in batching implementation
+ *
+ * Entries are serialized when added and kept in a fixed slot array with a
+ * free list. Queued slots wait in a ring used as a deque, roughly oldest
+ * first: new entries and rejected ones (whose wait restarts) go to the
+ * back, entries of a failed request go back to the front. A batch takes
+ * from the front and remembers its slots in payload order, so per-entry
+ * results map straight back to them.
+ */
+
+#include "consumption_batch.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define BATCH_ENTRY_MAX 4608        /* Largest entry: header and 255 products */
+#define BATCH_TRAILER 2             /* "]}" */
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef struct {
+    char* text;
+    uint32_t len;
+    uint32_t added_at;              /* Start of the current wait */
+    uint32_t attempts;              /* Rejections so far */
+} batch_entry_t;
+
+typedef struct {
+    bool used;
+    uint32_t id;
+    uint32_t count;
+    uint32_t* slots;                /* Payload order */
+} batch_flight_t;
+
+struct consumption_batch_t {
+    consumption_batch_config_t config;
+    batch_entry_t* entries;
+    uint32_t* free_slots;
+    uint32_t free_count;
+    uint32_t* queue;                /* Ring of slots, max_entries long */
+    uint32_t head;
+    uint32_t queued;
+    uint64_t queued_bytes;          /* Entry text plus separator */
+    batch_flight_t* flights;
+    uint32_t flights_used;
+    uint32_t in_flight;             /* Entries */
+    uint32_t next_id;
+    uint32_t hold_until;            /* No batch before this after a failure */
+    consumption_batch_stats_t stats;
+};
+
+/* ============================================================================
+ * INTERNAL FUNCTIONS
+ * ============================================================================ */
+
+static void push_back(consumption_batch_t* batch, uint32_t slot) {
+    batch->queue[(batch->head + batch->queued) % batch->config.max_entries] = slot;
+    batch->queued++;
+    batch->queued_bytes += batch->entries[slot].len + 1;
+}
+
+static void push_front(consumption_batch_t* batch, uint32_t slot) {
+    batch->head = (batch->head + batch->config.max_entries - 1) % batch->config.max_entries;
+    batch->queue[batch->head] = slot;
+    batch->queued++;
+    batch->queued_bytes += batch->entries[slot].len + 1;
+}
+
+static uint32_t pop_front(consumption_batch_t* batch) {
+    uint32_t slot = batch->queue[batch->head];
+    batch->head = (batch->head + 1) % batch->config.max_entries;
+    batch->queued--;
+    batch->queued_bytes -= batch->entries[slot].len + 1;
+    return slot;
+}
+
+static void free_entry(consumption_batch_t* batch, uint32_t slot) {
+    free(batch->entries[slot].text);
+    batch->entries[slot].text = NULL;
+    batch->free_slots[batch->free_count++] = slot;
+}
+
+static batch_flight_t* find_flight(consumption_batch_t* batch, uint32_t id) {
+    for (uint32_t i = 0; i < batch->config.max_in_flight; i++) {
+        if (batch->flights[i].used && batch->flights[i].id == id) {
+            return &batch->flights[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Serialize an aggregate as in single-machine uploads
+ * @return Length, 0 if it did not fit
+ */
+static size_t serialize_entry(const consumption_aggregate_t* aggregate, char* buffer, size_t size) {
+    int written = snprintf(buffer, size,
+        "{\"machine_id\":%u,\"period_start\":%u,\"period_end\":%u,\"total_events\":%u,\"products\":{",
+        aggregate->machine_id, aggregate->period_start, aggregate->period_end,
+        aggregate->total_events);
+    if (written < 0 || (size_t)written >= size) {
+        return 0;
+    }
+    size_t len = (size_t)written;
+    bool first = true;
+    for (uint32_t p = 1; p < 256; p++) {
+        if (aggregate->product_counts[p] == 0) {
+            continue;
+        }
+        written = snprintf(buffer + len, size - len, first ? "\"%u\":%u" : ",\"%u\":%u",
+                           p, aggregate->product_counts[p]);
+        if (written < 0 || (size_t)written >= size - len) {
+            return 0;
+        }
+        len += (size_t)written;
+        first = false;
+    }
+    if (len + 2 >= size) {
+        return 0;
+    }
+    buffer[len++] = '}';
+    buffer[len++] = '}';
+    buffer[len] = '\0';
+    return len;
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+void consumption_batch_config_default(consumption_batch_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    config->max_bytes = 65536;
+    config->max_delay = 2;
+    config->max_entries = 4096;
+    config->max_in_flight = 2;
+    config->retry_delay = 10;
+    config->max_attempts = 5;
+}
+
+consumption_batch_t* consumption_batch_create(const consumption_batch_config_t* config) {
+    consumption_batch_config_t defaults;
+    if (!config) {
+        consumption_batch_config_default(&defaults);
+        config = &defaults;
+    }
+    if (config->max_bytes < CONSUMPTION_BATCH_MIN_BYTES || config->max_entries == 0 ||
+        config->max_in_flight == 0 || config->max_in_flight > 64) {
+        return NULL;
+    }
+
+    consumption_batch_t* batch = (consumption_batch_t*)calloc(1, sizeof(consumption_batch_t));
+    if (!batch) {
+        return NULL;
+    }
+    batch->config = *config;
+    batch->entries = (batch_entry_t*)calloc(config->max_entries, sizeof(batch_entry_t));
+    batch->free_slots = (uint32_t*)malloc(config->max_entries * sizeof(uint32_t));
+    batch->queue = (uint32_t*)malloc(config->max_entries * sizeof(uint32_t));
+    batch->flights = (batch_flight_t*)calloc(config->max_in_flight, sizeof(batch_flight_t));
+    bool ok = batch->entries && batch->free_slots && batch->queue && batch->flights;
+    for (uint32_t i = 0; ok && i < config->max_in_flight; i++) {
+        batch->flights[i].slots = (uint32_t*)malloc(config->max_entries * sizeof(uint32_t));
+        ok = batch->flights[i].slots != NULL;
+    }
+    if (!ok) {
+        consumption_batch_destroy(batch);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < config->max_entries; i++) {
+        batch->free_slots[i] = config->max_entries - 1 - i;
+    }
+    batch->free_count = config->max_entries;
+    batch->next_id = 1;
+    return batch;
+}
+
+consumption_error_t consumption_batch_add(consumption_batch_t* batch,
+                                          const consumption_aggregate_t* aggregate, uint32_t now) {
+    if (!batch || !aggregate) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (batch->free_count == 0) {
+        return CONSUMPTION_ERROR_STORAGE_FULL;
+    }
+
+    char text[BATCH_ENTRY_MAX];
+    size_t len = serialize_entry(aggregate, text, sizeof(text));
+    char* copy = (char*)malloc(len + 1);
+    if (len == 0 || !copy) {
+        free(copy);
+        return CONSUMPTION_ERROR_MEMORY_ERROR;
+    }
+    memcpy(copy, text, len + 1);
+
+    uint32_t slot = batch->free_slots[--batch->free_count];
+    batch->entries[slot].text = copy;
+    batch->entries[slot].len = (uint32_t)len;
+    batch->entries[slot].added_at = now;
+    batch->entries[slot].attempts = 0;
+    push_back(batch, slot);
+    return CONSUMPTION_SUCCESS;
+}
+
+bool consumption_batch_ready(const consumption_batch_t* batch, uint32_t now) {
+    if (!batch || batch->queued == 0 || batch->flights_used == batch->config.max_in_flight ||
+        now < batch->hold_until) {
+        return false;
+    }
+    uint32_t oldest = batch->entries[batch->queue[batch->head]].added_at;
+    return batch->queued_bytes >= batch->config.max_bytes || now - oldest >= batch->config.max_delay;
+}
+
+consumption_error_t consumption_batch_next_due(const consumption_batch_t* batch, uint32_t now,
+                                               uint32_t* timestamp) {
+    if (!batch || !timestamp) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    *timestamp = 0;
+    if (batch->queued == 0 || batch->flights_used == batch->config.max_in_flight) {
+        return CONSUMPTION_SUCCESS;
+    }
+    uint32_t due = batch->entries[batch->queue[batch->head]].added_at + batch->config.max_delay;
+    if (batch->queued_bytes >= batch->config.max_bytes) {
+        due = now;
+    }
+    if (due < batch->hold_until) {
+        due = batch->hold_until;
+    }
+    *timestamp = (due > now) ? due : now;
+    return CONSUMPTION_SUCCESS;
+}
+
+size_t consumption_batch_take(consumption_batch_t* batch, char* buffer, size_t size,
+                              uint32_t* batch_id) {
+    if (!batch || !buffer || !batch_id || size <= batch->config.max_bytes || batch->queued == 0 ||
+        batch->flights_used == batch->config.max_in_flight) {
+        return 0;
+    }
+
+    batch_flight_t* flight = batch->flights;
+    while (flight->used) {
+        flight++;
+    }
+    int written = snprintf(buffer, size, "{\"gateway\":%u,\"batch\":%u,\"entries\":[",
+                           batch->config.gateway_id, batch->next_id);
+    size_t len = (size_t)written;
+    flight->count = 0;
+    while (batch->queued > 0) {
+        uint32_t slot = batch->queue[batch->head];
+        const batch_entry_t* entry = &batch->entries[slot];
+        size_t need = entry->len + (flight->count > 0) + BATCH_TRAILER;
+        if (flight->count > 0 && len + need > batch->config.max_bytes) {
+            break;
+        }
+        pop_front(batch);
+        if (flight->count > 0) {
+            buffer[len++] = ',';
+        }
+        memcpy(buffer + len, entry->text, entry->len);
+        len += entry->len;
+        flight->slots[flight->count++] = slot;
+    }
+    buffer[len++] = ']';
+    buffer[len++] = '}';
+    buffer[len] = '\0';
+
+    flight->used = true;
+    flight->id = batch->next_id++;
+    batch->flights_used++;
+    batch->in_flight += flight->count;
+    batch->stats.batches++;
+    batch->stats.entries_sent += flight->count;
+    batch->stats.bytes += len;
+    *batch_id = flight->id;
+    return len;
+}
+
+consumption_error_t consumption_batch_complete(consumption_batch_t* batch, uint32_t batch_id,
+                                               const bool* accepted, uint32_t count, uint32_t now) {
+    batch_flight_t* flight = batch ? find_flight(batch, batch_id) : NULL;
+    if (!flight || (accepted && count != flight->count)) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    if (!accepted) {
+        /* The request failed: everything goes back in front, in order */
+        for (uint32_t i = flight->count; i-- > 0;) {
+            push_front(batch, flight->slots[i]);
+        }
+        batch->hold_until = now + batch->config.retry_delay;
+        batch->stats.failed_batches++;
+    } else {
+        for (uint32_t i = 0; i < flight->count; i++) {
+            uint32_t slot = flight->slots[i];
+            batch_entry_t* entry = &batch->entries[slot];
+            if (accepted[i]) {
+                free_entry(batch, slot);
+                batch->stats.entries_acked++;
+                continue;
+            }
+            batch->stats.entries_rejected++;
+            entry->attempts++;
+            if (batch->config.max_attempts && entry->attempts >= batch->config.max_attempts) {
+                free_entry(batch, slot);
+                batch->stats.entries_dropped++;
+            } else {
+                entry->added_at = now;
+                push_back(batch, slot);
+            }
+        }
+    }
+
+    batch->in_flight -= flight->count;
+    flight->used = false;
+    batch->flights_used--;
+    return CONSUMPTION_SUCCESS;
+}
+
+void consumption_batch_get_stats(const consumption_batch_t* batch, consumption_batch_stats_t* stats) {
+    if (!batch || !stats) return;
+    *stats = batch->stats;
+    stats->queued = batch->queued;
+    stats->in_flight = batch->in_flight;
+}
+
+void consumption_batch_destroy(consumption_batch_t* batch) {
+    if (!batch) return;
+    for (uint32_t i = 0; batch->entries && i < batch->config.max_entries; i++) {
+        free(batch->entries[i].text);
+    }
+    for (uint32_t i = 0; batch->flights && i < batch->config.max_in_flight; i++) {
+        free(batch->flights[i].slots);
+    }
+    free(batch->entries);
+    free(batch->free_slots);
+    free(batch->queue);
+    free(batch->flights);
+    free(batch);
+}
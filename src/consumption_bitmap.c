@@ -0,0 +1,565 @@
+/**
+ * @file consumption_bitmap.c
+ * @brief Compressed bitmap implementation (roaring layout)
+ *
+ * Containers are kept sorted by key. Array containers hold at most
+ * BITMAP_ARRAY_MAX sorted 16-bit values; a container that grows past that
+ * becomes a bitset and one that shrinks back to it becomes an array again,
+ * so every container uses the smaller of the two forms. Set operations
+ * merge two arrays directly and go through 1024-word bitsets otherwise.
+ */
+
+#include "consumption_bitmap.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define BITMAP_ARRAY_MAX 4096       /* Array limit: 8 KB, the size of a bitset */
+#define BITMAP_WORDS 1024           /* 65536 bits */
+#define BITMAP_MAGIC 0x504D4243u    /* "CBMP" */
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef enum {
+    CONTAINER_ARRAY = 0,
+    CONTAINER_BITSET = 1,
+} container_type_t;
+
+typedef enum {
+    OP_AND = 0,
+    OP_OR,
+    OP_ANDNOT,
+} bitmap_op_t;
+
+typedef struct {
+    uint16_t key;                   /* Upper 16 bits of the values */
+    uint16_t type;                  /* container_type_t */
+    uint32_t cardinality;
+    uint32_t capacity;              /* Array entries allocated */
+    union {
+        uint16_t* array;
+        uint64_t* words;
+    } data;
+} container_t;
+
+struct consumption_bitmap_t {
+    uint32_t count;
+    uint32_t capacity;
+    container_t* containers;
+};
+
+/* ============================================================================
+ * CONTAINERS
+ * ============================================================================ */
+
+static void container_free(container_t* c) {
+    free(c->type == CONTAINER_ARRAY ? (void*)c->data.array : (void*)c->data.words);
+    c->data.array = NULL;
+}
+
+/**
+ * @brief First array position whose value is >= low
+ */
+static uint32_t array_lower_bound(const uint16_t* array, uint32_t n, uint16_t low) {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (array[mid] < low) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void words_from_container(const container_t* c, uint64_t* words) {
+    if (c->type == CONTAINER_BITSET) {
+        memcpy(words, c->data.words, BITMAP_WORDS * sizeof(uint64_t));
+        return;
+    }
+    memset(words, 0, BITMAP_WORDS * sizeof(uint64_t));
+    for (uint32_t i = 0; i < c->cardinality; i++) {
+        words[c->data.array[i] >> 6] |= 1ull << (c->data.array[i] & 63);
+    }
+}
+
+/**
+ * @brief Replace a container's content with a bitset, in its smaller form
+ *
+ * Allocates before touching the container: on failure it is left as it was.
+ */
+static bool container_set_words(container_t* c, const uint64_t* words) {
+    uint32_t card = 0;
+    for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+        card += (uint32_t)__builtin_popcountll(words[w]);
+    }
+
+    if (card > BITMAP_ARRAY_MAX) {
+        uint64_t* bitset = (uint64_t*)malloc(BITMAP_WORDS * sizeof(uint64_t));
+        if (!bitset) return false;
+        memcpy(bitset, words, BITMAP_WORDS * sizeof(uint64_t));
+        container_free(c);
+        c->type = CONTAINER_BITSET;
+        c->cardinality = card;
+        c->capacity = 0;
+        c->data.words = bitset;
+        return true;
+    }
+
+    uint16_t* array = card ? (uint16_t*)malloc(card * sizeof(uint16_t)) : NULL;
+    if (card && !array) return false;
+    uint32_t n = 0;
+    for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+        for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+            array[n++] = (uint16_t)(w * 64 + (uint32_t)__builtin_ctzll(bits));
+        }
+    }
+    container_free(c);
+    c->type = CONTAINER_ARRAY;
+    c->cardinality = card;
+    c->capacity = card;
+    c->data.array = array;
+    return true;
+}
+
+static bool container_add(container_t* c, uint16_t low) {
+    if (c->type == CONTAINER_BITSET) {
+        uint64_t bit = 1ull << (low & 63);
+        if (!(c->data.words[low >> 6] & bit)) {
+            c->data.words[low >> 6] |= bit;
+            c->cardinality++;
+        }
+        return true;
+    }
+
+    uint32_t pos = array_lower_bound(c->data.array, c->cardinality, low);
+    if (pos < c->cardinality && c->data.array[pos] == low) {
+        return true;
+    }
+
+    if (c->cardinality == BITMAP_ARRAY_MAX) {
+        uint64_t words[BITMAP_WORDS];
+        words_from_container(c, words);
+        words[low >> 6] |= 1ull << (low & 63);
+        return container_set_words(c, words);
+    }
+
+    if (c->cardinality == c->capacity) {
+        uint32_t capacity = c->capacity ? c->capacity * 2 : 4;
+        if (capacity > BITMAP_ARRAY_MAX) capacity = BITMAP_ARRAY_MAX;
+        uint16_t* array = (uint16_t*)realloc(c->data.array, capacity * sizeof(uint16_t));
+        if (!array) return false;
+        c->data.array = array;
+        c->capacity = capacity;
+    }
+    memmove(&c->data.array[pos + 1], &c->data.array[pos],
+            (c->cardinality - pos) * sizeof(uint16_t));
+    c->data.array[pos] = low;
+    c->cardinality++;
+    return true;
+}
+
+static void container_remove(container_t* c, uint16_t low) {
+    if (c->type == CONTAINER_BITSET) {
+        uint64_t bit = 1ull << (low & 63);
+        if (c->data.words[low >> 6] & bit) {
+            c->data.words[low >> 6] &= ~bit;
+            c->cardinality--;
+            if (c->cardinality <= BITMAP_ARRAY_MAX) {
+                uint64_t words[BITMAP_WORDS];
+                memcpy(words, c->data.words, sizeof(words));
+                container_set_words(c, words); /* Shrinks; failure keeps the bitset */
+            }
+        }
+        return;
+    }
+
+    uint32_t pos = array_lower_bound(c->data.array, c->cardinality, low);
+    if (pos < c->cardinality && c->data.array[pos] == low) {
+        memmove(&c->data.array[pos], &c->data.array[pos + 1],
+                (c->cardinality - pos - 1) * sizeof(uint16_t));
+        c->cardinality--;
+    }
+}
+
+static bool container_contains(const container_t* c, uint16_t low) {
+    if (c->type == CONTAINER_BITSET) {
+        return (c->data.words[low >> 6] >> (low & 63)) & 1;
+    }
+    uint32_t pos = array_lower_bound(c->data.array, c->cardinality, low);
+    return pos < c->cardinality && c->data.array[pos] == low;
+}
+
+/**
+ * @brief out = a op b for two containers with the same key
+ */
+static bool container_op(bitmap_op_t op, const container_t* a, const container_t* b,
+                         container_t* out) {
+    memset(out, 0, sizeof(*out));
+    out->key = a->key;
+
+    if (a->type == CONTAINER_ARRAY && b->type == CONTAINER_ARRAY) {
+        uint32_t limit = (op == OP_OR) ? a->cardinality + b->cardinality : a->cardinality;
+        uint16_t* result = (uint16_t*)malloc((limit ? limit : 1) * sizeof(uint16_t));
+        if (!result) return false;
+
+        const uint16_t* x = a->data.array;
+        const uint16_t* y = b->data.array;
+        uint32_t i = 0, j = 0, n = 0;
+        while (i < a->cardinality && j < b->cardinality) {
+            if (x[i] < y[j]) {
+                if (op != OP_AND) result[n++] = x[i];
+                i++;
+            } else if (x[i] > y[j]) {
+                if (op == OP_OR) result[n++] = y[j];
+                j++;
+            } else {
+                if (op != OP_ANDNOT) result[n++] = x[i];
+                i++;
+                j++;
+            }
+        }
+        if (op != OP_AND) while (i < a->cardinality) result[n++] = x[i++];
+        if (op == OP_OR) while (j < b->cardinality) result[n++] = y[j++];
+
+        if (n > BITMAP_ARRAY_MAX) {
+            uint64_t words[BITMAP_WORDS];
+            memset(words, 0, sizeof(words));
+            for (uint32_t k = 0; k < n; k++) {
+                words[result[k] >> 6] |= 1ull << (result[k] & 63);
+            }
+            free(result);
+            return container_set_words(out, words);
+        }
+        out->type = CONTAINER_ARRAY;
+        out->cardinality = n;
+        out->capacity = limit;
+        out->data.array = result;
+        return true;
+    }
+
+    uint64_t x[BITMAP_WORDS], y[BITMAP_WORDS];
+    words_from_container(a, x);
+    words_from_container(b, y);
+    for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+        switch (op) {
+            case OP_AND:    x[w] &= y[w]; break;
+            case OP_OR:     x[w] |= y[w]; break;
+            case OP_ANDNOT: x[w] &= ~y[w]; break;
+        }
+    }
+    return container_set_words(out, x);
+}
+
+/* ============================================================================
+ * CONTAINER LIST
+ * ============================================================================ */
+
+/**
+ * @brief Index of the container for key, or -1 with *pos set to its insert position
+ */
+static int32_t find_container(const consumption_bitmap_t* bitmap, uint16_t key, uint32_t* pos) {
+    uint32_t lo = 0, hi = bitmap->count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (bitmap->containers[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    if (pos) *pos = lo;
+    return (lo < bitmap->count && bitmap->containers[lo].key == key) ? (int32_t)lo : -1;
+}
+
+static bool reserve_containers(consumption_bitmap_t* bitmap, uint32_t count) {
+    if (count <= bitmap->capacity) {
+        return true;
+    }
+    uint32_t capacity = bitmap->capacity ? bitmap->capacity * 2 : 4;
+    if (capacity < count) capacity = count;
+    container_t* containers =
+        (container_t*)realloc(bitmap->containers, capacity * sizeof(container_t));
+    if (!containers) return false;
+    bitmap->containers = containers;
+    bitmap->capacity = capacity;
+    return true;
+}
+
+static void remove_container(consumption_bitmap_t* bitmap, uint32_t index) {
+    container_free(&bitmap->containers[index]);
+    memmove(&bitmap->containers[index], &bitmap->containers[index + 1],
+            (bitmap->count - index - 1) * sizeof(container_t));
+    bitmap->count--;
+}
+
+/**
+ * @brief dst = dst op src, built as a new container list
+ */
+static bool bitmap_op(bitmap_op_t op, consumption_bitmap_t* dst, const consumption_bitmap_t* src) {
+    consumption_bitmap_t result = {0};
+    uint32_t i = 0, j = 0;
+    bool ok = true;
+
+    while (ok && (i < dst->count || j < src->count)) {
+        const container_t* a = (i < dst->count) ? &dst->containers[i] : NULL;
+        const container_t* b = (j < src->count) ? &src->containers[j] : NULL;
+        container_t out;
+
+        if (a && b && a->key == b->key) {
+            ok = container_op(op, a, b, &out);
+            i++;
+            j++;
+        } else if (a && (!b || a->key < b->key)) {
+            i++;
+            if (op == OP_AND) continue;
+            out = *a; /* Moved; cleared in dst below */
+            dst->containers[i - 1].data.array = NULL;
+        } else {
+            j++;
+            if (op != OP_OR) continue;
+            consumption_bitmap_t single = {1, 1, (container_t*)b};
+            consumption_bitmap_t copy = {0};
+            ok = consumption_bitmap_copy(&copy, &single);
+            if (!ok) break;
+            out = copy.containers[0];
+            free(copy.containers);
+        }
+
+        if (ok && out.cardinality > 0) {
+            ok = reserve_containers(&result, result.count + 1);
+            if (ok) result.containers[result.count++] = out;
+            else container_free(&out);
+        } else {
+            container_free(&out);
+        }
+    }
+
+    consumption_bitmap_clear(dst);
+    free(dst->containers);
+    *dst = result;
+    return ok;
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+consumption_bitmap_t* consumption_bitmap_create(void) {
+    return (consumption_bitmap_t*)calloc(1, sizeof(consumption_bitmap_t));
+}
+
+void consumption_bitmap_destroy(consumption_bitmap_t* bitmap) {
+    if (!bitmap) return;
+    consumption_bitmap_clear(bitmap);
+    free(bitmap->containers);
+    free(bitmap);
+}
+
+void consumption_bitmap_clear(consumption_bitmap_t* bitmap) {
+    if (!bitmap) return;
+    for (uint32_t i = 0; i < bitmap->count; i++) {
+        container_free(&bitmap->containers[i]);
+    }
+    bitmap->count = 0;
+}
+
+bool consumption_bitmap_copy(consumption_bitmap_t* dst, const consumption_bitmap_t* src) {
+    if (!dst || !src) return false;
+    consumption_bitmap_clear(dst);
+    if (!reserve_containers(dst, src->count)) return false;
+
+    for (uint32_t i = 0; i < src->count; i++) {
+        const container_t* c = &src->containers[i];
+        container_t* out = &dst->containers[i];
+        *out = *c;
+        size_t bytes = (c->type == CONTAINER_BITSET) ? BITMAP_WORDS * sizeof(uint64_t)
+                                                     : c->cardinality * sizeof(uint16_t);
+        out->capacity = (c->type == CONTAINER_BITSET) ? 0 : c->cardinality;
+        out->data.array = (uint16_t*)malloc(bytes ? bytes : 1);
+        if (!out->data.array) {
+            dst->count = i;
+            consumption_bitmap_clear(dst);
+            return false;
+        }
+        memcpy(out->data.array, c->data.array, bytes);
+        dst->count = i + 1;
+    }
+    return true;
+}
+
+bool consumption_bitmap_add(consumption_bitmap_t* bitmap, uint32_t value) {
+    uint32_t pos;
+    int32_t index = find_container(bitmap, (uint16_t)(value >> 16), &pos);
+    if (index < 0) {
+        if (!reserve_containers(bitmap, bitmap->count + 1)) return false;
+        memmove(&bitmap->containers[pos + 1], &bitmap->containers[pos],
+                (bitmap->count - pos) * sizeof(container_t));
+        memset(&bitmap->containers[pos], 0, sizeof(container_t));
+        bitmap->containers[pos].key = (uint16_t)(value >> 16);
+        bitmap->count++;
+        index = (int32_t)pos;
+    }
+
+    container_t* c = &bitmap->containers[index];
+    if (!container_add(c, (uint16_t)value)) {
+        if (c->cardinality == 0) remove_container(bitmap, (uint32_t)index);
+        return false;
+    }
+    return true;
+}
+
+void consumption_bitmap_remove(consumption_bitmap_t* bitmap, uint32_t value) {
+    int32_t index = find_container(bitmap, (uint16_t)(value >> 16), NULL);
+    if (index < 0) return;
+    container_remove(&bitmap->containers[index], (uint16_t)value);
+    if (bitmap->containers[index].cardinality == 0) {
+        remove_container(bitmap, (uint32_t)index);
+    }
+}
+
+bool consumption_bitmap_contains(const consumption_bitmap_t* bitmap, uint32_t value) {
+    int32_t index = find_container(bitmap, (uint16_t)(value >> 16), NULL);
+    return index >= 0 && container_contains(&bitmap->containers[index], (uint16_t)value);
+}
+
+uint32_t consumption_bitmap_cardinality(const consumption_bitmap_t* bitmap) {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < bitmap->count; i++) {
+        total += bitmap->containers[i].cardinality;
+    }
+    return total;
+}
+
+uint32_t consumption_bitmap_to_array(const consumption_bitmap_t* bitmap, uint32_t* values,
+                                     uint32_t max) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < bitmap->count && n < max; i++) {
+        const container_t* c = &bitmap->containers[i];
+        uint32_t high = (uint32_t)c->key << 16;
+        if (c->type == CONTAINER_ARRAY) {
+            for (uint32_t k = 0; k < c->cardinality && n < max; k++) {
+                values[n++] = high | c->data.array[k];
+            }
+            continue;
+        }
+        for (uint32_t w = 0; w < BITMAP_WORDS && n < max; w++) {
+            for (uint64_t bits = c->data.words[w]; bits && n < max; bits &= bits - 1) {
+                values[n++] = high | (w * 64 + (uint32_t)__builtin_ctzll(bits));
+            }
+        }
+    }
+    return n;
+}
+
+bool consumption_bitmap_and(consumption_bitmap_t* dst, const consumption_bitmap_t* src) {
+    return bitmap_op(OP_AND, dst, src);
+}
+
+bool consumption_bitmap_or(consumption_bitmap_t* dst, const consumption_bitmap_t* src) {
+    return bitmap_op(OP_OR, dst, src);
+}
+
+bool consumption_bitmap_andnot(consumption_bitmap_t* dst, const consumption_bitmap_t* src) {
+    return bitmap_op(OP_ANDNOT, dst, src);
+}
+
+size_t consumption_bitmap_memory(const consumption_bitmap_t* bitmap) {
+    size_t bytes = sizeof(*bitmap) + bitmap->capacity * sizeof(container_t);
+    for (uint32_t i = 0; i < bitmap->count; i++) {
+        const container_t* c = &bitmap->containers[i];
+        bytes += (c->type == CONTAINER_BITSET) ? BITMAP_WORDS * sizeof(uint64_t)
+                                               : c->capacity * sizeof(uint16_t);
+    }
+    return bytes;
+}
+
+/*
+ * Serialized form: magic, container count, then per container its key,
+ * type and cardinality (u16, u16, u32) followed by the sorted values (u16
+ * each) or the 1024 bitset words.
+ */
+
+size_t consumption_bitmap_serialize(const consumption_bitmap_t* bitmap, void* buffer, size_t size) {
+    size_t needed = 2 * sizeof(uint32_t);
+    for (uint32_t i = 0; i < bitmap->count; i++) {
+        const container_t* c = &bitmap->containers[i];
+        needed += 8 + ((c->type == CONTAINER_BITSET) ? BITMAP_WORDS * sizeof(uint64_t)
+                                                     : c->cardinality * sizeof(uint16_t));
+    }
+    if (!buffer || size < needed) {
+        return needed;
+    }
+
+    uint8_t* p = (uint8_t*)buffer;
+    const uint32_t header[2] = {BITMAP_MAGIC, bitmap->count};
+    memcpy(p, header, sizeof(header));
+    p += sizeof(header);
+    for (uint32_t i = 0; i < bitmap->count; i++) {
+        const container_t* c = &bitmap->containers[i];
+        size_t bytes = (c->type == CONTAINER_BITSET) ? BITMAP_WORDS * sizeof(uint64_t)
+                                                     : c->cardinality * sizeof(uint16_t);
+        memcpy(p, &c->key, 2);
+        memcpy(p + 2, &c->type, 2);
+        memcpy(p + 4, &c->cardinality, 4);
+        memcpy(p + 8, c->data.array, bytes);
+        p += 8 + bytes;
+    }
+    return needed;
+}
+
+consumption_bitmap_t* consumption_bitmap_deserialize(const void* buffer, size_t len) {
+    const uint8_t* p = (const uint8_t*)buffer;
+    const uint8_t* end = p + len;
+    uint32_t header[2];
+
+    if (!buffer || len < sizeof(header)) return NULL;
+    memcpy(header, p, sizeof(header));
+    p += sizeof(header);
+    if (header[0] != BITMAP_MAGIC || header[1] > 65536) return NULL;
+    if (header[1] > (len - sizeof(header)) / 8) return NULL; /* 8-byte header each */
+
+    consumption_bitmap_t* bitmap = consumption_bitmap_create();
+    if (!bitmap || !reserve_containers(bitmap, header[1])) {
+        consumption_bitmap_destroy(bitmap);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < header[1]; i++) {
+        container_t c = {0};
+        if (end - p < 8) goto malformed;
+        memcpy(&c.key, p, 2);
+        memcpy(&c.type, p + 2, 2);
+        memcpy(&c.cardinality, p + 4, 4);
+        p += 8;
+
+        /* Keys ascend; arrays are small (a bitset may be too if a shrink failed) */
+        if ((i > 0 && c.key <= bitmap->containers[i - 1].key) ||
+            c.type > CONTAINER_BITSET || c.cardinality == 0 || c.cardinality > 65536 ||
+            (c.type == CONTAINER_ARRAY && c.cardinality > BITMAP_ARRAY_MAX)) {
+            goto malformed;
+        }
+
+        size_t bytes = (c.type == CONTAINER_BITSET) ? BITMAP_WORDS * sizeof(uint64_t)
+                                                    : c.cardinality * sizeof(uint16_t);
+        if ((size_t)(end - p) < bytes) goto malformed;
+        c.capacity = (c.type == CONTAINER_ARRAY) ? c.cardinality : 0;
+        c.data.array = (uint16_t*)malloc(bytes);
+        if (!c.data.array) goto malformed;
+        memcpy(c.data.array, p, bytes);
+        p += bytes;
+        bitmap->containers[bitmap->count++] = c;
+
+        uint32_t card = 0;
+        if (c.type == CONTAINER_BITSET) {
+            for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+                card += (uint32_t)__builtin_popcountll(c.data.words[w]);
+            }
+        } else {
+            card = 1;
+            while (card < c.cardinality && c.data.array[card - 1] < c.data.array[card]) card++;
+        }
+        if (card != c.cardinality) goto malformed;
+    }
+    return bitmap;
+
+malformed:
+    consumption_bitmap_destroy(bitmap);
+    return NULL;
+}
@@ -0,0 +1,544 @@
+/**
+ * @file consumption_crdt.c
+ * @brief Mergeable counters implementation
+ *
+ * Entries live in fixed arrays: a key, a row of per-product counters with
+ * the total in column 0, and a bit per counter changed since the last
+ * delta. An open-addressing table maps (machine, period) to the first of
+ * its entries; the entries of other replicas for the same period are
+ * chained from it. Changed entries are queued so deltas do not scan the
+ * whole set. Eviction compacts the arrays and rebuilds the table.
+ *
+ * Delta format: magic and entry count (u32 each), then per entry the
+ * machine, period start, replica, period length + 1 (0 = unknown) and
+ * counter count as varints, followed by (column u8, value varint) pairs
+ * with ascending columns. Values are absolute, which is what makes a
+ * merge idempotent.
+ */
+
+#include "consumption_crdt.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define CRDT_MAGIC 0x44434743u      /* "CGCD" */
+#define CRDT_EMPTY 0u               /* Table slot: unused */
+#define CRDT_ENTRY_MAX (5 * 5)      /* Entry header bytes, at most */
+#define CRDT_COUNTER_MAX 6          /* Column + value bytes, at most */
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t machine_id;
+    uint32_t period_start;
+    uint32_t replica_id;
+    uint32_t period_end;            /* 0 = unknown */
+    uint32_t next;                  /* Next replica of this period: index + 1 */
+} crdt_key_t;
+
+struct consumption_crdt_t {
+    consumption_crdt_config_t config;
+    uint32_t count;
+    crdt_key_t* keys;
+    uint32_t* counts;               /* Per entry: products counters */
+    uint32_t* changed;              /* Per entry: dirty_words bitmask words */
+    uint32_t dirty_words;
+    uint8_t* queued;                /* Per entry: in the pending list */
+    uint32_t* pending;              /* Changed entries, in change order */
+    uint32_t pending_count;
+    uint32_t* table;                /* (machine, period) hash -> first entry + 1 */
+    uint32_t table_mask;
+    uint32_t horizon;
+    uint64_t deltas;
+    uint64_t merges;
+    uint64_t raised;
+    uint64_t late;
+    uint32_t memory_bytes;
+};
+
+/* ============================================================================
+ * INTERNAL FUNCTIONS
+ * ============================================================================ */
+
+static uint32_t table_home(const consumption_crdt_t* crdt, uint32_t machine_id, uint32_t period_start) {
+    return ((machine_id * 2654435761u) ^ (period_start * 2246822519u)) & crdt->table_mask;
+}
+
+/**
+ * @brief Table slot of a (machine, period), or the empty slot it would take
+ */
+static uint32_t* find_slot(const consumption_crdt_t* crdt, uint32_t machine_id, uint32_t period_start) {
+    uint32_t h = table_home(crdt, machine_id, period_start);
+    for (;;) {
+        uint32_t entry = crdt->table[h];
+        if (entry == CRDT_EMPTY ||
+            (crdt->keys[entry - 1].machine_id == machine_id &&
+             crdt->keys[entry - 1].period_start == period_start)) {
+            return &crdt->table[h];
+        }
+        h = (h + 1) & crdt->table_mask;
+    }
+}
+
+/**
+ * @brief Index of an entry, created if needed
+ * @return -1 if the set is full
+ */
+static int32_t insert_entry(consumption_crdt_t* crdt, uint32_t machine_id,
+                            uint32_t period_start, uint32_t replica_id) {
+    uint32_t* slot = find_slot(crdt, machine_id, period_start);
+    for (uint32_t entry = *slot; entry != CRDT_EMPTY; entry = crdt->keys[entry - 1].next) {
+        if (crdt->keys[entry - 1].replica_id == replica_id) {
+            return (int32_t)(entry - 1);
+        }
+    }
+    if (crdt->count >= crdt->config.max_entries) {
+        return -1;
+    }
+
+    uint32_t index = crdt->count++;
+    crdt->keys[index] = (crdt_key_t){machine_id, period_start, replica_id, 0, *slot};
+    *slot = index + 1;
+    return (int32_t)index;
+}
+
+/**
+ * @brief Raise a counter to value; marks it changed if it grew
+ */
+static bool raise_counter(consumption_crdt_t* crdt, uint32_t index, uint32_t column, uint32_t value) {
+    uint32_t* counter = &crdt->counts[(size_t)index * crdt->config.products + column];
+    if (value <= *counter) {
+        return false;
+    }
+    *counter = value;
+    crdt->changed[(size_t)index * crdt->dirty_words + column / 32] |= 1u << (column % 32);
+    if (!crdt->queued[index]) {
+        crdt->queued[index] = 1;
+        crdt->pending[crdt->pending_count++] = index;
+    }
+    return true;
+}
+
+static void raise_period_end(consumption_crdt_t* crdt, uint32_t index, uint32_t period_end) {
+    crdt_key_t* key = &crdt->keys[index];
+    if (period_end > key->period_end) {
+        key->period_end = period_end;
+    }
+}
+
+static size_t put_varint(uint8_t* p, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        p[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    p[n++] = (uint8_t)value;
+    return n;
+}
+
+static bool get_varint(const uint8_t** p, const uint8_t* end, uint32_t* value) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 35 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        v |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            if (v > UINT32_MAX) return false;
+            *value = (uint32_t)v;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    uint32_t machine_id;
+    uint32_t period_start;
+    uint32_t replica_id;
+    uint32_t period_end;
+    uint32_t counters;
+} delta_entry_t;
+
+static bool get_entry(const uint8_t** p, const uint8_t* end, delta_entry_t* entry) {
+    uint32_t length;
+    if (!get_varint(p, end, &entry->machine_id) || !get_varint(p, end, &entry->period_start) ||
+        !get_varint(p, end, &entry->replica_id) || !get_varint(p, end, &length) ||
+        !get_varint(p, end, &entry->counters) || entry->counters > 256 ||
+        (length > 0 && length - 1 > UINT32_MAX - entry->period_start)) {
+        return false;
+    }
+    entry->period_end = length ? entry->period_start + length - 1 : 0;
+    return true;
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+void consumption_crdt_config_default(consumption_crdt_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    config->max_entries = 4096;
+    config->products = 256;
+}
+
+consumption_crdt_t* consumption_crdt_create(const consumption_crdt_config_t* config) {
+    consumption_crdt_config_t defaults;
+    if (!config) {
+        consumption_crdt_config_default(&defaults);
+        config = &defaults;
+    }
+    if (config->max_entries == 0 || config->max_entries > (1u << 24) ||
+        config->products < 2 || config->products > 256) {
+        return NULL;
+    }
+
+    consumption_crdt_t* crdt = (consumption_crdt_t*)calloc(1, sizeof(consumption_crdt_t));
+    if (!crdt) {
+        return NULL;
+    }
+    crdt->config = *config;
+
+    uint32_t capacity = config->max_entries;
+    uint32_t table_size = 4;
+    while (table_size < capacity * 2) {
+        table_size *= 2;
+    }
+    crdt->table_mask = table_size - 1;
+    crdt->dirty_words = (config->products + 31) / 32;
+
+    crdt->keys = (crdt_key_t*)calloc(capacity, sizeof(crdt_key_t));
+    crdt->counts = (uint32_t*)calloc((size_t)capacity * config->products, sizeof(uint32_t));
+    crdt->changed = (uint32_t*)calloc((size_t)capacity * crdt->dirty_words, sizeof(uint32_t));
+    crdt->queued = (uint8_t*)calloc(capacity, 1);
+    crdt->pending = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    crdt->table = (uint32_t*)calloc(table_size, sizeof(uint32_t));
+
+    uint64_t bytes = sizeof(*crdt) + (uint64_t)capacity *
+        (sizeof(crdt_key_t) + (config->products + crdt->dirty_words + 1) * sizeof(uint32_t) + 1) +
+        (uint64_t)table_size * sizeof(uint32_t);
+    if (!crdt->keys || !crdt->counts || !crdt->changed || !crdt->queued || !crdt->pending ||
+        !crdt->table || bytes > UINT32_MAX) {
+        consumption_crdt_destroy(crdt);
+        return NULL;
+    }
+
+    crdt->memory_bytes = (uint32_t)bytes;
+    return crdt;
+}
+
+consumption_error_t consumption_crdt_add(consumption_crdt_t* crdt, uint32_t machine_id,
+                                         uint32_t period_start, uint32_t replica_id,
+                                         uint8_t product_id, uint32_t units) {
+    if (!crdt || product_id == 0) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (period_start < crdt->horizon) {
+        crdt->late++;
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (units == 0) {
+        return CONSUMPTION_SUCCESS;
+    }
+
+    int32_t index = insert_entry(crdt, machine_id, period_start, replica_id);
+    if (index < 0) {
+        return CONSUMPTION_ERROR_STORAGE_FULL;
+    }
+
+    /* Own entry: adding is raising to the sum */
+    const uint32_t* row = &crdt->counts[(size_t)index * crdt->config.products];
+    raise_counter(crdt, (uint32_t)index, 0, row[0] + units);
+    if (product_id < crdt->config.products) {
+        raise_counter(crdt, (uint32_t)index, product_id, row[product_id] + units);
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_crdt_observe(consumption_crdt_t* crdt, uint32_t replica_id,
+                                             const consumption_aggregate_t* aggregate) {
+    if (!crdt || !aggregate) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (aggregate->period_start < crdt->horizon) {
+        crdt->late++;
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    int32_t index = insert_entry(crdt, aggregate->machine_id, aggregate->period_start, replica_id);
+    if (index < 0) {
+        return CONSUMPTION_ERROR_STORAGE_FULL;
+    }
+
+    raise_period_end(crdt, (uint32_t)index, aggregate->period_end);
+    raise_counter(crdt, (uint32_t)index, 0, aggregate->total_events);
+    for (uint32_t p = 1; p < crdt->config.products; p++) {
+        if (aggregate->product_counts[p]) {
+            raise_counter(crdt, (uint32_t)index, p, aggregate->product_counts[p]);
+        }
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+size_t consumption_crdt_delta(consumption_crdt_t* crdt, void* buffer, size_t size) {
+    if (!crdt || !buffer || crdt->pending_count == 0 || size < 2 * sizeof(uint32_t)) {
+        return 0;
+    }
+
+    uint8_t* out = (uint8_t*)buffer;
+    size_t len = 2 * sizeof(uint32_t);
+    uint32_t written = 0;
+    const uint32_t products = crdt->config.products;
+
+    while (written < crdt->pending_count) {
+        uint32_t index = crdt->pending[written];
+        uint32_t* changed = &crdt->changed[(size_t)index * crdt->dirty_words];
+        uint32_t counters = 0;
+        for (uint32_t w = 0; w < crdt->dirty_words; w++) {
+            counters += (uint32_t)__builtin_popcount(changed[w]);
+        }
+        if (size - len < CRDT_ENTRY_MAX + (size_t)counters * CRDT_COUNTER_MAX) {
+            break;
+        }
+
+        const crdt_key_t* key = &crdt->keys[index];
+        uint32_t length = (key->period_end >= key->period_start && key->period_end) ?
+                          key->period_end - key->period_start + 1 : 0;
+        len += put_varint(out + len, key->machine_id);
+        len += put_varint(out + len, key->period_start);
+        len += put_varint(out + len, key->replica_id);
+        len += put_varint(out + len, length);
+        len += put_varint(out + len, counters);
+
+        const uint32_t* row = &crdt->counts[(size_t)index * products];
+        for (uint32_t w = 0; w < crdt->dirty_words; w++) {
+            for (uint32_t bits = changed[w]; bits; bits &= bits - 1) {
+                uint32_t column = w * 32 + (uint32_t)__builtin_ctz(bits);
+                out[len++] = (uint8_t)column;
+                len += put_varint(out + len, row[column]);
+            }
+            changed[w] = 0;
+        }
+        crdt->queued[index] = 0;
+        written++;
+    }
+
+    if (written == 0) {
+        return 0;
+    }
+    crdt->pending_count -= written;
+    memmove(crdt->pending, crdt->pending + written, crdt->pending_count * sizeof(uint32_t));
+
+    const uint32_t header[2] = {CRDT_MAGIC, written};
+    memcpy(out, header, sizeof(header));
+    crdt->deltas++;
+    return len;
+}
+
+void consumption_crdt_mark_all(consumption_crdt_t* crdt) {
+    if (!crdt) return;
+    for (uint32_t i = 0; i < crdt->count; i++) {
+        const uint32_t* row = &crdt->counts[(size_t)i * crdt->config.products];
+        uint32_t* changed = &crdt->changed[(size_t)i * crdt->dirty_words];
+        for (uint32_t c = 0; c < crdt->config.products; c++) {
+            if (row[c]) changed[c / 32] |= 1u << (c % 32);
+        }
+        if (!crdt->queued[i]) {
+            crdt->queued[i] = 1;
+            crdt->pending[crdt->pending_count++] = i;
+        }
+    }
+}
+
+consumption_error_t consumption_crdt_merge(consumption_crdt_t* crdt, const void* delta, size_t len) {
+    uint32_t header[2];
+    if (!crdt || !delta || len < sizeof(header)) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    memcpy(header, delta, sizeof(header));
+    if (header[0] != CRDT_MAGIC) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    const uint8_t* start = (const uint8_t*)delta + sizeof(header);
+    const uint8_t* end = (const uint8_t*)delta + len;
+
+    /* Validate everything first so a bad delta changes nothing */
+    const uint8_t* p = start;
+    for (uint32_t e = 0; e < header[1]; e++) {
+        delta_entry_t entry;
+        if (!get_entry(&p, end, &entry)) {
+            return CONSUMPTION_ERROR_INVALID_PARAMETER;
+        }
+        int32_t last = -1;
+        for (uint32_t c = 0; c < entry.counters; c++) {
+            uint32_t value;
+            if (p >= end || (int32_t)*p <= last) {
+                return CONSUMPTION_ERROR_INVALID_PARAMETER;
+            }
+            last = *p++;
+            if (!get_varint(&p, end, &value)) {
+                return CONSUMPTION_ERROR_INVALID_PARAMETER;
+            }
+        }
+    }
+    if (p != end) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    bool full = false;
+    p = start;
+    for (uint32_t e = 0; e < header[1]; e++) {
+        delta_entry_t entry;
+        get_entry(&p, end, &entry);
+        int32_t index = -1;
+        if (entry.period_start < crdt->horizon) {
+            crdt->late++;
+        } else {
+            index = insert_entry(crdt, entry.machine_id, entry.period_start, entry.replica_id);
+            full = full || index < 0;
+        }
+        if (index >= 0) {
+            raise_period_end(crdt, (uint32_t)index, entry.period_end);
+        }
+
+        for (uint32_t c = 0; c < entry.counters; c++) {
+            uint32_t column = *p++;
+            uint32_t value = 0;
+            get_varint(&p, end, &value);
+            if (index >= 0 && column < crdt->config.products &&
+                raise_counter(crdt, (uint32_t)index, column, value)) {
+                crdt->raised++;
+            }
+        }
+    }
+
+    crdt->merges++;
+    return full ? CONSUMPTION_ERROR_STORAGE_FULL : CONSUMPTION_SUCCESS;
+}
+
+/**
+ * @brief Sum the replicas chained from an entry into an aggregate
+ */
+static void sum_replicas(const consumption_crdt_t* crdt, uint32_t first,
+                         consumption_aggregate_t* aggregate) {
+    memset(aggregate, 0, sizeof(*aggregate));
+    aggregate->machine_id = crdt->keys[first - 1].machine_id;
+    aggregate->period_start = crdt->keys[first - 1].period_start;
+
+    for (uint32_t entry = first; entry != CRDT_EMPTY; entry = crdt->keys[entry - 1].next) {
+        const crdt_key_t* key = &crdt->keys[entry - 1];
+        const uint32_t* row = &crdt->counts[(size_t)(entry - 1) * crdt->config.products];
+        if (key->period_end > aggregate->period_end) {
+            aggregate->period_end = key->period_end;
+        }
+        aggregate->total_events += row[0];
+        for (uint32_t p = 1; p < crdt->config.products; p++) {
+            aggregate->product_counts[p] += row[p];
+        }
+    }
+}
+
+consumption_error_t consumption_crdt_read(const consumption_crdt_t* crdt, uint32_t machine_id,
+                                          uint32_t period_start, consumption_aggregate_t* aggregate) {
+    if (!crdt || !aggregate) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    uint32_t first = *find_slot(crdt, machine_id, period_start);
+    if (first == CRDT_EMPTY) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    sum_replicas(crdt, first, aggregate);
+    return CONSUMPTION_SUCCESS;
+}
+
+uint32_t consumption_crdt_collect(const consumption_crdt_t* crdt, uint32_t before,
+                                  consumption_crdt_aggregate_cb_t on_aggregate, void* user) {
+    if (!crdt || !on_aggregate) {
+        return 0;
+    }
+
+    consumption_aggregate_t aggregate;
+    uint32_t reported = 0;
+    for (uint32_t h = 0; h <= crdt->table_mask; h++) {
+        uint32_t first = crdt->table[h];
+        if (first != CRDT_EMPTY && crdt->keys[first - 1].period_start < before) {
+            sum_replicas(crdt, first, &aggregate);
+            on_aggregate(&aggregate, user);
+            reported++;
+        }
+    }
+    return reported;
+}
+
+uint32_t consumption_crdt_evict(consumption_crdt_t* crdt, uint32_t before) {
+    if (!crdt) {
+        return 0;
+    }
+    if (before > crdt->horizon) {
+        crdt->horizon = before;
+    }
+
+    const uint32_t products = crdt->config.products;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < crdt->count; i++) {
+        if (crdt->keys[i].period_start < before) {
+            continue;
+        }
+        if (i != kept) {
+            crdt->keys[kept] = crdt->keys[i];
+            memcpy(&crdt->counts[(size_t)kept * products], &crdt->counts[(size_t)i * products],
+                   products * sizeof(uint32_t));
+            memcpy(&crdt->changed[(size_t)kept * crdt->dirty_words],
+                   &crdt->changed[(size_t)i * crdt->dirty_words], crdt->dirty_words * sizeof(uint32_t));
+            crdt->queued[kept] = crdt->queued[i];
+        }
+        kept++;
+    }
+    uint32_t dropped = crdt->count - kept;
+    if (dropped == 0) {
+        return 0;
+    }
+
+    /* Rebuild the table, chains and pending list over the compacted arrays */
+    crdt->count = kept;
+    memset(crdt->table, 0, ((size_t)crdt->table_mask + 1) * sizeof(uint32_t));
+    crdt->pending_count = 0;
+    for (uint32_t i = 0; i < kept; i++) {
+        uint32_t* slot = find_slot(crdt, crdt->keys[i].machine_id, crdt->keys[i].period_start);
+        crdt->keys[i].next = *slot;
+        *slot = i + 1;
+        if (crdt->queued[i]) {
+            crdt->pending[crdt->pending_count++] = i;
+        }
+    }
+    memset(&crdt->counts[(size_t)kept * products], 0, (size_t)dropped * products * sizeof(uint32_t));
+    memset(&crdt->changed[(size_t)kept * crdt->dirty_words], 0,
+           (size_t)dropped * crdt->dirty_words * sizeof(uint32_t));
+    memset(&crdt->queued[kept], 0, dropped);
+    return dropped;
+}
+
+void consumption_crdt_get_stats(const consumption_crdt_t* crdt, consumption_crdt_stats_t* stats) {
+    if (!crdt || !stats) return;
+    memset(stats, 0, sizeof(*stats));
+    stats->entries = crdt->count;
+    stats->pending = crdt->pending_count;
+    stats->deltas = crdt->deltas;
+    stats->merges = crdt->merges;
+    stats->raised = crdt->raised;
+    stats->late = crdt->late;
+    stats->horizon = crdt->horizon;
+    stats->memory_bytes = crdt->memory_bytes;
+}
+
+void consumption_crdt_destroy(consumption_crdt_t* crdt) {
+    if (!crdt) return;
+    free(crdt->keys);
+    free(crdt->counts);
+    free(crdt->changed);
+    free(crdt->queued);
+    free(crdt->pending);
+    free(crdt->table);
+    free(crdt);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file consumption_crypto.h
+ * @brief Storage sealing primitives (internal)
+ *
+ * Not part of the public API: shared by consumption.c and the unit tests,
+ * which check the construction against the RFC 8439 test vectors.
+ */
+
+#ifndef CONSUMPTION_CRYPTO_H
+#define CONSUMPTION_CRYPTO_H
+
+#include "consumption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief AEAD_CHACHA20_POLY1305 encryption (RFC 8439, section 2.8)
+ *
+ * The construction that seals stored records. Records use the nonce words
+ * (sealed_at, seq low, seq high) and their header up to the tag as AAD.
+ *
+ * @param key CONSUMPTION_STORAGE_KEY_SIZE bytes
+ * @param nonce 96-bit nonce
+ * @param aad Additional authenticated data, may be NULL if aad_len is 0
+ * @param aad_len AAD length
+ * @param plaintext Data to encrypt
+ * @param len Data length
+ * @param ciphertext Receives len bytes, may equal plaintext
+ * @param tag Receives the 16-byte tag
+ */
+void consumption_aead_seal(const uint8_t key[CONSUMPTION_STORAGE_KEY_SIZE], const uint8_t nonce[12],
+                           const uint8_t* aad, size_t aad_len,
+                           const uint8_t* plaintext, size_t len,
+                           uint8_t* ciphertext, uint8_t tag[16]);
+
+/**
+ * @brief One-time Poly1305 authenticator (RFC 8439, section 2.5)
+ *
+ * @param key 32-byte one-time key (r, s)
+ * @param message Message
+ * @param len Message length
+ * @param tag Receives the 16-byte tag
+ */
+void consumption_poly1305(const uint8_t key[32], const uint8_t* message, size_t len, uint8_t tag[16]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSUMPTION_CRYPTO_H */
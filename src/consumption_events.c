@@ -0,0 +1,699 @@
+/**
+ * @file consumption_events.c
+ * @brief Event-loop integration implementation (Linux, epoll, libcurl multi)
+ *
+ * One internal epoll set holds an eventfd (sync due on dispense), a timerfd
+ * (earliest of the next sync, the retry backoff and curl's timeout) and the
+ * sockets curl asks to watch. The host waits on that set's descriptor;
+ * consumption_process_events() drains it with zero-timeout calls only.
+ *
+ * Uploads go through a transport: libcurl multi by default, or one passed
+ * in the configuration, which reports back with
+ * consumption_events_upload_done().
+ *
+ * Asynchronous force-sync requests live in a small fixed table. Requests
+ * that arrive before an upload starts, or while it is in flight, are
+ * attached to it and completed together when it finishes.
+ */
+
+#define _GNU_SOURCE
+#include "consumption_events.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+
+#ifdef USE_CURL
+#include <curl/curl.h>
+#endif
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#define EVENTS_MAX_EVENTS 16
+#define EVENTS_AUTH_BUFFER_SIZE 160
+#define EVENTS_MAX_REQUESTS 16          /* Pending asynchronous force-syncs */
+
+/* Provided by the platform layer, same clock as the module's timestamps */
+extern uint32_t consumption_platform_get_timestamp(void);
+extern void consumption_platform_log(int level, const char* message);
+
+/* ============================================================================
+ * INTERNAL STATE
+ * ============================================================================ */
+
+typedef struct {
+    consumption_sync_handle_t id;   /* 0 = free slot */
+    consumption_sync_cb_t cb;
+    void* user;
+    uint64_t created_ns;
+    uint64_t deadline_ns;           /* 0 = none */
+    bool attached;                  /* Completes with the upload in flight */
+} sync_request_t;
+
+typedef struct {
+    bool initialized;
+    consumption_events_config_t config;
+    consumption_events_transport_t transport;
+    int epoll_fd;
+    int event_fd;
+    int timer_fd;
+    consumption_upload_t* upload;   /* In flight, NULL when idle */
+    bool sync_pending;              /* Notified by the module */
+    uint32_t idle_sync;             /* Due time already found with nothing to send */
+    uint64_t retry_due_ns;          /* End of the backoff, 0 = none */
+    consumption_upload_info_t info; /* Upload in flight */
+    sync_request_t requests[EVENTS_MAX_REQUESTS];
+    consumption_sync_handle_t next_handle;
+} events_state_t;
+
+static events_state_t g_events = { .epoll_fd = -1, .event_fd = -1, .timer_fd = -1 };
+
+#ifdef USE_CURL
+typedef struct {
+    CURLM* multi;                   /* NULL unless curl is the transport */
+    CURL* easy;                     /* Reused so the connection stays alive */
+    struct curl_slist* headers;
+    char api_key[sizeof(((consumption_config_t*)0)->api_key)]; /* Key in headers */
+    uint64_t due_ns;                /* curl timeout, 0 = none */
+} curl_transport_t;
+
+static curl_transport_t g_curl;
+#endif
+
+/* ============================================================================
+ * HELPERS
+ * ============================================================================ */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void drain(int fd) {
+    uint64_t value;
+    while (read(fd, &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+    }
+}
+
+/**
+ * @brief Sync handler: runs on the dispensing thread, only signals the loop
+ */
+static void events_notify(void* ctx) {
+    (void)ctx;
+    uint64_t one = 1;
+    ssize_t n = write(g_events.event_fd, &one, sizeof(one));
+    (void)n; /* Counter saturated means a wakeup is already pending */
+}
+
+/**
+ * @brief Arm the timerfd for the earliest deadline
+ */
+static void arm_timer(void) {
+    uint64_t now = now_ns();
+    uint64_t due = 0;
+#ifdef USE_CURL
+    due = g_curl.due_ns;
+#endif
+
+    if (!g_events.upload) {
+        uint64_t sync_due = g_events.retry_due_ns;
+        if (sync_due == 0) {
+            uint32_t next = 0;
+            if (consumption_get_next_sync(&next) == CONSUMPTION_SUCCESS && next > 0 &&
+                next != g_events.idle_sync) {
+                uint32_t ts = consumption_platform_get_timestamp();
+                sync_due = now + ((next > ts) ? (uint64_t)(next - ts) * 1000000000u : 0);
+            }
+        }
+        if (sync_due > 0 && (due == 0 || sync_due < due)) {
+            due = sync_due;
+        }
+    }
+
+    for (uint32_t i = 0; i < EVENTS_MAX_REQUESTS; i++) {
+        uint64_t deadline = g_events.requests[i].id ? g_events.requests[i].deadline_ns : 0;
+        if (deadline > 0 && (due == 0 || deadline < due)) {
+            due = deadline;
+        }
+    }
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (due > 0) {
+        uint64_t delta = (due > now) ? due - now : 1; /* 0 would disarm */
+        spec.it_value.tv_sec = (time_t)(delta / 1000000000u);
+        spec.it_value.tv_nsec = (long)(delta % 1000000000u);
+    }
+    timerfd_settime(g_events.timer_fd, 0, &spec, NULL);
+}
+
+/* ============================================================================
+ * FORCE-SYNC REQUESTS
+ * ============================================================================ */
+
+static sync_request_t* find_request(consumption_sync_handle_t handle) {
+    for (uint32_t i = 0; handle != 0 && i < EVENTS_MAX_REQUESTS; i++) {
+        if (g_events.requests[i].id == handle) {
+            return &g_events.requests[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Free a request's slot, then run its callback
+ */
+static void complete_request(sync_request_t* request, consumption_error_t result,
+                             const consumption_upload_info_t* info, uint32_t merged) {
+    sync_request_t done = *request;
+    memset(request, 0, sizeof(*request));
+
+    consumption_sync_result_t r;
+    memset(&r, 0, sizeof(r));
+    r.result = result;
+    if (info) {
+        r.period_start = info->period_start;
+        r.period_end = info->period_end;
+        r.events = info->events;
+        r.bytes = info->bytes;
+    }
+    r.elapsed_ms = (uint32_t)((now_ns() - done.created_ns) / 1000000u);
+    r.merged = merged;
+
+    if (done.cb) {
+        done.cb(done.id, &r, done.user);
+    }
+}
+
+/**
+ * @brief Complete the attached (or the waiting) requests
+ *
+ * Handles are collected first: callbacks may add or cancel requests.
+ */
+static void complete_requests(bool attached, consumption_error_t result,
+                              const consumption_upload_info_t* info) {
+    consumption_sync_handle_t handles[EVENTS_MAX_REQUESTS];
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < EVENTS_MAX_REQUESTS; i++) {
+        if (g_events.requests[i].id && g_events.requests[i].attached == attached) {
+            handles[count++] = g_events.requests[i].id;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        sync_request_t* request = find_request(handles[i]);
+        if (request) {
+            complete_request(request, result, info, count);
+        }
+    }
+}
+
+static bool requests_waiting(void) {
+    for (uint32_t i = 0; i < EVENTS_MAX_REQUESTS; i++) {
+        if (g_events.requests[i].id && !g_events.requests[i].attached) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void expire_requests(void) {
+    uint64_t now = now_ns();
+    for (uint32_t i = 0; i < EVENTS_MAX_REQUESTS; i++) {
+        sync_request_t* request = &g_events.requests[i];
+        if (request->id && request->deadline_ns > 0 && now >= request->deadline_ns) {
+            complete_request(request, CONSUMPTION_ERROR_TIMEOUT, NULL, 1);
+        }
+    }
+}
+
+/* ============================================================================
+ * UPLOADS
+ * ============================================================================ */
+
+static bool start_upload(consumption_upload_t* upload) {
+    if (!g_events.transport.start(upload, g_events.transport.ctx)) {
+        return false;
+    }
+    g_events.upload = upload;
+    consumption_upload_get_info(upload, &g_events.info);
+
+    /* Everyone waiting rides on this upload */
+    for (uint32_t i = 0; i < EVENTS_MAX_REQUESTS; i++) {
+        if (g_events.requests[i].id) g_events.requests[i].attached = true;
+    }
+    return true;
+}
+
+static void finish_upload(bool success) {
+    consumption_upload_t* upload = g_events.upload;
+    g_events.upload = NULL;
+
+    consumption_upload_get_info(upload, &g_events.info); /* Final byte count */
+    consumption_upload_finish(upload, success);
+    g_events.retry_due_ns = success ? 0 :
+        now_ns() + (uint64_t)g_events.config.retry_delay_ms * 1000000u;
+
+    complete_requests(true, success ? CONSUMPTION_SUCCESS : CONSUMPTION_ERROR_API_ERROR,
+                      &g_events.info);
+}
+
+/**
+ * @brief Begin an upload if one is due and none is in flight
+ */
+static void maybe_start(void) {
+    if (g_events.upload) {
+        return;
+    }
+
+    uint64_t now = now_ns();
+    bool forced = requests_waiting();
+    if (forced) {
+        g_events.retry_due_ns = 0; /* A force-sync skips the backoff */
+    } else if (g_events.retry_due_ns > 0) {
+        if (now < g_events.retry_due_ns) return;
+        g_events.retry_due_ns = 0;
+    } else if (!g_events.sync_pending) {
+        uint32_t next = 0;
+        if (consumption_get_next_sync(&next) != CONSUMPTION_SUCCESS || next == 0 ||
+            next == g_events.idle_sync || consumption_platform_get_timestamp() < next) {
+            return;
+        }
+    }
+    g_events.sync_pending = false;
+
+    consumption_upload_t* upload = NULL;
+    consumption_error_t result = consumption_upload_begin(&upload);
+    if (result != CONSUMPTION_SUCCESS || !upload) {
+        /* Nothing to send (or a blocking sync runs): wait for a dispense */
+        consumption_get_next_sync(&g_events.idle_sync);
+        complete_requests(false, result, NULL);
+        return;
+    }
+    if (!start_upload(upload)) {
+        consumption_platform_log(0, "Failed to start asynchronous upload");
+        consumption_upload_finish(upload, false);
+        g_events.retry_due_ns = now + (uint64_t)g_events.config.retry_delay_ms * 1000000u;
+        complete_requests(false, CONSUMPTION_ERROR_NETWORK_UNAVAILABLE, NULL);
+    }
+}
+
+#ifdef USE_CURL
+
+/* ============================================================================
+ * LIBCURL TRANSPORT
+ * ============================================================================ */
+
+static int curl_socket_cb(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp) {
+    (void)easy; (void)userp;
+
+    if (what == CURL_POLL_REMOVE) {
+        epoll_ctl(g_events.epoll_fd, EPOLL_CTL_DEL, s, NULL);
+        return 0;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = s;
+    if (what & CURL_POLL_IN) ev.events |= EPOLLIN;
+    if (what & CURL_POLL_OUT) ev.events |= EPOLLOUT;
+
+    if (socketp) {
+        epoll_ctl(g_events.epoll_fd, EPOLL_CTL_MOD, s, &ev);
+    } else {
+        epoll_ctl(g_events.epoll_fd, EPOLL_CTL_ADD, s, &ev);
+        curl_multi_assign(g_curl.multi, s, &g_curl); /* Marks it as watched */
+    }
+    return 0;
+}
+
+static int curl_timer_cb(CURLM* multi, long timeout_ms, void* userp) {
+    (void)multi; (void)userp;
+    g_curl.due_ns = (timeout_ms < 0) ? 0 : now_ns() + (uint64_t)timeout_ms * 1000000u;
+    arm_timer();
+    return 0;
+}
+
+static size_t curl_read_cb(char* buffer, size_t size, size_t nitems, void* userdata) {
+    return consumption_upload_read(buffer, size * nitems, userdata);
+}
+
+/**
+ * @brief Build the request headers, again whenever the API key changed
+ */
+static void curl_headers(const consumption_config_t* config) {
+    if (g_curl.headers && strncmp(g_curl.api_key, config->api_key, sizeof(g_curl.api_key)) == 0) {
+        return;
+    }
+
+    curl_slist_free_all(g_curl.headers);
+    g_curl.headers = curl_slist_append(NULL, "Content-Type: application/json");
+    g_curl.headers = curl_slist_append(g_curl.headers, "User-Agent: Consumption-Module/1.0");
+    g_curl.headers = curl_slist_append(g_curl.headers, "Transfer-Encoding: chunked");
+    if (config->api_key[0]) {
+        char auth[EVENTS_AUTH_BUFFER_SIZE];
+        snprintf(auth, sizeof(auth), "Authorization: Bearer %s", config->api_key);
+        g_curl.headers = curl_slist_append(g_curl.headers, auth);
+    }
+    memcpy(g_curl.api_key, config->api_key, sizeof(g_curl.api_key));
+}
+
+static bool curl_start(consumption_upload_t* upload, void* ctx) {
+    (void)ctx;
+    consumption_config_t config;
+    if (consumption_get_config(&config) != CONSUMPTION_SUCCESS) {
+        return false;
+    }
+
+    if (!g_curl.easy) {
+        g_curl.easy = curl_easy_init();
+        if (!g_curl.easy) return false;
+    }
+    curl_headers(&config);
+
+    CURL* easy = g_curl.easy;
+    curl_easy_setopt(easy, CURLOPT_URL, config.api_endpoint);
+    curl_easy_setopt(easy, CURLOPT_POST, 1L);
+    curl_easy_setopt(easy, CURLOPT_READFUNCTION, curl_read_cb);
+    curl_easy_setopt(easy, CURLOPT_READDATA, upload);
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, g_curl.headers);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, (long)g_events.config.timeout_ms);
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, (long)g_events.config.connect_timeout_ms);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+
+    return curl_multi_add_handle(g_curl.multi, easy) == CURLM_OK;
+}
+
+static void curl_abort(void* ctx) {
+    (void)ctx;
+    curl_multi_remove_handle(g_curl.multi, g_curl.easy);
+}
+
+/**
+ * @brief Pass ready sockets and an expired timeout to curl, collect finished transfers
+ */
+static void curl_process(const struct epoll_event* events, int n) {
+    int running = 0;
+
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == g_events.event_fd || fd == g_events.timer_fd) {
+            continue;
+        }
+        int flags = 0;
+        if (events[i].events & EPOLLIN) flags |= CURL_CSELECT_IN;
+        if (events[i].events & EPOLLOUT) flags |= CURL_CSELECT_OUT;
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) flags |= CURL_CSELECT_ERR;
+        curl_multi_socket_action(g_curl.multi, fd, flags, &running);
+    }
+
+    if (g_curl.due_ns > 0 && now_ns() >= g_curl.due_ns) {
+        g_curl.due_ns = 0;
+        curl_multi_socket_action(g_curl.multi, CURL_SOCKET_TIMEOUT, 0, &running);
+    }
+
+    CURLMsg* msg;
+    int queued;
+    while ((msg = curl_multi_info_read(g_curl.multi, &queued)) != NULL) {
+        if (msg->msg != CURLMSG_DONE || msg->easy_handle != g_curl.easy || !g_events.upload) {
+            continue;
+        }
+        long response_code = 0;
+        curl_easy_getinfo(g_curl.easy, CURLINFO_RESPONSE_CODE, &response_code);
+        curl_multi_remove_handle(g_curl.multi, g_curl.easy);
+        finish_upload(msg->data.result == CURLE_OK &&
+                      response_code >= 200 && response_code < 300);
+    }
+}
+
+static consumption_error_t curl_init(void) {
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        return CONSUMPTION_ERROR_NETWORK_UNAVAILABLE;
+    }
+    g_curl.multi = curl_multi_init();
+    if (!g_curl.multi) {
+        curl_global_cleanup();
+        return CONSUMPTION_ERROR_MEMORY_ERROR;
+    }
+    curl_multi_setopt(g_curl.multi, CURLMOPT_SOCKETFUNCTION, curl_socket_cb);
+    curl_multi_setopt(g_curl.multi, CURLMOPT_TIMERFUNCTION, curl_timer_cb);
+    return CONSUMPTION_SUCCESS;
+}
+
+static void curl_cleanup(void) {
+    if (!g_curl.multi) {
+        return;
+    }
+    if (g_curl.easy) curl_easy_cleanup(g_curl.easy);
+    curl_multi_cleanup(g_curl.multi);
+    curl_slist_free_all(g_curl.headers);
+    curl_global_cleanup();
+    memset(&g_curl, 0, sizeof(g_curl));
+}
+
+#endif /* USE_CURL */
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+void consumption_events_config_default(consumption_events_config_t* config) {
+    if (!config) return;
+
+    memset(config, 0, sizeof(consumption_events_config_t));
+    config->timeout_ms = 30000;
+    config->connect_timeout_ms = 10000;
+    config->retry_delay_ms = 60000;
+}
+
+consumption_error_t consumption_events_init(const consumption_events_config_t* config) {
+    if (g_events.initialized) {
+        return CONSUMPTION_SUCCESS;
+    }
+
+    uint32_t next;
+    if (consumption_get_next_sync(&next) != CONSUMPTION_SUCCESS) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG; /* Module not initialized */
+    }
+
+    if (config && config->transport && !config->transport->start) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (config) {
+        g_events.config = *config;
+    } else {
+        consumption_events_config_default(&g_events.config);
+    }
+
+    if (g_events.config.transport) {
+        g_events.transport = *g_events.config.transport;
+    } else {
+#ifdef USE_CURL
+        consumption_error_t result = curl_init();
+        if (result != CONSUMPTION_SUCCESS) {
+            return result;
+        }
+        g_events.transport.start = curl_start;
+        g_events.transport.abort = curl_abort;
+#else
+        return CONSUMPTION_ERROR_NETWORK_UNAVAILABLE;  /* libcurl not available */
+#endif
+    }
+
+    g_events.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    g_events.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    g_events.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (g_events.epoll_fd < 0 || g_events.event_fd < 0 || g_events.timer_fd < 0) {
+        g_events.initialized = true; /* Lets deinit release what was created */
+        consumption_events_deinit();
+        return CONSUMPTION_ERROR_MEMORY_ERROR;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = g_events.event_fd;
+    epoll_ctl(g_events.epoll_fd, EPOLL_CTL_ADD, g_events.event_fd, &ev);
+    ev.data.fd = g_events.timer_fd;
+    epoll_ctl(g_events.epoll_fd, EPOLL_CTL_ADD, g_events.timer_fd, &ev);
+
+    g_events.initialized = true;
+    consumption_set_sync_handler(events_notify, NULL);
+    arm_timer();
+
+    return CONSUMPTION_SUCCESS;
+}
+
+int consumption_events_get_fd(void) {
+    return g_events.initialized ? g_events.epoll_fd : -1;
+}
+
+consumption_error_t consumption_process_events(void) {
+    if (!g_events.initialized) {
+        return CONSUMPTION_ERROR_INVALID_CONFIG;
+    }
+
+    struct epoll_event events[EVENTS_MAX_EVENTS];
+    int n = epoll_wait(g_events.epoll_fd, events, EVENTS_MAX_EVENTS, 0);
+
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == g_events.event_fd) {
+            drain(fd);
+            g_events.sync_pending = true;
+        } else if (fd == g_events.timer_fd) {
+            drain(fd);
+        }
+    }
+#ifdef USE_CURL
+    if (g_curl.multi) {
+        curl_process(events, n);
+    }
+#endif
+
+    expire_requests();
+    maybe_start();
+    arm_timer();
+
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_events_upload_done(bool success) {
+    if (!g_events.initialized || !g_events.upload) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+#ifdef USE_CURL
+    if (g_curl.multi) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER; /* curl reports its own uploads */
+    }
+#endif
+
+    finish_upload(success);
+    arm_timer();
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_sync_handle_t consumption_force_sync_async(consumption_sync_cb_t cb, void* user) {
+    if (!g_events.initialized) {
+        return 0;
+    }
+
+    sync_request_t* request = NULL;
+    for (uint32_t i = 0; !request && i < EVENTS_MAX_REQUESTS; i++) {
+        if (g_events.requests[i].id == 0) request = &g_events.requests[i];
+    }
+    if (!request) {
+        return 0;
+    }
+
+    if (++g_events.next_handle == 0) {
+        g_events.next_handle = 1;
+    }
+    request->id = g_events.next_handle;
+    request->cb = cb;
+    request->user = user;
+    request->created_ns = now_ns();
+    request->deadline_ns = 0;
+    request->attached = (g_events.upload != NULL);
+
+    events_notify(NULL); /* Start it from the next consumption_process_events() */
+    return request->id;
+}
+
+consumption_error_t consumption_sync_set_deadline(consumption_sync_handle_t handle,
+                                                  uint32_t timeout_ms) {
+    sync_request_t* request = find_request(handle);
+    if (!request) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    request->deadline_ns = now_ns() + (uint64_t)timeout_ms * 1000000u;
+    arm_timer();
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_sync_cancel(consumption_sync_handle_t handle) {
+    sync_request_t* request = find_request(handle);
+    if (!request) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    complete_request(request, CONSUMPTION_ERROR_CANCELLED, NULL, 1);
+    return CONSUMPTION_SUCCESS;
+}
+
+void consumption_events_deinit(void) {
+    if (!g_events.initialized) {
+        return;
+    }
+
+    consumption_set_sync_handler(NULL, NULL);
+
+    complete_requests(true, CONSUMPTION_ERROR_CANCELLED, NULL);
+    complete_requests(false, CONSUMPTION_ERROR_CANCELLED, NULL);
+    if (g_events.upload) {
+        if (g_events.transport.abort) {
+            g_events.transport.abort(g_events.transport.ctx);
+        }
+        finish_upload(false); /* Counters return to the open period */
+    }
+#ifdef USE_CURL
+    curl_cleanup();
+#endif
+
+    if (g_events.timer_fd >= 0) close(g_events.timer_fd);
+    if (g_events.event_fd >= 0) close(g_events.event_fd);
+    if (g_events.epoll_fd >= 0) close(g_events.epoll_fd);
+
+    memset(&g_events, 0, sizeof(g_events));
+    g_events.epoll_fd = g_events.event_fd = g_events.timer_fd = -1;
+}
+
+#else /* Linux not available */
+
+void consumption_events_config_default(consumption_events_config_t* config) {
+    if (config) memset(config, 0, sizeof(consumption_events_config_t));
+}
+
+consumption_error_t consumption_events_init(const consumption_events_config_t* config) {
+    (void)config;
+    return CONSUMPTION_ERROR_NETWORK_UNAVAILABLE;  /* epoll not available */
+}
+
+int consumption_events_get_fd(void) {
+    return -1;
+}
+
+consumption_error_t consumption_process_events(void) {
+    return CONSUMPTION_ERROR_INVALID_CONFIG;
+}
+
+consumption_error_t consumption_events_upload_done(bool success) {
+    (void)success;
+    return CONSUMPTION_ERROR_INVALID_PARAMETER;
+}
+
+consumption_sync_handle_t consumption_force_sync_async(consumption_sync_cb_t cb, void* user) {
+    (void)cb; (void)user;
+    return 0;
+}
+
+consumption_error_t consumption_sync_set_deadline(consumption_sync_handle_t handle,
+                                                  uint32_t timeout_ms) {
+    (void)handle; (void)timeout_ms;
+    return CONSUMPTION_ERROR_INVALID_PARAMETER;
+}
+
+consumption_error_t consumption_sync_cancel(consumption_sync_handle_t handle) {
+    (void)handle;
+    return CONSUMPTION_ERROR_INVALID_PARAMETER;
+}
+
+void consumption_events_deinit(void) {
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,461 @@
+/**
+ * @file consumption_fleet.c
+ * @brief Structure-of-arrays fleet counters implementation
+ *
+ * Machines are rows. Every scalar hot field is an array indexed by row,
+ * `stride` rows long (max_machines rounded up to 32; padding rows are
+ * never due). Product counters are a row of products - 1 counters per
+ * machine in each of two planes; a per-row plane number says which one is
+ * open, the other holds the last closed period. Members (ID and a
+ * profile reference, 16 bytes) and the ID table are cold and only read
+ * by add, find and collect; settings live once per profile. A machine's
+ * phase lives in its deadline, which advances by whole intervals.
+ *
+ * Close runs in two passes. The first compares deadlines four rows at a
+ * time (GCC vector extensions, SSE2 or NEON), rolls due rows over with
+ * masked blends, flips their plane and records a bit per row. The second
+ * clears the newly open counter row of each due machine, skipping words
+ * of 32 rows with nothing due; nothing is copied.
+ */
+
+#include "consumption_fleet.h"
+#include "consumption_profile.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define FLEET_EMPTY 0u              /* Table slot: unused */
+#define FLEET_WORD 32               /* Rows per mask word */
+
+#if defined(__GNUC__)
+#define FLEET_VECTOR 1
+typedef uint32_t u32x4 __attribute__((vector_size(16)));
+#endif
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t machine_id;
+    consumption_profile_t* profile;
+} fleet_member_t;
+
+struct consumption_fleet_t {
+    consumption_fleet_config_t config;
+    uint32_t count;
+    uint32_t stride;                /* Rows, multiple of FLEET_WORD */
+    uint32_t columns;               /* Counters per row: products - 1 */
+
+    /* Hot, per row */
+    uint32_t* due_at;               /* Next boundary on the phase; UINT32_MAX for padding */
+    uint32_t* interval;
+    uint32_t* period_start;
+    uint32_t* period_events;
+    uint32_t* total_events;
+    uint32_t* closed_start;
+    uint32_t* closed_end;           /* 0 = nothing closed yet */
+    uint32_t* closed_events;
+    uint32_t* plane;                /* Open plane, 0 or 1 */
+    uint32_t* closed_words;         /* Last close: bit per row */
+    uint32_t* counts;               /* 2 planes * stride * columns */
+
+    /* Cold */
+    fleet_member_t* members;
+    consumption_profiles_t* profiles;   /* Interned by consumption_fleet_add() */
+    uint32_t* table;                /* ID hash -> row + 1 */
+    uint32_t table_mask;
+
+    uint32_t last_closed;
+    uint64_t periods_closed;
+    uint64_t hot_bytes;
+    uint64_t cold_bytes;
+};
+
+/* ============================================================================
+ * INTERNAL FUNCTIONS
+ * ============================================================================ */
+
+static uint32_t table_home(const consumption_fleet_t* fleet, uint32_t id) {
+    return (id * 2654435761u) & fleet->table_mask;
+}
+
+/**
+ * @brief Table slot holding an ID, or the empty slot it would take
+ */
+static uint32_t* find_entry(const consumption_fleet_t* fleet, uint32_t id) {
+    uint32_t h = table_home(fleet, id);
+    while (fleet->table[h] != FLEET_EMPTY &&
+           fleet->members[fleet->table[h] - 1].machine_id != id) {
+        h = (h + 1) & fleet->table_mask;
+    }
+    return &fleet->table[h];
+}
+
+static bool valid_index(const consumption_fleet_t* fleet, int32_t index) {
+    return fleet && index >= 0 && (uint32_t)index < fleet->count;
+}
+
+/**
+ * @brief Counter row of a machine in a plane
+ */
+static uint32_t* counter_row(const consumption_fleet_t* fleet, uint32_t row, uint32_t plane) {
+    return &fleet->counts[((size_t)plane * fleet->stride + row) * fleet->columns];
+}
+
+/**
+ * @brief Roll rows [i, i + 4) over if due
+ * @return Bits of the rows closed
+ */
+static uint32_t close_rows(consumption_fleet_t* fleet, uint32_t i, uint32_t now) {
+#ifdef FLEET_VECTOR
+    u32x4 due_at, m;
+    memcpy(&due_at, &fleet->due_at[i], sizeof(due_at));
+    m = (u32x4)(due_at <= now);
+    if ((m[0] | m[1] | m[2] | m[3]) == 0) {
+        return 0;
+    }
+
+    u32x4 interval, start, events, total, c_start, c_end, c_events, plane;
+    memcpy(&interval, &fleet->interval[i], sizeof(interval));
+    memcpy(&start, &fleet->period_start[i], sizeof(start));
+    memcpy(&events, &fleet->period_events[i], sizeof(events));
+    memcpy(&total, &fleet->total_events[i], sizeof(total));
+    memcpy(&c_start, &fleet->closed_start[i], sizeof(c_start));
+    memcpy(&c_end, &fleet->closed_end[i], sizeof(c_end));
+    memcpy(&c_events, &fleet->closed_events[i], sizeof(c_events));
+    memcpy(&plane, &fleet->plane[i], sizeof(plane));
+
+    const u32x4 now4 = {now, now, now, now};
+    c_start = (start & m) | (c_start & ~m);
+    c_end = (now4 & m) | (c_end & ~m);
+    c_events = (events & m) | (c_events & ~m);
+    total += events & m;
+    events &= ~m;
+    start = (now4 & m) | (start & ~m);
+    /* Next boundary after now; rows not due divide by all ones, never 0 */
+    u32x4 next = now4 + interval - (now4 - due_at) % (interval | ~m);
+    due_at = (next & m) | (due_at & ~m);
+    plane ^= m & 1;
+
+    memcpy(&fleet->due_at[i], &due_at, sizeof(due_at));
+    memcpy(&fleet->period_start[i], &start, sizeof(start));
+    memcpy(&fleet->period_events[i], &events, sizeof(events));
+    memcpy(&fleet->total_events[i], &total, sizeof(total));
+    memcpy(&fleet->closed_start[i], &c_start, sizeof(c_start));
+    memcpy(&fleet->closed_end[i], &c_end, sizeof(c_end));
+    memcpy(&fleet->closed_events[i], &c_events, sizeof(c_events));
+    memcpy(&fleet->plane[i], &plane, sizeof(plane));
+    return (m[0] & 1) | (m[1] & 2) | (m[2] & 4) | (m[3] & 8);
+#else
+    uint32_t bits = 0;
+    for (uint32_t j = 0; j < 4; j++) {
+        uint32_t r = i + j;
+        if (fleet->due_at[r] > now) {
+            continue;
+        }
+        fleet->closed_start[r] = fleet->period_start[r];
+        fleet->closed_end[r] = now;
+        fleet->closed_events[r] = fleet->period_events[r];
+        fleet->total_events[r] += fleet->period_events[r];
+        fleet->period_events[r] = 0;
+        fleet->period_start[r] = now;
+        /* A late close skips to the next boundary rather than shifting them */
+        fleet->due_at[r] = now + fleet->interval[r] - (now - fleet->due_at[r]) % fleet->interval[r];
+        fleet->plane[r] ^= 1;
+        bits |= 1u << j;
+    }
+    return bits;
+#endif
+}
+
+/**
+ * @brief Whether rows [first, first + FLEET_WORD) are all open in one plane
+ */
+static bool word_in_one_plane(const consumption_fleet_t* fleet, uint32_t first) {
+    for (uint32_t j = 1; j < FLEET_WORD; j++) {
+        if (fleet->plane[first + j] != fleet->plane[first]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void fill_aggregate(const consumption_fleet_t* fleet, uint32_t row, uint32_t plane,
+                           consumption_aggregate_t* aggregate) {
+    memset(aggregate, 0, sizeof(*aggregate));
+    aggregate->machine_id = fleet->members[row].machine_id;
+    memcpy(&aggregate->product_counts[1], counter_row(fleet, row, plane),
+           fleet->columns * sizeof(uint32_t));
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+void consumption_fleet_config_default(consumption_fleet_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    config->max_machines = 1024;
+    config->products = 256;
+    config->max_profiles = 16;
+}
+
+consumption_fleet_t* consumption_fleet_create(const consumption_fleet_config_t* config) {
+    consumption_fleet_config_t defaults;
+    if (!config) {
+        consumption_fleet_config_default(&defaults);
+        config = &defaults;
+    }
+    if (config->max_machines == 0 || config->max_machines > (1u << 24) ||
+        config->products < 2 || config->products > 256 || config->max_profiles == 0) {
+        return NULL;
+    }
+
+    consumption_fleet_t* fleet = (consumption_fleet_t*)calloc(1, sizeof(consumption_fleet_t));
+    if (!fleet) {
+        return NULL;
+    }
+    fleet->config = *config;
+    fleet->stride = (config->max_machines + FLEET_WORD - 1) / FLEET_WORD * FLEET_WORD;
+    fleet->columns = config->products - 1;
+
+    uint32_t table_size = 4;
+    while (table_size < config->max_machines * 2) {
+        table_size *= 2;
+    }
+    fleet->table_mask = table_size - 1;
+
+    const size_t rows = fleet->stride;
+    uint32_t** fields[] = {
+        &fleet->due_at, &fleet->interval, &fleet->period_start, &fleet->period_events,
+        &fleet->total_events, &fleet->closed_start, &fleet->closed_end, &fleet->closed_events,
+        &fleet->plane
+    };
+    const size_t field_count = sizeof(fields) / sizeof(fields[0]);
+    bool ok = true;
+    for (size_t f = 0; f < field_count; f++) {
+        *fields[f] = (uint32_t*)calloc(rows, sizeof(uint32_t));
+        ok = ok && *fields[f];
+    }
+    fleet->closed_words = (uint32_t*)calloc(rows / FLEET_WORD, sizeof(uint32_t));
+    fleet->counts = (uint32_t*)calloc(2 * rows * fleet->columns, sizeof(uint32_t));
+    fleet->members = (fleet_member_t*)calloc(config->max_machines, sizeof(fleet_member_t));
+    fleet->table = (uint32_t*)calloc(table_size, sizeof(uint32_t));
+    fleet->profiles = consumption_profiles_create(config->max_profiles);
+    if (!ok || !fleet->closed_words || !fleet->counts || !fleet->members || !fleet->table ||
+        !fleet->profiles) {
+        consumption_fleet_destroy(fleet);
+        return NULL;
+    }
+
+    for (size_t r = 0; r < rows; r++) {
+        fleet->due_at[r] = UINT32_MAX;
+    }
+    fleet->hot_bytes = sizeof(*fleet) +
+        (rows * field_count + rows / FLEET_WORD + 2 * rows * fleet->columns) * sizeof(uint32_t);
+    fleet->cold_bytes = (uint64_t)config->max_machines * sizeof(fleet_member_t) +
+                        (uint64_t)table_size * sizeof(uint32_t);
+    return fleet;
+}
+
+int32_t consumption_fleet_add(consumption_fleet_t* fleet, const consumption_config_t* config,
+                              uint32_t now) {
+    if (!fleet || !config || config->aggregation_interval == 0) {
+        return -1;
+    }
+    consumption_profile_t* profile = consumption_profile_intern(fleet->profiles, config, NULL);
+    int32_t row = consumption_fleet_add_member(fleet, config->machine_id, profile,
+                                               now % config->aggregation_interval, now);
+    consumption_profile_release(profile);
+    return row;
+}
+
+int32_t consumption_fleet_add_member(consumption_fleet_t* fleet, uint32_t machine_id,
+                                     consumption_profile_t* profile, uint32_t phase, uint32_t now) {
+    if (!fleet || !profile || fleet->count >= fleet->config.max_machines) {
+        return -1;
+    }
+    uint32_t interval = consumption_profile_config(profile)->aggregation_interval;
+    uint32_t* entry = find_entry(fleet, machine_id);
+    if (interval == 0 || *entry != FLEET_EMPTY) {
+        return -1;
+    }
+
+    uint32_t row = fleet->count++;
+    fleet->members[row].machine_id = machine_id;
+    fleet->members[row].profile = consumption_profile_retain(profile);
+    *entry = row + 1;
+    fleet->interval[row] = interval;
+    fleet->period_start[row] = now;
+    fleet->due_at[row] = now + interval - (now - phase) % interval;
+    return (int32_t)row;
+}
+
+int32_t consumption_fleet_find(const consumption_fleet_t* fleet, uint32_t machine_id) {
+    if (!fleet) {
+        return -1;
+    }
+    uint32_t entry = *find_entry(fleet, machine_id);
+    return entry == FLEET_EMPTY ? -1 : (int32_t)(entry - 1);
+}
+
+consumption_error_t consumption_fleet_get_config(const consumption_fleet_t* fleet, int32_t index,
+                                                 consumption_config_t* config) {
+    if (!valid_index(fleet, index) || !config) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    *config = *consumption_profile_config(fleet->members[index].profile);
+    config->machine_id = fleet->members[index].machine_id;
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_profile_t* consumption_fleet_get_profile(const consumption_fleet_t* fleet, int32_t index) {
+    return valid_index(fleet, index) ? fleet->members[index].profile : NULL;
+}
+
+consumption_error_t consumption_fleet_update_profile(consumption_fleet_t* fleet, consumption_profile_t* profile,
+                                                     const consumption_config_t* config,
+                                                     const consumption_network_config_t* network) {
+    if (!fleet || !profile || !config || config->aggregation_interval == 0) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    consumption_error_t result = consumption_profile_update(profile, config, network);
+    if (result != CONSUMPTION_SUCCESS) {
+        return result;
+    }
+    for (uint32_t row = 0; row < fleet->count; row++) {
+        if (fleet->members[row].profile == profile) {
+            fleet->interval[row] = config->aggregation_interval;
+        }
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_fleet_dispense(consumption_fleet_t* fleet, int32_t index,
+                                               uint8_t product_id, uint16_t quantity) {
+    if (!valid_index(fleet, index) || product_id == 0 || quantity == 0) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    fleet->period_events[index] += quantity;
+    if (product_id < fleet->config.products) {
+        counter_row(fleet, (uint32_t)index, fleet->plane[index])[product_id - 1] += quantity;
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+uint32_t consumption_fleet_close(consumption_fleet_t* fleet, uint32_t now) {
+    if (!fleet) {
+        return 0;
+    }
+
+    /* Pass 1: deadlines, scalar fields, plane flips */
+    const uint32_t words = (fleet->count + FLEET_WORD - 1) / FLEET_WORD;
+    uint32_t closed = 0;
+    for (uint32_t w = 0; w < words; w++) {
+        uint32_t bits = 0;
+        for (uint32_t j = 0; j < FLEET_WORD; j += 4) {
+            bits |= close_rows(fleet, w * FLEET_WORD + j, now) << j;
+        }
+        fleet->closed_words[w] = bits;
+        closed += (uint32_t)__builtin_popcount(bits);
+    }
+
+    /* Pass 2: clear the counter rows that just opened */
+    const size_t row_bytes = fleet->columns * sizeof(uint32_t);
+    for (uint32_t w = 0; w < words && closed > 0; w++) {
+        uint32_t bits = fleet->closed_words[w];
+        uint32_t first = w * FLEET_WORD;
+        if (bits == ~0u && word_in_one_plane(fleet, first)) {
+            memset(counter_row(fleet, first, fleet->plane[first]), 0, row_bytes * FLEET_WORD);
+            continue;
+        }
+        for (; bits; bits &= bits - 1) {
+            uint32_t row = first + (uint32_t)__builtin_ctz(bits);
+            memset(counter_row(fleet, row, fleet->plane[row]), 0, row_bytes);
+        }
+    }
+
+    fleet->last_closed = closed;
+    fleet->periods_closed += closed;
+    return closed;
+}
+
+uint32_t consumption_fleet_collect(const consumption_fleet_t* fleet,
+                                   consumption_fleet_aggregate_cb_t on_aggregate, void* user) {
+    if (!fleet || !on_aggregate) {
+        return 0;
+    }
+
+    consumption_aggregate_t aggregate;
+    uint32_t reported = 0;
+    const uint32_t words = (fleet->count + FLEET_WORD - 1) / FLEET_WORD;
+    for (uint32_t w = 0; w < words; w++) {
+        for (uint32_t bits = fleet->closed_words[w]; bits; bits &= bits - 1) {
+            uint32_t row = w * FLEET_WORD + (uint32_t)__builtin_ctz(bits);
+            fill_aggregate(fleet, row, fleet->plane[row] ^ 1, &aggregate);
+            aggregate.period_start = fleet->closed_start[row];
+            aggregate.period_end = fleet->closed_end[row];
+            aggregate.total_events = fleet->closed_events[row];
+            on_aggregate(&aggregate, user);
+            reported++;
+        }
+    }
+    return reported;
+}
+
+consumption_error_t consumption_fleet_get_open(const consumption_fleet_t* fleet, int32_t index,
+                                               consumption_aggregate_t* aggregate) {
+    if (!valid_index(fleet, index) || !aggregate) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    fill_aggregate(fleet, (uint32_t)index, fleet->plane[index], aggregate);
+    aggregate->period_start = fleet->period_start[index];
+    aggregate->total_events = fleet->period_events[index];
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_fleet_get_closed(const consumption_fleet_t* fleet, int32_t index,
+                                                 consumption_aggregate_t* aggregate) {
+    if (!valid_index(fleet, index) || !aggregate || fleet->closed_end[index] == 0) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    fill_aggregate(fleet, (uint32_t)index, fleet->plane[index] ^ 1, aggregate);
+    aggregate->period_start = fleet->closed_start[index];
+    aggregate->period_end = fleet->closed_end[index];
+    aggregate->total_events = fleet->closed_events[index];
+    return CONSUMPTION_SUCCESS;
+}
+
+void consumption_fleet_get_stats(const consumption_fleet_t* fleet, consumption_fleet_stats_t* stats) {
+    if (!fleet || !stats) return;
+    memset(stats, 0, sizeof(*stats));
+    stats->machines = fleet->count;
+    stats->last_closed = fleet->last_closed;
+    stats->periods_closed = fleet->periods_closed;
+    stats->hot_bytes = fleet->hot_bytes;
+    consumption_profiles_stats_t profile_stats;
+    consumption_profiles_get_stats(fleet->profiles, &profile_stats);
+    stats->cold_bytes = fleet->cold_bytes + profile_stats.bytes;
+}
+
+void consumption_fleet_destroy(consumption_fleet_t* fleet) {
+    if (!fleet) return;
+    for (uint32_t row = 0; fleet->members && row < fleet->count; row++) {
+        consumption_profile_release(fleet->members[row].profile);
+    }
+    consumption_profiles_destroy(fleet->profiles);
+    free(fleet->due_at);
+    free(fleet->interval);
+    free(fleet->period_start);
+    free(fleet->period_events);
+    free(fleet->total_events);
+    free(fleet->closed_start);
+    free(fleet->closed_end);
+    free(fleet->closed_events);
+    free(fleet->plane);
+    free(fleet->closed_words);
+    free(fleet->counts);
+    free(fleet->members);
+    free(fleet->table);
+    free(fleet);
+}
@@ -0,0 +1,766 @@
+/**
+ * @file consumption_http.c
+ * @brief Local HTTP query endpoint implementation (Linux, epoll)
+ *
+ * Every response, headers included, is rendered by consumption_http_refresh()
+ * into an immutable reference-counted block. Requests only pick the block for
+ * their route and write it out, so serving costs one send() per request and
+ * a response that is still being written keeps its snapshot after a refresh.
+ */
+
+#define _GNU_SOURCE
+#include "consumption_http.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#define HTTP_REQUEST_BUFFER_SIZE 1024   /* Per connection; longer requests get 400 */
+#define HTTP_BODY_BUFFER_SIZE 8192      /* Largest rendered body (all 255 products) */
+#define HTTP_MAX_EVENTS 64
+#define HTTP_RATE_HISTORY 128           /* Counter samples kept for rates */
+#define HTTP_RATE_STEP 10               /* Seconds between counter samples */
+#define HTTP_SWEEP_INTERVAL_MS 1000     /* Idle connection check */
+#define HTTP_BIN_MAGIC 0x534E5343u      /* "CSNS" */
+#define HTTP_BIN_VERSION 1
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef enum {
+    ROUTE_STATS = 0,
+    ROUTE_PRODUCTS,
+    ROUTE_SNAPSHOT,
+    ROUTE_SNAPSHOT_BIN,
+    ROUTE_NOT_FOUND,
+    ROUTE_BAD_METHOD,
+    ROUTE_BAD_REQUEST,
+    ROUTE_COUNT
+} http_route_t;
+
+/**
+ * @brief Immutable, fully rendered response shared by connections
+ */
+typedef struct {
+    uint32_t refs;
+    size_t len;
+    char data[];
+} http_response_t;
+
+typedef struct {
+    int fd;                                 /* -1 when the slot is free */
+    uint64_t last_active_ms;
+    size_t request_len;
+    http_response_t* response;              /* Being written, or NULL */
+    size_t response_off;
+    bool close_after;
+    bool want_write;                        /* EPOLLOUT registered */
+    char request[HTTP_REQUEST_BUFFER_SIZE];
+} http_conn_t;
+
+typedef struct {
+    uint32_t timestamp;
+    uint32_t total_events;
+} http_rate_sample_t;
+
+struct consumption_http_server_t {
+    consumption_http_config_t config;
+    int listen_fd;
+    int epoll_fd;
+    uint16_t port;
+    http_conn_t* conns;
+    uint64_t last_sweep_ms;
+    consumption_http_stats_t stats;
+
+    /* [route][0] keep-alive, [route][1] with "Connection: close" */
+    http_response_t* responses[ROUTE_COUNT][2];
+
+    http_rate_sample_t rate_history[HTTP_RATE_HISTORY];
+    uint32_t rate_head;
+    uint32_t rate_count;
+
+    consumption_snapshot_t snapshot;
+    char body[HTTP_BODY_BUFFER_SIZE];
+};
+
+/* ============================================================================
+ * HELPERS
+ * ============================================================================ */
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/**
+ * @brief Append formatted text to a bounded buffer
+ * @return false (buffer unchanged) if the text does not fit
+ */
+static bool body_append(char* buffer, size_t limit, size_t* len, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(buffer + *len, limit - *len, fmt, args);
+    va_end(args);
+
+    if (written < 0 || (size_t)written >= limit - *len) {
+        buffer[*len] = '\0';
+        return false;
+    }
+
+    *len += (size_t)written;
+    return true;
+}
+
+static void response_release(http_response_t* response) {
+    if (response && --response->refs == 0) {
+        free(response);
+    }
+}
+
+/**
+ * @brief Build a complete HTTP response around a body
+ */
+static http_response_t* response_build(int status, const char* reason,
+                                       const char* content_type,
+                                       const void* body, size_t body_len,
+                                       bool close) {
+    char head[256];
+    int head_len = snprintf(head, sizeof(head),
+        "HTTP/1.1 %d %s\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "Cache-Control: no-cache\r\n"
+        "%s"
+        "\r\n",
+        status, reason, content_type, body_len,
+        close ? "Connection: close\r\n" : "");
+    if (head_len < 0 || (size_t)head_len >= sizeof(head)) {
+        return NULL;
+    }
+
+    http_response_t* response = (http_response_t*)malloc(
+        sizeof(http_response_t) + (size_t)head_len + body_len);
+    if (!response) {
+        return NULL;
+    }
+
+    response->refs = 1;
+    response->len = (size_t)head_len + body_len;
+    memcpy(response->data, head, (size_t)head_len);
+    memcpy(response->data + head_len, body, body_len);
+    return response;
+}
+
+/**
+ * @brief Replace both variants of a route's response
+ */
+static bool route_set(consumption_http_server_t* server, http_route_t route,
+                      int status, const char* reason, const char* content_type,
+                      const void* body, size_t body_len) {
+    http_response_t* keep = response_build(status, reason, content_type, body, body_len, false);
+    http_response_t* close = response_build(status, reason, content_type, body, body_len, true);
+    if (!keep || !close) {
+        free(keep);
+        free(close);
+        return false;
+    }
+
+    response_release(server->responses[route][0]);
+    response_release(server->responses[route][1]);
+    server->responses[route][0] = keep;
+    server->responses[route][1] = close;
+    return true;
+}
+
+/* ============================================================================
+ * SNAPSHOT RENDERING
+ * ============================================================================ */
+
+/**
+ * @brief Units per minute over the last window_s seconds
+ */
+static double window_rate(const consumption_http_server_t* server, uint32_t window_s) {
+    const consumption_snapshot_t* snap = &server->snapshot;
+    const http_rate_sample_t* oldest = NULL;
+
+    /* Walk back from the newest sample to the oldest still inside the window */
+    for (uint32_t i = 0; i < server->rate_count; i++) {
+        uint32_t index = (server->rate_head + HTTP_RATE_HISTORY - 1 - i) % HTTP_RATE_HISTORY;
+        const http_rate_sample_t* sample = &server->rate_history[index];
+        if (snap->timestamp - sample->timestamp > window_s) {
+            break;
+        }
+        oldest = sample;
+    }
+
+    if (!oldest || oldest->timestamp == snap->timestamp) {
+        return 0.0;
+    }
+
+    return (double)(snap->total_events - oldest->total_events) * 60.0 /
+           (double)(snap->timestamp - oldest->timestamp);
+}
+
+static void rate_record(consumption_http_server_t* server) {
+    const consumption_snapshot_t* snap = &server->snapshot;
+
+    if (server->rate_count > 0) {
+        uint32_t newest = (server->rate_head + HTTP_RATE_HISTORY - 1) % HTTP_RATE_HISTORY;
+        if (snap->timestamp - server->rate_history[newest].timestamp < HTTP_RATE_STEP) {
+            return;
+        }
+    }
+
+    server->rate_history[server->rate_head].timestamp = snap->timestamp;
+    server->rate_history[server->rate_head].total_events = snap->total_events;
+    server->rate_head = (server->rate_head + 1) % HTTP_RATE_HISTORY;
+    if (server->rate_count < HTTP_RATE_HISTORY) {
+        server->rate_count++;
+    }
+}
+
+static void render_stats(const consumption_http_server_t* server, char* body,
+                         size_t limit, size_t* len) {
+    const consumption_snapshot_t* snap = &server->snapshot;
+    body_append(body, limit, len,
+        "\"machine_id\":%u,\"timestamp\":%u,\"total_events\":%u,"
+        "\"period_start\":%u,\"period_events\":%u,\"buffered_events\":%u,"
+        "\"last_sync\":%u,\"sync_failures\":%u,"
+        "\"rates_per_minute\":{\"1m\":%.2f,\"5m\":%.2f,\"15m\":%.2f}",
+        snap->machine_id, snap->timestamp, snap->total_events,
+        snap->period_start, snap->period_events, snap->buffered_events,
+        snap->last_sync, snap->sync_failures,
+        window_rate(server, 60), window_rate(server, 300), window_rate(server, 900));
+}
+
+static void render_products(const consumption_http_server_t* server, char* body,
+                            size_t limit, size_t* len) {
+    bool first = true;
+    for (int i = 1; i < 256; i++) {
+        if (server->snapshot.product_counts[i] > 0) {
+            body_append(body, limit, len, first ? "\"%d\":%u" : ",\"%d\":%u",
+                        i, server->snapshot.product_counts[i]);
+            first = false;
+        }
+    }
+}
+
+static size_t render_binary(const consumption_http_server_t* server, char* body) {
+    const consumption_snapshot_t* snap = &server->snapshot;
+    consumption_http_bin_header_t header = {
+        .magic = HTTP_BIN_MAGIC,
+        .version = HTTP_BIN_VERSION,
+        .machine_id = snap->machine_id,
+        .timestamp = snap->timestamp,
+        .total_events = snap->total_events,
+        .period_start = snap->period_start,
+        .period_events = snap->period_events,
+        .buffered_events = snap->buffered_events,
+        .last_sync = snap->last_sync,
+        .sync_failures = snap->sync_failures,
+        .rate_1m = (uint32_t)(window_rate(server, 60) * 100.0),
+        .rate_5m = (uint32_t)(window_rate(server, 300) * 100.0),
+        .rate_15m = (uint32_t)(window_rate(server, 900) * 100.0),
+    };
+
+    size_t len = sizeof(header);
+    for (int i = 1; i < 256; i++) {
+        uint32_t count = snap->product_counts[i];
+        if (count > 0) {
+            body[len] = (char)i;
+            memcpy(body + len + 1, &count, sizeof(count));
+            len += 1 + sizeof(count);
+            header.product_entries++;
+        }
+    }
+
+    memcpy(body, &header, sizeof(header));
+    return len;
+}
+
+/* ============================================================================
+ * CONNECTIONS
+ * ============================================================================ */
+
+static void conn_close(consumption_http_server_t* server, http_conn_t* conn) {
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    response_release(conn->response);
+    conn->response = NULL;
+    conn->fd = -1;
+    server->stats.connections--;
+}
+
+static void conn_watch_write(consumption_http_server_t* server, http_conn_t* conn, bool enable) {
+    if (conn->want_write == enable) {
+        return;
+    }
+    /* Stop reading while a response is blocked, the client is not keeping up */
+    struct epoll_event ev = {
+        .events = enable ? EPOLLOUT : EPOLLIN,
+        .data.ptr = conn,
+    };
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->want_write = enable;
+}
+
+static void accept_connections(consumption_http_server_t* server) {
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return; /* EAGAIN: backlog drained */
+        }
+
+        http_conn_t* conn = NULL;
+        for (uint32_t i = 0; i < server->config.max_connections; i++) {
+            if (server->conns[i].fd < 0) {
+                conn = &server->conns[i];
+                break;
+            }
+        }
+        if (!conn) {
+            server->stats.rejected++;
+            close(fd);
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        conn->fd = fd;
+        conn->last_active_ms = monotonic_ms();
+        conn->request_len = 0;
+        conn->response = NULL;
+        conn->response_off = 0;
+        conn->close_after = false;
+        conn->want_write = false;
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = conn };
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            conn->fd = -1;
+            continue;
+        }
+        server->stats.connections++;
+    }
+}
+
+/**
+ * @brief Route one complete request
+ */
+static http_route_t parse_request(const char* request, size_t head_len, bool* close) {
+    const char* end = request + head_len;
+    const char* method_end = memchr(request, ' ', head_len);
+    if (!method_end) {
+        return ROUTE_BAD_REQUEST;
+    }
+    const char* path = method_end + 1;
+    const char* path_end = path;
+    while (path_end < end && *path_end != ' ' && *path_end != '?' && *path_end != '\r') {
+        path_end++;
+    }
+    const char* version = memchr(path_end, ' ', (size_t)(end - path_end));
+    if (!version) {
+        return ROUTE_BAD_REQUEST;
+    }
+    version++;
+
+    /* HTTP/1.1 keeps the connection open unless asked otherwise */
+    *close = (strncmp(version, "HTTP/1.1", 8) != 0);
+    const char* header = memmem(request, head_len, "\r\nConnection:", 13);
+    if (!header) header = memmem(request, head_len, "\r\nconnection:", 13);
+    if (header) {
+        const char* value = header + 13;
+        while (*value == ' ') value++;
+        if (strncasecmp(value, "close", 5) == 0) *close = true;
+        else if (strncasecmp(value, "keep-alive", 10) == 0) *close = false;
+    }
+
+    size_t method_len = (size_t)(method_end - request);
+    if (method_len != 3 || memcmp(request, "GET", 3) != 0) {
+        return ROUTE_BAD_METHOD;
+    }
+
+    size_t path_len = (size_t)(path_end - path);
+    static const struct { const char* path; http_route_t route; } routes[] = {
+        {"/stats", ROUTE_STATS},
+        {"/products", ROUTE_PRODUCTS},
+        {"/snapshot", ROUTE_SNAPSHOT},
+        {"/snapshot.bin", ROUTE_SNAPSHOT_BIN},
+    };
+    for (size_t i = 0; i < sizeof(routes) / sizeof(routes[0]); i++) {
+        if (strlen(routes[i].path) == path_len && memcmp(routes[i].path, path, path_len) == 0) {
+            return routes[i].route;
+        }
+    }
+    return ROUTE_NOT_FOUND;
+}
+
+/**
+ * @brief Write the pending response
+ * @return false if the connection was closed
+ */
+static bool conn_flush(consumption_http_server_t* server, http_conn_t* conn) {
+    while (conn->response) {
+        ssize_t n = send(conn->fd, conn->response->data + conn->response_off,
+                         conn->response->len - conn->response_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                conn_watch_write(server, conn, true);
+                return true;
+            }
+            conn_close(server, conn);
+            return false;
+        }
+
+        conn->response_off += (size_t)n;
+        if (conn->response_off == conn->response->len) {
+            response_release(conn->response);
+            conn->response = NULL;
+            conn->response_off = 0;
+            conn_watch_write(server, conn, false);
+            if (conn->close_after) {
+                conn_close(server, conn);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Answer buffered requests in order (pipelining)
+ * @return Number of requests answered
+ */
+static int conn_process(consumption_http_server_t* server, http_conn_t* conn) {
+    int answered = 0;
+
+    while (!conn->response && conn->fd >= 0) {
+        const char* head_end = memmem(conn->request, conn->request_len, "\r\n\r\n", 4);
+        http_route_t route;
+        bool close = false;
+        size_t consumed;
+
+        if (head_end) {
+            consumed = (size_t)(head_end - conn->request) + 4;
+            route = parse_request(conn->request, consumed - 2, &close);
+        } else if (conn->request_len == sizeof(conn->request)) {
+            route = ROUTE_BAD_REQUEST;
+            consumed = conn->request_len;
+        } else {
+            break; /* Incomplete request */
+        }
+        if (route == ROUTE_BAD_REQUEST) {
+            close = true;
+        }
+
+        conn->response = server->responses[route][close ? 1 : 0];
+        conn->response->refs++;
+        conn->response_off = 0;
+        conn->close_after = close;
+
+        memmove(conn->request, conn->request + consumed, conn->request_len - consumed);
+        conn->request_len -= consumed;
+
+        answered++;
+        server->stats.requests++;
+
+        if (!conn_flush(server, conn)) {
+            break;
+        }
+    }
+
+    return answered;
+}
+
+static int conn_readable(consumption_http_server_t* server, http_conn_t* conn) {
+    while (conn->request_len < sizeof(conn->request)) {
+        ssize_t n = recv(conn->fd, conn->request + conn->request_len,
+                         sizeof(conn->request) - conn->request_len, 0);
+        if (n > 0) {
+            conn->request_len += (size_t)n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        conn_close(server, conn); /* Peer closed or error */
+        return 0;
+    }
+
+    conn->last_active_ms = monotonic_ms();
+    return conn_process(server, conn);
+}
+
+static void sweep_idle(consumption_http_server_t* server, uint64_t now_ms) {
+    for (uint32_t i = 0; i < server->config.max_connections; i++) {
+        http_conn_t* conn = &server->conns[i];
+        if (conn->fd >= 0 && now_ms - conn->last_active_ms > server->config.idle_timeout_ms) {
+            conn_close(server, conn);
+        }
+    }
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+void consumption_http_config_default(consumption_http_config_t* config) {
+    if (!config) return;
+
+    memset(config, 0, sizeof(consumption_http_config_t));
+    strncpy(config->bind_address, "127.0.0.1", sizeof(config->bind_address) - 1);
+    config->port = 8080;
+    config->max_connections = 64;
+    config->idle_timeout_ms = 30000;
+}
+
+consumption_error_t consumption_http_refresh(consumption_http_server_t* server) {
+    if (!server) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    consumption_error_t result = consumption_get_snapshot(&server->snapshot);
+    if (result != CONSUMPTION_SUCCESS) {
+        return result;
+    }
+    rate_record(server);
+    server->stats.snapshot_time = server->snapshot.timestamp;
+
+    char* body = server->body;
+    const size_t limit = sizeof(server->body);
+    size_t len = 0;
+    bool ok = true;
+
+    body_append(body, limit, &len, "{");
+    render_stats(server, body, limit, &len);
+    body_append(body, limit, &len, "}");
+    ok &= route_set(server, ROUTE_STATS, 200, "OK", "application/json", body, len);
+
+    len = 0;
+    body_append(body, limit, &len, "{");
+    render_products(server, body, limit, &len);
+    body_append(body, limit, &len, "}");
+    ok &= route_set(server, ROUTE_PRODUCTS, 200, "OK", "application/json", body, len);
+
+    len = 0;
+    body_append(body, limit, &len, "{");
+    render_stats(server, body, limit, &len);
+    body_append(body, limit, &len, ",\"products\":{");
+    render_products(server, body, limit, &len);
+    body_append(body, limit, &len, "}}");
+    ok &= route_set(server, ROUTE_SNAPSHOT, 200, "OK", "application/json", body, len);
+
+    len = render_binary(server, body);
+    ok &= route_set(server, ROUTE_SNAPSHOT_BIN, 200, "OK", "application/octet-stream", body, len);
+
+    return ok ? CONSUMPTION_SUCCESS : CONSUMPTION_ERROR_MEMORY_ERROR;
+}
+
+consumption_http_server_t* consumption_http_start(const consumption_http_config_t* config) {
+    if (!config || config->max_connections == 0) {
+        return NULL;
+    }
+
+    consumption_http_server_t* server =
+        (consumption_http_server_t*)calloc(1, sizeof(consumption_http_server_t));
+    if (!server) {
+        return NULL;
+    }
+    server->config = *config;
+    server->listen_fd = -1;
+    server->epoll_fd = -1;
+
+    server->conns = (http_conn_t*)calloc(config->max_connections, sizeof(http_conn_t));
+    if (!server->conns) {
+        goto fail;
+    }
+    for (uint32_t i = 0; i < config->max_connections; i++) {
+        server->conns[i].fd = -1;
+    }
+
+    static const char not_found[] = "{\"error\":\"not found\"}";
+    static const char bad_method[] = "{\"error\":\"method not allowed\"}";
+    static const char bad_request[] = "{\"error\":\"bad request\"}";
+    if (!route_set(server, ROUTE_NOT_FOUND, 404, "Not Found", "application/json",
+                   not_found, sizeof(not_found) - 1) ||
+        !route_set(server, ROUTE_BAD_METHOD, 405, "Method Not Allowed", "application/json",
+                   bad_method, sizeof(bad_method) - 1) ||
+        !route_set(server, ROUTE_BAD_REQUEST, 400, "Bad Request", "application/json",
+                   bad_request, sizeof(bad_request) - 1) ||
+        consumption_http_refresh(server) != CONSUMPTION_SUCCESS) {
+        goto fail;
+    }
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config->port);
+    if (inet_pton(AF_INET, config->bind_address, &addr.sin_addr) != 1) {
+        goto fail;
+    }
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listen_fd < 0) {
+        goto fail;
+    }
+    int one = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, SOMAXCONN) != 0) {
+        goto fail;
+    }
+
+    socklen_t addr_len = sizeof(addr);
+    getsockname(server->listen_fd, (struct sockaddr*)&addr, &addr_len);
+    server->port = ntohs(addr.sin_port);
+
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (server->epoll_fd < 0) {
+        goto fail;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &ev) != 0) {
+        goto fail;
+    }
+
+    server->last_sweep_ms = monotonic_ms();
+    return server;
+
+fail:
+    consumption_http_stop(server);
+    return NULL;
+}
+
+int consumption_http_poll(consumption_http_server_t* server, int timeout_ms) {
+    if (!server) {
+        return -1;
+    }
+
+    struct epoll_event events[HTTP_MAX_EVENTS];
+    int n = epoll_wait(server->epoll_fd, events, HTTP_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    int answered = 0;
+    for (int i = 0; i < n; i++) {
+        http_conn_t* conn = (http_conn_t*)events[i].data.ptr;
+        if (!conn) {
+            accept_connections(server);
+            continue;
+        }
+        if (conn->fd < 0) {
+            continue; /* Closed earlier in this batch */
+        }
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            conn_close(server, conn);
+            continue;
+        }
+        if ((events[i].events & EPOLLOUT) && !conn_flush(server, conn)) {
+            continue;
+        }
+        if (events[i].events & EPOLLIN) {
+            answered += conn_readable(server, conn);
+        } else if (!conn->response) {
+            answered += conn_process(server, conn); /* Pipelined requests waiting on a write */
+        }
+    }
+
+    uint64_t now_ms = monotonic_ms();
+    if (now_ms - server->last_sweep_ms >= HTTP_SWEEP_INTERVAL_MS) {
+        sweep_idle(server, now_ms);
+        server->last_sweep_ms = now_ms;
+    }
+
+    return answered;
+}
+
+int consumption_http_get_fd(const consumption_http_server_t* server) {
+    return server ? server->epoll_fd : -1;
+}
+
+uint16_t consumption_http_get_port(const consumption_http_server_t* server) {
+    return server ? server->port : 0;
+}
+
+void consumption_http_get_stats(const consumption_http_server_t* server,
+                              consumption_http_stats_t* stats) {
+    if (!server || !stats) return;
+    *stats = server->stats;
+}
+
+void consumption_http_stop(consumption_http_server_t* server) {
+    if (!server) return;
+
+    if (server->conns) {
+        for (uint32_t i = 0; i < server->config.max_connections; i++) {
+            if (server->conns[i].fd >= 0) {
+                conn_close(server, &server->conns[i]);
+            }
+        }
+        free(server->conns);
+    }
+    for (int r = 0; r < ROUTE_COUNT; r++) {
+        response_release(server->responses[r][0]);
+        response_release(server->responses[r][1]);
+    }
+    if (server->epoll_fd >= 0) close(server->epoll_fd);
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    free(server);
+}
+
+#else /* __linux__ not defined */
+
+void consumption_http_config_default(consumption_http_config_t* config) {
+    if (config) memset(config, 0, sizeof(consumption_http_config_t));
+}
+
+consumption_http_server_t* consumption_http_start(const consumption_http_config_t* config) {
+    (void)config;
+    return NULL;  /* epoll not available */
+}
+
+consumption_error_t consumption_http_refresh(consumption_http_server_t* server) {
+    (void)server;
+    return CONSUMPTION_ERROR_INVALID_PARAMETER;
+}
+
+int consumption_http_poll(consumption_http_server_t* server, int timeout_ms) {
+    (void)server; (void)timeout_ms;
+    return -1;
+}
+
+int consumption_http_get_fd(const consumption_http_server_t* server) {
+    (void)server;
+    return -1;
+}
+
+uint16_t consumption_http_get_port(const consumption_http_server_t* server) {
+    (void)server;
+    return 0;
+}
+
+void consumption_http_get_stats(const consumption_http_server_t* server,
+                              consumption_http_stats_t* stats) {
+    (void)server;
+    if (stats) memset(stats, 0, sizeof(consumption_http_stats_t));
+}
+
+void consumption_http_stop(consumption_http_server_t* server) {
+    (void)server;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,456 @@
+/**
+ * @file consumption_ingest.c
+ * @brief Aggregate payload parser implementation
+ *
+ * A recursive-descent parser over a cursor, specialized for the aggregate
+ * object: known keys are matched by length and bytes, product keys are
+ * parsed as numbers in place, and anything else is skipped without
+ * building values.
+ *
+ * Numbers: on little-endian GCC targets eight bytes are loaded at once,
+ * the run of leading digits is found from a per-byte digit test, the
+ * digits are shifted to the top (the zero bytes shifted in read as
+ * leading zeros) and combined with three multiplies (SWAR). Strings and
+ * skipped containers are scanned sixteen bytes at a time with GCC vector
+ * extensions (SSE2, NEON) for the next quote, backslash or bracket.
+ */
+
+#include "consumption_ingest.h"
+#include <string.h>
+
+#if defined(__GNUC__)
+#define INGEST_VECTOR 1
+typedef uint8_t u8x16 __attribute__((vector_size(16)));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define INGEST_SWAR 1
+#endif
+#endif
+
+#define INGEST_MAX_DEPTH 64         /* Nesting of skipped members */
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef struct {
+    const char* p;
+    const char* end;
+} cursor_t;
+
+typedef enum {
+    KEY_UNKNOWN = 0,
+    KEY_MACHINE_ID,
+    KEY_SEQ,
+    KEY_PERIOD_START,
+    KEY_PERIOD_END,
+    KEY_TOTAL_EVENTS,
+    KEY_PRODUCTS,
+    KEY_GATEWAY,
+    KEY_BATCH,
+    KEY_ENTRIES
+} ingest_key_t;
+
+#define HAVE_REQUIRED ((1u << KEY_MACHINE_ID) | (1u << KEY_PERIOD_START) | (1u << KEY_PERIOD_END))
+
+/* ============================================================================
+ * INTERNAL FUNCTIONS
+ * ============================================================================ */
+
+static inline void skip_ws(cursor_t* c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\n' || *c->p == '\r' || *c->p == '\t')) {
+        c->p++;
+    }
+}
+
+static inline bool expect(cursor_t* c, char ch) {
+    skip_ws(c);
+    if (c->p < c->end && *c->p == ch) {
+        c->p++;
+        return true;
+    }
+    return false;
+}
+
+#ifdef INGEST_VECTOR
+/**
+ * @brief Byte index of the first set lane of a comparison, 16 if none
+ */
+static inline unsigned first_lane(u8x16 hits) {
+    uint64_t lo, hi;
+    memcpy(&lo, &hits, sizeof(lo));
+    memcpy(&hi, (const char*)&hits + sizeof(lo), sizeof(hi));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (lo) return (unsigned)__builtin_ctzll(lo) / 8;
+    if (hi) return 8 + (unsigned)__builtin_ctzll(hi) / 8;
+    return 16;
+#else
+    for (unsigned i = 0; i < 16; i++) {
+        if (hits[i]) return i;
+    }
+    return 16;
+#endif
+}
+#endif
+
+/**
+ * @brief Advance to the next '"' or '\\'
+ * @return false at the end of input
+ */
+static inline bool find_quote(cursor_t* c) {
+#ifdef INGEST_VECTOR
+    const u8x16 quote = {'"','"','"','"','"','"','"','"','"','"','"','"','"','"','"','"'};
+    const u8x16 slash = {'\\','\\','\\','\\','\\','\\','\\','\\','\\','\\','\\','\\','\\','\\','\\','\\'};
+    while (c->end - c->p >= 16) {
+        u8x16 block;
+        memcpy(&block, c->p, sizeof(block));
+        unsigned i = first_lane((u8x16)((block == quote) | (block == slash)));
+        c->p += i;
+        if (i < 16) {
+            return true;
+        }
+    }
+#endif
+    while (c->p < c->end && *c->p != '"' && *c->p != '\\') {
+        c->p++;
+    }
+    return c->p < c->end;
+}
+
+/**
+ * @brief Skip the rest of a string after its opening quote
+ */
+static bool skip_string(cursor_t* c) {
+    while (find_quote(c)) {
+        if (*c->p == '"') {
+            c->p++;
+            return true;
+        }
+        c->p += 2;                  /* Escape and the escaped byte */
+        if (c->p > c->end) {
+            return false;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Advance to the next structural byte of a container: quote or bracket
+ */
+static inline bool find_structural(cursor_t* c) {
+#ifdef INGEST_VECTOR
+    const u8x16 quote = {'"','"','"','"','"','"','"','"','"','"','"','"','"','"','"','"'};
+    const u8x16 fold = {0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20};
+    const u8x16 open = {'{','{','{','{','{','{','{','{','{','{','{','{','{','{','{','{'};
+    const u8x16 close = {'}','}','}','}','}','}','}','}','}','}','}','}','}','}','}','}'};
+    while (c->end - c->p >= 16) {
+        u8x16 block;
+        memcpy(&block, c->p, sizeof(block));
+        /* '[' | 0x20 == '{' and ']' | 0x20 == '}' */
+        u8x16 folded = block | fold;
+        unsigned i = first_lane((u8x16)((block == quote) | (folded == open) | (folded == close)));
+        c->p += i;
+        if (i < 16) {
+            return true;
+        }
+    }
+#endif
+    while (c->p < c->end && *c->p != '"' && *c->p != '{' && *c->p != '}' &&
+           *c->p != '[' && *c->p != ']') {
+        c->p++;
+    }
+    return c->p < c->end;
+}
+
+/**
+ * @brief Skip any JSON value
+ */
+static bool skip_value(cursor_t* c) {
+    skip_ws(c);
+    if (c->p >= c->end) {
+        return false;
+    }
+    char first = *c->p;
+    if (first == '"') {
+        c->p++;
+        return skip_string(c);
+    }
+    if (first != '{' && first != '[') {
+        /* Number or literal: up to the next delimiter */
+        while (c->p < c->end && *c->p != ',' && *c->p != '}' && *c->p != ']' &&
+               *c->p != ' ' && *c->p != '\n' && *c->p != '\r' && *c->p != '\t') {
+            c->p++;
+        }
+        return true;
+    }
+
+    char stack[INGEST_MAX_DEPTH];
+    int depth = 0;
+    while (find_structural(c)) {
+        char ch = *c->p++;
+        if (ch == '"') {
+            if (!skip_string(c)) return false;
+        } else if (ch == '{' || ch == '[') {
+            if (depth == INGEST_MAX_DEPTH) return false;
+            stack[depth++] = (char)(ch + 2);    /* '{' + 2 == '}', '[' + 2 == ']' */
+        } else if (depth == 0 || stack[--depth] != ch) {
+            return false;
+        } else if (depth == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef INGEST_SWAR
+/**
+ * @brief Value of eight ASCII digits, first digit in the lowest byte
+ */
+static inline uint32_t eight_digits(uint64_t v) {
+    v = ((v & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+    v = ((v & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+    return (uint32_t)(((v & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32);
+}
+#endif
+
+/**
+ * @brief Parse an unsigned 32-bit integer
+ */
+static inline bool parse_u32(cursor_t* c, uint32_t* out) {
+    uint64_t value = 0;
+    const char* start = c->p;
+#ifdef INGEST_SWAR
+    if (c->end - c->p >= 8) {
+        uint64_t v;
+        memcpy(&v, c->p, sizeof(v));
+        uint64_t non_digit = ((v & 0xF0F0F0F0F0F0F0F0ull) ^ 0x3030303030303030ull) |
+                             (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) ^ 0x3030303030303030ull);
+        unsigned n = non_digit ? (unsigned)__builtin_ctzll(non_digit) / 8 : 8;
+        if (n == 0) {
+            return false;
+        }
+        value = eight_digits(n == 8 ? v : v << (8 * (8 - n)));
+        c->p += n;
+        if (n < 8) {
+            *out = (uint32_t)value;
+            return true;
+        }
+    }
+#endif
+    while (c->p < c->end && *c->p >= '0' && *c->p <= '9') {
+        value = value * 10 + (uint64_t)(*c->p++ - '0');
+        if (value > UINT32_MAX) {
+            return false;
+        }
+    }
+    if (c->p == start) {
+        return false;
+    }
+    *out = (uint32_t)value;
+    return true;
+}
+
+/**
+ * @brief Parse a member key after its opening quote, and the colon
+ */
+static bool parse_key(cursor_t* c, ingest_key_t* key) {
+    const char* start = c->p;
+    if (!find_quote(c)) {
+        return false;
+    }
+    if (*c->p == '\\') {
+        *key = KEY_UNKNOWN;         /* No known key is escaped */
+        if (!skip_string(c)) return false;
+        return expect(c, ':');
+    }
+    size_t len = (size_t)(c->p - start);
+    c->p++;
+
+    *key = KEY_UNKNOWN;
+    switch (len) {
+        case 3:  if (memcmp(start, "seq", 3) == 0) *key = KEY_SEQ; break;
+        case 5:  if (memcmp(start, "batch", 5) == 0) *key = KEY_BATCH; break;
+        case 7:
+            if (memcmp(start, "gateway", 7) == 0) *key = KEY_GATEWAY;
+            else if (memcmp(start, "entries", 7) == 0) *key = KEY_ENTRIES;
+            break;
+        case 8:  if (memcmp(start, "products", 8) == 0) *key = KEY_PRODUCTS; break;
+        case 10:
+            if (memcmp(start, "machine_id", 10) == 0) *key = KEY_MACHINE_ID;
+            else if (memcmp(start, "period_end", 10) == 0) *key = KEY_PERIOD_END;
+            break;
+        case 12:
+            if (memcmp(start, "period_start", 12) == 0) *key = KEY_PERIOD_START;
+            else if (memcmp(start, "total_events", 12) == 0) *key = KEY_TOTAL_EVENTS;
+            break;
+        default: break;
+    }
+    return expect(c, ':');
+}
+
+/**
+ * @brief Parse the products object: "id":count pairs
+ */
+static bool parse_products(cursor_t* c, consumption_sparse_aggregate_t* entry) {
+    uint32_t seen[8] = {0};
+    if (!expect(c, '{')) {
+        return false;
+    }
+    if (expect(c, '}')) {
+        return true;
+    }
+    do {
+        uint32_t id, count;
+        if (!expect(c, '"') || !parse_u32(c, &id) || c->p >= c->end || *c->p++ != '"' ||
+            !expect(c, ':')) {
+            return false;
+        }
+        skip_ws(c);
+        if (!parse_u32(c, &count) || id == 0 || id > 255 || (seen[id >> 5] & (1u << (id & 31))) ||
+            entry->count >= 255) {
+            return false;
+        }
+        seen[id >> 5] |= 1u << (id & 31);
+        entry->product_ids[entry->count] = (uint8_t)id;
+        entry->counts[entry->count++] = count;
+    } while (expect(c, ','));
+    return expect(c, '}');
+}
+
+/**
+ * @brief Parse one aggregate object
+ */
+static bool parse_entry(cursor_t* c, consumption_sparse_aggregate_t* entry) {
+    uint32_t have = 0;
+    entry->seq = 0;
+    entry->total_events = 0;
+    entry->count = 0;
+    if (!expect(c, '{')) {
+        return false;
+    }
+    if (!expect(c, '}')) {
+        do {
+            ingest_key_t key;
+            if (!expect(c, '"') || !parse_key(c, &key)) {
+                return false;
+            }
+            skip_ws(c);
+            if (key == KEY_PRODUCTS && (have & (1u << KEY_PRODUCTS))) {
+                return false;               /* Product IDs are only unique within one object */
+            }
+            bool ok;
+            switch (key) {
+                case KEY_MACHINE_ID:   ok = parse_u32(c, &entry->machine_id); break;
+                case KEY_SEQ:          ok = parse_u32(c, &entry->seq); break;
+                case KEY_PERIOD_START: ok = parse_u32(c, &entry->period_start); break;
+                case KEY_PERIOD_END:   ok = parse_u32(c, &entry->period_end); break;
+                case KEY_TOTAL_EVENTS: ok = parse_u32(c, &entry->total_events); break;
+                case KEY_PRODUCTS:     ok = parse_products(c, entry); break;
+                default:               ok = skip_value(c); break;
+            }
+            if (!ok) {
+                return false;
+            }
+            have |= 1u << key;
+        } while (expect(c, ','));
+        if (!expect(c, '}')) {
+            return false;
+        }
+    }
+    return (have & HAVE_REQUIRED) == HAVE_REQUIRED;
+}
+
+static bool at_end(cursor_t* c) {
+    skip_ws(c);
+    return c->p == c->end;
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+consumption_error_t consumption_ingest_parse_sparse(const char* json, size_t len,
+                                                    consumption_sparse_aggregate_t* entry) {
+    if (!json || !entry) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    cursor_t c = {json, json + len};
+    return (parse_entry(&c, entry) && at_end(&c)) ? CONSUMPTION_SUCCESS
+                                                  : CONSUMPTION_ERROR_INVALID_PARAMETER;
+}
+
+consumption_error_t consumption_ingest_parse(const char* json, size_t len,
+                                             consumption_aggregate_t* aggregate) {
+    if (!aggregate) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    consumption_sparse_aggregate_t entry;
+    consumption_error_t result = consumption_ingest_parse_sparse(json, len, &entry);
+    if (result != CONSUMPTION_SUCCESS) {
+        return result;
+    }
+    memset(aggregate, 0, sizeof(*aggregate));
+    aggregate->machine_id = entry.machine_id;
+    aggregate->period_start = entry.period_start;
+    aggregate->period_end = entry.period_end;
+    aggregate->total_events = entry.total_events;
+    for (uint32_t i = 0; i < entry.count; i++) {
+        aggregate->product_counts[entry.product_ids[i]] = entry.counts[i];
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_ingest_parse_batch(const char* json, size_t len,
+                                                   uint32_t* gateway_id, uint32_t* batch_id,
+                                                   consumption_ingest_entry_cb_t on_entry, void* user,
+                                                   uint32_t* entries) {
+    uint32_t reported = 0, gateway = 0, batch = 0;
+    bool have_entries = false;
+    if (entries) *entries = 0;
+    if (!json || !on_entry) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    consumption_sparse_aggregate_t entry;
+    cursor_t c = {json, json + len};
+    bool ok = expect(&c, '{');
+    while (ok) {
+        ingest_key_t key;
+        if (!expect(&c, '"') || !parse_key(&c, &key)) {
+            ok = false;
+            break;
+        }
+        skip_ws(&c);
+        if (key == KEY_GATEWAY) {
+            ok = parse_u32(&c, &gateway);
+        } else if (key == KEY_BATCH) {
+            ok = parse_u32(&c, &batch);
+        } else if (key == KEY_ENTRIES) {
+            have_entries = true;
+            ok = expect(&c, '[');
+            if (ok && !expect(&c, ']')) {
+                do {
+                    ok = parse_entry(&c, &entry);
+                    if (ok) {
+                        on_entry(&entry, user);
+                        reported++;
+                    }
+                } while (ok && expect(&c, ','));
+                ok = ok && expect(&c, ']');
+            }
+        } else {
+            ok = skip_value(&c);
+        }
+        if (ok && !expect(&c, ',')) {
+            ok = expect(&c, '}') && at_end(&c);
+            break;
+        }
+    }
+
+    if (entries) *entries = reported;
+    if (!ok || !have_entries) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (gateway_id) *gateway_id = gateway;
+    if (batch_id) *batch_id = batch;
+    return CONSUMPTION_SUCCESS;
+}
@@ -19,6 +19,17 @@
 #include <mosquitto.h>
 #endif
 
+/* Stack buffers used by the clients and convenience functions */
+#define NETWORK_JSON_BUFFER_SIZE 2048
+#define NETWORK_URL_BUFFER_SIZE 512
+#define NETWORK_AUTH_BUFFER_SIZE 256
+#define NETWORK_TOPIC_BUFFER_SIZE 256
+#define NETWORK_CHUNK_SIZE 1024       /* MQTT streamed publish chunk */
+
+/* Heap held by live client handles (excludes curl/mosquitto internals).
+ * Clients come and go on any thread: updated with relaxed atomics */
+static size_t g_client_heap_bytes = 0;
+
 /* ============================================================================
  * ERROR STRINGS
  * ============================================================================ */
@@ -47,6 +58,24 @@ const char* consumption_network_error_string(consumption_network_error_t error)
     }
 }
 
+/* ============================================================================
+ * MEMORY FOOTPRINT
+ * ============================================================================ */
+
+void consumption_network_get_footprint(size_t* heap_bytes, size_t* peak_stack_bytes) {
+    if (heap_bytes) {
+        *heap_bytes = __atomic_load_n(&g_client_heap_bytes, __ATOMIC_RELAXED);
+    }
+    if (peak_stack_bytes) {
+        /* send_https_data() -> https_post(): payload + URL + auth header */
+        size_t https_path = NETWORK_JSON_BUFFER_SIZE + NETWORK_URL_BUFFER_SIZE +
+                            NETWORK_AUTH_BUFFER_SIZE;
+        /* send_mqtt_data(): payload + topic */
+        size_t mqtt_path = NETWORK_JSON_BUFFER_SIZE + NETWORK_TOPIC_BUFFER_SIZE;
+        *peak_stack_bytes = (https_path > mqtt_path) ? https_path : mqtt_path;
+    }
+}
+
 /* ============================================================================
  * CONFIGURATION HELPERS
  * ============================================================================ */
@@ -107,11 +136,13 @@ consumption_https_client_t* consumption_https_init(const consumption_network_con
     if (!client) {
         return NULL;
     }
+    __atomic_fetch_add(&g_client_heap_bytes, sizeof(consumption_https_client_t), __ATOMIC_RELAXED);
 
     memcpy(&client->config, config, sizeof(consumption_network_config_t));
 
     client->curl = curl_easy_init();
     if (!client->curl) {
+        __atomic_fetch_sub(&g_client_heap_bytes, sizeof(consumption_https_client_t), __ATOMIC_RELAXED);
         free(client);
         return NULL;
     }
@@ -142,6 +173,41 @@ consumption_https_client_t* consumption_https_init(const consumption_network_con
     return client;
 }
 
+/**
+ * @brief Convert a curl result to our error type
+ */
+static consumption_network_error_t curl_to_network_error(CURLcode res) {
+    switch (res) {
+        case CURLE_OK:
+            return CONSUMPTION_NETWORK_SUCCESS;
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_COULDNT_RESOLVE_HOST:
+            return CONSUMPTION_NETWORK_ERROR_CONNECT;
+        case CURLE_OPERATION_TIMEDOUT:
+            return CONSUMPTION_NETWORK_ERROR_TIMEOUT;
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_SSL_CERTPROBLEM:
+            return CONSUMPTION_NETWORK_ERROR_SSL;
+        default:
+            return CONSUMPTION_NETWORK_ERROR_SEND;
+    }
+}
+
+/**
+ * @brief Build the request headers shared by buffered and streamed posts
+ */
+static struct curl_slist* https_headers(consumption_https_client_t* client) {
+    struct curl_slist* headers = NULL;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    if (client->config.password[0]) {
+        char auth_header[NETWORK_AUTH_BUFFER_SIZE];
+        snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s",
+                client->config.password);
+        headers = curl_slist_append(headers, auth_header);
+    }
+    return headers;
+}
+
 consumption_network_error_t consumption_https_post(consumption_https_client_t* client,
                                                   const char* endpoint,
                                                   const char* data,
@@ -152,7 +218,7 @@ consumption_network_error_t consumption_https_post(consumption_https_client_t* c
     }
 
     /* Build full URL */
-    char url[512];
+    char url[NETWORK_URL_BUFFER_SIZE];
     int url_len = snprintf(url, sizeof(url), "%s%s",
                           client->config.server, endpoint);
 
@@ -168,14 +234,7 @@ consumption_network_error_t consumption_https_post(consumption_https_client_t* c
     curl_easy_setopt(client->curl, CURLOPT_POSTFIELDSIZE, data_len);
 
     /* Set headers */
-    struct curl_slist* headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    if (client->config.password[0]) {
-        char auth_header[256];
-        snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s",
-                client->config.password);
-        headers = curl_slist_append(headers, auth_header);
-    }
+    struct curl_slist* headers = https_headers(client);
     curl_easy_setopt(client->curl, CURLOPT_HTTPHEADER, headers);
 
     /* Perform request */
@@ -189,23 +248,63 @@ consumption_network_error_t consumption_https_post(consumption_https_client_t* c
     /* Clean up headers */
     curl_slist_free_all(headers);
 
-    /* Convert curl error to our error type */
-    if (res != CURLE_OK) {
-        switch (res) {
-            case CURLE_COULDNT_CONNECT:
-            case CURLE_COULDNT_RESOLVE_HOST:
-                return CONSUMPTION_NETWORK_ERROR_CONNECT;
-            case CURLE_OPERATION_TIMEDOUT:
-                return CONSUMPTION_NETWORK_ERROR_TIMEOUT;
-            case CURLE_SSL_CONNECT_ERROR:
-            case CURLE_SSL_CERTPROBLEM:
-                return CONSUMPTION_NETWORK_ERROR_SSL;
-            default:
-                return CONSUMPTION_NETWORK_ERROR_SEND;
-        }
+    return curl_to_network_error(res);
+}
+
+/**
+ * @brief Adapter from consumption_network_read_t to CURLOPT_READFUNCTION
+ */
+typedef struct {
+    consumption_network_read_t read_cb;
+    void* ctx;
+} https_stream_source_t;
+
+static size_t https_stream_read(char* buffer, size_t size, size_t nitems, void* userdata) {
+    https_stream_source_t* source = (https_stream_source_t*)userdata;
+    return source->read_cb(buffer, size * nitems, source->ctx);
+}
+
+consumption_network_error_t consumption_https_post_stream(consumption_https_client_t* client,
+                                                         const char* endpoint,
+                                                         consumption_network_read_t read_cb,
+                                                         void* ctx,
+                                                         long* response_code) {
+    if (!client || !client->curl || !endpoint || !read_cb) {
+        return CONSUMPTION_NETWORK_ERROR_INIT;
     }
 
-    return CONSUMPTION_NETWORK_SUCCESS;
+    char url[NETWORK_URL_BUFFER_SIZE];
+    int url_len = snprintf(url, sizeof(url), "%s%s",
+                          client->config.server, endpoint);
+
+    if (url_len < 0 || (size_t)url_len >= sizeof(url)) {
+        return CONSUMPTION_NETWORK_ERROR_INIT;
+    }
+
+    https_stream_source_t source = {read_cb, ctx};
+
+    curl_easy_setopt(client->curl, CURLOPT_URL, url);
+    curl_easy_setopt(client->curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(client->curl, CURLOPT_POSTFIELDS, NULL);
+    curl_easy_setopt(client->curl, CURLOPT_READFUNCTION, https_stream_read);
+    curl_easy_setopt(client->curl, CURLOPT_READDATA, &source);
+
+    /* No Content-Length: the body is sent with chunked encoding */
+    struct curl_slist* headers = https_headers(client);
+    headers = curl_slist_append(headers, "Transfer-Encoding: chunked");
+    curl_easy_setopt(client->curl, CURLOPT_HTTPHEADER, headers);
+
+    CURLcode res = curl_easy_perform(client->curl);
+
+    if (response_code) {
+        curl_easy_getinfo(client->curl, CURLINFO_RESPONSE_CODE, response_code);
+    }
+
+    curl_slist_free_all(headers);
+    curl_easy_setopt(client->curl, CURLOPT_READFUNCTION, NULL);
+    curl_easy_setopt(client->curl, CURLOPT_READDATA, NULL);
+
+    return curl_to_network_error(res);
 }
 
 void consumption_https_deinit(consumption_https_client_t* client) {
@@ -213,6 +312,7 @@ void consumption_https_deinit(consumption_https_client_t* client) {
         if (client->curl) {
             curl_easy_cleanup(client->curl);
         }
+        __atomic_fetch_sub(&g_client_heap_bytes, sizeof(consumption_https_client_t), __ATOMIC_RELAXED);
         free(client);
     }
 }
@@ -233,6 +333,15 @@ consumption_network_error_t consumption_https_post(consumption_https_client_t* c
     return CONSUMPTION_NETWORK_ERROR_INIT;  /* HTTPS not supported */
 }
 
+consumption_network_error_t consumption_https_post_stream(consumption_https_client_t* client,
+                                                         const char* endpoint,
+                                                         consumption_network_read_t read_cb,
+                                                         void* ctx,
+                                                         long* response_code) {
+    (void)client; (void)endpoint; (void)read_cb; (void)ctx; (void)response_code;
+    return CONSUMPTION_NETWORK_ERROR_INIT;  /* HTTPS not supported */
+}
+
 void consumption_https_deinit(consumption_https_client_t* client) {
     (void)client;
 }
@@ -297,6 +406,7 @@ consumption_mqtt_client_t* consumption_mqtt_init(const consumption_network_confi
     if (!client) {
         return NULL;
     }
+    __atomic_fetch_add(&g_client_heap_bytes, sizeof(consumption_mqtt_client_t), __ATOMIC_RELAXED);
 
     memcpy(&client->config, config, sizeof(consumption_network_config_t));
     client->message_callback = message_callback;
@@ -307,6 +417,7 @@ consumption_mqtt_client_t* consumption_mqtt_init(const consumption_network_confi
     client->mosq = mosquitto_new(config->client_id[0] ? config->client_id : NULL,
                                true, client);
     if (!client->mosq) {
+        __atomic_fetch_sub(&g_client_heap_bytes, sizeof(consumption_mqtt_client_t), __ATOMIC_RELAXED);
         free(client);
         return NULL;
     }
@@ -331,6 +442,7 @@ consumption_mqtt_client_t* consumption_mqtt_init(const consumption_network_confi
                                           NULL);
         if (tls_result != MOSQ_ERR_SUCCESS) {
             mosquitto_destroy(client->mosq);
+            __atomic_fetch_sub(&g_client_heap_bytes, sizeof(consumption_mqtt_client_t), __ATOMIC_RELAXED);
             free(client);
             return NULL;
         }
@@ -388,6 +500,42 @@ consumption_network_error_t consumption_mqtt_publish(consumption_mqtt_client_t*
     return CONSUMPTION_NETWORK_SUCCESS;
 }
 
+consumption_network_error_t consumption_mqtt_publish_stream(consumption_mqtt_client_t* client,
+                                                          const char* topic,
+                                                          uint32_t upload_id,
+                                                          consumption_network_read_t read_cb,
+                                                          void* ctx,
+                                                          int qos) {
+    if (!client || !client->mosq || !topic || !read_cb) {
+        return CONSUMPTION_NETWORK_ERROR_INIT;
+    }
+
+    char chunk_topic[NETWORK_TOPIC_BUFFER_SIZE];
+    char chunk[NETWORK_CHUNK_SIZE];
+    uint32_t index = 0;
+    size_t len;
+
+    /* mosquitto copies the payload, so one chunk buffer is reused */
+    while ((len = read_cb(chunk, sizeof(chunk), ctx)) > 0) {
+        int topic_len = snprintf(chunk_topic, sizeof(chunk_topic), "%s/%u/%u",
+                                 topic, upload_id, index);
+        if (topic_len >= (int)sizeof(chunk_topic)) {
+            return CONSUMPTION_NETWORK_ERROR_INIT;
+        }
+
+        consumption_network_error_t err =
+            consumption_mqtt_publish(client, chunk_topic, chunk, len, qos, false);
+        if (err != CONSUMPTION_NETWORK_SUCCESS) {
+            return err;
+        }
+        index++;
+    }
+
+    snprintf(chunk_topic, sizeof(chunk_topic), "%s/%u/end", topic, upload_id);
+    int count_len = snprintf(chunk, sizeof(chunk), "%u", index);
+    return consumption_mqtt_publish(client, chunk_topic, chunk, (size_t)count_len, qos, false);
+}
+
 consumption_network_error_t consumption_mqtt_subscribe(consumption_mqtt_client_t* client,
                                                      const char* topic,
                                                      int qos) {
@@ -454,6 +602,7 @@ void consumption_mqtt_deinit(consumption_mqtt_client_t* client) {
             mosquitto_disconnect(client->mosq);
             mosquitto_destroy(client->mosq);
         }
+        __atomic_fetch_sub(&g_client_heap_bytes, sizeof(consumption_mqtt_client_t), __ATOMIC_RELAXED);
         free(client);
     }
 
@@ -484,6 +633,16 @@ consumption_network_error_t consumption_mqtt_publish(consumption_mqtt_client_t*
     return CONSUMPTION_NETWORK_ERROR_INIT;
 }
 
+consumption_network_error_t consumption_mqtt_publish_stream(consumption_mqtt_client_t* client,
+                                                          const char* topic,
+                                                          uint32_t upload_id,
+                                                          consumption_network_read_t read_cb,
+                                                          void* ctx,
+                                                          int qos) {
+    (void)client; (void)topic; (void)upload_id; (void)read_cb; (void)ctx; (void)qos;
+    return CONSUMPTION_NETWORK_ERROR_INIT;
+}
+
 consumption_network_error_t consumption_mqtt_subscribe(consumption_mqtt_client_t* client,
                                                      const char* topic,
                                                      int qos) {
@@ -529,7 +688,7 @@ bool consumption_network_send_https_data(const char* server,
     }
 
     /* Create JSON payload */
-    char json_buffer[2048];
+    char json_buffer[NETWORK_JSON_BUFFER_SIZE];
     int len = snprintf(json_buffer, sizeof(json_buffer),
         "{\"machine_id\":%u,\"period_start\":%u,\"period_end\":%u,\"total_events\":%u",
         machine_id, period_start, period_end, total_events);
@@ -586,7 +745,7 @@ bool consumption_network_send_mqtt_data(const char* server,
     }
 
     /* Create JSON payload */
-    char json_buffer[2048];
+    char json_buffer[NETWORK_JSON_BUFFER_SIZE];
     int len = snprintf(json_buffer, sizeof(json_buffer),
         "{\"machine_id\":%u,\"period_start\":%u,\"period_end\":%u,\"total_events\":%u",
         machine_id, period_start, period_end, total_events);
@@ -604,7 +763,7 @@ bool consumption_network_send_mqtt_data(const char* server,
     len += snprintf(json_buffer + len, sizeof(json_buffer) - len, "}}");
 
     /* Create topic */
-    char topic[256];
+    char topic[NETWORK_TOPIC_BUFFER_SIZE];
     snprintf(topic, sizeof(topic), "%s/consumption/%u", topic_base, machine_id);
 
     consumption_network_error_t result = consumption_mqtt_publish(client, topic,
@@ -138,6 +138,65 @@ bool consumption_platform_network_send(const char* endpoint,
     return false;
 }
 
+/**
+ * @brief Adapter from the module's pull callback to CURLOPT_READFUNCTION
+ */
+typedef struct {
+    size_t (*read_cb)(char* buffer, size_t size, void* ctx);
+    void* ctx;
+} stream_source_t;
+
+static size_t curl_stream_read(char* buffer, size_t size, size_t nitems, void* userdata) {
+    stream_source_t* source = (stream_source_t*)userdata;
+    return source->read_cb(buffer, size * nitems, source->ctx);
+}
+
+bool consumption_platform_network_send_stream(const char* endpoint,
+                                            size_t (*read_cb)(char* buffer, size_t size, void* ctx),
+                                            void* ctx) {
+    if (!g_curl) {
+        return false;
+    }
+
+    CURLcode res;
+    struct curl_slist* headers = NULL;
+    stream_source_t source = {read_cb, ctx};
+
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "User-Agent: Consumption-Module/1.0");
+    headers = curl_slist_append(headers, "Transfer-Encoding: chunked");
+
+    curl_easy_setopt(g_curl, CURLOPT_URL, endpoint);
+    curl_easy_setopt(g_curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(g_curl, CURLOPT_POSTFIELDS, NULL);
+    curl_easy_setopt(g_curl, CURLOPT_READFUNCTION, curl_stream_read);
+    curl_easy_setopt(g_curl, CURLOPT_READDATA, &source);
+    curl_easy_setopt(g_curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(g_curl, CURLOPT_TIMEOUT, 30L);  /* 30 second timeout */
+    curl_easy_setopt(g_curl, CURLOPT_CONNECTTIMEOUT, 10L);  /* 10 second connect timeout */
+
+    /* Disable SSL verification for development (enable in production!) */
+    curl_easy_setopt(g_curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(g_curl, CURLOPT_SSL_VERIFYHOST, 0L);
+
+    res = curl_easy_perform(g_curl);
+
+    curl_slist_free_all(headers);
+    /* Back to buffered posts for consumption_platform_network_send() */
+    curl_easy_setopt(g_curl, CURLOPT_READFUNCTION, NULL);
+    curl_easy_setopt(g_curl, CURLOPT_READDATA, NULL);
+
+    if (res == CURLE_OK) {
+        long response_code;
+        curl_easy_getinfo(g_curl, CURLINFO_RESPONSE_CODE, &response_code);
+
+        /* Consider 2xx responses as success */
+        return (response_code >= 200 && response_code < 300);
+    }
+
+    return false;
+}
+
 /* ============================================================================
  * LOGGING
  * ============================================================================ */
@@ -125,6 +125,17 @@ bool consumption_platform_network_send(const char* endpoint,
 #endif
 }
 
+bool consumption_platform_network_send_stream(const char* endpoint,
+                                            size_t (*read_cb)(char* buffer, size_t size, void* ctx),
+                                            void* ctx) {
+    /* Pull fixed-size chunks from read_cb() into the TCP/MQTT stack, e.g.
+     * HTTP chunked encoding over a LWIP netconn. Not implemented: returning
+     * without calling read_cb() makes the module send a truncated payload
+     * through consumption_platform_network_send() instead. */
+    (void)endpoint; (void)read_cb; (void)ctx;
+    return false;
+}
+
 /* ============================================================================
  * LOGGING
  * ============================================================================ */
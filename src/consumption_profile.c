@@ -0,0 +1,284 @@
+/**
+ * @file consumption_profile.c
+ * @brief Shared configuration profiles implementation
+ *
+ * A version is a normalized copy of the settings: zero-filled, fields
+ * assigned one by one and strings copied up to their terminator, so equal
+ * settings are equal bytes and hash alike (FNV-1a over words). Profiles sit in a
+ * fixed slot array; interning compares hashes, then bytes. There are few
+ * profiles per gateway, so a scan is cheaper than maintaining a table.
+ *
+ * A profile points at its current version. Updates build the new version
+ * aside and publish it with a release store; the old one goes on the
+ * registry's retired list until reclaimed.
+ */
+
+#include "consumption_profile.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define PROFILE_RETIRED_MIN 8       /* First retired list allocation */
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef struct {
+    consumption_config_t config;
+    consumption_network_config_t network;
+} profile_version_t;
+
+struct consumption_profile_t {
+    consumption_profiles_t* owner;
+    profile_version_t* current;     /* Published with release stores */
+    uint32_t hash;                  /* Of current */
+    uint32_t refs;
+    uint32_t slot;
+};
+
+struct consumption_profiles_t {
+    uint32_t max_profiles;
+    uint32_t count;
+    consumption_profile_t** slots;
+    profile_version_t** retired;
+    uint32_t retired_count;
+    uint32_t retired_capacity;
+    uint64_t interned;
+    uint64_t bytes;
+};
+
+/* ============================================================================
+ * INTERNAL FUNCTIONS
+ * ============================================================================ */
+
+/**
+ * @brief Copy a string field up to its terminator; dst is zero-filled
+ */
+static void copy_string(char* dst, const char* src, size_t size) {
+    const char* end = (const char*)memchr(src, '\0', size - 1);
+    memcpy(dst, src, end ? (size_t)(end - src) : size - 1);
+}
+
+/**
+ * @brief Normalized copy of settings; machine_id is left 0
+ */
+static void normalize(profile_version_t* version, const consumption_config_t* config,
+                      const consumption_network_config_t* network) {
+    memset(version, 0, sizeof(*version));
+
+    consumption_config_t* c = &version->config;
+    c->enable_external_api = config->enable_external_api;
+    c->ring_buffer_size = config->ring_buffer_size;
+    c->aggregation_interval = config->aggregation_interval;
+    copy_string(c->api_endpoint, config->api_endpoint, sizeof(c->api_endpoint));
+    copy_string(c->api_key, config->api_key, sizeof(c->api_key));
+    c->max_retry_attempts = config->max_retry_attempts;
+    c->counter_only = config->counter_only;
+    c->retention = config->retention;
+    c->upload_events = config->upload_events;
+    c->heartbeat_frames = config->heartbeat_frames;
+
+    if (network) {
+        consumption_network_config_t* n = &version->network;
+        n->type = network->type;
+        copy_string(n->server, network->server, sizeof(n->server));
+        n->port = network->port;
+        copy_string(n->username, network->username, sizeof(n->username));
+        copy_string(n->password, network->password, sizeof(n->password));
+        copy_string(n->client_id, network->client_id, sizeof(n->client_id));
+        n->timeout_ms = network->timeout_ms;
+        n->use_ssl = network->use_ssl;
+        copy_string(n->ca_cert_path, network->ca_cert_path, sizeof(n->ca_cert_path));
+        copy_string(n->client_cert_path, network->client_cert_path, sizeof(n->client_cert_path));
+        copy_string(n->client_key_path, network->client_key_path, sizeof(n->client_key_path));
+    }
+}
+
+/**
+ * @brief FNV-1a over 8-byte words, folded to 32 bits
+ */
+static uint32_t hash_version(const profile_version_t* version) {
+    const uint8_t* p = (const uint8_t*)version;
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= sizeof(*version); i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < sizeof(*version); i++) {
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static profile_version_t* current_version(const consumption_profile_t* profile) {
+    return __atomic_load_n(&profile->current, __ATOMIC_ACQUIRE);
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+consumption_profiles_t* consumption_profiles_create(uint32_t max_profiles) {
+    if (max_profiles == 0 || max_profiles > 65536) {
+        return NULL;
+    }
+    consumption_profiles_t* profiles = (consumption_profiles_t*)calloc(1, sizeof(consumption_profiles_t));
+    if (!profiles) {
+        return NULL;
+    }
+    profiles->max_profiles = max_profiles;
+    profiles->slots = (consumption_profile_t**)calloc(max_profiles, sizeof(consumption_profile_t*));
+    if (!profiles->slots) {
+        free(profiles);
+        return NULL;
+    }
+    profiles->bytes = sizeof(*profiles) + max_profiles * sizeof(consumption_profile_t*);
+    return profiles;
+}
+
+consumption_profile_t* consumption_profile_intern(consumption_profiles_t* profiles,
+                                                  const consumption_config_t* config,
+                                                  const consumption_network_config_t* network) {
+    if (!profiles || !config) {
+        return NULL;
+    }
+    profile_version_t key;
+    normalize(&key, config, network);
+    uint32_t hash = hash_version(&key);
+
+    uint32_t free_slot = profiles->max_profiles;
+    for (uint32_t i = 0; i < profiles->max_profiles; i++) {
+        consumption_profile_t* profile = profiles->slots[i];
+        if (!profile) {
+            if (free_slot == profiles->max_profiles) free_slot = i;
+            continue;
+        }
+        if (profile->hash == hash && memcmp(profile->current, &key, sizeof(key)) == 0) {
+            profiles->interned++;
+            return consumption_profile_retain(profile);
+        }
+    }
+    if (free_slot == profiles->max_profiles) {
+        return NULL;
+    }
+
+    consumption_profile_t* profile = (consumption_profile_t*)calloc(1, sizeof(consumption_profile_t));
+    profile_version_t* version = (profile_version_t*)malloc(sizeof(profile_version_t));
+    if (!profile || !version) {
+        free(profile);
+        free(version);
+        return NULL;
+    }
+    *version = key;
+    profile->owner = profiles;
+    profile->current = version;
+    profile->hash = hash;
+    profile->refs = 1;
+    profile->slot = free_slot;
+    profiles->slots[free_slot] = profile;
+    profiles->count++;
+    profiles->bytes += sizeof(*profile) + sizeof(*version);
+    return profile;
+}
+
+consumption_profile_t* consumption_profile_retain(consumption_profile_t* profile) {
+    if (profile) {
+        __atomic_fetch_add(&profile->refs, 1, __ATOMIC_RELAXED);
+    }
+    return profile;
+}
+
+void consumption_profile_release(consumption_profile_t* profile) {
+    if (!profile || __atomic_sub_fetch(&profile->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    consumption_profiles_t* profiles = profile->owner;
+    profiles->slots[profile->slot] = NULL;
+    profiles->count--;
+    profiles->bytes -= sizeof(*profile) + sizeof(profile_version_t);
+    free(profile->current);
+    free(profile);
+}
+
+const consumption_config_t* consumption_profile_config(const consumption_profile_t* profile) {
+    return profile ? &current_version(profile)->config : NULL;
+}
+
+const consumption_network_config_t* consumption_profile_network(const consumption_profile_t* profile) {
+    return profile ? &current_version(profile)->network : NULL;
+}
+
+consumption_error_t consumption_profile_update(consumption_profile_t* profile,
+                                               const consumption_config_t* config,
+                                               const consumption_network_config_t* network) {
+    if (!profile || !config) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    consumption_profiles_t* profiles = profile->owner;
+    if (profiles->retired_count == profiles->retired_capacity) {
+        uint32_t capacity = profiles->retired_capacity ? profiles->retired_capacity * 2 : PROFILE_RETIRED_MIN;
+        profile_version_t** retired = (profile_version_t**)realloc(profiles->retired,
+                                                                   capacity * sizeof(profile_version_t*));
+        if (!retired) {
+            return CONSUMPTION_ERROR_MEMORY_ERROR;
+        }
+        profiles->retired = retired;
+        profiles->retired_capacity = capacity;
+    }
+    profile_version_t* version = (profile_version_t*)malloc(sizeof(profile_version_t));
+    if (!version) {
+        return CONSUMPTION_ERROR_MEMORY_ERROR;
+    }
+    normalize(version, config, network);
+
+    profile_version_t* old = profile->current;
+    profile->hash = hash_version(version);
+    __atomic_store_n(&profile->current, version, __ATOMIC_RELEASE);
+    profiles->retired[profiles->retired_count++] = old;
+    profiles->bytes += sizeof(*version);
+    return CONSUMPTION_SUCCESS;
+}
+
+uint32_t consumption_profiles_reclaim(consumption_profiles_t* profiles) {
+    if (!profiles) {
+        return 0;
+    }
+    uint32_t freed = profiles->retired_count;
+    for (uint32_t i = 0; i < freed; i++) {
+        free(profiles->retired[i]);
+    }
+    profiles->retired_count = 0;
+    profiles->bytes -= (uint64_t)freed * sizeof(profile_version_t);
+    return freed;
+}
+
+void consumption_profiles_get_stats(const consumption_profiles_t* profiles,
+                                    consumption_profiles_stats_t* stats) {
+    if (!profiles || !stats) return;
+    memset(stats, 0, sizeof(*stats));
+    for (uint32_t i = 0; i < profiles->max_profiles; i++) {
+        if (profiles->slots[i]) {
+            stats->references += __atomic_load_n(&profiles->slots[i]->refs, __ATOMIC_RELAXED);
+        }
+    }
+    stats->profiles = profiles->count;
+    stats->retired = profiles->retired_count;
+    stats->interned = profiles->interned;
+    stats->bytes = profiles->bytes + profiles->retired_capacity * sizeof(profile_version_t*);
+}
+
+void consumption_profiles_destroy(consumption_profiles_t* profiles) {
+    if (!profiles) return;
+    consumption_profiles_reclaim(profiles);
+    for (uint32_t i = 0; i < profiles->max_profiles; i++) {
+        if (profiles->slots[i]) {
+            free(profiles->slots[i]->current);
+            free(profiles->slots[i]);
+        }
+    }
+    free(profiles->retired);
+    free(profiles->slots);
+    free(profiles);
+}
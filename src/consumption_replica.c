@@ -0,0 +1,782 @@
+/**
+ * @file consumption_replica.c
+ * @brief Log streaming to a hot-standby process (Linux, epoll)
+ *
+ * Both transports carry the same frames: a 16-byte header (payload size,
+ * magic, record type, log sequence number) followed by the event or the
+ * checkpointed state record. Sequence numbers count every record the
+ * primary logged, so a standby sees the records it missed as a gap. A
+ * standby acknowledges with the sequence number of the last record it
+ * applied, once per read.
+ */
+
+#define _GNU_SOURCE
+#include "consumption_replica.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+/* Platform functions */
+extern void consumption_platform_log(int level, const char* message);
+
+#define REPLICA_MAGIC 0x5743u           /* "CW" */
+#define REPLICA_MAX_PAYLOAD 4096        /* Largest frame payload (checkpoint) */
+#define REPLICA_IN_BUFFER 65536         /* Standby read buffer */
+#define REPLICA_RETRY_MS 100            /* Primary reconnect interval */
+#define REPLICA_READ_BUFFER (1 << 20)   /* Log file reader buffer */
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t size;                  /* Payload bytes */
+    uint16_t magic;
+    uint8_t type;                   /* consumption_log_type_t */
+    uint8_t reserved;
+    uint64_t lsn;                   /* Log sequence number, from 1 */
+} frame_header_t;
+
+struct consumption_replica_t {
+    consumption_replica_config_t config;
+    bool primary;
+    bool promoted;
+    int epoll_fd;
+    int fd;                         /* Connection or log file, -1 if none */
+    int listen_fd;                  /* Standby, socket */
+    int watch_fd;                   /* Standby, file: inotify */
+    pthread_mutex_t lock;           /* Primary: log handler vs poll */
+    consumption_replica_stats_t stats;
+
+    /* Primary */
+    uint8_t* out;
+    size_t out_len;
+    size_t out_capacity;
+    uint32_t out_records;
+    uint64_t out_since_ms;          /* When the oldest unsent record was logged */
+    uint64_t lsn;                   /* Last record logged */
+    uint64_t acked_lsn;
+    uint8_t ack_buffer[sizeof(uint64_t)];
+    size_t ack_len;
+    uint64_t retry_at_ms;
+    bool need_checkpoint;
+
+    /* Standby */
+    uint8_t* in;
+    size_t in_len;
+    uint64_t applied_lsn;
+    uint64_t acked_sent;
+    off_t offset;                   /* File: bytes consumed */
+};
+
+/* ============================================================================
+ * INTERNAL FUNCTIONS
+ * ============================================================================ */
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void watch_fd(consumption_replica_t* replica, int fd) {
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = fd};
+    epoll_ctl(replica->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void drop_connection(consumption_replica_t* replica) {
+    if (replica->fd < 0) {
+        return;
+    }
+    epoll_ctl(replica->epoll_fd, EPOLL_CTL_DEL, replica->fd, NULL);
+    close(replica->fd);
+    replica->fd = -1;
+    replica->stats.connected = 0;
+    replica->stats.disconnects++;
+
+    if (replica->primary) {
+        replica->stats.dropped += replica->out_records;
+        replica->out_len = 0;
+        replica->out_records = 0;
+        replica->ack_len = 0;
+        replica->retry_at_ms = monotonic_ms() + REPLICA_RETRY_MS;
+        consumption_platform_log(1, "Replication standby lost");
+    } else {
+        replica->in_len = 0;
+        consumption_platform_log(1, "Replication primary lost");
+    }
+}
+
+static bool sockaddr_for(const char* path, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        return false;
+    }
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+/* ============================================================================
+ * PRIMARY
+ * ============================================================================ */
+
+static void try_connect(consumption_replica_t* replica) {
+    struct sockaddr_un addr;
+    sockaddr_for(replica->config.path, &addr);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return;
+    }
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        replica->retry_at_ms = monotonic_ms() + REPLICA_RETRY_MS;
+        return;
+    }
+
+    replica->fd = fd;
+    watch_fd(replica, fd);
+    replica->stats.connected = 1;
+    replica->acked_lsn = replica->lsn;  /* Nothing in flight on a new connection */
+    replica->need_checkpoint = true;
+}
+
+/**
+ * @brief Read acknowledgements, waiting up to timeout_ms for the first
+ */
+static void read_acks(consumption_replica_t* replica, int timeout_ms) {
+    if (replica->fd < 0 || replica->config.transport != CONSUMPTION_REPLICA_SOCKET) {
+        return;
+    }
+
+    struct pollfd pfd = {.fd = replica->fd, .events = POLLIN};
+    if (timeout_ms > 0 && poll(&pfd, 1, timeout_ms) <= 0) {
+        return;
+    }
+
+    for (;;) {
+        ssize_t n = read(replica->fd, replica->ack_buffer + replica->ack_len,
+                         sizeof(replica->ack_buffer) - replica->ack_len);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            drop_connection(replica);
+            return;
+        }
+        if (n < 0) {
+            return;
+        }
+        replica->ack_len += (size_t)n;
+        if (replica->ack_len == sizeof(replica->ack_buffer)) {
+            uint64_t lsn;
+            memcpy(&lsn, replica->ack_buffer, sizeof(lsn));
+            if (lsn > replica->acked_lsn && lsn <= replica->lsn) {
+                replica->stats.acked += lsn - replica->acked_lsn;
+                replica->acked_lsn = lsn;
+            }
+            replica->ack_len = 0;
+        }
+    }
+}
+
+/**
+ * @brief Write the pending batch
+ */
+static void flush(consumption_replica_t* replica) {
+    if (replica->out_len == 0 || replica->fd < 0) {
+        return;
+    }
+
+    /* send() so that a standby going away is EPIPE, not SIGPIPE for the primary */
+    bool file = (replica->config.transport == CONSUMPTION_REPLICA_FILE);
+    size_t sent = 0;
+    while (sent < replica->out_len) {
+        ssize_t n = file ? write(replica->fd, replica->out + sent, replica->out_len - sent)
+                         : send(replica->fd, replica->out + sent, replica->out_len - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            /* Standby is behind: wait for room, reading acknowledgements */
+            struct pollfd pfd = {.fd = replica->fd, .events = POLLOUT};
+            if (poll(&pfd, 1, (int)replica->config.ack_timeout_ms) > 0) {
+                read_acks(replica, 0);
+                if (replica->fd >= 0) continue;
+            }
+        }
+        drop_connection(replica);
+        return;
+    }
+
+    replica->stats.batches++;
+    replica->stats.bytes += replica->out_len;
+    if (replica->config.transport == CONSUMPTION_REPLICA_FILE) {
+        if (replica->config.mode == CONSUMPTION_REPLICA_SYNC) {
+            fdatasync(replica->fd);
+        }
+        replica->stats.acked += replica->lsn - replica->acked_lsn;
+        replica->acked_lsn = replica->lsn;
+    }
+    replica->out_len = 0;
+    replica->out_records = 0;
+}
+
+/**
+ * @brief Wait until the standby has acknowledged lsn, or drop it
+ */
+static void wait_acked(consumption_replica_t* replica, uint64_t lsn) {
+    uint64_t deadline = monotonic_ms() + replica->config.ack_timeout_ms;
+    while (replica->fd >= 0 && replica->acked_lsn < lsn) {
+        uint64_t now = monotonic_ms();
+        if (now >= deadline) {
+            drop_connection(replica);
+            return;
+        }
+        read_acks(replica, (int)(deadline - now));
+    }
+}
+
+static bool append_frame(consumption_replica_t* replica, uint8_t type,
+                         const void* payload, uint32_t size) {
+    size_t needed = replica->out_len + sizeof(frame_header_t) + size;
+    if (needed > replica->out_capacity) {
+        size_t capacity = replica->out_capacity * 2;
+        if (capacity < needed) capacity = needed;
+        uint8_t* out = (uint8_t*)realloc(replica->out, capacity);
+        if (!out) {
+            return false;
+        }
+        replica->out = out;
+        replica->out_capacity = capacity;
+    }
+
+    frame_header_t header = {
+        .size = size,
+        .magic = REPLICA_MAGIC,
+        .type = type,
+        .lsn = replica->lsn
+    };
+    memcpy(replica->out + replica->out_len, &header, sizeof(header));
+    memcpy(replica->out + replica->out_len + sizeof(header), payload, size);
+    replica->out_len = needed;
+    if (replica->out_records++ == 0) {
+        replica->out_since_ms = monotonic_ms();
+    }
+    return true;
+}
+
+static void on_log_record(const consumption_log_record_t* record, void* ctx) {
+    consumption_replica_t* replica = (consumption_replica_t*)ctx;
+    const bool checkpoint = (record->type == CONSUMPTION_LOG_CHECKPOINT);
+
+    pthread_mutex_lock(&replica->lock);
+    replica->lsn++;
+
+    if (replica->fd < 0 || (checkpoint && record->state_size > REPLICA_MAX_PAYLOAD)) {
+        replica->stats.dropped++;
+        pthread_mutex_unlock(&replica->lock);
+        return;
+    }
+
+    bool added = checkpoint ?
+        append_frame(replica, CONSUMPTION_LOG_CHECKPOINT, record->state, record->state_size) :
+        append_frame(replica, CONSUMPTION_LOG_DISPENSE, &record->event, sizeof(record->event));
+    if (!added) {
+        replica->stats.dropped++;
+        pthread_mutex_unlock(&replica->lock);
+        return;
+    }
+    replica->stats.records++;
+
+    if (replica->config.mode == CONSUMPTION_REPLICA_SYNC) {
+        flush(replica);
+        wait_acked(replica, replica->lsn);
+    } else {
+        if (checkpoint || replica->out_records >= replica->config.batch_records) {
+            flush(replica);
+        }
+        if (replica->lsn - replica->acked_lsn > replica->config.max_unacked) {
+            wait_acked(replica, replica->lsn - replica->config.max_unacked);
+        }
+    }
+    pthread_mutex_unlock(&replica->lock);
+}
+
+static int poll_primary(consumption_replica_t* replica) {
+    pthread_mutex_lock(&replica->lock);
+    uint64_t acked = replica->stats.acked;
+
+    if (replica->fd < 0 && replica->config.transport == CONSUMPTION_REPLICA_SOCKET &&
+        monotonic_ms() >= replica->retry_at_ms) {
+        try_connect(replica);
+    }
+    if (replica->out_records > 0 &&
+        monotonic_ms() - replica->out_since_ms >= replica->config.batch_delay_ms) {
+        flush(replica);
+    }
+    read_acks(replica, 0);
+
+    bool checkpoint = replica->need_checkpoint && replica->fd >= 0;
+    replica->need_checkpoint = false;
+    int result = (int)(replica->stats.acked - acked);
+    pthread_mutex_unlock(&replica->lock);
+
+    /* Logged through on_log_record(), which takes the lock */
+    if (checkpoint) {
+        consumption_log_checkpoint();
+    }
+    return result;
+}
+
+/* ============================================================================
+ * STANDBY
+ * ============================================================================ */
+
+static void decode_frame(const frame_header_t* header, const uint8_t* payload,
+                         consumption_log_record_t* record) {
+    memset(record, 0, sizeof(*record));
+    record->type = (consumption_log_type_t)header->type;
+    if (record->type == CONSUMPTION_LOG_DISPENSE && header->size == sizeof(record->event)) {
+        memcpy(&record->event, payload, sizeof(record->event));
+    } else {
+        record->state = payload;
+        record->state_size = header->size;
+    }
+}
+
+static void apply_frame(consumption_replica_t* replica, const frame_header_t* header,
+                        const uint8_t* payload) {
+    /* A restarted primary counts from 1 again */
+    if (header->lsn != replica->applied_lsn + 1 && header->lsn != 1) {
+        replica->stats.gaps++;
+    }
+    replica->applied_lsn = header->lsn;
+
+    consumption_log_record_t record;
+    decode_frame(header, payload, &record);
+    if (consumption_log_apply(&record) == CONSUMPTION_SUCCESS) {
+        replica->stats.records++;
+    } else {
+        replica->stats.rejected++;
+    }
+}
+
+/**
+ * @brief Apply every complete frame in the input buffer
+ * @return Frames applied, -1 on a malformed stream
+ */
+static int apply_frames(consumption_replica_t* replica) {
+    size_t pos = 0;
+    int applied = 0;
+    while (replica->in_len - pos >= sizeof(frame_header_t)) {
+        frame_header_t header;
+        memcpy(&header, replica->in + pos, sizeof(header));
+        if (header.magic != REPLICA_MAGIC || header.size > REPLICA_MAX_PAYLOAD) {
+            return -1;
+        }
+        if (replica->in_len - pos < sizeof(header) + header.size) {
+            break; /* Rest of the frame not here yet */
+        }
+        apply_frame(replica, &header, replica->in + pos + sizeof(header));
+        pos += sizeof(header) + header.size;
+        applied++;
+    }
+    memmove(replica->in, replica->in + pos, replica->in_len - pos);
+    replica->in_len -= pos;
+    return applied;
+}
+
+static void send_ack(consumption_replica_t* replica) {
+    if (replica->fd < 0 || replica->config.transport != CONSUMPTION_REPLICA_SOCKET ||
+        replica->applied_lsn == replica->acked_sent) {
+        return;
+    }
+    uint64_t lsn = replica->applied_lsn;
+    if (send(replica->fd, &lsn, sizeof(lsn), MSG_NOSIGNAL) == (ssize_t)sizeof(lsn)) {
+        replica->acked_sent = lsn;
+        replica->stats.batches++;
+    }
+}
+
+static void accept_primary(consumption_replica_t* replica) {
+    for (;;) {
+        int fd = accept4(replica->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        /* A new primary replaces the old connection */
+        drop_connection(replica);
+        replica->fd = fd;
+        watch_fd(replica, fd);
+        replica->stats.connected = 1;
+        replica->in_len = 0;
+        replica->acked_sent = 0;
+    }
+}
+
+static void open_log_file(consumption_replica_t* replica) {
+    replica->fd = open(replica->config.path, O_RDONLY | O_CLOEXEC);
+    if (replica->fd < 0) {
+        return;
+    }
+    replica->offset = 0;
+    replica->in_len = 0;
+    if (replica->watch_fd >= 0) {
+        inotify_add_watch(replica->watch_fd, replica->config.path, IN_MODIFY);
+    }
+}
+
+static int poll_standby(consumption_replica_t* replica) {
+    if (replica->promoted) {
+        return 0;
+    }
+
+    bool file = (replica->config.transport == CONSUMPTION_REPLICA_FILE);
+    if (file) {
+        char events[4096];
+        while (replica->watch_fd >= 0 && read(replica->watch_fd, events, sizeof(events)) > 0) {
+        }
+        if (replica->fd < 0) {
+            open_log_file(replica);
+        }
+    } else {
+        accept_primary(replica);
+    }
+
+    int applied = 0;
+    while (replica->fd >= 0) {
+        ssize_t n = read(replica->fd, replica->in + replica->in_len, REPLICA_IN_BUFFER - replica->in_len);
+        if (n > 0) {
+            replica->in_len += (size_t)n;
+            replica->offset += n;
+            replica->stats.bytes += (uint64_t)n;
+            int frames = apply_frames(replica);
+            if (frames < 0) {
+                consumption_platform_log(0, "Replication stream corrupted");
+                if (file) {
+                    close(replica->fd); /* Reopened from the start on the next poll */
+                    replica->fd = -1;
+                } else {
+                    drop_connection(replica);
+                }
+                return -1;
+            }
+            applied += frames;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (file) {
+            /* A new primary truncated the log: start over */
+            struct stat st;
+            if (fstat(replica->fd, &st) == 0 && st.st_size < replica->offset) {
+                lseek(replica->fd, 0, SEEK_SET);
+                replica->offset = 0;
+                replica->in_len = 0;
+                continue;
+            }
+        } else if (n == 0 || errno != EAGAIN) {
+            drop_connection(replica);
+        }
+        break;
+    }
+
+    send_ack(replica);
+    return applied;
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+void consumption_replica_config_default(consumption_replica_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    config->transport = CONSUMPTION_REPLICA_SOCKET;
+    strcpy(config->path, "/tmp/consumption.wal");
+    config->mode = CONSUMPTION_REPLICA_ASYNC;
+    config->batch_records = 256;
+    config->batch_delay_ms = 5;
+    config->max_unacked = 65536;
+    config->ack_timeout_ms = 1000;
+}
+
+static consumption_replica_t* replica_create(const consumption_replica_config_t* config, bool primary) {
+    struct sockaddr_un addr;
+    if (!config || !sockaddr_for(config->path, &addr) || config->path[0] == '\0' ||
+        config->batch_records == 0 || config->ack_timeout_ms == 0 ||
+        (int)config->transport < 0 || config->transport > CONSUMPTION_REPLICA_FILE) {
+        return NULL;
+    }
+
+    consumption_replica_t* replica = (consumption_replica_t*)calloc(1, sizeof(consumption_replica_t));
+    if (!replica) {
+        return NULL;
+    }
+    replica->config = *config;
+    replica->primary = primary;
+    replica->fd = -1;
+    replica->listen_fd = -1;
+    replica->watch_fd = -1;
+    pthread_mutex_init(&replica->lock, NULL);
+    replica->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (replica->epoll_fd < 0) {
+        free(replica);
+        return NULL;
+    }
+    return replica;
+}
+
+consumption_replica_t* consumption_replica_primary_start(const consumption_replica_config_t* config) {
+    consumption_replica_t* replica = replica_create(config, true);
+    if (!replica) {
+        return NULL;
+    }
+
+    if (config->transport == CONSUMPTION_REPLICA_FILE) {
+        replica->fd = open(config->path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+        if (replica->fd < 0) {
+            consumption_replica_stop(replica);
+            return NULL;
+        }
+    } else {
+        try_connect(replica);
+    }
+
+    consumption_set_log_handler(on_log_record, replica);
+    replica->need_checkpoint = false;
+    if (replica->fd >= 0 && consumption_log_checkpoint() != CONSUMPTION_SUCCESS) {
+        consumption_replica_stop(replica);
+        return NULL;
+    }
+    return replica;
+}
+
+consumption_replica_t* consumption_replica_standby_start(const consumption_replica_config_t* config) {
+    consumption_replica_t* replica = replica_create(config, false);
+    if (!replica) {
+        return NULL;
+    }
+
+    replica->in = (uint8_t*)malloc(REPLICA_IN_BUFFER);
+    if (!replica->in) {
+        consumption_replica_stop(replica);
+        return NULL;
+    }
+
+    if (config->transport == CONSUMPTION_REPLICA_FILE) {
+        replica->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (replica->watch_fd >= 0) {
+            watch_fd(replica, replica->watch_fd);
+        }
+        open_log_file(replica);
+        return replica;
+    }
+
+    struct sockaddr_un addr;
+    sockaddr_for(config->path, &addr);
+    unlink(config->path);
+    replica->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (replica->listen_fd < 0 ||
+        bind(replica->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(replica->listen_fd, 4) != 0) {
+        consumption_replica_stop(replica);
+        return NULL;
+    }
+    watch_fd(replica, replica->listen_fd);
+    return replica;
+}
+
+int consumption_replica_poll(consumption_replica_t* replica, int timeout_ms) {
+    if (!replica) {
+        return -1;
+    }
+    if (timeout_ms > 0) {
+        struct epoll_event events[4];
+        epoll_wait(replica->epoll_fd, events, 4, timeout_ms);
+    }
+    return replica->primary ? poll_primary(replica) : poll_standby(replica);
+}
+
+int consumption_replica_get_fd(const consumption_replica_t* replica) {
+    return replica ? replica->epoll_fd : -1;
+}
+
+consumption_error_t consumption_replica_promote(consumption_replica_t* replica) {
+    if (!replica || replica->primary) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (replica->promoted) {
+        return CONSUMPTION_SUCCESS;
+    }
+
+    poll_standby(replica);
+    replica->promoted = true;
+    if (replica->fd >= 0) {
+        epoll_ctl(replica->epoll_fd, EPOLL_CTL_DEL, replica->fd, NULL);
+        close(replica->fd);
+        replica->fd = -1;
+    }
+    replica->stats.connected = 0;
+    consumption_platform_log(2, "Replication standby promoted");
+    return CONSUMPTION_SUCCESS;
+}
+
+void consumption_replica_get_stats(consumption_replica_t* replica,
+                                   consumption_replica_stats_t* stats) {
+    if (!replica || !stats) return;
+    pthread_mutex_lock(&replica->lock);
+    *stats = replica->stats;
+    pthread_mutex_unlock(&replica->lock);
+}
+
+void consumption_replica_stop(consumption_replica_t* replica) {
+    if (!replica) return;
+
+    if (replica->primary) {
+        consumption_set_log_handler(NULL, NULL);
+        pthread_mutex_lock(&replica->lock);
+        flush(replica);
+        pthread_mutex_unlock(&replica->lock);
+    }
+    if (replica->fd >= 0) close(replica->fd);
+    if (replica->watch_fd >= 0) close(replica->watch_fd);
+    if (replica->listen_fd >= 0) {
+        close(replica->listen_fd);
+        unlink(replica->config.path);
+    }
+    close(replica->epoll_fd);
+    pthread_mutex_destroy(&replica->lock);
+    free(replica->out);
+    free(replica->in);
+    free(replica);
+}
+
+/* ============================================================================
+ * LOG FILES
+ * ============================================================================ */
+
+consumption_error_t consumption_replica_read_log(const char* path, consumption_log_handler_t handler,
+                                                 void* ctx, uint64_t* records) {
+    if (records) *records = 0;
+    if (!path || !handler) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    uint8_t* buffer = (uint8_t*)malloc(REPLICA_READ_BUFFER);
+    if (!buffer) {
+        close(fd);
+        return CONSUMPTION_ERROR_MEMORY_ERROR;
+    }
+
+    consumption_error_t result = CONSUMPTION_SUCCESS;
+    size_t len = 0;
+    for (;;) {
+        ssize_t n = read(fd, buffer + len, REPLICA_READ_BUFFER - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            /* A frame cut short at the end is still being written */
+            if (n < 0) result = CONSUMPTION_ERROR_INVALID_PARAMETER;
+            break;
+        }
+        len += (size_t)n;
+
+        size_t pos = 0;
+        while (len - pos >= sizeof(frame_header_t)) {
+            frame_header_t header;
+            memcpy(&header, buffer + pos, sizeof(header));
+            if (header.magic != REPLICA_MAGIC || header.size > REPLICA_MAX_PAYLOAD) {
+                result = CONSUMPTION_ERROR_INVALID_PARAMETER;
+                goto done;
+            }
+            if (len - pos < sizeof(header) + header.size) {
+                break;
+            }
+            consumption_log_record_t record;
+            decode_frame(&header, buffer + pos + sizeof(header), &record);
+            handler(&record, ctx);
+            if (records) (*records)++;
+            pos += sizeof(header) + header.size;
+        }
+        memmove(buffer, buffer + pos, len - pos);
+        len -= pos;
+    }
+
+done:
+    free(buffer);
+    close(fd);
+    return result;
+}
+
+#else /* __linux__ not defined */
+
+void consumption_replica_config_default(consumption_replica_config_t* config) {
+    if (config) memset(config, 0, sizeof(consumption_replica_config_t));
+}
+
+consumption_replica_t* consumption_replica_primary_start(const consumption_replica_config_t* config) {
+    (void)config;
+    return NULL;  /* epoll not available */
+}
+
+consumption_replica_t* consumption_replica_standby_start(const consumption_replica_config_t* config) {
+    (void)config;
+    return NULL;
+}
+
+int consumption_replica_poll(consumption_replica_t* replica, int timeout_ms) {
+    (void)replica; (void)timeout_ms;
+    return -1;
+}
+
+int consumption_replica_get_fd(const consumption_replica_t* replica) {
+    (void)replica;
+    return -1;
+}
+
+consumption_error_t consumption_replica_promote(consumption_replica_t* replica) {
+    (void)replica;
+    return CONSUMPTION_ERROR_INVALID_PARAMETER;
+}
+
+void consumption_replica_get_stats(consumption_replica_t* replica,
+                                   consumption_replica_stats_t* stats) {
+    (void)replica;
+    if (stats) memset(stats, 0, sizeof(consumption_replica_stats_t));
+}
+
+void consumption_replica_stop(consumption_replica_t* replica) {
+    (void)replica;
+}
+
+consumption_error_t consumption_replica_read_log(const char* path, consumption_log_handler_t handler,
+                                                 void* ctx, uint64_t* records) {
+    (void)path; (void)handler; (void)ctx;
+    if (records) *records = 0;
+    return CONSUMPTION_ERROR_INVALID_PARAMETER;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,489 @@
+/**
+ * @file consumption_reprocess.c
+ * @brief Aggregate reprocessing implementation
+ *
+ * Every counted unit becomes a cell keyed by period, machine and product,
+ * packed into 64 bits as (period within the partition << 40 | machine << 8
+ * | product). Each time-range partition appends its cells to its own
+ * array, so a partition is only ever touched by one thread and adding is
+ * a sequential write. Small arrays just grow. Once an array is large,
+ * filling it up radix-sorts it by period and machine and merges equal
+ * keys, and it only grows when that leaves it at least half full.
+ * Emitting merges once more, which leaves each machine's period in one
+ * run, and walks the partitions in order. Apart from the radix buckets,
+ * memory is only read and written in sequence.
+ */
+
+#include "consumption_reprocess.h"
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define REPROCESS_MAX_THREADS 64
+#define REPROCESS_PARTITIONS_PER_THREAD 4
+#define REPROCESS_MAX_LOCAL_PERIODS (1u << 24)
+#define REPROCESS_INITIAL_CELLS 4096
+#define REPROCESS_MERGE_CELLS (1u << 20) /* Smaller arrays grow without merging first */
+#define REPROCESS_MAX_CELLS (1u << 30)
+#define REPROCESS_RADIX_BITS 11
+#define REPROCESS_RADIX_PASSES 6        /* 56 key bits */
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef struct {
+    uint64_t key;
+    uint32_t units;
+} cell_t;
+
+typedef struct {
+    cell_t* cells;                  /* Merged prefix, then appended cells */
+    cell_t* scratch;                /* Radix sort buffer, same capacity */
+    uint32_t count;
+    uint32_t capacity;              /* 0 until the first cell */
+    uint32_t merged;                /* Leading cells already merged */
+    uint32_t first_period;          /* Period index of local period 0 */
+    uint32_t period_base;           /* Its start */
+    uint32_t time_lo;               /* Timestamps owned: time_lo + [0, time_span) */
+    uint32_t time_span;
+    uint64_t events;                /* Counted by archive scans */
+    bool failed;
+} partition_t;
+
+struct consumption_reprocess_t {
+    consumption_reprocess_config_t config;
+    uint32_t start;                 /* Start of the period holding time_from */
+    uint32_t per_partition;         /* Periods per partition */
+    uint32_t partition_count;
+    partition_t* partitions;
+    consumption_reprocess_stats_t stats;
+    consumption_aggregate_t aggregate;  /* Emit scratch */
+};
+
+typedef void (*partition_work_t)(consumption_reprocess_t* reprocess, partition_t* partition, void* ctx);
+
+typedef struct {
+    consumption_reprocess_t* reprocess;
+    partition_work_t work;
+    void* ctx;
+    uint32_t next;
+} job_t;
+
+/* ============================================================================
+ * CELLS
+ * ============================================================================ */
+
+/**
+ * @brief LSD radix sort by period and machine (key bits 8-63)
+ *
+ * Only the bits that differ between cells are sorted on, in digits of up
+ * to 11 bits: a day's partition of hourly periods for 10,000 machines
+ * takes two passes.
+ *
+ * @return The array holding the result, cells or scratch
+ */
+static cell_t* radix_sort(cell_t* cells, cell_t* scratch, uint32_t n) {
+    uint64_t varying = 0;
+    for (uint32_t i = 1; i < n; i++) {
+        varying |= cells[i].key ^ cells[0].key;
+    }
+    varying >>= 8;
+    if (varying == 0) {
+        return cells;
+    }
+    const uint32_t low = 8 + (uint32_t)__builtin_ctzll(varying);
+    const uint32_t bits = 64 - (uint32_t)__builtin_clzll(varying) + 8 - low;
+    const uint32_t passes = (bits + REPROCESS_RADIX_BITS - 1) / REPROCESS_RADIX_BITS;
+    const uint32_t width = (bits + passes - 1) / passes;
+    const uint32_t mask = (1u << width) - 1;
+
+    uint32_t counts[REPROCESS_RADIX_PASSES][1u << REPROCESS_RADIX_BITS];
+    memset(counts, 0, passes * sizeof(counts[0]));
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t key = cells[i].key >> low;
+        for (uint32_t d = 0; d < passes; d++) {
+            counts[d][(key >> (d * width)) & mask]++;
+        }
+    }
+
+    for (uint32_t d = 0; d < passes; d++) {
+        const uint32_t shift = low + d * width;
+        uint32_t offset = 0;
+        for (uint32_t v = 0; v <= mask; v++) {
+            uint32_t c = counts[d][v];
+            counts[d][v] = offset;
+            offset += c;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            scratch[counts[d][(cells[i].key >> shift) & mask]++] = cells[i];
+        }
+        cell_t* swap = cells;
+        cells = scratch;
+        scratch = swap;
+    }
+    return cells;
+}
+
+/**
+ * @brief Sort the cells by period and machine and merge equal keys
+ *
+ * Products within a machine's period are merged through a 256-entry
+ * table and keep their first-seen order.
+ */
+static void merge_cells(partition_t* partition) {
+    if (partition->merged == partition->count) {
+        return;
+    }
+    cell_t* sorted = radix_sort(partition->cells, partition->scratch, partition->count);
+    if (sorted != partition->cells) {
+        partition->scratch = partition->cells;
+        partition->cells = sorted;
+    }
+
+    cell_t* cells = partition->cells;
+    const uint32_t n = partition->count;
+    uint32_t stamp[256] = {0};
+    uint32_t slot[256];
+    uint32_t out = 0, run = 0;
+    for (uint32_t i = 0; i < n;) {
+        const uint64_t group = cells[i].key >> 8;
+        uint32_t j = i + 1;
+        if (j == n || (cells[j].key >> 8) != group) {
+            cells[out++] = cells[i];
+            i = j;
+            continue;
+        }
+        run++;
+        for (j = i; j < n && (cells[j].key >> 8) == group; j++) {
+            const uint32_t product = (uint32_t)(cells[j].key & 0xFF);
+            const uint32_t units = cells[j].units;
+            if (stamp[product] != run) {
+                stamp[product] = run;
+                slot[product] = out;
+                cells[out].key = cells[j].key;
+                cells[out].units = 0;
+                out++;
+            }
+            cells[slot[product]].units += units;
+        }
+        i = j;
+    }
+    partition->count = out;
+    partition->merged = out;
+}
+
+static bool grow(partition_t* partition) {
+    if (partition->capacity >= REPROCESS_MAX_CELLS) {
+        return false;
+    }
+    uint32_t capacity = partition->capacity ? partition->capacity * 2 : REPROCESS_INITIAL_CELLS;
+    cell_t* cells = (cell_t*)realloc(partition->cells, (size_t)capacity * sizeof(cell_t));
+    if (!cells) {
+        return false;
+    }
+    partition->cells = cells;
+    cell_t* scratch = (cell_t*)malloc((size_t)capacity * sizeof(cell_t));
+    if (!scratch) {
+        return false;
+    }
+    free(partition->scratch);
+    partition->scratch = scratch;
+    partition->capacity = capacity;
+    return true;
+}
+
+static inline bool cell_add(partition_t* partition, uint64_t key, uint32_t units) {
+    if (partition->count > partition->merged && partition->cells[partition->count - 1].key == key) {
+        partition->cells[partition->count - 1].units += units;
+        return true;
+    }
+    if (partition->count == partition->capacity) {
+        if (partition->capacity >= REPROCESS_MERGE_CELLS) {
+            merge_cells(partition);
+        }
+        if (2 * partition->count >= partition->capacity && !grow(partition)) {
+            return false;
+        }
+    }
+    partition->cells[partition->count].key = key;
+    partition->cells[partition->count].units = units;
+    partition->count++;
+    return true;
+}
+
+static void partition_clear(partition_t* partition) {
+    free(partition->cells);
+    free(partition->scratch);
+    partition->cells = NULL;
+    partition->scratch = NULL;
+    partition->count = 0;
+    partition->capacity = 0;
+    partition->merged = 0;
+}
+
+static inline uint64_t cell_key(uint32_t local_period, uint32_t machine_id, uint8_t product_id) {
+    return ((uint64_t)local_period << 40) | ((uint64_t)machine_id << 8) | product_id;
+}
+
+/* ============================================================================
+ * WORKERS
+ * ============================================================================ */
+
+static void* job_main(void* arg) {
+    job_t* job = (job_t*)arg;
+    for (;;) {
+        uint32_t index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (index >= job->reprocess->partition_count) {
+            return NULL;
+        }
+        job->work(job->reprocess, &job->reprocess->partitions[index], job->ctx);
+    }
+}
+
+/**
+ * @brief Run work on every partition, spread over the configured threads
+ *
+ * Threads that cannot be started leave their share to the others.
+ */
+static void run_partitions(consumption_reprocess_t* reprocess, partition_work_t work, void* ctx) {
+    job_t job = {reprocess, work, ctx, 0};
+    pthread_t threads[REPROCESS_MAX_THREADS];
+    uint32_t started = 0;
+    for (uint32_t t = 1; t < reprocess->config.threads && t < reprocess->partition_count; t++) {
+        if (pthread_create(&threads[started], NULL, job_main, &job) != 0) {
+            break;
+        }
+        started++;
+    }
+    job_main(&job);
+    for (uint32_t t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+}
+
+typedef struct {
+    consumption_reprocess_t* reprocess;
+    partition_t* partition;
+} scan_t;
+
+static void scan_rows(const consumption_archive_rows_t* rows, void* user) {
+    scan_t* scan = (scan_t*)user;
+    partition_t* partition = scan->partition;
+    const uint32_t interval = scan->reprocess->config.interval;
+    if (partition->failed) {
+        return;
+    }
+    for (uint32_t r = 0; r < rows->count; r++) {
+        const uint32_t t = rows->timestamp[r];
+        if (t - partition->time_lo >= partition->time_span) {
+            continue;
+        }
+        uint64_t key = cell_key((t - partition->period_base) / interval, rows->machine_id[r],
+                                rows->product_id[r]);
+        if (!cell_add(partition, key, rows->quantity[r])) {
+            partition->failed = true;
+            return;
+        }
+        partition->events++;
+    }
+}
+
+static void scan_partition(consumption_reprocess_t* reprocess, partition_t* partition, void* ctx) {
+    scan_t scan = {reprocess, partition};
+    consumption_archive_scan((const consumption_archive_t*)ctx, partition->time_lo,
+                             partition->time_lo + partition->time_span, scan_rows, &scan);
+}
+
+static void merge_partition(consumption_reprocess_t* reprocess, partition_t* partition, void* ctx) {
+    (void)reprocess;
+    (void)ctx;
+    merge_cells(partition);
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+void consumption_reprocess_config_default(consumption_reprocess_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    config->interval = 3600;
+    config->threads = 1;
+}
+
+consumption_reprocess_t* consumption_reprocess_create(const consumption_reprocess_config_t* config) {
+    if (!config || config->interval == 0 || config->time_to <= config->time_from ||
+        config->threads == 0 || config->threads > REPROCESS_MAX_THREADS) {
+        return NULL;
+    }
+
+    /* First period: the one holding time_from */
+    const uint32_t interval = config->interval;
+    const uint32_t alignment = config->alignment % interval;
+    uint32_t offset = (config->time_from >= alignment)
+        ? (config->time_from - alignment) % interval
+        : (interval - (alignment - config->time_from) % interval) % interval;
+    const uint32_t start = config->time_from - offset;
+    const uint64_t periods = ((uint64_t)config->time_to - start + interval - 1) / interval;
+    if ((uint64_t)start + periods * interval - 1 > UINT32_MAX) {
+        return NULL;
+    }
+    uint64_t partitions = (uint64_t)config->threads * REPROCESS_PARTITIONS_PER_THREAD;
+    if (partitions > periods) {
+        partitions = periods;
+    }
+    const uint64_t per_partition = (periods + partitions - 1) / partitions;
+    if (per_partition > REPROCESS_MAX_LOCAL_PERIODS) {
+        return NULL;
+    }
+    partitions = (periods + per_partition - 1) / per_partition;
+
+    consumption_reprocess_t* reprocess = (consumption_reprocess_t*)calloc(1, sizeof(consumption_reprocess_t));
+    if (!reprocess) {
+        return NULL;
+    }
+    reprocess->config = *config;
+    reprocess->config.alignment = alignment;
+    reprocess->start = start;
+    reprocess->per_partition = (uint32_t)per_partition;
+    reprocess->partition_count = (uint32_t)partitions;
+    reprocess->partitions = (partition_t*)calloc(partitions, sizeof(partition_t));
+    if (!reprocess->partitions) {
+        free(reprocess);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < reprocess->partition_count; i++) {
+        partition_t* partition = &reprocess->partitions[i];
+        uint64_t first = (uint64_t)i * per_partition;
+        uint64_t lo = start + first * interval;
+        uint64_t hi = lo + per_partition * interval;
+        partition->first_period = (uint32_t)first;
+        partition->period_base = (uint32_t)lo;
+        if (lo < config->time_from) lo = config->time_from;
+        if (hi > config->time_to) hi = config->time_to;
+        partition->time_lo = (uint32_t)lo;
+        partition->time_span = (uint32_t)(hi - lo);
+    }
+    reprocess->stats.partitions = reprocess->partition_count;
+    return reprocess;
+}
+
+consumption_error_t consumption_reprocess_add(consumption_reprocess_t* reprocess,
+                                              const consumption_event_t* events, uint32_t count) {
+    if (!reprocess || (!events && count > 0)) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    const uint32_t from = reprocess->config.time_from;
+    const uint32_t span = reprocess->config.time_to - from;
+    for (uint32_t i = 0; i < count; i++) {
+        const consumption_event_t* e = &events[i];
+        if (e->timestamp - from >= span) {
+            reprocess->stats.skipped++;
+            continue;
+        }
+        uint32_t period = (e->timestamp - reprocess->start) / reprocess->config.interval;
+        uint32_t index = period / reprocess->per_partition;
+        partition_t* partition = &reprocess->partitions[index];
+        uint64_t key = cell_key(period - partition->first_period, e->machine_id, e->product_id);
+        if (!cell_add(partition, key, e->quantity)) {
+            return CONSUMPTION_ERROR_MEMORY_ERROR;
+        }
+        reprocess->stats.events++;
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_reprocess_add_log(consumption_reprocess_t* reprocess,
+                                                  const consumption_log_record_t* record) {
+    if (!reprocess || !record) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (record->type != CONSUMPTION_LOG_DISPENSE) {
+        return CONSUMPTION_SUCCESS;
+    }
+    return consumption_reprocess_add(reprocess, &record->event, 1);
+}
+
+consumption_error_t consumption_reprocess_add_archive(consumption_reprocess_t* reprocess,
+                                                      const consumption_archive_t* archive) {
+    if (!reprocess || !archive) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    run_partitions(reprocess, scan_partition, (void*)archive);
+
+    consumption_error_t result = CONSUMPTION_SUCCESS;
+    for (uint32_t i = 0; i < reprocess->partition_count; i++) {
+        partition_t* partition = &reprocess->partitions[i];
+        reprocess->stats.events += partition->events;
+        partition->events = 0;
+        if (partition->failed) {
+            partition->failed = false;
+            result = CONSUMPTION_ERROR_MEMORY_ERROR;
+        }
+    }
+    return result;
+}
+
+consumption_error_t consumption_reprocess_emit(consumption_reprocess_t* reprocess,
+                                               consumption_reprocess_aggregate_cb_t on_aggregate,
+                                               void* user) {
+    if (!reprocess || !on_aggregate) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    run_partitions(reprocess, merge_partition, NULL);
+
+    consumption_aggregate_t* aggregate = &reprocess->aggregate;
+    const uint32_t interval = reprocess->config.interval;
+    for (uint32_t p = 0; p < reprocess->partition_count; p++) {
+        partition_t* partition = &reprocess->partitions[p];
+        const cell_t* cells = partition->cells;
+        const uint32_t n = partition->count;
+        for (uint32_t i = 0; i < n;) {
+            const uint64_t group = cells[i].key >> 8;
+            uint32_t period = partition->first_period + (uint32_t)(group >> 32);
+            uint32_t total = 0, j = i;
+            for (; j < n && (cells[j].key >> 8) == group; j++) {
+                aggregate->product_counts[cells[j].key & 0xFF] += cells[j].units;
+                total += cells[j].units;
+            }
+            aggregate->machine_id = (uint32_t)group;
+            aggregate->period_start = reprocess->start + period * interval;
+            aggregate->period_end = aggregate->period_start + interval;
+            aggregate->total_events = total;
+            on_aggregate(aggregate, user);
+            reprocess->stats.aggregates++;
+            for (; i < j; i++) {
+                aggregate->product_counts[cells[i].key & 0xFF] = 0;
+            }
+        }
+        partition_clear(partition);
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+void consumption_reprocess_get_stats(const consumption_reprocess_t* reprocess,
+                                     consumption_reprocess_stats_t* stats) {
+    if (!reprocess || !stats) return;
+    *stats = reprocess->stats;
+    stats->cells = 0;
+    stats->memory_bytes = sizeof(*reprocess) + reprocess->partition_count * sizeof(partition_t);
+    for (uint32_t i = 0; i < reprocess->partition_count; i++) {
+        const partition_t* partition = &reprocess->partitions[i];
+        stats->cells += partition->count;
+        stats->memory_bytes += (uint64_t)partition->capacity * 2 * sizeof(cell_t);
+    }
+}
+
+void consumption_reprocess_destroy(consumption_reprocess_t* reprocess) {
+    if (!reprocess) return;
+    for (uint32_t i = 0; i < reprocess->partition_count; i++) {
+        partition_clear(&reprocess->partitions[i]);
+    }
+    free(reprocess->partitions);
+    free(reprocess);
+}
@@ -0,0 +1,446 @@
+/**
+ * @file consumption_rollup.c
+ * @brief Hierarchical rollup cube implementation
+ *
+ * Every node (machine, site, region) owns a ring of bucket cells, each a
+ * row of per-product counters with the total in column 0. A cell is tagged
+ * with the bucket number it holds; a stale tag means the slot was evicted
+ * and is cleared on its next write. Node IDs are mapped to dense indexes by
+ * open-addressing tables sized at creation.
+ *
+ * The optional machine index keeps one bitmap of active machine indexes
+ * per (bucket slot, product), tagged per slot like the cells.
+ */
+
+#include "consumption_rollup.h"
+#include "consumption_bitmap.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define ROLLUP_EMPTY 0u             /* Table slot / cell tag: unused */
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t* ids;                  /* Node ID per index */
+    uint32_t* parent;               /* Index of the node one level up */
+    uint32_t* table;                /* ID hash -> index + 1 */
+    uint32_t table_mask;
+    uint32_t* tags;                 /* Per cell: bucket number + 1 */
+    uint32_t* counts;               /* Per cell: products counters */
+} rollup_level_t;
+
+struct consumption_rollup_t {
+    consumption_rollup_config_t config;
+    rollup_level_t levels[CONSUMPTION_ROLLUP_LEVELS];
+    uint32_t* last_end;             /* Per machine: period_end of the last aggregate */
+    consumption_bitmap_t** index;   /* Per slot and product: active machines, or NULL */
+    uint32_t* index_tags;           /* Per slot: bucket number + 1 */
+    uint32_t newest;                /* Newest bucket number + 1, 0 = none yet */
+    uint64_t aggregates;
+    uint64_t duplicates;
+    uint64_t late;
+    uint32_t memory_bytes;
+};
+
+/* ============================================================================
+ * INTERNAL FUNCTIONS
+ * ============================================================================ */
+
+static uint32_t table_home(const rollup_level_t* level, uint32_t id) {
+    return (id * 2654435761u) & level->table_mask;
+}
+
+/**
+ * @brief Index of a node, or -1 if unknown
+ */
+static int32_t find_node(const rollup_level_t* level, uint32_t id) {
+    for (uint32_t i = 0, h = table_home(level, id); i <= level->table_mask;
+         i++, h = (h + 1) & level->table_mask) {
+        uint32_t entry = level->table[h];
+        if (entry == ROLLUP_EMPTY) {
+            return -1;
+        }
+        if (level->ids[entry - 1] == id) {
+            return (int32_t)(entry - 1);
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Index of a node, created if needed
+ * @return -1 if the level is full
+ */
+static int32_t insert_node(rollup_level_t* level, uint32_t id, uint32_t parent) {
+    int32_t index = find_node(level, id);
+    if (index >= 0) {
+        return index;
+    }
+    if (level->count >= level->capacity) {
+        return -1;
+    }
+
+    uint32_t h = table_home(level, id);
+    while (level->table[h] != ROLLUP_EMPTY) {
+        h = (h + 1) & level->table_mask;
+    }
+    index = (int32_t)level->count++;
+    level->ids[index] = id;
+    level->parent[index] = parent;
+    level->table[h] = (uint32_t)index + 1;
+    return index;
+}
+
+static bool level_alloc(rollup_level_t* level, uint32_t capacity, uint32_t buckets,
+                        uint32_t products, uint64_t* bytes) {
+    uint32_t table_size = 4;
+    while (table_size < capacity * 2) {
+        table_size *= 2;
+    }
+
+    uint64_t cells = (uint64_t)capacity * buckets;
+    level->capacity = capacity;
+    level->table_mask = table_size - 1;
+    level->ids = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    level->parent = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    level->table = (uint32_t*)calloc(table_size, sizeof(uint32_t));
+    level->tags = (uint32_t*)calloc((size_t)cells, sizeof(uint32_t));
+    level->counts = (uint32_t*)calloc((size_t)(cells * products), sizeof(uint32_t));
+
+    *bytes += ((uint64_t)capacity * 2 + table_size + cells + cells * products) * sizeof(uint32_t);
+    return level->ids && level->parent && level->table && level->tags && level->counts;
+}
+
+static void level_free(rollup_level_t* level) {
+    free(level->ids);
+    free(level->parent);
+    free(level->table);
+    free(level->tags);
+    free(level->counts);
+}
+
+/**
+ * @brief Cell of a node for a bucket, cleared first if it held an older one
+ */
+static uint32_t* write_cell(consumption_rollup_t* cube, rollup_level_t* level,
+                            uint32_t node, uint32_t bucket) {
+    uint32_t cell = node * cube->config.buckets + bucket % cube->config.buckets;
+    uint32_t* counts = &level->counts[(size_t)cell * cube->config.products];
+    if (level->tags[cell] != bucket + 1) {
+        memset(counts, 0, cube->config.products * sizeof(uint32_t));
+        level->tags[cell] = bucket + 1;
+    }
+    return counts;
+}
+
+/**
+ * @brief Cell of a node for a bucket, NULL if it does not hold that bucket
+ */
+static const uint32_t* read_cell(const consumption_rollup_t* cube, consumption_rollup_level_t level,
+                                 uint32_t id, uint32_t timestamp, bool* known) {
+    const rollup_level_t* l = &cube->levels[level];
+    int32_t node = find_node(l, id);
+    *known = (node >= 0);
+    if (node < 0) {
+        return NULL;
+    }
+
+    uint32_t bucket = timestamp / cube->config.bucket_seconds;
+    uint32_t cell = (uint32_t)node * cube->config.buckets + bucket % cube->config.buckets;
+    if (l->tags[cell] != bucket + 1) {
+        return NULL;
+    }
+    return &l->counts[(size_t)cell * cube->config.products];
+}
+
+/**
+ * @brief Mark a machine active in the index for the products it dispensed
+ */
+static consumption_error_t index_machine(consumption_rollup_t* cube, uint32_t machine,
+                                         uint32_t bucket, const uint8_t* ids, uint32_t n,
+                                         bool any) {
+    const uint32_t products = cube->config.products;
+    uint32_t slot = bucket % cube->config.buckets;
+    consumption_bitmap_t** row = &cube->index[(size_t)slot * products];
+
+    if (cube->index_tags[slot] != bucket + 1) {
+        for (uint32_t p = 0; p < products; p++) {
+            consumption_bitmap_clear(row[p]);
+        }
+        cube->index_tags[slot] = bucket + 1;
+    }
+
+    for (uint32_t i = 0; i <= n; i++) {
+        uint32_t p = (i < n) ? ids[i] : 0;
+        if (i == n && !any) {
+            break;
+        }
+        if (!row[p] && !(row[p] = consumption_bitmap_create())) {
+            return CONSUMPTION_ERROR_MEMORY_ERROR;
+        }
+        if (!consumption_bitmap_add(row[p], machine)) {
+            return CONSUMPTION_ERROR_MEMORY_ERROR;
+        }
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+void consumption_rollup_config_default(consumption_rollup_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    config->max_machines = 256;
+    config->max_sites = 32;
+    config->max_regions = 8;
+    config->products = 256;
+    config->bucket_seconds = 3600;
+    config->buckets = 24;
+    config->index_machines = false;
+}
+
+consumption_rollup_t* consumption_rollup_create(const consumption_rollup_config_t* config) {
+    consumption_rollup_config_t defaults;
+    if (!config) {
+        consumption_rollup_config_default(&defaults);
+        config = &defaults;
+    }
+    if (config->max_machines == 0 || config->max_sites == 0 || config->max_regions == 0 ||
+        config->max_machines > (1u << 24) || config->max_sites > config->max_machines ||
+        config->max_regions > config->max_sites ||
+        config->products < 2 || config->products > 256 ||
+        config->bucket_seconds == 0 || config->buckets == 0 || config->buckets > 65536) {
+        return NULL;
+    }
+
+    consumption_rollup_t* cube = (consumption_rollup_t*)calloc(1, sizeof(consumption_rollup_t));
+    if (!cube) {
+        return NULL;
+    }
+    cube->config = *config;
+
+    const uint32_t capacity[CONSUMPTION_ROLLUP_LEVELS] = {
+        config->max_machines, config->max_sites, config->max_regions
+    };
+    uint64_t bytes = sizeof(*cube) + (uint64_t)config->max_machines * sizeof(uint32_t);
+    bool ok = true;
+    for (int l = 0; l < CONSUMPTION_ROLLUP_LEVELS; l++) {
+        ok = level_alloc(&cube->levels[l], capacity[l], config->buckets, config->products,
+                         &bytes) && ok;
+    }
+    cube->last_end = (uint32_t*)calloc(config->max_machines, sizeof(uint32_t));
+    if (config->index_machines) {
+        size_t rows = (size_t)config->buckets * config->products;
+        cube->index = (consumption_bitmap_t**)calloc(rows, sizeof(consumption_bitmap_t*));
+        cube->index_tags = (uint32_t*)calloc(config->buckets, sizeof(uint32_t));
+        ok = ok && cube->index && cube->index_tags;
+        bytes += rows * sizeof(consumption_bitmap_t*) + config->buckets * sizeof(uint32_t);
+    }
+    if (!ok || !cube->last_end || bytes > UINT32_MAX) {
+        consumption_rollup_destroy(cube);
+        return NULL;
+    }
+
+    cube->memory_bytes = (uint32_t)bytes;
+    return cube;
+}
+
+consumption_error_t consumption_rollup_add_machine(consumption_rollup_t* cube, uint32_t machine_id,
+                                                   uint32_t site_id, uint32_t region_id) {
+    if (!cube) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    rollup_level_t* machines = &cube->levels[CONSUMPTION_ROLLUP_MACHINE];
+    rollup_level_t* sites = &cube->levels[CONSUMPTION_ROLLUP_SITE];
+    rollup_level_t* regions = &cube->levels[CONSUMPTION_ROLLUP_REGION];
+
+    /* Check the whole path before creating anything */
+    int32_t machine = find_node(machines, machine_id);
+    int32_t site = find_node(sites, site_id);
+    int32_t region = find_node(regions, region_id);
+    if (site >= 0 && (region < 0 || sites->parent[site] != (uint32_t)region)) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (machine >= 0) {
+        return (site >= 0 && machines->parent[machine] == (uint32_t)site) ?
+            CONSUMPTION_SUCCESS : CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (machines->count >= machines->capacity ||
+        (site < 0 && sites->count >= sites->capacity) ||
+        (region < 0 && regions->count >= regions->capacity)) {
+        return CONSUMPTION_ERROR_STORAGE_FULL;
+    }
+
+    region = insert_node(regions, region_id, 0);
+    site = insert_node(sites, site_id, (uint32_t)region);
+    insert_node(machines, machine_id, (uint32_t)site);
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_rollup_add(consumption_rollup_t* cube,
+                                           const consumption_aggregate_t* aggregate) {
+    if (!cube || !aggregate) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    rollup_level_t* levels = cube->levels;
+    int32_t machine = find_node(&levels[CONSUMPTION_ROLLUP_MACHINE], aggregate->machine_id);
+    if (machine < 0) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    if (aggregate->period_end <= cube->last_end[machine]) {
+        cube->duplicates++;
+        return CONSUMPTION_SUCCESS;
+    }
+
+    uint32_t bucket = aggregate->period_start / cube->config.bucket_seconds;
+    if (cube->newest > 0 && bucket + cube->config.buckets < cube->newest) {
+        cube->late++;
+        return CONSUMPTION_ERROR_INVALID_PARAMETER; /* Already evicted */
+    }
+    if (bucket + 1 > cube->newest) {
+        cube->newest = bucket + 1;
+    }
+
+    /* Collect the delta once, then push it up the three levels */
+    const uint32_t products = cube->config.products;
+    uint8_t ids[256];
+    uint32_t n = 0;
+    for (uint32_t p = 1; p < products; p++) {
+        if (aggregate->product_counts[p] > 0) {
+            ids[n++] = (uint8_t)p;
+        }
+    }
+
+    uint32_t node = (uint32_t)machine;
+    for (int l = 0; l < CONSUMPTION_ROLLUP_LEVELS; l++) {
+        uint32_t* counts = write_cell(cube, &levels[l], node, bucket);
+        counts[0] += aggregate->total_events;
+        for (uint32_t i = 0; i < n; i++) {
+            counts[ids[i]] += aggregate->product_counts[ids[i]];
+        }
+        node = levels[l].parent[node];
+    }
+
+    cube->last_end[machine] = aggregate->period_end;
+    cube->aggregates++;
+    if (cube->index) {
+        return index_machine(cube, (uint32_t)machine, bucket, ids, n,
+                             aggregate->total_events > 0);
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_rollup_query(const consumption_rollup_t* cube,
+                                             consumption_rollup_level_t level, uint32_t id,
+                                             uint32_t timestamp, uint8_t product_id,
+                                             uint64_t* units) {
+    if (!cube || !units || (int)level < 0 || level >= CONSUMPTION_ROLLUP_LEVELS ||
+        product_id >= cube->config.products) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    bool known;
+    const uint32_t* counts = read_cell(cube, level, id, timestamp, &known);
+    if (!known) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    *units = counts ? counts[product_id] : 0;
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_rollup_get_products(const consumption_rollup_t* cube,
+                                                    consumption_rollup_level_t level, uint32_t id,
+                                                    uint32_t timestamp, uint32_t* counts) {
+    if (!cube || !counts || (int)level < 0 || level >= CONSUMPTION_ROLLUP_LEVELS) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    bool known;
+    const uint32_t* cell = read_cell(cube, level, id, timestamp, &known);
+    if (!known) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (cell) {
+        memcpy(counts, cell, cube->config.products * sizeof(uint32_t));
+    } else {
+        memset(counts, 0, cube->config.products * sizeof(uint32_t));
+    }
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_rollup_machines(const consumption_rollup_t* cube, uint8_t product_id,
+                                                uint32_t timestamp, consumption_bitmap_t* machines) {
+    if (!cube || !machines || !cube->index || product_id >= cube->config.products) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    uint32_t bucket = timestamp / cube->config.bucket_seconds;
+    uint32_t slot = bucket % cube->config.buckets;
+    const consumption_bitmap_t* bitmap = cube->index[(size_t)slot * cube->config.products + product_id];
+    if (cube->index_tags[slot] != bucket + 1 || !bitmap) {
+        consumption_bitmap_clear(machines);
+        return CONSUMPTION_SUCCESS;
+    }
+    return consumption_bitmap_copy(machines, bitmap) ?
+        CONSUMPTION_SUCCESS : CONSUMPTION_ERROR_MEMORY_ERROR;
+}
+
+consumption_error_t consumption_rollup_machine_id(const consumption_rollup_t* cube, uint32_t index,
+                                                  uint32_t* machine_id) {
+    if (!cube || !machine_id || index >= cube->levels[CONSUMPTION_ROLLUP_MACHINE].count) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    *machine_id = cube->levels[CONSUMPTION_ROLLUP_MACHINE].ids[index];
+    return CONSUMPTION_SUCCESS;
+}
+
+void consumption_rollup_get_stats(const consumption_rollup_t* cube,
+                                  consumption_rollup_stats_t* stats) {
+    if (!cube || !stats) return;
+    memset(stats, 0, sizeof(*stats));
+    for (int l = 0; l < CONSUMPTION_ROLLUP_LEVELS; l++) {
+        stats->nodes[l] = cube->levels[l].count;
+    }
+    stats->aggregates = cube->aggregates;
+    stats->duplicates = cube->duplicates;
+    stats->late = cube->late;
+    if (cube->newest > 0) {
+        stats->newest_bucket_start = (cube->newest - 1) * cube->config.bucket_seconds;
+    }
+    stats->memory_bytes = cube->memory_bytes;
+    if (cube->index) {
+        size_t rows = (size_t)cube->config.buckets * cube->config.products;
+        for (size_t i = 0; i < rows; i++) {
+            if (cube->index[i]) {
+                stats->memory_bytes += (uint32_t)consumption_bitmap_memory(cube->index[i]);
+            }
+        }
+    }
+}
+
+void consumption_rollup_destroy(consumption_rollup_t* cube) {
+    if (!cube) return;
+    for (int l = 0; l < CONSUMPTION_ROLLUP_LEVELS; l++) {
+        level_free(&cube->levels[l]);
+    }
+    free(cube->last_end);
+    if (cube->index) {
+        size_t rows = (size_t)cube->config.buckets * cube->config.products;
+        for (size_t i = 0; i < rows; i++) {
+            consumption_bitmap_destroy(cube->index[i]);
+        }
+    }
+    free(cube->index);
+    free(cube->index_tags);
+    free(cube);
+}
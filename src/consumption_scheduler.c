@@ -0,0 +1,520 @@
+/**
+ * @file consumption_scheduler.c
+ * @brief Deadline-ordered sync scheduler implementation
+ *
+ * Contexts live in fixed arrays indexed by slot, with a free list and an
+ * open-addressing table from context ID to slot (backward-shift deletion,
+ * so removals leave no tombstones). Each destination keeps a binary
+ * min-heap of the slots waiting on it, keyed by deadline; a slot records
+ * its heap position so removal is O(log n).
+ *
+ * Fairness between destinations is start-time fair queuing: every
+ * dispatch advances the destination's virtual time by SCALE / weight, and
+ * the due destination with the smallest start tag goes next. A
+ * destination that was idle restarts at the current system virtual time,
+ * so it cannot bank credit while it has nothing to send.
+ */
+
+#include "consumption_scheduler.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define SCHED_EMPTY 0u              /* Table slot: unused */
+#define SCHED_IN_FLIGHT UINT32_MAX  /* Heap position: dispatched */
+#define SCHED_FREE (UINT32_MAX - 1) /* Heap position: slot unused */
+#define SCHED_VTIME_SCALE 1000000u  /* Virtual time per dispatch at weight 1 */
+#define SCHED_MAX_WEIGHT 1000u
+
+/* ============================================================================
+ * INTERNAL TYPES
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t weight;
+    uint32_t max_in_flight;         /* 0 = no limit */
+    uint32_t in_flight;
+    uint32_t* heap;                 /* Context slots, min-heap on deadline */
+    uint32_t heap_count;
+    uint32_t heap_capacity;
+    uint64_t vtime;                 /* Finish tag of the last dispatch */
+    uint64_t dispatched;
+} sched_destination_t;
+
+struct consumption_scheduler_t {
+    consumption_scheduler_config_t config;
+
+    /* Contexts, per slot */
+    uint32_t* ids;
+    uint32_t* deadline;
+    uint32_t* interval;
+    uint32_t* heap_pos;             /* Index in the destination heap, or SCHED_IN_FLIGHT/FREE */
+    uint8_t* destination;
+    uint8_t* failures;              /* Consecutive failed uploads */
+    uint8_t* removed;               /* Removed while in flight */
+    uint32_t* free_slots;
+    uint32_t free_count;
+    uint32_t* table;                /* ID hash -> slot + 1 */
+    uint32_t table_mask;
+
+    sched_destination_t* destinations;
+    uint32_t destination_count;
+    uint64_t system_vtime;          /* Start tag of the last dispatch */
+
+    uint64_t tokens;
+    uint32_t refilled_at;
+
+    uint32_t contexts;
+    uint32_t in_flight;
+    uint64_t dispatched;
+    uint64_t failed;
+    uint64_t throttled;
+    uint64_t capped;
+    uint32_t max_lateness;
+};
+
+/* ============================================================================
+ * INTERNAL FUNCTIONS
+ * ============================================================================ */
+
+static uint32_t table_home(const consumption_scheduler_t* sched, uint32_t id) {
+    return (id * 2654435761u) & sched->table_mask;
+}
+
+/**
+ * @brief Table slot holding an ID, or the empty slot it would take
+ */
+static uint32_t* find_entry(const consumption_scheduler_t* sched, uint32_t id) {
+    uint32_t h = table_home(sched, id);
+    while (sched->table[h] != SCHED_EMPTY && sched->ids[sched->table[h] - 1] != id) {
+        h = (h + 1) & sched->table_mask;
+    }
+    return &sched->table[h];
+}
+
+static void delete_entry(consumption_scheduler_t* sched, uint32_t* entry) {
+    uint32_t hole = (uint32_t)(entry - sched->table);
+    uint32_t j = hole;
+    for (;;) {
+        j = (j + 1) & sched->table_mask;
+        if (sched->table[j] == SCHED_EMPTY) {
+            break;
+        }
+        /* Move back entries whose home is not between the hole and j */
+        uint32_t home = table_home(sched, sched->ids[sched->table[j] - 1]);
+        if (((j - home) & sched->table_mask) >= ((j - hole) & sched->table_mask)) {
+            sched->table[hole] = sched->table[j];
+            hole = j;
+        }
+    }
+    sched->table[hole] = SCHED_EMPTY;
+}
+
+static void heap_set(consumption_scheduler_t* sched, sched_destination_t* dest,
+                     uint32_t pos, uint32_t slot) {
+    dest->heap[pos] = slot;
+    sched->heap_pos[slot] = pos;
+}
+
+static void sift_up(consumption_scheduler_t* sched, sched_destination_t* dest, uint32_t pos) {
+    uint32_t slot = dest->heap[pos];
+    while (pos > 0) {
+        uint32_t parent = (pos - 1) / 2;
+        if (sched->deadline[dest->heap[parent]] <= sched->deadline[slot]) {
+            break;
+        }
+        heap_set(sched, dest, pos, dest->heap[parent]);
+        pos = parent;
+    }
+    heap_set(sched, dest, pos, slot);
+}
+
+static void sift_down(consumption_scheduler_t* sched, sched_destination_t* dest, uint32_t pos) {
+    uint32_t slot = dest->heap[pos];
+    for (;;) {
+        uint32_t child = pos * 2 + 1;
+        if (child >= dest->heap_count) {
+            break;
+        }
+        if (child + 1 < dest->heap_count &&
+            sched->deadline[dest->heap[child + 1]] < sched->deadline[dest->heap[child]]) {
+            child++;
+        }
+        if (sched->deadline[slot] <= sched->deadline[dest->heap[child]]) {
+            break;
+        }
+        heap_set(sched, dest, pos, dest->heap[child]);
+        pos = child;
+    }
+    heap_set(sched, dest, pos, slot);
+}
+
+static bool heap_push(consumption_scheduler_t* sched, sched_destination_t* dest, uint32_t slot) {
+    if (dest->heap_count == dest->heap_capacity) {
+        uint32_t capacity = dest->heap_capacity ? dest->heap_capacity * 2 : 64;
+        uint32_t* heap = (uint32_t*)realloc(dest->heap, capacity * sizeof(uint32_t));
+        if (!heap) {
+            return false;
+        }
+        dest->heap = heap;
+        dest->heap_capacity = capacity;
+    }
+    dest->heap[dest->heap_count++] = slot;
+    sift_up(sched, dest, dest->heap_count - 1);
+    return true;
+}
+
+static void heap_remove(consumption_scheduler_t* sched, sched_destination_t* dest, uint32_t pos) {
+    uint32_t last = dest->heap[--dest->heap_count];
+    if (pos == dest->heap_count) {
+        return;
+    }
+    heap_set(sched, dest, pos, last);
+    sift_down(sched, dest, pos);
+    sift_up(sched, dest, sched->heap_pos[last]);
+}
+
+static void release_slot(consumption_scheduler_t* sched, uint32_t slot) {
+    delete_entry(sched, find_entry(sched, sched->ids[slot]));
+    sched->heap_pos[slot] = SCHED_FREE;
+    sched->free_slots[sched->free_count++] = slot;
+    sched->contexts--;
+}
+
+static bool can_dispatch(const sched_destination_t* dest) {
+    return dest->max_in_flight == 0 || dest->in_flight < dest->max_in_flight;
+}
+
+static uint64_t start_tag(const consumption_scheduler_t* sched, const sched_destination_t* dest) {
+    return dest->vtime > sched->system_vtime ? dest->vtime : sched->system_vtime;
+}
+
+/**
+ * @brief Tokens available at now
+ */
+static uint64_t tokens_at(const consumption_scheduler_t* sched, uint32_t now) {
+    if (sched->config.rate == 0) {
+        return UINT64_MAX;
+    }
+    uint64_t tokens = sched->tokens;
+    if (now > sched->refilled_at) {
+        tokens += (uint64_t)(now - sched->refilled_at) * sched->config.rate;
+    }
+    return tokens < sched->config.burst ? tokens : sched->config.burst;
+}
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+void consumption_scheduler_config_default(consumption_scheduler_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    config->max_contexts = 1024;
+    config->max_destinations = 16;
+    config->rate = 0;
+    config->burst = 100;
+    config->retry_min = 10;
+    config->retry_max = 600;
+}
+
+consumption_scheduler_t* consumption_scheduler_create(const consumption_scheduler_config_t* config) {
+    consumption_scheduler_config_t defaults;
+    if (!config) {
+        consumption_scheduler_config_default(&defaults);
+        config = &defaults;
+    }
+    if (config->max_contexts == 0 || config->max_contexts > (1u << 24) ||
+        config->max_destinations == 0 || config->max_destinations > 256 ||
+        (config->rate > 0 && config->burst == 0) ||
+        config->retry_min == 0 || config->retry_max < config->retry_min) {
+        return NULL;
+    }
+
+    consumption_scheduler_t* sched = (consumption_scheduler_t*)calloc(1, sizeof(consumption_scheduler_t));
+    if (!sched) {
+        return NULL;
+    }
+    sched->config = *config;
+
+    uint32_t capacity = config->max_contexts;
+    uint32_t table_size = 4;
+    while (table_size < capacity * 2) {
+        table_size *= 2;
+    }
+    sched->table_mask = table_size - 1;
+
+    sched->ids = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    sched->deadline = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    sched->interval = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    sched->heap_pos = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    sched->destination = (uint8_t*)calloc(capacity, 1);
+    sched->failures = (uint8_t*)calloc(capacity, 1);
+    sched->removed = (uint8_t*)calloc(capacity, 1);
+    sched->free_slots = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    sched->table = (uint32_t*)calloc(table_size, sizeof(uint32_t));
+    sched->destinations = (sched_destination_t*)calloc(config->max_destinations,
+                                                       sizeof(sched_destination_t));
+    if (!sched->ids || !sched->deadline || !sched->interval || !sched->heap_pos ||
+        !sched->destination || !sched->failures || !sched->removed || !sched->free_slots ||
+        !sched->table || !sched->destinations) {
+        consumption_scheduler_destroy(sched);
+        return NULL;
+    }
+
+    /* Lowest slots first */
+    for (uint32_t i = 0; i < capacity; i++) {
+        sched->free_slots[i] = capacity - 1 - i;
+        sched->heap_pos[i] = SCHED_FREE;
+    }
+    sched->free_count = capacity;
+    sched->tokens = config->burst;
+    return sched;
+}
+
+int consumption_scheduler_add_destination(consumption_scheduler_t* sched, uint32_t weight,
+                                          uint32_t max_in_flight) {
+    if (!sched || weight == 0 || weight > SCHED_MAX_WEIGHT ||
+        sched->destination_count >= sched->config.max_destinations) {
+        return -1;
+    }
+    sched_destination_t* dest = &sched->destinations[sched->destination_count];
+    dest->weight = weight;
+    dest->max_in_flight = max_in_flight;
+    dest->vtime = sched->system_vtime;
+    return (int)sched->destination_count++;
+}
+
+consumption_error_t consumption_scheduler_add(consumption_scheduler_t* sched, uint32_t context_id,
+                                              uint32_t destination, uint32_t interval,
+                                              uint32_t first_due) {
+    if (!sched || destination >= sched->destination_count || interval == 0) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    uint32_t* entry = find_entry(sched, context_id);
+    if (*entry != SCHED_EMPTY) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    if (sched->free_count == 0) {
+        return CONSUMPTION_ERROR_STORAGE_FULL;
+    }
+
+    uint32_t slot = sched->free_slots[sched->free_count - 1];
+    sched->ids[slot] = context_id;
+    sched->deadline[slot] = first_due;
+    sched->interval[slot] = interval;
+    sched->destination[slot] = (uint8_t)destination;
+    sched->failures[slot] = 0;
+    sched->removed[slot] = 0;
+    if (!heap_push(sched, &sched->destinations[destination], slot)) {
+        return CONSUMPTION_ERROR_MEMORY_ERROR;
+    }
+    sched->free_count--;
+    *entry = slot + 1;
+    sched->contexts++;
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_scheduler_remove(consumption_scheduler_t* sched, uint32_t context_id) {
+    if (!sched) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    uint32_t entry = *find_entry(sched, context_id);
+    if (entry == SCHED_EMPTY || sched->removed[entry - 1]) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    uint32_t slot = entry - 1;
+    if (sched->heap_pos[slot] == SCHED_IN_FLIGHT) {
+        sched->removed[slot] = 1;   /* Released by consumption_scheduler_complete() */
+        return CONSUMPTION_SUCCESS;
+    }
+    heap_remove(sched, &sched->destinations[sched->destination[slot]], sched->heap_pos[slot]);
+    release_slot(sched, slot);
+    return CONSUMPTION_SUCCESS;
+}
+
+uint32_t consumption_scheduler_poll(consumption_scheduler_t* sched, uint32_t now,
+                                    uint32_t* context_ids, uint32_t max) {
+    if (!sched || !context_ids) {
+        return 0;
+    }
+
+    if (sched->config.rate > 0) {
+        sched->tokens = tokens_at(sched, now);
+        sched->refilled_at = now;
+    }
+
+    uint32_t n = 0;
+    bool capped = false;
+    while (n < max) {
+        /* Due destination with the smallest start tag */
+        sched_destination_t* best = NULL;
+        uint64_t best_tag = 0;
+        for (uint32_t d = 0; d < sched->destination_count; d++) {
+            sched_destination_t* dest = &sched->destinations[d];
+            if (dest->heap_count == 0 || sched->deadline[dest->heap[0]] > now) {
+                continue;
+            }
+            if (!can_dispatch(dest)) {
+                capped = true;
+                continue;
+            }
+            uint64_t tag = start_tag(sched, dest);
+            if (!best || tag < best_tag) {
+                best = dest;
+                best_tag = tag;
+            }
+        }
+        if (!best) {
+            break;
+        }
+        if (sched->config.rate > 0) {
+            if (sched->tokens == 0) {
+                sched->throttled++;
+                break;
+            }
+            sched->tokens--;
+        }
+
+        uint32_t slot = best->heap[0];
+        heap_remove(sched, best, 0);
+        sched->heap_pos[slot] = SCHED_IN_FLIGHT;
+        best->in_flight++;
+        best->dispatched++;
+        best->vtime = best_tag + SCHED_VTIME_SCALE / best->weight;
+        sched->system_vtime = best_tag;
+        sched->in_flight++;
+        sched->dispatched++;
+
+        uint32_t lateness = now - sched->deadline[slot];
+        if (lateness > sched->max_lateness) {
+            sched->max_lateness = lateness;
+        }
+        context_ids[n++] = sched->ids[slot];
+    }
+
+    if (capped) {
+        sched->capped++;
+    }
+    return n;
+}
+
+consumption_error_t consumption_scheduler_complete(consumption_scheduler_t* sched, uint32_t context_id,
+                                                   bool success, uint32_t now) {
+    if (!sched) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    uint32_t entry = *find_entry(sched, context_id);
+    if (entry == SCHED_EMPTY || sched->heap_pos[entry - 1] != SCHED_IN_FLIGHT) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    uint32_t slot = entry - 1;
+    sched_destination_t* dest = &sched->destinations[sched->destination[slot]];
+    dest->in_flight--;
+    sched->in_flight--;
+    if (!success) {
+        sched->failed++;
+    }
+
+    if (sched->removed[slot]) {
+        release_slot(sched, slot);
+        return CONSUMPTION_SUCCESS;
+    }
+
+    if (success) {
+        sched->failures[slot] = 0;
+        uint32_t next = sched->deadline[slot] + sched->interval[slot];
+        sched->deadline[slot] = (next > now) ? next : now + sched->interval[slot];
+    } else {
+        if (sched->failures[slot] < 31) {
+            sched->failures[slot]++;
+        }
+        uint64_t delay = (uint64_t)sched->config.retry_min << (sched->failures[slot] - 1);
+        sched->deadline[slot] = now + (uint32_t)(delay < sched->config.retry_max ?
+                                                 delay : sched->config.retry_max);
+    }
+
+    /* The slot came out of this heap, so there is room */
+    heap_push(sched, dest, slot);
+    return CONSUMPTION_SUCCESS;
+}
+
+consumption_error_t consumption_scheduler_next_due(const consumption_scheduler_t* sched, uint32_t now,
+                                                   uint32_t* timestamp) {
+    if (!sched || !timestamp) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+
+    bool found = false;
+    uint32_t earliest = 0;
+    for (uint32_t d = 0; d < sched->destination_count; d++) {
+        const sched_destination_t* dest = &sched->destinations[d];
+        if (dest->heap_count > 0 && can_dispatch(dest)) {
+            uint32_t deadline = sched->deadline[dest->heap[0]];
+            if (!found || deadline < earliest) {
+                earliest = deadline;
+                found = true;
+            }
+        }
+    }
+    if (!found) {
+        *timestamp = 0;
+        return CONSUMPTION_SUCCESS;
+    }
+
+    if (earliest < now) {
+        earliest = now;
+    }
+    if (earliest == now && tokens_at(sched, now) == 0) {
+        earliest = now + 1; /* Rate is at least one token per second */
+    }
+    *timestamp = earliest;
+    return CONSUMPTION_SUCCESS;
+}
+
+void consumption_scheduler_get_stats(const consumption_scheduler_t* sched,
+                                     consumption_scheduler_stats_t* stats) {
+    if (!sched || !stats) return;
+    memset(stats, 0, sizeof(*stats));
+    stats->contexts = sched->contexts;
+    stats->in_flight = sched->in_flight;
+    stats->dispatched = sched->dispatched;
+    stats->failed = sched->failed;
+    stats->throttled = sched->throttled;
+    stats->capped = sched->capped;
+    stats->max_lateness = sched->max_lateness;
+}
+
+consumption_error_t consumption_scheduler_get_destination_stats(const consumption_scheduler_t* sched,
+                                                                uint32_t destination,
+                                                                consumption_scheduler_destination_stats_t* stats) {
+    if (!sched || !stats || destination >= sched->destination_count) {
+        return CONSUMPTION_ERROR_INVALID_PARAMETER;
+    }
+    const sched_destination_t* dest = &sched->destinations[destination];
+    stats->contexts = dest->heap_count;
+    stats->in_flight = dest->in_flight;
+    stats->dispatched = dest->dispatched;
+    return CONSUMPTION_SUCCESS;
+}
+
+void consumption_scheduler_destroy(consumption_scheduler_t* sched) {
+    if (!sched) return;
+    if (sched->destinations) {
+        for (uint32_t d = 0; d < sched->config.max_destinations; d++) {
+            free(sched->destinations[d].heap);
+        }
+    }
+    free(sched->ids);
+    free(sched->deadline);
+    free(sched->interval);
+    free(sched->heap_pos);
+    free(sched->destination);
+    free(sched->failures);
+    free(sched->removed);
+    free(sched->free_slots);
+    free(sched->table);
+    free(sched->destinations);
+    free(sched);
+}
@@ -0,0 +1,1548 @@
+/**
+ * @file benchmark.c
+ * @brief Performance benchmarks for Consumption Counter Module
+ *
+ * Run all benchmarks, or only those whose name contains the given filter:
+ *   ./benchmark [filter]
+ *
+ * Link with src/consumption.c, src/consumption_http.c, src/consumption_rollup.c,
+ * src/consumption_bitmap.c, src/consumption_archive.c, src/consumption_replica.c,
+ * src/consumption_crdt.c, src/consumption_scheduler.c, src/consumption_fleet.c,
+ * src/consumption_profile.c, src/consumption_batch.c, src/consumption_ingest.c
+ * and src/consumption_reprocess.c (-lpthread).
+ */
+
+#include "consumption.h"
+#include "consumption_archive.h"
+#include "consumption_batch.h"
+#include "consumption_bitmap.h"
+#include "consumption_crdt.h"
+#include "consumption_fleet.h"
+#include "consumption_http.h"
+#include "consumption_ingest.h"
+#include "consumption_profile.h"
+#include "consumption_replica.h"
+#include "consumption_reprocess.h"
+#include "consumption_rollup.h"
+#include "consumption_scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/* Mock platform functions for benchmarking */
+static uint32_t mock_timestamp = 1000000000;
+static unsigned char mock_storage[4096];
+static const char* mock_storage_file = NULL;   /* Set: writes go to this file */
+
+uint32_t consumption_platform_get_timestamp(void) {
+    return mock_timestamp;
+}
+
+bool consumption_platform_storage_read(void* data, size_t size) {
+    if (size > sizeof(mock_storage)) {
+        return false;
+    }
+    memcpy(data, mock_storage, size);
+    return true;
+}
+
+bool consumption_platform_storage_write(const void* data, size_t size) {
+    if (size > sizeof(mock_storage)) {
+        return false;
+    }
+    memcpy(mock_storage, data, size);
+    if (mock_storage_file) {
+        /* Same pattern as the Linux platform layer */
+        int fd = open(mock_storage_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        ssize_t written = write(fd, data, size);
+        close(fd);
+        return written == (ssize_t)size;
+    }
+    return true;
+}
+
+bool consumption_platform_network_send(const char* endpoint, const char* data, size_t data_len) {
+    (void)endpoint; (void)data; (void)data_len;
+    return true;
+}
+
+bool consumption_platform_network_send_stream(const char* endpoint,
+                                            size_t (*read_cb)(char* buffer, size_t size, void* ctx),
+                                            void* ctx) {
+    char chunk[1024];
+    (void)endpoint;
+    while (read_cb(chunk, sizeof(chunk), ctx) > 0) {
+    }
+    return true;
+}
+
+void consumption_platform_log(int level, const char* message) {
+    (void)level; (void)message;
+}
+
+void* consumption_platform_malloc(size_t size) {
+    return malloc(size);
+}
+
+void consumption_platform_free(void* ptr) {
+    free(ptr);
+}
+
+void consumption_platform_enter_critical(void) {}
+void consumption_platform_exit_critical(void) {}
+
+bool consumption_platform_init(void) { return true; }
+void consumption_platform_deinit(void) {}
+
+/* ============================================================================
+ * HELPERS
+ * ============================================================================ */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* ============================================================================
+ * BENCHMARKS
+ * ============================================================================ */
+
+/**
+ * @brief Time from consumption_init() to the first accepted dispense
+ *
+ * Builds histories of increasing size, shuts down, then measures the cold
+ * start. The restored state has a fixed size, so the result should not
+ * depend on the history length.
+ */
+static void bench_cold_start(void) {
+    static const uint32_t histories[] = {10000, 1000000, 10000000};
+    consumption_config_t config = {
+        .machine_id = 1,
+        .ring_buffer_size = 10000,
+        .aggregation_interval = 3600,
+    };
+
+    printf("cold_start: init + first dispense (ring %u events)\n", config.ring_buffer_size);
+    for (size_t h = 0; h < sizeof(histories) / sizeof(histories[0]); h++) {
+        memset(mock_storage, 0, sizeof(mock_storage));
+        consumption_init(&config);
+        for (uint32_t i = 0; i < histories[h]; i++) {
+            if ((i & 0xFF) == 0) mock_timestamp++;
+            consumption_on_dispense(1, (uint8_t)(1 + i % 32));
+        }
+        consumption_deinit();
+
+        const int runs = 100;
+        uint64_t best = UINT64_MAX;
+        for (int r = 0; r < runs; r++) {
+            uint64_t start = now_ns();
+            consumption_init(&config);
+            consumption_on_dispense(1, 1);
+            uint64_t elapsed = now_ns() - start;
+            consumption_deinit();
+            if (elapsed < best) best = elapsed;
+        }
+
+        uint32_t total_events;
+        consumption_init(&config);
+        consumption_get_stats(&total_events, NULL, NULL);
+        consumption_deinit();
+
+        printf("  history %9u events: %8.1f us (restored total %u)\n",
+               histories[h], best / 1000.0, total_events);
+    }
+}
+
+/**
+ * @brief Dispense path cost with and without the raw event ring
+ */
+static void bench_dispense(void) {
+    const uint32_t iterations = 10000000;
+    consumption_config_t config = {
+        .machine_id = 2,
+        .ring_buffer_size = 1000,
+        .aggregation_interval = 3600,
+    };
+
+    printf("dispense: %u single-event calls\n", iterations);
+    for (int mode = 0; mode < 2; mode++) {
+        config.counter_only = (mode == 1);
+        memset(mock_storage, 0, sizeof(mock_storage));
+        consumption_init(&config);
+
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < iterations; i++) {
+            consumption_on_dispense(2, (uint8_t)(1 + (i & 31)));
+        }
+        uint64_t elapsed = now_ns() - start;
+
+        consumption_footprint_t fp;
+        consumption_get_footprint(&fp);
+        consumption_deinit();
+
+        printf("  %-13s %6.2f ns/event, heap %6u B, static %5u B\n",
+               mode ? "counter-only" : "ring",
+               (double)elapsed / iterations, fp.total_heap_bytes, fp.total_static_bytes);
+    }
+}
+
+/**
+ * @brief Batch dispense throughput against the single-event loop
+ */
+static void bench_batch_dispense(void) {
+    const uint32_t units = 10000000;
+    static const uint32_t batch_sizes[] = {1, 16, 256};
+    consumption_dispense_t batch[256];
+    consumption_config_t config = {
+        .machine_id = 3,
+        .ring_buffer_size = 1000,
+        .aggregation_interval = 3600,
+        .enable_external_api = true,
+    };
+
+    printf("batch_dispense: %u units, one unit per record\n", units);
+
+    memset(mock_storage, 0, sizeof(mock_storage));
+    consumption_init(&config);
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < units; i++) {
+        consumption_on_dispense(3, (uint8_t)(1 + (i & 31)));
+    }
+    uint64_t loop_ns = now_ns() - start;
+    consumption_deinit();
+    printf("  single-event loop   %6.2f ns/unit\n", (double)loop_ns / units);
+
+    for (size_t b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); b++) {
+        uint32_t size = batch_sizes[b];
+        for (uint32_t i = 0; i < size; i++) {
+            batch[i].timestamp = 0;
+            batch[i].product_id = (uint8_t)(1 + (i & 31));
+            batch[i].quantity = 1;
+        }
+
+        memset(mock_storage, 0, sizeof(mock_storage));
+        consumption_init(&config);
+        start = now_ns();
+        for (uint32_t done = 0; done < units; done += size) {
+            consumption_on_dispense_batch(3, batch, size);
+        }
+        uint64_t batch_ns = now_ns() - start;
+        consumption_deinit();
+
+        printf("  batch of %-4u       %6.2f ns/unit (%.1fx)\n", size,
+               (double)batch_ns / units, (double)loop_ns / batch_ns);
+    }
+}
+
+/**
+ * @brief State persist cost, plaintext against sealed
+ *
+ * Each consumption_update_config() saves the state once. "memory" storage
+ * is a memcpy and shows the raw sealing cost; "file" rewrites a file the
+ * way the Linux platform layer does.
+ */
+static void bench_persist(void) {
+    const uint32_t iterations[2] = {200000, 20000};
+    char path[] = "/tmp/consumption-bench-XXXXXX";
+    consumption_config_t config = {
+        .machine_id = 6,
+        .ring_buffer_size = 100,
+        .aggregation_interval = 3600,
+    };
+    uint8_t key[CONSUMPTION_STORAGE_KEY_SIZE];
+    for (int i = 0; i < CONSUMPTION_STORAGE_KEY_SIZE; i++) {
+        key[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        printf("persist: skipped, no temporary file\n");
+        return;
+    }
+    close(fd);
+
+    printf("persist: state saves\n");
+    for (int backend = 0; backend < 2; backend++) {
+        mock_storage_file = backend ? path : NULL;
+        double plain_ns = 0;
+
+        for (int sealed = 0; sealed < 2; sealed++) {
+            consumption_set_storage_key(sealed ? key : NULL);
+            memset(mock_storage, 0, sizeof(mock_storage));
+            consumption_init(&config);
+            for (uint32_t i = 0; i < 1000; i++) {
+                consumption_on_dispense(6, (uint8_t)(1 + (i & 63)));
+            }
+
+            uint64_t start = now_ns();
+            for (uint32_t i = 0; i < iterations[backend]; i++) {
+                consumption_update_config(&config);
+            }
+            double per_save = (double)(now_ns() - start) / iterations[backend];
+            consumption_deinit();
+
+            if (!sealed) {
+                plain_ns = per_save;
+                printf("  %-6s plaintext %8.0f ns/save\n", backend ? "file" : "memory", per_save);
+            } else {
+                printf("  %-6s sealed    %8.0f ns/save (%+.1f%%)\n", backend ? "file" : "memory",
+                       per_save, 100.0 * (per_save - plain_ns) / plain_ns);
+            }
+        }
+    }
+
+    consumption_set_storage_key(NULL);
+    mock_storage_file = NULL;
+    unlink(path);
+}
+
+/**
+ * @brief Rollup cube ingest and region queries against summing machines
+ *
+ * 4096 machines in 64 sites and 8 regions report one aggregate per hour
+ * for a day. A region query reads one cube cell; the baseline sums the
+ * region's 512 machine cells as a gateway without the cube would.
+ */
+static void bench_rollup(void) {
+    enum { MACHINES = 4096, SITES = 64, REGIONS = 8, HOURS = 24, QUERIES = 100000 };
+    static consumption_aggregate_t aggregate;
+    consumption_rollup_config_t config;
+    consumption_rollup_config_default(&config);
+    config.max_machines = MACHINES;
+    config.max_sites = SITES;
+    config.max_regions = REGIONS;
+    config.products = 64;
+
+    consumption_rollup_t* cube = consumption_rollup_create(&config);
+    if (!cube) {
+        printf("rollup: skipped, out of memory\n");
+        return;
+    }
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        consumption_rollup_add_machine(cube, 1000 + m, m % SITES, (m % SITES) % REGIONS);
+    }
+
+    const uint32_t base = 1000000000u / 3600 * 3600;
+    uint64_t start = now_ns();
+    for (uint32_t h = 0; h < HOURS; h++) {
+        for (uint32_t m = 0; m < MACHINES; m++) {
+            memset(aggregate.product_counts, 0, sizeof(aggregate.product_counts));
+            aggregate.machine_id = 1000 + m;
+            aggregate.period_start = base + h * 3600;
+            aggregate.period_end = aggregate.period_start + 3600;
+            aggregate.total_events = 0;
+            for (uint32_t p = 1; p <= 12; p++) {
+                aggregate.product_counts[(m + p * 5) % 63 + 1] += p;
+                aggregate.total_events += p;
+            }
+            consumption_rollup_add(cube, &aggregate);
+        }
+    }
+    double ingest_ns = (double)(now_ns() - start) / (HOURS * MACHINES);
+
+    uint64_t units;
+    const uint32_t hour = base + (HOURS - 1) * 3600;
+    start = now_ns();
+    for (uint32_t q = 0; q < QUERIES; q++) {
+        consumption_rollup_query(cube, CONSUMPTION_ROLLUP_REGION, q % REGIONS, hour, 7, &units);
+    }
+    double cube_ns = (double)(now_ns() - start) / QUERIES;
+
+    const uint32_t scans = QUERIES / 100;
+    start = now_ns();
+    for (uint32_t q = 0; q < scans; q++) {
+        uint32_t region = q % REGIONS;
+        for (uint32_t m = 0; m < MACHINES; m++) {
+            if ((m % SITES) % REGIONS == region) {
+                consumption_rollup_query(cube, CONSUMPTION_ROLLUP_MACHINE, 1000 + m, hour, 7, &units);
+            }
+        }
+    }
+    double scan_ns = (double)(now_ns() - start) / scans;
+
+    consumption_rollup_stats_t stats;
+    consumption_rollup_get_stats(cube, &stats);
+    consumption_rollup_destroy(cube);
+
+    printf("rollup: %d machines, %d sites, %d regions, %d hourly buckets, %u KB\n",
+           MACHINES, SITES, REGIONS, HOURS, stats.memory_bytes / 1024);
+    printf("  ingest              %8.1f ns/aggregate\n", ingest_ns);
+    printf("  region query, cube  %8.1f ns\n", cube_ns);
+    printf("  region query, scan  %8.1f ns (%.0fx)\n", scan_ns, scan_ns / cube_ns);
+}
+
+/**
+ * @brief "Sold product 17 and 5 but not 9 this hour" over 100k machines
+ *
+ * Bitmap index intersection against asking the cube machine by machine.
+ */
+static void bench_bitmap(void) {
+    enum { MACHINES = 100000, PRODUCTS = 32, QUERIES = 1000 };
+    static consumption_aggregate_t aggregate;
+    consumption_rollup_config_t config;
+    consumption_rollup_config_default(&config);
+    config.max_machines = MACHINES;
+    config.max_sites = 1000;
+    config.max_regions = 10;
+    config.products = PRODUCTS;
+    config.buckets = 2;
+    config.index_machines = true;
+
+    consumption_rollup_t* cube = consumption_rollup_create(&config);
+    consumption_bitmap_t* result = consumption_bitmap_create();
+    consumption_bitmap_t* other = consumption_bitmap_create();
+    if (!cube || !result || !other) {
+        printf("bitmap: skipped, out of memory\n");
+        consumption_rollup_destroy(cube);
+        consumption_bitmap_destroy(result);
+        consumption_bitmap_destroy(other);
+        return;
+    }
+
+    const uint32_t hour = 1000000000u / 3600 * 3600;
+    uint32_t seed = 12345;
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        consumption_rollup_add_machine(cube, 1000 + m, m % 1000, (m % 1000) % 10);
+        memset(aggregate.product_counts, 0, sizeof(aggregate.product_counts));
+        aggregate.machine_id = 1000 + m;
+        aggregate.period_start = hour;
+        aggregate.period_end = hour + 3600;
+        aggregate.total_events = 0;
+        for (uint32_t k = 0; k < 8; k++) {
+            seed = seed * 1103515245u + 12345u;
+            aggregate.product_counts[1 + (seed >> 16) % (PRODUCTS - 1)]++;
+            aggregate.total_events++;
+        }
+        consumption_rollup_add(cube, &aggregate);
+    }
+
+    uint32_t found = 0;
+    uint64_t start = now_ns();
+    for (uint32_t q = 0; q < QUERIES; q++) {
+        consumption_rollup_machines(cube, 17, hour, result);
+        consumption_rollup_machines(cube, 5, hour, other);
+        consumption_bitmap_and(result, other);
+        consumption_rollup_machines(cube, 9, hour, other);
+        consumption_bitmap_andnot(result, other);
+        found = consumption_bitmap_cardinality(result);
+    }
+    double bitmap_ns = (double)(now_ns() - start) / QUERIES;
+
+    uint32_t scanned = 0;
+    const uint32_t scans = QUERIES / 100;
+    start = now_ns();
+    for (uint32_t q = 0; q < scans; q++) {
+        scanned = 0;
+        for (uint32_t m = 0; m < MACHINES; m++) {
+            uint64_t a, b, c;
+            consumption_rollup_query(cube, CONSUMPTION_ROLLUP_MACHINE, 1000 + m, hour, 17, &a);
+            consumption_rollup_query(cube, CONSUMPTION_ROLLUP_MACHINE, 1000 + m, hour, 5, &b);
+            consumption_rollup_query(cube, CONSUMPTION_ROLLUP_MACHINE, 1000 + m, hour, 9, &c);
+            scanned += (a && b && !c);
+        }
+    }
+    double scan_ns = (double)(now_ns() - start) / scans;
+
+    consumption_bitmap_t* all = consumption_bitmap_create();
+    size_t index_bytes = 0;
+    if (all && consumption_rollup_machines(cube, 0, hour, all) == CONSUMPTION_SUCCESS) {
+        index_bytes = consumption_bitmap_memory(all);
+    }
+    consumption_bitmap_destroy(all);
+    consumption_bitmap_destroy(result);
+    consumption_bitmap_destroy(other);
+    consumption_rollup_destroy(cube);
+
+    printf("bitmap: %d machines, %d products, %u matches%s\n", MACHINES, PRODUCTS, found,
+           found == scanned ? "" : " (scan disagrees)");
+    printf("  bitmap (17 & 5) & ~9  %10.1f us\n", bitmap_ns / 1000.0);
+    printf("  per-machine scan      %10.1f us (%.0fx)\n", scan_ns / 1000.0, scan_ns / bitmap_ns);
+    printf("  any-product bitmap    %10zu bytes\n", index_bytes);
+}
+
+/**
+ * @brief Sync scheduling for 100k machine contexts on one gateway
+ *
+ * Steady state: one poll per second for two hours, uploads completing at
+ * once, against looping over every context each tick. Outage: every
+ * context is overdue when polling resumes; the backlog drains at the
+ * configured rate, uploads take a second, and destinations share the
+ * rate by weight within their in-flight caps.
+ */
+static void bench_scheduler(void) {
+    enum { CONTEXTS = 100000, DESTINATIONS = 8, INTERVAL = 3600, BATCH = 4096 };
+    static const uint32_t weights[DESTINATIONS] = {1, 1, 1, 1, 2, 2, 4, 4};
+    static uint32_t last_sync[CONTEXTS];
+    static uint32_t due[BATCH], in_flight[BATCH];
+    consumption_scheduler_config_t config;
+    consumption_scheduler_config_default(&config);
+    config.max_contexts = CONTEXTS;
+
+    for (int outage = 0; outage < 2; outage++) {
+        config.rate = outage ? 1000 : 0;
+        config.burst = outage ? 1000 : 100;
+        consumption_scheduler_t* sched = consumption_scheduler_create(&config);
+        if (!sched) {
+            printf("scheduler: skipped, out of memory\n");
+            return;
+        }
+        for (uint32_t d = 0; d < DESTINATIONS; d++) {
+            consumption_scheduler_add_destination(sched, weights[d], 256);
+        }
+        const uint32_t t0 = 1000000000u;
+        for (uint32_t c = 0; c < CONTEXTS; c++) {
+            consumption_scheduler_add(sched, c, c % DESTINATIONS, INTERVAL, t0 + c % INTERVAL);
+        }
+
+        if (!outage) {
+            uint64_t dispatched = 0;
+            uint64_t start = now_ns();
+            for (uint32_t now = t0; now < t0 + 2 * INTERVAL; now++) {
+                uint32_t n = consumption_scheduler_poll(sched, now, due, BATCH);
+                for (uint32_t i = 0; i < n; i++) {
+                    consumption_scheduler_complete(sched, due[i], true, now);
+                }
+                dispatched += n;
+            }
+            double sched_ns = (double)(now_ns() - start) / (2 * INTERVAL);
+
+            /* The same schedule, checked context by context */
+            for (uint32_t c = 0; c < CONTEXTS; c++) {
+                last_sync[c] = t0 + c % INTERVAL - INTERVAL;
+            }
+            uint64_t scanned = 0;
+            start = now_ns();
+            for (uint32_t now = t0; now < t0 + 2 * INTERVAL; now++) {
+                for (uint32_t c = 0; c < CONTEXTS; c++) {
+                    if (now - last_sync[c] >= INTERVAL) {
+                        last_sync[c] = now;
+                        scanned++;
+                    }
+                }
+            }
+            double scan_ns = (double)(now_ns() - start) / (2 * INTERVAL);
+
+            printf("scheduler: %d contexts, %d destinations, %d s interval\n",
+                   CONTEXTS, DESTINATIONS, INTERVAL);
+            printf("  steady state  %9.2f us/tick (%llu syncs), per-context scan %9.2f us/tick (%llu)\n",
+                   sched_ns / 1000.0, (unsigned long long)dispatched, scan_ns / 1000.0,
+                   (unsigned long long)scanned);
+        } else {
+            /* Two hours without polling: everything is overdue */
+            uint32_t now = t0 + 2 * INTERVAL;
+            uint32_t pending = 0, peak = 0, seconds = 0;
+            uint64_t drained = 0;
+            uint64_t start = now_ns();
+            uint64_t first_window[DESTINATIONS] = {0};
+            while (drained < CONTEXTS) {
+                for (uint32_t i = 0; i < pending; i++) {
+                    consumption_scheduler_complete(sched, in_flight[i], true, now);
+                }
+                pending = consumption_scheduler_poll(sched, now, in_flight, BATCH);
+                drained += pending;
+                if (pending > peak) peak = pending;
+                if (seconds < 10) {
+                    for (uint32_t i = 0; i < pending; i++) {
+                        first_window[in_flight[i] % DESTINATIONS]++;
+                    }
+                }
+                now++;
+                seconds++;
+            }
+            double drain_ms = (double)(now_ns() - start) / 1e6;
+
+            consumption_scheduler_stats_t stats;
+            consumption_scheduler_get_stats(sched, &stats);
+            printf("  outage backlog drained in %u s at <= %u/s (rate %u), %.1f ms CPU, max lateness %u s\n",
+                   seconds, peak, config.rate, drain_ms, stats.max_lateness);
+            printf("  first 10 s by destination weight:");
+            for (uint32_t d = 0; d < DESTINATIONS; d++) {
+                printf(" %u:%llu", weights[d], (unsigned long long)first_window[d]);
+            }
+            printf("\n");
+        }
+        consumption_scheduler_destroy(sched);
+    }
+}
+
+/**
+ * @brief Period close for a gateway hosting many machines
+ *
+ * Before: one context struct per machine, as the core keeps it (configuration,
+ * 256 counters, the copy being uploaded), closed by checking each context's
+ * deadline and copying and clearing its counters. After: the fleet's
+ * structure-of-arrays layout at 256 and 32 products. Top of the hour closes
+ * every machine at once; staggered spreads deadlines over a minute, so each
+ * one-second tick closes 1/60 of the fleet.
+ */
+typedef struct {
+    consumption_config_t config;
+    uint32_t period_start;
+    uint32_t total_events;
+    uint32_t counts[256];
+    uint32_t upload_counts[256];
+    uint32_t upload_start;
+    uint32_t upload_end;
+    uint32_t upload_events;
+} bench_fleet_context_t;
+
+static void bench_fleet(void) {
+    enum { MACHINES = 20000, TICKS = 120, STAGGER = 60 };
+    const uint32_t t0 = 1000000000u;
+    bench_fleet_context_t* contexts = (bench_fleet_context_t*)calloc(MACHINES, sizeof(*contexts));
+    if (!contexts) {
+        printf("fleet: skipped, out of memory\n");
+        return;
+    }
+
+    printf("fleet: %d machines, close cost per tick\n", MACHINES);
+    for (int staggered = 0; staggered < 2; staggered++) {
+        const uint32_t interval = staggered ? STAGGER : 1;
+        const char* label = staggered ? "staggered  " : "top of hour";
+
+        /* Before: array of context structs */
+        for (uint32_t m = 0; m < MACHINES; m++) {
+            contexts[m].config.machine_id = m;
+            contexts[m].config.aggregation_interval = interval;
+            contexts[m].period_start = t0 - (staggered ? m % STAGGER : 0);
+        }
+        uint64_t closed = 0, elapsed = 0;
+        for (uint32_t now = t0 + 1; now <= t0 + TICKS; now++) {
+            for (uint32_t m = 0; m < MACHINES; m++) {
+                contexts[m].counts[1 + m % 32]++;
+                contexts[m].total_events++;
+            }
+            uint64_t start = now_ns();
+            for (uint32_t m = 0; m < MACHINES; m++) {
+                bench_fleet_context_t* ctx = &contexts[m];
+                if (now - ctx->period_start < ctx->config.aggregation_interval) {
+                    continue;
+                }
+                memcpy(ctx->upload_counts, ctx->counts, sizeof(ctx->counts));
+                memset(ctx->counts, 0, sizeof(ctx->counts));
+                ctx->upload_start = ctx->period_start;
+                ctx->upload_end = now;
+                ctx->upload_events = ctx->total_events;
+                ctx->total_events = 0;
+                ctx->period_start = now;
+                closed++;
+            }
+            elapsed += now_ns() - start;
+        }
+        double aos_ns = (double)elapsed / TICKS;
+        printf("  %s  structs            %9.1f us/tick (%llu closes)\n", label, aos_ns / 1000.0,
+               (unsigned long long)closed);
+
+        /* After: fleet, all products and a typical machine's 32 */
+        static const uint32_t product_counts[] = {256, 33};
+        for (size_t v = 0; v < 2; v++) {
+            consumption_fleet_config_t config;
+            consumption_fleet_config_default(&config);
+            config.max_machines = MACHINES;
+            config.products = product_counts[v];
+            consumption_fleet_t* fleet = consumption_fleet_create(&config);
+            if (!fleet) {
+                printf("  fleet: skipped, out of memory\n");
+                continue;
+            }
+            consumption_config_t machine = contexts[0].config;
+            for (uint32_t m = 0; m < MACHINES; m++) {
+                machine.machine_id = m;
+                consumption_fleet_add(fleet, &machine, t0 - (staggered ? m % STAGGER : 0));
+            }
+            closed = 0;
+            elapsed = 0;
+            for (uint32_t now = t0 + 1; now <= t0 + TICKS; now++) {
+                for (uint32_t m = 0; m < MACHINES; m++) {
+                    consumption_fleet_dispense(fleet, (int32_t)m, (uint8_t)(1 + m % 32), 1);
+                }
+                uint64_t start = now_ns();
+                closed += consumption_fleet_close(fleet, now);
+                elapsed += now_ns() - start;
+            }
+            double soa_ns = (double)elapsed / TICKS;
+            consumption_fleet_stats_t stats;
+            consumption_fleet_get_stats(fleet, &stats);
+            printf("  %s  fleet %3u products %9.1f us/tick (%llu closes, %.1f MB hot)  %.1fx\n",
+                   label, config.products, soa_ns / 1000.0, (unsigned long long)closed,
+                   (double)stats.hot_bytes / 1e6, aos_ns / soa_ns);
+            consumption_fleet_destroy(fleet);
+        }
+    }
+    free(contexts);
+}
+
+/**
+ * @brief Per-machine settings memory with shared profiles
+ *
+ * 20,000 machines spread over 4 endpoints. Before: each keeps its own
+ * consumption_config_t and consumption_network_config_t. After: the fleet
+ * interns the settings into profiles and keeps a member record per
+ * machine. Also times adding machines through the interner and rotating
+ * the API key of a quarter of the fleet with one profile update.
+ */
+static void bench_profiles(void) {
+    enum { MACHINES = 20000, ENDPOINTS = 4 };
+    consumption_fleet_config_t config;
+    consumption_fleet_config_default(&config);
+    config.max_machines = MACHINES;
+    config.products = 33;
+    consumption_fleet_t* fleet = consumption_fleet_create(&config);
+    if (!fleet) {
+        printf("profiles: skipped, out of memory\n");
+        return;
+    }
+
+    consumption_config_t machine;
+    memset(&machine, 0, sizeof(machine));
+    machine.aggregation_interval = 3600;
+    machine.max_retry_attempts = 3;
+    strcpy(machine.api_key, "0123456789abcdef0123456789abcdef");
+    uint64_t start = now_ns();
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        machine.machine_id = m;
+        snprintf(machine.api_endpoint, sizeof(machine.api_endpoint),
+                 "https://region-%u.example.com/v1/consumption", m % ENDPOINTS);
+        consumption_fleet_add(fleet, &machine, 1000000000u);
+    }
+    double add_ns = (double)(now_ns() - start) / MACHINES;
+
+    strcpy(machine.api_key, "fedcba9876543210fedcba9876543210");
+    snprintf(machine.api_endpoint, sizeof(machine.api_endpoint),
+             "https://region-%u.example.com/v1/consumption", 0u);
+    start = now_ns();
+    consumption_fleet_update_profile(fleet, consumption_fleet_get_profile(fleet, 0), &machine, NULL);
+    double update_us = (double)(now_ns() - start) / 1000.0;
+
+    consumption_fleet_stats_t stats;
+    consumption_fleet_get_stats(fleet, &stats);
+    const size_t inline_bytes = sizeof(consumption_config_t) + sizeof(consumption_network_config_t);
+    printf("profiles: %d machines, %d distinct endpoints\n", MACHINES, ENDPOINTS);
+    printf("  settings per machine   inline %zu B, profiles %.1f B (members, ID table, profiles)\n",
+           inline_bytes, (double)stats.cold_bytes / MACHINES);
+    printf("  add via interning      %9.1f ns/machine\n", add_ns);
+    printf("  key rotation           %9.1f us for %d machines\n", update_us, MACHINES / ENDPOINTS);
+    consumption_fleet_destroy(fleet);
+}
+
+/**
+ * @brief Upstream requests with fan-in batching
+ *
+ * 20,000 machines close hourly periods of 8 products, either all at the
+ * top of the hour or spread over the hour. Before: one upload per machine
+ * and period. After: a batcher with the default 64 KB / 2 s bounds, the
+ * backend rejecting 1% of entries once. Reports requests, payload bytes
+ * and batcher CPU per entry (add, take and complete).
+ */
+static void bench_fan_in(void) {
+    enum { MACHINES = 20000, HOUR = 3600, PRODUCTS = 8 };
+    static consumption_aggregate_t aggregate;
+    static char payload[65536 + 1];
+    static bool accepted[8192];
+    static char single[4608];
+
+    for (int spread = 0; spread < 2; spread++) {
+        consumption_batch_config_t config;
+        consumption_batch_config_default(&config);
+        config.max_entries = MACHINES;
+        consumption_batch_t* batch = consumption_batch_create(&config);
+        if (!batch) {
+            printf("batch: skipped, out of memory\n");
+            return;
+        }
+
+        uint64_t single_bytes = 0, elapsed = 0;
+        uint32_t rng = 12345, next_machine = 0;
+        const uint32_t t0 = 1000000000u;
+        for (uint32_t now = t0; now < t0 + HOUR + 60; now++) {
+            uint32_t closing = spread ? MACHINES / HOUR + (now - t0 < MACHINES % HOUR)
+                                      : (now == t0 ? MACHINES : 0);
+            for (uint32_t i = 0; i < closing && next_machine < MACHINES; i++, next_machine++) {
+                memset(&aggregate, 0, sizeof(aggregate));
+                aggregate.machine_id = next_machine;
+                aggregate.period_start = now - HOUR;
+                aggregate.period_end = now;
+                for (uint32_t p = 1; p <= PRODUCTS; p++) {
+                    aggregate.product_counts[p] = 1 + (next_machine * p) % 97;
+                    aggregate.total_events += aggregate.product_counts[p];
+                }
+                /* As a single upload: the same object on its own */
+                size_t len = (size_t)snprintf(single, sizeof(single),
+                    "{\"machine_id\":%u,\"period_start\":%u,\"period_end\":%u,\"total_events\":%u,\"products\":{",
+                    next_machine, now - HOUR, now, aggregate.total_events);
+                for (uint32_t p = 1; p <= PRODUCTS; p++) {
+                    len += (size_t)snprintf(single + len, sizeof(single) - len, p == 1 ? "\"%u\":%u" : ",\"%u\":%u",
+                                            p, aggregate.product_counts[p]);
+                }
+                single_bytes += len + 2;
+
+                uint64_t start = now_ns();
+                consumption_batch_add(batch, &aggregate, now);
+                elapsed += now_ns() - start;
+            }
+            while (consumption_batch_ready(batch, now)) {
+                uint32_t id;
+                uint64_t start = now_ns();
+                consumption_batch_take(batch, payload, sizeof(payload), &id);
+                elapsed += now_ns() - start;
+                uint32_t count = 0;
+                for (const char* e = payload; (e = strstr(e, "{\"machine_id\"")) != NULL; e++) {
+                    rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+                    accepted[count++] = (rng % 100) != 0;
+                }
+                start = now_ns();
+                consumption_batch_complete(batch, id, accepted, count, now);
+                elapsed += now_ns() - start;
+            }
+        }
+
+        consumption_batch_stats_t stats;
+        consumption_batch_get_stats(batch, &stats);
+        printf("fan_in: %d machines, %s\n", MACHINES, spread ? "closes spread over the hour" : "all close at the top of the hour");
+        printf("  single uploads  %8d requests, %8.1f KB payload\n", MACHINES, (double)single_bytes / 1024.0);
+        printf("  batched         %8llu requests, %8.1f KB payload, %llu entries resent, %.0fx fewer requests\n",
+               (unsigned long long)stats.batches, (double)stats.bytes / 1024.0,
+               (unsigned long long)stats.entries_rejected,
+               (double)MACHINES / (double)stats.batches);
+        printf("  batcher CPU     %8.1f ns/entry, %u left queued\n",
+               (double)elapsed / (double)stats.entries_sent, stats.queued + stats.in_flight);
+        consumption_batch_destroy(batch);
+    }
+}
+
+/* Generic tree parser, allocating a node per value: the baseline for ingest */
+typedef struct dom_node {
+    int type;                       /* 0 number, 1 string, 2 object, 3 array, 4 literal */
+    double number;
+    char* key;
+    char* string;
+    struct dom_node* child;
+    struct dom_node* next;
+} dom_node_t;
+
+static const char* dom_ws(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    return p;
+}
+
+static char* dom_string(const char** pp, const char* end) {
+    const char* p = *pp + 1;
+    const char* start = p;
+    while (p < end && *p != '"') p += (*p == '\\') ? 2 : 1;
+    if (p >= end) return NULL;
+    char* out = (char*)malloc((size_t)(p - start) + 1);
+    memcpy(out, start, (size_t)(p - start));
+    out[p - start] = '\0';
+    *pp = p + 1;
+    return out;
+}
+
+static void dom_free(dom_node_t* node) {
+    while (node) {
+        dom_node_t* next = node->next;
+        dom_free(node->child);
+        free(node->key);
+        free(node->string);
+        free(node);
+        node = next;
+    }
+}
+
+static dom_node_t* dom_parse(const char** pp, const char* end) {
+    const char* p = dom_ws(*pp, end);
+    if (p >= end) return NULL;
+    dom_node_t* node = (dom_node_t*)calloc(1, sizeof(dom_node_t));
+    if (*p == '{' || *p == '[') {
+        bool object = (*p == '{');
+        node->type = object ? 2 : 3;
+        dom_node_t** tail = &node->child;
+        p = dom_ws(p + 1, end);
+        if (p < end && *p == (object ? '}' : ']')) {
+            *pp = p + 1;
+            return node;
+        }
+        for (;;) {
+            char* key = NULL;
+            p = dom_ws(p, end);
+            if (object) {
+                if (p >= end || *p != '"' || !(key = dom_string(&p, end))) break;
+                p = dom_ws(p, end);
+                if (p >= end || *p++ != ':') { free(key); break; }
+            }
+            dom_node_t* child = dom_parse(&p, end);
+            if (!child) { free(key); break; }
+            child->key = key;
+            *tail = child;
+            tail = &child->next;
+            p = dom_ws(p, end);
+            if (p < end && *p == ',') { p++; continue; }
+            if (p < end && *p == (object ? '}' : ']')) { *pp = p + 1; return node; }
+            break;
+        }
+        dom_free(node);
+        return NULL;
+    }
+    if (*p == '"') {
+        node->type = 1;
+        node->string = dom_string(&p, end);
+    } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+        char* stop;
+        node->number = strtod(p, &stop);
+        p = stop;
+    } else {
+        node->type = 4;
+        while (p < end && *p >= 'a' && *p <= 'z') p++;
+    }
+    *pp = p;
+    return node;
+}
+
+static const dom_node_t* dom_member(const dom_node_t* object, const char* key) {
+    for (const dom_node_t* child = object->child; child; child = child->next) {
+        if (strcmp(child->key, key) == 0) return child;
+    }
+    return NULL;
+}
+
+static void count_units(const consumption_sparse_aggregate_t* entry, void* user) {
+    *(uint32_t*)user += entry->total_events;
+}
+
+/**
+ * @brief Backend-side parsing of batch uploads
+ *
+ * Payloads are full 64 KB batches from the batcher, with few products per
+ * machine (the common case) and with many. Compares the ingest parser,
+ * sparse and per-entry dense, against a generic parser that builds a tree
+ * with a node per value and then walks it into aggregates.
+ */
+static void bench_ingest(void) {
+    enum { ENTRIES = 4096, RUNS = 20 };
+    static consumption_aggregate_t aggregate;
+    static char payload[65536 + 1];
+    static const uint32_t product_counts[] = {8, 200};
+
+    for (size_t shape = 0; shape < 2; shape++) {
+        consumption_batch_config_t config;
+        consumption_batch_config_default(&config);
+        config.max_entries = ENTRIES;
+        consumption_batch_t* batch = consumption_batch_create(&config);
+        if (!batch) {
+            printf("ingest: skipped, out of memory\n");
+            return;
+        }
+        memset(&aggregate, 0, sizeof(aggregate));
+        for (uint32_t m = 0; m < ENTRIES; m++) {
+            aggregate.machine_id = 100000 + m;
+            aggregate.period_start = 1700000000;
+            aggregate.period_end = 1700003600;
+            aggregate.total_events = 0;
+            for (uint32_t p = 1; p <= product_counts[shape]; p++) {
+                aggregate.product_counts[p] = 1 + (m * 7919u * p) % 100000;
+                aggregate.total_events += aggregate.product_counts[p];
+            }
+            consumption_batch_add(batch, &aggregate, 0);
+        }
+        uint32_t id;
+        size_t len = consumption_batch_take(batch, payload, sizeof(payload), &id);
+        consumption_batch_destroy(batch);
+
+        /* Entry boundaries, for the per-entry dense parse */
+        static size_t starts[ENTRIES], lens[ENTRIES];
+        uint32_t count = 0;
+        for (const char* e = payload; (e = strstr(e, "{\"machine_id\"")) != NULL; e++) {
+            starts[count] = (size_t)(e - payload);
+            lens[count] = (size_t)(strstr(e, "}}") + 2 - e);
+            count++;
+        }
+
+        uint64_t sparse_ns, dense_ns, dom_ns;
+        uint32_t units = 0, entries = 0;
+        uint64_t start = now_ns();
+        for (int run = 0; run < RUNS; run++) {
+            consumption_ingest_parse_batch(payload, len, NULL, NULL, count_units, &units, &entries);
+        }
+        sparse_ns = now_ns() - start;
+
+        start = now_ns();
+        for (int run = 0; run < RUNS; run++) {
+            for (uint32_t i = 0; i < count; i++) {
+                consumption_ingest_parse(payload + starts[i], lens[i], &aggregate);
+                units += aggregate.total_events;
+            }
+        }
+        dense_ns = now_ns() - start;
+
+        start = now_ns();
+        for (int run = 0; run < RUNS; run++) {
+            const char* p = payload;
+            dom_node_t* root = dom_parse(&p, payload + len);
+            const dom_node_t* list = root ? dom_member(root, "entries") : NULL;
+            for (const dom_node_t* e = list ? list->child : NULL; e; e = e->next) {
+                memset(&aggregate, 0, sizeof(aggregate));
+                aggregate.machine_id = (uint32_t)dom_member(e, "machine_id")->number;
+                aggregate.period_start = (uint32_t)dom_member(e, "period_start")->number;
+                aggregate.period_end = (uint32_t)dom_member(e, "period_end")->number;
+                const dom_node_t* products = dom_member(e, "products");
+                for (const dom_node_t* c = products ? products->child : NULL; c; c = c->next) {
+                    aggregate.product_counts[atoi(c->key) & 0xFF] = (uint32_t)c->number;
+                }
+                units += aggregate.machine_id;
+            }
+            dom_free(root);
+        }
+        dom_ns = now_ns() - start;
+
+        double bytes = (double)len * RUNS;
+        printf("ingest: %u entries, %u products each, %.1f KB payload\n",
+               entries, product_counts[shape], (double)len / 1024.0);
+        printf("  ingest, batch (sparse)  %7.2f GB/s  %7.1f ns/entry\n",
+               bytes / (double)sparse_ns, (double)sparse_ns / ((double)count * RUNS));
+        printf("  ingest, per entry dense %7.2f GB/s  %7.1f ns/entry\n",
+               bytes / (double)dense_ns, (double)dense_ns / ((double)count * RUNS));
+        printf("  generic tree parser     %7.2f GB/s  %7.1f ns/entry, %.1fx slower than batch\n",
+               bytes / (double)dom_ns, (double)dom_ns / ((double)count * RUNS),
+               (double)dom_ns / (double)sparse_ns);
+        if (units == 0) {
+            printf("  (no units parsed)\n");
+        }
+    }
+}
+
+static void count_reprocessed(const consumption_aggregate_t* aggregate, void* user) {
+    *(uint64_t*)user += aggregate->total_events;
+}
+
+/**
+ * @brief Rebuilding a day of aggregates from the archive
+ *
+ * 10,000 machines dispense 2,000,000 events over a day, archived in
+ * arrival order. Rebuilds hourly and 15-minute periods with 1 and 4
+ * threads, timing the archive scan and the sort and emit separately, and
+ * compares the rate at which the scan consumes archive columns with a
+ * memcpy of the same bytes.
+ */
+static void bench_reprocess(void) {
+    enum { MACHINES = 10000, EVENTS = 2000000, DAY = 86400 };
+    const uint32_t day = 1700006400u - 1700006400u % DAY;
+    consumption_event_t* events = (consumption_event_t*)malloc(EVENTS * sizeof(consumption_event_t));
+    consumption_archive_t* archive = consumption_archive_create(NULL);
+    if (!events || !archive) {
+        printf("reprocess: skipped, out of memory\n");
+        free(events);
+        consumption_archive_destroy(archive);
+        return;
+    }
+    uint32_t rng = 2024;
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        events[i].timestamp = day + (uint32_t)((uint64_t)i * DAY / EVENTS);
+        events[i].machine_id = rng % MACHINES;
+        events[i].product_id = (uint8_t)(1 + (rng >> 16) % 24);
+        events[i].quantity = 1;
+    }
+    consumption_archive_append(archive, events, EVENTS);
+    free(events);
+
+    /* Archive columns: timestamp, machine, product, quantity */
+    const size_t column_bytes = (size_t)EVENTS * 11;
+    char* from = (char*)malloc(column_bytes);
+    char* to = (char*)malloc(column_bytes);
+    double memcpy_gbs = 0;
+    if (from && to) {
+        memset(from, 1, column_bytes);
+        memset(to, 0, column_bytes);
+        void* (*volatile copy)(void*, const void*, size_t) = memcpy;
+        uint64_t start = now_ns();
+        copy(to, from, column_bytes);
+        memcpy_gbs = (double)column_bytes / (double)(now_ns() - start);
+    }
+    free(from);
+    free(to);
+
+    printf("reprocess: %d machines, %d events over a day (memcpy of the columns: %.2f GB/s)\n",
+           MACHINES, EVENTS, memcpy_gbs);
+    static const uint32_t intervals[] = {3600, 900};
+    static const uint32_t threads[] = {1, 4};
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t t = 0; t < 2; t++) {
+            consumption_reprocess_config_t config;
+            consumption_reprocess_config_default(&config);
+            config.interval = intervals[i];
+            config.time_from = day;
+            config.time_to = day + DAY;
+            config.threads = threads[t];
+            consumption_reprocess_t* reprocess = consumption_reprocess_create(&config);
+            if (!reprocess) {
+                continue;
+            }
+            uint64_t units = 0;
+            uint64_t start = now_ns();
+            consumption_reprocess_add_archive(reprocess, archive);
+            uint64_t scanned = now_ns();
+            consumption_reprocess_emit(reprocess, count_reprocessed, &units);
+            uint64_t done = now_ns();
+            consumption_reprocess_stats_t stats;
+            consumption_reprocess_get_stats(reprocess, &stats);
+
+            printf("  %4u s periods, %u thread%s  scan %6.1f ms (%.2f GB/s), sort and emit %6.1f ms, "
+                   "%5.1f M events/s, %llu aggregates%s\n",
+                   intervals[i], threads[t], threads[t] > 1 ? "s" : " ",
+                   (double)(scanned - start) / 1e6, (double)column_bytes / (double)(scanned - start),
+                   (double)(done - scanned) / 1e6, (double)EVENTS * 1e3 / (double)(done - start),
+                   (unsigned long long)stats.aggregates, units == EVENTS ? "" : " (MISMATCH)");
+            consumption_reprocess_destroy(reprocess);
+        }
+    }
+    consumption_archive_destroy(archive);
+}
+
+/**
+ * @brief Gossip between two redundant gateways with mergeable counters
+ *
+ * Both gateways receive every machine's aggregate. Measures the size of a
+ * full-state delta and of an incremental one touching 1% of the machines,
+ * delta encoding, and merge throughput into an empty set
+ * (entries created) and into one that already has the counters (a no-op
+ * merge, the common case between redundant gateways).
+ */
+static void bench_crdt(void) {
+    enum { MACHINES = 20000, PRODUCTS = 32, RUNS = 20 };
+    static consumption_aggregate_t aggregate;
+    consumption_crdt_config_t config;
+    consumption_crdt_config_default(&config);
+    config.max_entries = MACHINES * 2;
+    config.products = PRODUCTS;
+
+    consumption_crdt_t* a = consumption_crdt_create(&config);
+    consumption_crdt_t* b = consumption_crdt_create(&config);
+    consumption_crdt_t* c = consumption_crdt_create(&config);
+    const size_t capacity = (size_t)MACHINES * 128;
+    uint8_t* delta = (uint8_t*)malloc(capacity);
+    if (!a || !b || !c || !delta) {
+        printf("crdt: skipped, out of memory\n");
+        consumption_crdt_destroy(a);
+        consumption_crdt_destroy(b);
+        consumption_crdt_destroy(c);
+        free(delta);
+        return;
+    }
+
+    const uint32_t hour = 1000000000u / 3600 * 3600;
+    uint32_t seed = 12345;
+    uint64_t expected = 0;
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        memset(aggregate.product_counts, 0, sizeof(aggregate.product_counts));
+        aggregate.machine_id = 1000 + m;
+        aggregate.period_start = hour;
+        aggregate.period_end = hour + 3600;
+        aggregate.total_events = 0;
+        for (uint32_t k = 0; k < 8; k++) {
+            seed = seed * 1103515245u + 12345u;
+            uint32_t units = 1 + (seed >> 16) % 50;
+            aggregate.product_counts[1 + (seed >> 8) % (PRODUCTS - 1)] += units;
+            aggregate.total_events += units;
+        }
+        expected += aggregate.total_events;
+        consumption_crdt_observe(a, 0, &aggregate);
+        consumption_crdt_observe(b, 0, &aggregate);
+    }
+    consumption_crdt_delta(b, delta, capacity);  /* B's own changes, sent elsewhere */
+
+    /* Full state */
+    uint64_t start = now_ns();
+    size_t full = consumption_crdt_delta(a, delta, capacity);
+    double encode_ns = (double)(now_ns() - start);
+
+    double merge_new_ns = 0, merge_same_ns = 0;
+    for (int r = 0; r < RUNS; r++) {
+        consumption_crdt_destroy(c);
+        c = consumption_crdt_create(&config);
+        start = now_ns();
+        consumption_crdt_merge(c, delta, full);
+        merge_new_ns += (double)(now_ns() - start) / RUNS;
+
+        start = now_ns();
+        consumption_crdt_merge(b, delta, full);
+        merge_same_ns += (double)(now_ns() - start) / RUNS;
+    }
+
+    /* Gateway A counts one more unit for 1% of the machines */
+    for (uint32_t m = 0; m < MACHINES; m += 100) {
+        consumption_crdt_add(a, 1000 + m, hour, 7, 3, 1);
+        expected++;
+    }
+    size_t incremental = consumption_crdt_delta(a, delta, capacity);
+    consumption_crdt_merge(b, delta, incremental);
+
+    uint64_t total = 0;
+    consumption_aggregate_t merged;
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        if (consumption_crdt_read(b, 1000 + m, hour, &merged) == CONSUMPTION_SUCCESS) {
+            total += merged.total_events;
+        }
+    }
+
+    consumption_crdt_stats_t stats;
+    consumption_crdt_get_stats(b, &stats);
+    printf("crdt: %d machines x 8 products, both gateways receive every aggregate\n", MACHINES);
+    printf("  full delta         %8zu B (%.1f B/entry, aggregate %zu B), encoded in %.2f ms\n",
+           full, (double)full / MACHINES, sizeof(consumption_aggregate_t), encode_ns / 1e6);
+    printf("  1%% incremental     %8zu B\n", incremental);
+    printf("  merge, new entries %8.1f M entries/s\n", MACHINES / merge_new_ns * 1e3);
+    printf("  merge, no change   %8.1f M entries/s\n", MACHINES / merge_same_ns * 1e3);
+    printf("  merged total %llu units (%s), set %u KB\n", (unsigned long long)total,
+           total == expected ? "exact" : "MISMATCH", stats.memory_bytes / 1024);
+
+    consumption_crdt_destroy(a);
+    consumption_crdt_destroy(b);
+    consumption_crdt_destroy(c);
+    free(delta);
+}
+
+static void count_row(const consumption_query_row_t* row, void* user) {
+    (void)row;
+    (*(uint32_t*)user)++;
+}
+
+/**
+ * @brief Archive query throughput over 8M events, on one thread and one per CPU
+ *
+ * Every query but the last scans all blocks, so the rate is kernel
+ * throughput; the last one shows block pruning.
+ */
+static void bench_archive(void) {
+    enum { EVENTS = 8 * 1024 * 1024, BATCH = 4096, HOURS = 24, RUNS = 5 };
+    static consumption_event_t batch[BATCH];
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const uint32_t runs[2] = {1, cpus > 1 ? (uint32_t)(cpus < 64 ? cpus : 64) : 0};
+
+    for (int t = 0; t < 2 && runs[t] > 0; t++) {
+        const uint32_t threads = runs[t];
+        consumption_archive_config_t config;
+        consumption_archive_config_default(&config);
+        config.threads = threads;
+        consumption_archive_t* archive = consumption_archive_create(&config);
+        if (!archive) {
+            printf("archive: skipped\n");
+            return;
+        }
+
+        /* Time-ordered, as a gateway archives payloads */
+        const uint32_t base = 1000000000u / 3600 * 3600;
+        uint32_t seed = 7;
+        for (uint32_t i = 0; i < EVENTS; i += BATCH) {
+            for (uint32_t k = 0; k < BATCH; k++) {
+                seed = seed * 1103515245u + 12345u;
+                batch[k].timestamp = base + (uint32_t)((uint64_t)(i + k) * HOURS * 3600 / EVENTS);
+                batch[k].machine_id = 1000 + (seed >> 8) % 5000;
+                batch[k].product_id = (uint8_t)(1 + (seed >> 20) % 64);
+                batch[k].quantity = (uint16_t)(1 + (seed >> 28) % 2);
+            }
+            if (consumption_archive_append(archive, batch, BATCH) != CONSUMPTION_SUCCESS) {
+                printf("archive: skipped, out of memory\n");
+                consumption_archive_destroy(archive);
+                return;
+            }
+        }
+
+        struct {
+            const char* name;
+            uint8_t product;
+            consumption_query_group_t group_by;
+            uint32_t top_n;
+            uint32_t hours;
+        } queries[] = {
+            {"filtered sum", 0, CONSUMPTION_QUERY_GROUP_NONE, 0, HOURS},
+            {"product = 7", 7, CONSUMPTION_QUERY_GROUP_NONE, 0, HOURS},
+            {"by product", 0, CONSUMPTION_QUERY_GROUP_PRODUCT, 0, HOURS},
+            {"by product, hour", 0, CONSUMPTION_QUERY_GROUP_PRODUCT_HOUR, 0, HOURS},
+            {"top 10 products", 0, CONSUMPTION_QUERY_GROUP_PRODUCT, 10, HOURS},
+            {"by product, 1 hour", 0, CONSUMPTION_QUERY_GROUP_PRODUCT, 0, 1},
+        };
+
+        printf("archive: %d events, %u thread(s)\n", EVENTS, threads);
+        for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+            consumption_query_t query;
+            consumption_query_default(&query);
+            query.time_from = base;
+            query.time_to = base + queries[q].hours * 3600;
+            query.machine_from = 2000;          /* Keeps blocks from being covered */
+            query.machine_to = 4999;
+            query.product_id = queries[q].product;
+            query.group_by = queries[q].group_by;
+            query.top_n = queries[q].top_n;
+
+            consumption_query_stats_t stats;
+            uint32_t rows = 0;
+            uint64_t start = now_ns();
+            for (int run = 0; run < RUNS; run++) {
+                consumption_archive_query(archive, &query, count_row, &rows, &stats);
+            }
+            double ns = (double)(now_ns() - start) / RUNS;
+            printf("  %-20s %8.2f ms %8.0f M events/s (%u blocks pruned)\n", queries[q].name,
+                   ns / 1e6, EVENTS / ns * 1e3, stats.blocks_pruned);
+        }
+        consumption_archive_destroy(archive);
+    }
+}
+
+/* What the standby child saw, sent back over a pipe */
+typedef struct {
+    uint64_t applied;
+    uint64_t gaps;
+    uint32_t total_events;
+    uint64_t detected_ns;
+} standby_report_t;
+
+static void run_standby(const consumption_replica_config_t* replica_config,
+                        const consumption_config_t* config, int ready_fd, int report_fd) {
+    memset(mock_storage, 0, sizeof(mock_storage));
+    consumption_init(config);
+    consumption_replica_t* standby = consumption_replica_standby_start(replica_config);
+    char ready = standby ? 1 : 0;
+    if (write(ready_fd, &ready, 1) != 1 || !standby) {
+        _exit(1);
+    }
+
+    consumption_replica_stats_t stats;
+    do {
+        consumption_replica_poll(standby, 100);
+        consumption_replica_get_stats(standby, &stats);
+    } while (!(stats.disconnects > 0 && !stats.connected));
+
+    standby_report_t report = {.detected_ns = now_ns()};
+    consumption_replica_promote(standby);
+    consumption_replica_get_stats(standby, &stats);
+    report.applied = stats.records;
+    report.gaps = stats.gaps;
+    consumption_get_stats(&report.total_events, NULL, NULL);
+    consumption_replica_stop(standby);
+    consumption_deinit();
+    if (write(report_fd, &report, sizeof(report)) != sizeof(report)) {
+        _exit(1);
+    }
+    _exit(0);
+}
+
+/**
+ * @brief Dispense cost with a hot standby, and how fast the standby notices
+ *        the primary going away
+ *
+ * A forked child runs the standby on a Unix socket and reports what it
+ * applied once the primary stops.
+ */
+static void bench_replica(void) {
+    static const char* const names[] = {"none", "async", "sync"};
+    static const uint32_t iterations[] = {1000000, 1000000, 50000};
+    consumption_config_t config = {
+        .machine_id = 7,
+        .ring_buffer_size = 1000,
+        .aggregation_interval = 3600,
+    };
+    consumption_replica_config_t replica_config;
+    consumption_replica_config_default(&replica_config);
+    snprintf(replica_config.path, sizeof(replica_config.path), "/tmp/consumption_bench_%d.wal", (int)getpid());
+
+    printf("replica: dispenses shipped to a standby process over a Unix socket\n");
+    for (int mode = 0; mode < 3; mode++) {
+        int ready_pipe[2], report_pipe[2];
+        pid_t child = -1;
+        if (mode > 0) {
+            replica_config.mode = (mode == 2) ? CONSUMPTION_REPLICA_SYNC : CONSUMPTION_REPLICA_ASYNC;
+            if (pipe(ready_pipe) != 0 || pipe(report_pipe) != 0) {
+                printf("  %-5s cannot create pipes\n", names[mode]);
+                return;
+            }
+            fflush(stdout);
+            child = fork();
+            if (child == 0) {
+                run_standby(&replica_config, &config, ready_pipe[1], report_pipe[1]);
+            }
+            char ready = 0;
+            if (child < 0 || read(ready_pipe[0], &ready, 1) != 1 || !ready) {
+                printf("  %-5s cannot start standby\n", names[mode]);
+                return;
+            }
+        }
+
+        memset(mock_storage, 0, sizeof(mock_storage));
+        consumption_init(&config);
+        consumption_replica_t* primary = mode > 0 ? consumption_replica_primary_start(&replica_config) : NULL;
+
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < iterations[mode]; i++) {
+            consumption_on_dispense(7, (uint8_t)(1 + (i & 31)));
+            if ((i & 255) == 0) {
+                consumption_replica_poll(primary, 0);
+            }
+        }
+        uint64_t elapsed = now_ns() - start;
+
+        uint32_t total_events;
+        consumption_get_stats(&total_events, NULL, NULL);
+        if (mode == 0) {
+            consumption_deinit();
+            printf("  %-5s %7.2f ns/event\n", names[mode], (double)elapsed / iterations[mode]);
+            continue;
+        }
+
+        consumption_replica_stats_t stats;
+        consumption_replica_get_stats(primary, &stats);
+        uint64_t stopped = now_ns();
+        consumption_replica_stop(primary);
+        consumption_deinit();
+
+        standby_report_t report = {0};
+        if (read(report_pipe[0], &report, sizeof(report)) != sizeof(report)) {
+            printf("  %-5s standby failed\n", names[mode]);
+        } else {
+            printf("  %-5s %7.2f ns/event, %6.1f%% acked at end, standby applied %llu records "
+                   "(%s), failover detected in %.1f us\n",
+                   names[mode], (double)elapsed / iterations[mode],
+                   100.0 * stats.acked / stats.records, (unsigned long long)report.applied,
+                   report.total_events == total_events && report.gaps == 0 ? "in sync" : "diverged",
+                   (report.detected_ns - stopped) / 1000.0);
+        }
+        waitpid(child, NULL, 0);
+        close(ready_pipe[0]); close(ready_pipe[1]);
+        close(report_pipe[0]); close(report_pipe[1]);
+    }
+}
+
+/**
+ * @brief Local query endpoint throughput over loopback keep-alive connections
+ *
+ * Clients and server share one thread, so the figure is the server's cost
+ * per request plus the loopback round trip, refreshed once per 1000 requests.
+ */
+static void bench_http_query(void) {
+    const uint32_t requests = 200000;
+    enum { CLIENTS = 8 };
+    static const char request[] = "GET /snapshot HTTP/1.1\r\nHost: gateway\r\n\r\n";
+    consumption_config_t config = {
+        .machine_id = 4,
+        .ring_buffer_size = 100,
+        .aggregation_interval = 3600,
+    };
+
+    memset(mock_storage, 0, sizeof(mock_storage));
+    consumption_init(&config);
+    for (uint32_t i = 0; i < 100000; i++) {
+        consumption_on_dispense(4, (uint8_t)(1 + (i % 200)));
+    }
+
+    consumption_http_config_t http_config;
+    consumption_http_config_default(&http_config);
+    http_config.port = 0;
+    consumption_http_server_t* server = consumption_http_start(&http_config);
+    if (!server) {
+        printf("http_query: cannot start server\n");
+        consumption_deinit();
+        return;
+    }
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(consumption_http_get_port(server));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int clients[CLIENTS];
+    for (int c = 0; c < CLIENTS; c++) {
+        clients[c] = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(clients[c], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        connect(clients[c], (struct sockaddr*)&addr, sizeof(addr));
+    }
+
+    char response[8192];
+    size_t response_len = 0;
+    uint64_t start = now_ns();
+    for (uint32_t done = 0; done < requests; done += CLIENTS) {
+        if (done % 1000 < CLIENTS) {
+            consumption_http_refresh(server);
+        }
+        for (int c = 0; c < CLIENTS; c++) {
+            send(clients[c], request, sizeof(request) - 1, 0);
+        }
+        int answered = 0;
+        while (answered < CLIENTS) {
+            answered += consumption_http_poll(server, 10);
+        }
+        for (int c = 0; c < CLIENTS; c++) {
+            response_len = (size_t)recv(clients[c], response, sizeof(response) - 1, 0);
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    response[response_len] = '\0';
+    consumption_http_stats_t stats;
+    consumption_http_get_stats(server, &stats);
+    printf("http_query: %u GET /snapshot over %d keep-alive connections\n", requests, CLIENTS);
+    printf("  %8.0f req/s, %6.2f us/req, %zu B responses, %s\n",
+           requests / (elapsed / 1e9), (double)elapsed / requests / 1000.0, response_len,
+           strncmp(response, "HTTP/1.1 200", 12) == 0 ? "200 OK" : "unexpected status");
+
+    for (int c = 0; c < CLIENTS; c++) {
+        close(clients[c]);
+    }
+    consumption_http_stop(server);
+    consumption_deinit();
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} benchmark_t;
+
+static const benchmark_t g_benchmarks[] = {
+    {"cold_start", bench_cold_start},
+    {"dispense", bench_dispense},
+    {"batch_dispense", bench_batch_dispense},
+    {"persist", bench_persist},
+    {"rollup", bench_rollup},
+    {"bitmap", bench_bitmap},
+    {"scheduler", bench_scheduler},
+    {"fleet", bench_fleet},
+    {"profiles", bench_profiles},
+    {"fan_in", bench_fan_in},
+    {"ingest", bench_ingest},
+    {"reprocess", bench_reprocess},
+    {"crdt", bench_crdt},
+    {"archive", bench_archive},
+    {"replica", bench_replica},
+    {"http_query", bench_http_query},
+};
+
+int main(int argc, char* argv[]) {
+    const char* filter = (argc > 1) ? argv[1] : NULL;
+
+    printf("Consumption Counter Module - Benchmarks\n");
+    printf("=======================================\n\n");
+
+    for (size_t i = 0; i < sizeof(g_benchmarks) / sizeof(g_benchmarks[0]); i++) {
+        if (filter && !strstr(g_benchmarks[i].name, filter)) {
+            continue;
+        }
+        g_benchmarks[i].run();
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -4,9 +4,29 @@
  */
 
 #include "consumption.h"
+#include "consumption_archive.h"
+#include "consumption_batch.h"
+#include "consumption_bitmap.h"
+#include "consumption_crdt.h"
+#include "consumption_events.h"
+#include "consumption_fleet.h"
+#include "consumption_http.h"
+#include "consumption_ingest.h"
+#include "consumption_profile.h"
+#include "consumption_replica.h"
+#include "consumption_reprocess.h"
+#include "consumption_rollup.h"
+#include "consumption_scheduler.h"
+#include "../src/consumption_crypto.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 /* Mock platform functions for testing */
 uint32_t mock_timestamp = 1000000000; /* 2001-09-09 01:46:40 UTC */
@@ -15,19 +35,60 @@ uint32_t consumption_platform_get_timestamp(void) {
     return mock_timestamp++;
 }
 
+/* In-memory storage, zero-filled like a fresh flash sector */
+static unsigned char mock_storage[4096];
+
 bool consumption_platform_storage_read(void* data, size_t size) {
-    memset(data, 0, size);
+    if (size > sizeof(mock_storage)) {
+        return false;
+    }
+    memcpy(data, mock_storage, size);
+    return true;
+}
+
+static char mock_stream[65536];
+static size_t mock_stream_len = 0;
+static bool mock_stream_supported = true;
+
+bool consumption_platform_network_send_stream(const char* endpoint,
+                                            size_t (*read_cb)(char* buffer, size_t size, void* ctx),
+                                            void* ctx) {
+    (void)endpoint;
+    printf("MOCK: Network stream called\n");
+    if (!mock_stream_supported) {
+        return false; /* Like the MCU ports: nothing pulled */
+    }
+    /* Small, odd-sized pulls exercise items split across reads */
+    char chunk[7];
+    size_t n;
+    mock_stream_len = 0;
+    while ((n = read_cb(chunk, sizeof(chunk), ctx)) > 0) {
+        assert(mock_stream_len + n < sizeof(mock_stream));
+        memcpy(mock_stream + mock_stream_len, chunk, n);
+        mock_stream_len += n;
+    }
+    mock_stream[mock_stream_len] = '\0';
     return true;
 }
 
 bool consumption_platform_storage_write(const void* data, size_t size) {
-    (void)data; (void)size;
+    if (size > sizeof(mock_storage)) {
+        return false;
+    }
+    memcpy(mock_storage, data, size);
     return true;
 }
 
+/* Last payload handed to the network layer */
+static char mock_payload[2048];
+
 bool consumption_platform_network_send(const char* endpoint, const char* data, size_t data_len) {
-    (void)endpoint; (void)data; (void)data_len;
+    (void)endpoint;
     printf("MOCK: Network send called\n");
+    if (data_len < sizeof(mock_payload)) {
+        memcpy(mock_payload, data, data_len);
+        mock_payload[data_len] = '\0';
+    }
     return true;
 }
 
@@ -216,11 +277,2356 @@ void test_configuration_update(void) {
     result = consumption_update_config(&new_config);
     assert(result == CONSUMPTION_ERROR_INVALID_PARAMETER);
 
+    /* Rebinding the machine does not credit it with the old counters */
+    consumption_on_dispense(22222, 5);
+    consumption_on_dispense(22222, 5);
+    new_config = config;
+    new_config.machine_id = 22223;
+    assert(consumption_update_config(&new_config) == CONSUMPTION_SUCCESS);
+    consumption_snapshot_t snapshot;
+    consumption_get_snapshot(&snapshot);
+    assert(snapshot.machine_id == 22223);
+    assert(snapshot.period_events == 0 && snapshot.product_counts[5] == 0);
+    assert(snapshot.buffered_events == 0);
+    assert(consumption_on_dispense(22222, 5) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_on_dispense(22223, 5) == CONSUMPTION_SUCCESS);
+    consumption_get_snapshot(&snapshot);
+    assert(snapshot.period_events == 1 && snapshot.product_counts[5] == 1);
+
     consumption_deinit();
 
     printf("✓ Configuration update tests passed\n");
 }
 
+void test_memory_footprint(void) {
+    printf("Testing memory footprint...\n");
+
+    consumption_footprint_t fp;
+    consumption_error_t result = consumption_get_footprint(&fp);
+    assert(result == CONSUMPTION_SUCCESS);
+    assert(fp.total_heap_bytes == 0); /* Nothing allocated before init */
+    assert(fp.components[CONSUMPTION_COMPONENT_STATE].static_bytes > 0);
+    assert(fp.components[CONSUMPTION_COMPONENT_NETWORK].static_bytes == 256 + 128);
+
+    /* Reference configuration: 1000-event ring */
+    consumption_config_t config = {
+        .machine_id = 33333,
+        .ring_buffer_size = 1000,
+    };
+
+    result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    consumption_get_footprint(&fp);
+    assert(fp.components[CONSUMPTION_COMPONENT_RING].heap_bytes ==
+           1000 * sizeof(consumption_event_t));
+    assert(fp.components[CONSUMPTION_COMPONENT_AGGREGATES].static_bytes >= 256 * sizeof(uint32_t));
+    assert(fp.components[CONSUMPTION_COMPONENT_SERIALIZER].peak_stack_bytes >= 1024);
+    assert(fp.total_heap_bytes == 1000 * sizeof(consumption_event_t));
+    assert(fp.total_peak_stack_bytes ==
+           fp.components[CONSUMPTION_COMPONENT_SERIALIZER].peak_stack_bytes);
+
+    consumption_deinit();
+
+    /* Reference configuration: ring constrained to 50 events by budget */
+    result = consumption_set_memory_budget(CONSUMPTION_COMPONENT_RING,
+                                           50 * sizeof(consumption_event_t));
+    assert(result == CONSUMPTION_SUCCESS);
+
+    result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    consumption_get_footprint(&fp);
+    assert(fp.components[CONSUMPTION_COMPONENT_RING].heap_bytes ==
+           50 * sizeof(consumption_event_t));
+    assert(!fp.components[CONSUMPTION_COMPONENT_RING].over_budget);
+
+    /* Ring degrades gracefully: still records, keeps the newest 50 events */
+    for (int i = 0; i < 60; i++) {
+        result = consumption_on_dispense(33333, 1);
+        assert(result == CONSUMPTION_SUCCESS);
+    }
+    uint32_t total_events, buffered_events;
+    consumption_get_stats(&total_events, &buffered_events, NULL);
+    assert(total_events == 60);
+    assert(buffered_events == 50);
+
+    /* Fixed-size components report budget violations */
+    consumption_set_memory_budget(CONSUMPTION_COMPONENT_AGGREGATES, 512);
+    consumption_get_footprint(&fp);
+    assert(fp.components[CONSUMPTION_COMPONENT_AGGREGATES].over_budget);
+
+    /* Invalid component */
+    result = consumption_set_memory_budget(CONSUMPTION_COMPONENT_COUNT, 1);
+    assert(result == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    consumption_deinit();
+    consumption_set_memory_budget(CONSUMPTION_COMPONENT_RING, 0);
+    consumption_set_memory_budget(CONSUMPTION_COMPONENT_AGGREGATES, 0);
+
+    printf("✓ Memory footprint tests passed\n");
+}
+
+void test_state_restore(void) {
+    printf("Testing state restore...\n");
+
+    consumption_config_t config = {
+        .machine_id = 44444,
+        .ring_buffer_size = 20,
+    };
+
+    consumption_error_t result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    for (uint8_t i = 1; i <= 3; i++) {
+        result = consumption_on_dispense(44444, i);
+        assert(result == CONSUMPTION_SUCCESS);
+    }
+    consumption_deinit();
+
+    /* Counters survive a restart, raw events do not */
+    result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    uint32_t total_events, buffered_events;
+    consumption_get_stats(&total_events, &buffered_events, NULL);
+    assert(total_events == 3);
+    assert(buffered_events == 0);
+
+    /* Dispenses are accepted immediately after restore */
+    result = consumption_on_dispense(44444, 1);
+    assert(result == CONSUMPTION_SUCCESS);
+    consumption_get_stats(&total_events, NULL, NULL);
+    assert(total_events == 4);
+    consumption_deinit();
+
+    /* Persisted counters belong to another machine: start fresh */
+    config.machine_id = 55555;
+    result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+    consumption_get_stats(&total_events, NULL, NULL);
+    assert(total_events == 0);
+    consumption_deinit();
+
+    printf("✓ State restore tests passed\n");
+}
+
+void test_counter_only_mode(void) {
+    printf("Testing counter-only mode...\n");
+
+    consumption_config_t config = {
+        .machine_id = 66666,
+        .ring_buffer_size = 0, /* No raw events needed */
+        .counter_only = true,
+    };
+
+    consumption_error_t result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    consumption_footprint_t fp;
+    consumption_get_footprint(&fp);
+    assert(fp.components[CONSUMPTION_COMPONENT_RING].heap_bytes == 0);
+
+    for (int i = 0; i < 10; i++) {
+        result = consumption_on_dispense(66666, (uint8_t)(1 + i % 2));
+        assert(result == CONSUMPTION_SUCCESS);
+    }
+    result = consumption_on_dispense(66666, 255);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    uint32_t total_events, buffered_events;
+    consumption_get_stats(&total_events, &buffered_events, NULL);
+    assert(total_events == 11);
+    assert(buffered_events == 0);
+
+    /* Mode cannot change at runtime */
+    consumption_config_t new_config = config;
+    new_config.counter_only = false;
+    new_config.ring_buffer_size = 0;
+    result = consumption_update_config(&new_config);
+    assert(result != CONSUMPTION_SUCCESS);
+
+    consumption_deinit();
+
+    /* Counts are uploaded from the counters */
+    config.enable_external_api = true;
+    config.aggregation_interval = 0; /* Upload on every dispense */
+    result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    result = consumption_on_dispense(66666, 7);
+    assert(result == CONSUMPTION_SUCCESS);
+    assert(strstr(mock_payload, "\"total_events\":1") != NULL);
+    assert(strstr(mock_payload, "\"7\":1") != NULL);
+
+    consumption_deinit();
+
+    printf("✓ Counter-only mode tests passed\n");
+}
+
+#if defined(CONSUMPTION_COUNTER_SHARDS) && CONSUMPTION_COUNTER_SHARDS > 1
+#define DISPENSE_THREADS 4
+#define DISPENSES_PER_THREAD 20000
+
+/**
+ * @brief Units one dispense_thread() adds per product
+ */
+static void dispense_pattern(uint32_t units[256]) {
+    for (int i = 0; i < DISPENSES_PER_THREAD; i++) {
+        if (i % 4 == 0) {
+            units[7] += 2;
+            units[250] += 1;
+        } else {
+            units[1 + i % 255]++;
+        }
+    }
+}
+
+static void* dispense_thread(void* arg) {
+    consumption_error_t* result = (consumption_error_t*)arg;
+    consumption_dispense_t batch[] = {
+        {.timestamp = 0, .product_id = 7, .quantity = 2},
+        {.timestamp = 0, .product_id = 250, .quantity = 1},
+    };
+    *result = CONSUMPTION_SUCCESS;
+    for (int i = 0; i < DISPENSES_PER_THREAD && *result == CONSUMPTION_SUCCESS; i++) {
+        if (i % 4 == 0) {
+            *result = consumption_on_dispense_batch(12121, batch, 2);
+        } else {
+            *result = consumption_on_dispense(12121, (uint8_t)(1 + i % 255));
+        }
+    }
+    return NULL;
+}
+#endif
+
+/*
+ * Needs a sharded build, e.g. -DCONSUMPTION_COUNTER_SHARDS=4
+ * -DCONSUMPTION_COUNTER_PRODUCTS=64 to cover the unsharded IDs as well.
+ */
+void test_concurrent_dispense(void) {
+    printf("Testing concurrent dispense...\n");
+
+#if defined(CONSUMPTION_COUNTER_SHARDS) && CONSUMPTION_COUNTER_SHARDS > 1
+    consumption_config_t config = {
+        .machine_id = 12121,
+        .counter_only = true,
+    };
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+
+    consumption_snapshot_t before;
+    assert(consumption_get_snapshot(&before) == CONSUMPTION_SUCCESS);
+
+    pthread_t threads[DISPENSE_THREADS];
+    consumption_error_t results[DISPENSE_THREADS];
+    for (int t = 0; t < DISPENSE_THREADS; t++) {
+        assert(pthread_create(&threads[t], NULL, dispense_thread, &results[t]) == 0);
+    }
+
+    /* The driving thread folds the shards while they are written */
+    consumption_snapshot_t snapshot;
+    for (int i = 0; i < 1000; i++) {
+        assert(consumption_get_snapshot(&snapshot) == CONSUMPTION_SUCCESS);
+        assert(snapshot.total_events >= before.total_events);
+    }
+    for (int t = 0; t < DISPENSE_THREADS; t++) {
+        assert(pthread_join(threads[t], NULL) == 0);
+        assert(results[t] == CONSUMPTION_SUCCESS);
+    }
+
+    /* Not a unit lost */
+    uint32_t units[256] = {0};
+    dispense_pattern(units);
+    uint32_t total = 0;
+    assert(consumption_get_snapshot(&snapshot) == CONSUMPTION_SUCCESS);
+    for (int p = 1; p < 256; p++) {
+        assert(snapshot.product_counts[p] - before.product_counts[p] == units[p] * DISPENSE_THREADS);
+        total += units[p] * DISPENSE_THREADS;
+    }
+    assert(snapshot.total_events - before.total_events == total);
+    assert(snapshot.period_events - before.period_events == total);
+    consumption_deinit();
+
+    /* Other threads cannot reach the ring */
+    config.counter_only = false;
+    config.ring_buffer_size = 16;
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+    consumption_error_t result;
+    assert(pthread_create(&threads[0], NULL, dispense_thread, &result) == 0);
+    assert(pthread_join(threads[0], NULL) == 0);
+    assert(result == CONSUMPTION_ERROR_INVALID_CONFIG);
+    assert(consumption_on_dispense(12121, 5) == CONSUMPTION_SUCCESS);
+    assert(consumption_get_snapshot(&snapshot) == CONSUMPTION_SUCCESS);
+    assert(snapshot.buffered_events == 1);
+    consumption_deinit();
+
+    printf("✓ Concurrent dispense tests passed\n");
+#else
+    printf("  (single-shard build, skipped)\n");
+#endif
+}
+
+static void ignore_record(const consumption_log_record_t* record, void* ctx) {
+    (void)record;
+    (void)ctx;
+}
+
+void test_batch_dispense(void) {
+    printf("Testing batch dispense...\n");
+
+    consumption_config_t config = {
+        .machine_id = 77777,
+        .ring_buffer_size = 4,
+    };
+
+    consumption_error_t result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    consumption_dispense_t batch[] = {
+        {.timestamp = 0, .product_id = 1, .quantity = 12},
+        {.timestamp = 1000000001, .product_id = 2, .quantity = 1},
+        {.timestamp = 1000000002, .product_id = 3, .quantity = 500},
+    };
+
+    result = consumption_on_dispense_batch(77777, batch, 3);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    /* Totals are in units, the ring holds one slot per record */
+    uint32_t total_events, buffered_events;
+    consumption_get_stats(&total_events, &buffered_events, NULL);
+    assert(total_events == 513);
+    assert(buffered_events == 3);
+
+    /* A batch larger than the ring keeps the newest records */
+    result = consumption_on_dispense_batch(77777, batch, 3);
+    assert(result == CONSUMPTION_SUCCESS);
+    consumption_get_stats(&total_events, &buffered_events, NULL);
+    assert(total_events == 1026);
+    assert(buffered_events == 4);
+
+    /* The ring and the log share one clock read */
+    consumption_set_log_handler(ignore_record, NULL);
+    uint32_t clock_before = mock_timestamp;
+    result = consumption_on_dispense_batch(77777, batch, 3);
+    assert(result == CONSUMPTION_SUCCESS);
+    assert(mock_timestamp == clock_before + 1);
+    consumption_set_log_handler(NULL, NULL);
+
+    /* One invalid record rejects the whole batch */
+    consumption_dispense_t bad[] = {
+        {.timestamp = 0, .product_id = 4, .quantity = 1},
+        {.timestamp = 0, .product_id = 5, .quantity = 0},
+    };
+    result = consumption_on_dispense_batch(77777, bad, 2);
+    assert(result == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    consumption_get_stats(&total_events, NULL, NULL);
+    assert(total_events == 1539);
+
+    result = consumption_on_dispense_batch(99999, batch, 3);
+    assert(result == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    result = consumption_on_dispense_batch(77777, NULL, 0);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    consumption_deinit();
+
+    printf("✓ Batch dispense tests passed\n");
+}
+
+void test_reservoir_retention(void) {
+    printf("Testing reservoir retention...\n");
+
+    consumption_config_t config = {
+        .machine_id = 66666,
+        .ring_buffer_size = 10,
+        .retention = CONSUMPTION_RETENTION_UNIFORM,
+    };
+
+    consumption_error_t result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    for (int i = 0; i < 1000; i++) {
+        consumption_on_dispense(66666, (uint8_t)(1 + i % 5));
+    }
+
+    /* Memory stays fixed, weights add back up to the events seen */
+    consumption_sample_t samples[16];
+    uint32_t count = 0;
+    result = consumption_get_samples(samples, 16, &count);
+    assert(result == CONSUMPTION_SUCCESS);
+    assert(count == 10);
+    float weight_sum = 0.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        assert(samples[i].quantity == 1);
+        weight_sum += samples[i].weight;
+    }
+    assert(weight_sum > 999.0f && weight_sum < 1001.0f);
+
+    /* Policy cannot change at runtime */
+    config.retention = CONSUMPTION_RETENTION_RECENT;
+    assert(consumption_update_config(&config) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    consumption_deinit();
+
+    /* Hour strata need at least one slot per hour a period spans */
+    config.retention = CONSUMPTION_RETENTION_HOURLY;
+    config.aggregation_interval = 86400;
+    assert(consumption_init(&config) == CONSUMPTION_ERROR_INVALID_CONFIG);
+
+    config.ring_buffer_size = 48;
+    result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    /* A burst in one hour cannot crowd out a quiet hour */
+    consumption_dispense_t busy = {.timestamp = 3600 * 100 + 8 * 3600, .product_id = 1, .quantity = 1};
+    consumption_dispense_t quiet = {.timestamp = 3600 * 100 + 3 * 3600, .product_id = 2, .quantity = 1};
+    for (int i = 0; i < 500; i++) {
+        consumption_on_dispense_batch(66666, &busy, 1);
+    }
+    consumption_on_dispense_batch(66666, &quiet, 1);
+
+    consumption_sample_t hourly[48];
+    result = consumption_get_samples(hourly, 48, &count);
+    assert(result == CONSUMPTION_SUCCESS);
+    assert(count == 3);
+    bool found_quiet = false;
+    for (uint32_t i = 0; i < count; i++) {
+        if (hourly[i].product_id == 2) {
+            found_quiet = true;
+            assert(hourly[i].weight == 1.0f);
+        } else {
+            assert(hourly[i].weight == 250.0f);
+        }
+    }
+    assert(found_quiet);
+
+    consumption_deinit();
+
+    /* Hourly periods share the whole ring between the hours they span */
+    config.aggregation_interval = 3600;
+    result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+    consumption_dispense_t early = {.timestamp = 3600 * 200 + 10, .product_id = 1, .quantity = 1};
+    consumption_dispense_t late = {.timestamp = 3600 * 201 + 10, .product_id = 2, .quantity = 1};
+    for (int i = 0; i < 100; i++) {
+        consumption_on_dispense_batch(66666, &early, 1);
+        consumption_on_dispense_batch(66666, &late, 1);
+    }
+    result = consumption_get_samples(hourly, 48, &count);
+    assert(result == CONSUMPTION_SUCCESS);
+    assert(count == 32);
+    for (uint32_t i = 0; i < count; i++) {
+        assert(hourly[i].weight == 6.25f);
+    }
+
+    /* An hour's stratum restarts when the clock comes round to it again */
+    consumption_dispense_t next_day = {.timestamp = 3600 * 203 + 10, .product_id = 3, .quantity = 1};
+    consumption_on_dispense_batch(66666, &next_day, 1);
+    consumption_on_dispense_batch(66666, &early, 1);
+    result = consumption_get_samples(hourly, 48, &count);
+    assert(result == CONSUMPTION_SUCCESS);
+    assert(count == 17);
+
+    consumption_deinit();
+
+    printf("✓ Reservoir retention tests passed\n");
+}
+
+void test_streaming_upload(void) {
+    printf("Testing streaming upload...\n");
+
+    consumption_config_t config = {
+        .machine_id = 55555,
+        .ring_buffer_size = 2000,
+        .enable_external_api = true,
+        .aggregation_interval = 86400,
+        .upload_events = true,
+    };
+
+    consumption_error_t result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    for (int i = 0; i < 1500; i++) {
+        consumption_on_dispense(55555, (uint8_t)(1 + i % 40));
+    }
+
+    /* Far larger than the serializer buffer: pulled by the transport */
+    mock_timestamp += 86400;
+    mock_stream_len = 0;
+    result = consumption_force_sync();
+    assert(result == CONSUMPTION_SUCCESS);
+    assert(mock_stream_len > 1024);
+    assert(mock_stream[0] == '{');
+    assert(strcmp(mock_stream + mock_stream_len - 2, "]}") == 0);
+    assert(strstr(mock_stream, "\"total_events\":1500") != NULL);
+    assert(strstr(mock_stream, "\"40\":37") != NULL);
+
+    int events = 0;
+    for (const char* p = strstr(mock_stream, "\"events\":["); p && *p; p++) {
+        if (*p == '[' && p[1] != '[') events++;
+    }
+    assert(events == 1500);
+
+    uint32_t total_events;
+    consumption_get_stats(&total_events, NULL, NULL);
+    assert(total_events == 1500);
+
+    /* Without streaming the payload is still delivered, truncated to one buffer */
+    mock_stream_supported = false;
+    for (int i = 0; i < 400; i++) {
+        consumption_on_dispense(55555, (uint8_t)(1 + i % 200));
+    }
+    mock_timestamp += 86400;
+    mock_payload[0] = '\0';
+    result = consumption_force_sync();
+    assert(result == CONSUMPTION_SUCCESS);
+    size_t len = strlen(mock_payload);
+    assert(len > 0 && len <= 1024);
+    assert(strncmp(mock_payload, "{\"machine_id\":55555,", 20) == 0);
+    assert(strcmp(mock_payload + len - 19, "},\"truncated\":true}") == 0);
+    assert(strstr(mock_payload, "\"1\":2") != NULL);
+
+    consumption_snapshot_t snapshot;
+    consumption_get_snapshot(&snapshot);
+    assert(snapshot.period_events == 0);
+    assert(snapshot.sync_failures == 0);
+
+    /* A serializer budget caps the truncated payload too */
+    consumption_set_memory_budget(CONSUMPTION_COMPONENT_SERIALIZER, 512);
+    for (int i = 0; i < 400; i++) {
+        consumption_on_dispense(55555, (uint8_t)(1 + i % 200));
+    }
+    mock_timestamp += 86400;
+    mock_payload[0] = '\0';
+    assert(consumption_force_sync() == CONSUMPTION_SUCCESS);
+    len = strlen(mock_payload);
+    assert(len > 0 && len <= 512);
+    assert(strcmp(mock_payload + len - 19, "},\"truncated\":true}") == 0);
+    consumption_set_memory_budget(CONSUMPTION_COMPONENT_SERIALIZER, 0);
+    mock_stream_supported = true;
+
+    consumption_deinit();
+
+    printf("✓ Streaming upload tests passed\n");
+}
+
+void test_snapshot(void) {
+    printf("Testing snapshot...\n");
+
+    consumption_snapshot_t snapshot;
+    assert(consumption_get_snapshot(&snapshot) == CONSUMPTION_ERROR_INVALID_CONFIG);
+
+    consumption_config_t config = {
+        .machine_id = 44444,
+        .ring_buffer_size = 8,
+    };
+    consumption_error_t result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    consumption_on_dispense(44444, 9);
+    consumption_on_dispense(44444, 9);
+    consumption_on_dispense(44444, 200);
+
+    result = consumption_get_snapshot(&snapshot);
+    assert(result == CONSUMPTION_SUCCESS);
+    assert(snapshot.machine_id == 44444);
+    assert(snapshot.period_events == 3);
+    assert(snapshot.buffered_events == 3);
+    assert(snapshot.product_counts[9] == 2);
+    assert(snapshot.product_counts[200] == 1);
+    assert(snapshot.product_counts[1] == 0);
+
+    assert(consumption_get_snapshot(NULL) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    consumption_deinit();
+
+    printf("✓ Snapshot tests passed\n");
+}
+
+static int notify_calls = 0;
+
+static void count_notify(void* ctx) {
+    (void)ctx;
+    notify_calls++;
+}
+
+void test_async_upload(void) {
+    printf("Testing asynchronous upload...\n");
+
+    consumption_config_t config = {
+        .machine_id = 33333,
+        .ring_buffer_size = 16,
+        .enable_external_api = true,
+        .aggregation_interval = 3600,
+    };
+    consumption_error_t result = consumption_init(&config);
+    assert(result == CONSUMPTION_SUCCESS);
+
+    /* With a handler, a due sync notifies once instead of uploading inline */
+    consumption_set_sync_handler(count_notify, NULL);
+    consumption_on_dispense(33333, 5);
+    mock_timestamp += 3600;
+    mock_payload[0] = '\0';
+    consumption_on_dispense(33333, 5);
+    consumption_on_dispense(33333, 6);
+    assert(notify_calls == 1);
+    assert(mock_payload[0] == '\0');
+
+    uint32_t next;
+    assert(consumption_get_next_sync(&next) == CONSUMPTION_SUCCESS);
+    assert(next <= mock_timestamp);
+
+    consumption_upload_t* upload;
+    assert(consumption_upload_begin(&upload) == CONSUMPTION_SUCCESS);
+    assert(upload != NULL);
+    assert(consumption_force_sync() == CONSUMPTION_ERROR_API_ERROR);
+
+    /* Dispenses during the upload belong to the next period */
+    consumption_on_dispense(33333, 7);
+    consumption_snapshot_t snapshot;
+    consumption_get_snapshot(&snapshot);
+    assert(snapshot.period_events == 4);
+
+    char payload[256];
+    size_t len = consumption_upload_read(payload, sizeof(payload) - 1, upload);
+    payload[len] = '\0';
+    assert(strstr(payload, "\"total_events\":3") != NULL);
+    assert(strstr(payload, "\"7\"") == NULL);
+
+    consumption_upload_info_t info;
+    assert(consumption_upload_get_info(upload, &info) == CONSUMPTION_SUCCESS);
+    assert(info.events == 3 && info.bytes == len);
+
+    /* A failed upload folds its counters back */
+    assert(consumption_upload_finish(upload, false) == CONSUMPTION_ERROR_API_ERROR);
+    assert(consumption_upload_finish(upload, false) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    consumption_get_snapshot(&snapshot);
+    assert(snapshot.period_events == 4);
+    assert(snapshot.product_counts[5] == 2);
+    assert(snapshot.sync_failures == 1);
+
+    assert(consumption_upload_begin(&upload) == CONSUMPTION_SUCCESS);
+    assert(upload != NULL);
+    consumption_on_dispense(33333, 8);
+    assert(consumption_upload_finish(upload, true) == CONSUMPTION_SUCCESS);
+    consumption_get_snapshot(&snapshot);
+    assert(snapshot.period_events == 1);
+    assert(snapshot.product_counts[8] == 1);
+    assert(snapshot.sync_failures == 0);
+
+    /* Not due again yet */
+    assert(consumption_upload_begin(&upload) == CONSUMPTION_SUCCESS);
+    assert(upload == NULL);
+
+    consumption_deinit();
+
+    /* Samples taken while an upload is in flight stay for the next period */
+    config.ring_buffer_size = 48;
+    config.retention = CONSUMPTION_RETENTION_HOURLY;
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+    uint32_t hour = mock_timestamp / 3600 + 2;
+    consumption_dispense_t closed = {.timestamp = hour * 3600 + 10, .product_id = 1, .quantity = 1};
+    for (int i = 0; i < 100; i++) {
+        consumption_on_dispense_batch(33333, &closed, 1);
+    }
+    mock_timestamp = (hour + 1) * 3600;
+    assert(consumption_upload_begin(&upload) == CONSUMPTION_SUCCESS);
+    assert(upload != NULL);
+    consumption_dispense_t open = {.timestamp = (hour + 1) * 3600 + 10, .product_id = 2, .quantity = 1};
+    for (int i = 0; i < 50; i++) {
+        consumption_on_dispense_batch(33333, &open, 1);
+    }
+    assert(consumption_upload_finish(upload, true) == CONSUMPTION_SUCCESS);
+
+    consumption_sample_t samples[48];
+    uint32_t count = 0;
+    assert(consumption_get_samples(samples, 48, &count) == CONSUMPTION_SUCCESS);
+    assert(count == 16);
+    for (uint32_t i = 0; i < count; i++) {
+        assert(samples[i].product_id == 2);
+        assert(samples[i].weight == 3.125f);
+    }
+
+    consumption_set_sync_handler(NULL, NULL);
+    consumption_deinit();
+
+    printf("✓ Asynchronous upload tests passed\n");
+}
+
+static uint32_t mock_transport_starts = 0;
+static uint32_t mock_transport_aborts = 0;
+
+static bool mock_transport_start(consumption_upload_t* upload, void* ctx) {
+    (void)ctx;
+    char chunk[64];
+    while (consumption_upload_read(chunk, sizeof(chunk), upload) > 0) {
+    }
+    mock_transport_starts++;
+    return true;
+}
+
+static void mock_transport_abort(void* ctx) {
+    (void)ctx;
+    mock_transport_aborts++;
+}
+
+typedef struct {
+    uint32_t calls;
+    consumption_sync_handle_t handle;
+    consumption_sync_result_t result;
+} sync_outcome_t;
+
+static void record_sync(consumption_sync_handle_t handle, const consumption_sync_result_t* result,
+                        void* user) {
+    sync_outcome_t* outcome = (sync_outcome_t*)user;
+    outcome->calls++;
+    outcome->handle = handle;
+    outcome->result = *result;
+}
+
+void test_event_driver(void) {
+    printf("Testing event-loop driver...\n");
+
+    consumption_config_t config = {
+        .machine_id = 23232,
+        .ring_buffer_size = 16,
+        .enable_external_api = true,
+        .aggregation_interval = 60,
+    };
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+
+    consumption_events_transport_t transport = {
+        .start = mock_transport_start,
+        .abort = mock_transport_abort,
+    };
+    consumption_events_config_t events;
+    consumption_events_config_default(&events);
+    events.transport = &transport;
+    assert(consumption_events_init(&events) == CONSUMPTION_SUCCESS);
+    assert(consumption_events_get_fd() >= 0);
+
+    consumption_on_dispense(23232, 3);
+    consumption_on_dispense(23232, 3);
+    consumption_on_dispense(23232, 4);
+    consumption_snapshot_t snapshot;
+    consumption_get_snapshot(&snapshot);
+    uint32_t period_events = snapshot.period_events;
+    mock_timestamp += 60;
+
+    /* Two requests made before the upload starts are merged into it */
+    sync_outcome_t first = {0}, second = {0}, cancelled = {0}, expired = {0};
+    consumption_sync_handle_t a = consumption_force_sync_async(record_sync, &first);
+    consumption_sync_handle_t b = consumption_force_sync_async(record_sync, &second);
+    assert(a != 0 && b != 0 && a != b);
+    assert(consumption_process_events() == CONSUMPTION_SUCCESS);
+    assert(mock_transport_starts == 1);
+    assert(first.calls == 0 && second.calls == 0);
+
+    /* Cancelled before completion: called back at once */
+    consumption_sync_handle_t c = consumption_force_sync_async(record_sync, &cancelled);
+    assert(consumption_sync_cancel(c) == CONSUMPTION_SUCCESS);
+    assert(cancelled.calls == 1 && cancelled.handle == c);
+    assert(cancelled.result.result == CONSUMPTION_ERROR_CANCELLED);
+    assert(cancelled.result.merged == 1);
+    assert(consumption_sync_cancel(c) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    /* A request's deadline passes; the upload and the others carry on */
+    consumption_sync_handle_t d = consumption_force_sync_async(record_sync, &expired);
+    assert(consumption_sync_set_deadline(d, 0) == CONSUMPTION_SUCCESS);
+    assert(consumption_process_events() == CONSUMPTION_SUCCESS);
+    assert(expired.calls == 1 && expired.handle == d);
+    assert(expired.result.result == CONSUMPTION_ERROR_TIMEOUT);
+    assert(first.calls == 0 && second.calls == 0);
+    assert(mock_transport_starts == 1);
+
+    assert(consumption_events_upload_done(true) == CONSUMPTION_SUCCESS);
+    assert(first.calls == 1 && first.handle == a);
+    assert(second.calls == 1 && second.handle == b);
+    assert(first.result.result == CONSUMPTION_SUCCESS && second.result.result == CONSUMPTION_SUCCESS);
+    assert(first.result.merged == 2 && second.result.merged == 2);
+    assert(first.result.events == period_events && first.result.bytes > 0);
+    assert(first.result.period_end > first.result.period_start);
+    assert(cancelled.calls == 1 && expired.calls == 1);
+    assert(consumption_events_upload_done(true) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_sync_set_deadline(a, 1000) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    /* A failed upload returns the counters; a force-sync skips the backoff */
+    consumption_on_dispense(23232, 5);
+    mock_timestamp += 60;
+    sync_outcome_t failed = {0}, aborted = {0};
+    consumption_force_sync_async(record_sync, &failed);
+    assert(consumption_process_events() == CONSUMPTION_SUCCESS);
+    assert(mock_transport_starts == 2);
+    assert(consumption_events_upload_done(false) == CONSUMPTION_SUCCESS);
+    assert(failed.calls == 1 && failed.result.result == CONSUMPTION_ERROR_API_ERROR);
+    consumption_get_snapshot(&snapshot);
+    assert(snapshot.period_events == 1 && snapshot.sync_failures == 1);
+
+    consumption_force_sync_async(record_sync, &aborted);
+    assert(consumption_process_events() == CONSUMPTION_SUCCESS);
+    assert(mock_transport_starts == 3);
+
+    /* Deinit aborts the upload in flight and cancels its requests */
+    consumption_events_deinit();
+    assert(mock_transport_aborts == 1);
+    assert(aborted.calls == 1 && aborted.result.result == CONSUMPTION_ERROR_CANCELLED);
+    assert(consumption_events_get_fd() == -1);
+    consumption_get_snapshot(&snapshot);
+    assert(snapshot.period_events == 1);
+
+    consumption_deinit();
+
+    printf("✓ Event-loop driver tests passed\n");
+}
+
+static int http_connect(uint16_t port) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    assert(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    return fd;
+}
+
+/**
+ * @brief Poll the server until one whole response arrived
+ * @return Response length (headers and body), 0 if the server closed first
+ */
+static size_t http_receive(consumption_http_server_t* server, int fd,
+                           char* response, size_t size) {
+    size_t len = 0;
+    for (int i = 0; i < 200; i++) {
+        consumption_http_poll(server, 5);
+        ssize_t n = recv(fd, response + len, size - 1 - len, MSG_DONTWAIT);
+        if (n == 0) {
+            return 0;
+        }
+        if (n > 0) {
+            len += (size_t)n;
+            response[len] = '\0';
+        }
+        const char* head_end = strstr(response, "\r\n\r\n");
+        const char* length = strstr(response, "Content-Length: ");
+        if (len > 0 && head_end && length &&
+            len >= (size_t)(head_end + 4 - response) + strtoul(length + 16, NULL, 10)) {
+            return len;
+        }
+    }
+    assert(!"no response");
+    return 0;
+}
+
+static size_t http_request(consumption_http_server_t* server, int fd, const char* request,
+                           char* response, size_t size) {
+    assert(send(fd, request, strlen(request), 0) == (ssize_t)strlen(request));
+    return http_receive(server, fd, response, size);
+}
+
+/**
+ * @brief Whether the server closed the connection
+ */
+static bool http_closed(consumption_http_server_t* server, int fd) {
+    char byte;
+    for (int i = 0; i < 200; i++) {
+        consumption_http_poll(server, 5);
+        ssize_t n = recv(fd, &byte, 1, MSG_DONTWAIT);
+        if (n >= 0) {
+            return n == 0;
+        }
+    }
+    return false;
+}
+
+void test_http_endpoint(void) {
+    printf("Testing HTTP query endpoint...\n");
+
+    consumption_config_t config = {
+        .machine_id = 45454,
+        .ring_buffer_size = 8,
+    };
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+    consumption_on_dispense(45454, 9);
+    consumption_on_dispense(45454, 9);
+    consumption_on_dispense(45454, 200);
+    consumption_snapshot_t snapshot;
+    assert(consumption_get_snapshot(&snapshot) == CONSUMPTION_SUCCESS);
+
+    consumption_http_config_t http_config;
+    consumption_http_config_default(&http_config);
+    http_config.port = 0;
+    consumption_http_server_t* server = consumption_http_start(&http_config);
+    assert(server != NULL);
+    uint16_t port = consumption_http_get_port(server);
+    assert(port != 0);
+
+    /* Keep-alive: every status on one connection */
+    char response[8192];
+    int fd = http_connect(port);
+    assert(http_request(server, fd, "GET /stats HTTP/1.1\r\nHost: gateway\r\n\r\n",
+                        response, sizeof(response)) > 0);
+    assert(strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    assert(strstr(response, "Content-Type: application/json\r\n") != NULL);
+    assert(strstr(response, "Connection: close") == NULL);
+    assert(strstr(response, "\"machine_id\":45454") != NULL);
+
+    assert(http_request(server, fd, "GET /missing HTTP/1.1\r\n\r\n", response, sizeof(response)) > 0);
+    assert(strncmp(response, "HTTP/1.1 404 Not Found\r\n", 24) == 0);
+    assert(http_request(server, fd, "POST /stats HTTP/1.1\r\n\r\n", response, sizeof(response)) > 0);
+    assert(strncmp(response, "HTTP/1.1 405 Method Not Allowed\r\n", 33) == 0);
+    assert(http_request(server, fd, "GET /products?x=1 HTTP/1.1\r\n\r\n", response, sizeof(response)) > 0);
+    assert(strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    assert(strstr(response, "\"9\":") != NULL && strstr(response, "\"200\":") != NULL);
+
+    /* A request split across reads is answered once complete */
+    assert(send(fd, "GET /snapshot.bin HT", 20, 0) == 20);
+    for (int i = 0; i < 5; i++) {
+        assert(consumption_http_poll(server, 5) == 0);
+    }
+    assert(recv(fd, response, sizeof(response), MSG_DONTWAIT) < 0);
+    size_t len = http_request(server, fd, "TP/1.1\r\n\r\n", response, sizeof(response));
+    assert(strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    assert(strstr(response, "Content-Type: application/octet-stream\r\n") != NULL);
+
+    /* Binary layout: packed header, then 5-byte product records */
+    const char* body = strstr(response, "\r\n\r\n") + 4;
+    size_t body_len = len - (size_t)(body - response);
+    consumption_http_bin_header_t header;
+    assert(sizeof(header) == 52);
+    assert(body_len >= sizeof(header));
+    memcpy(&header, body, sizeof(header));
+    assert(memcmp(body, "CSNS", 4) == 0 && header.magic == 0x534E5343u);
+    assert(header.version == 1);
+    assert(header.machine_id == 45454);
+    assert(header.total_events == snapshot.total_events);
+    assert(header.period_events == snapshot.period_events);
+    assert(header.buffered_events == snapshot.buffered_events);
+    assert(body_len == sizeof(header) + header.product_entries * 5u);
+    uint32_t entries = 0;
+    for (int p = 1; p < 256; p++) {
+        if (snapshot.product_counts[p] > 0) {
+            const char* record = body + sizeof(header) + entries * 5u;
+            uint32_t count;
+            memcpy(&count, record + 1, sizeof(count));
+            assert((uint8_t)record[0] == p && count == snapshot.product_counts[p]);
+            entries++;
+        }
+    }
+    assert(entries == header.product_entries && entries >= 2);
+
+    /* Asked to close: the response says so and the server hangs up */
+    assert(http_request(server, fd, "GET /snapshot HTTP/1.1\r\nConnection: close\r\n\r\n",
+                        response, sizeof(response)) > 0);
+    assert(strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    assert(strstr(response, "Connection: close\r\n") != NULL);
+    assert(http_closed(server, fd));
+    close(fd);
+
+    /* HTTP/1.0 closes by default */
+    fd = http_connect(port);
+    assert(http_request(server, fd, "GET /stats HTTP/1.0\r\n\r\n", response, sizeof(response)) > 0);
+    assert(strstr(response, "Connection: close\r\n") != NULL);
+    assert(http_closed(server, fd));
+    close(fd);
+
+    /* Malformed: 400, then closed */
+    fd = http_connect(port);
+    assert(http_request(server, fd, "garbage\r\n\r\n", response, sizeof(response)) > 0);
+    assert(strncmp(response, "HTTP/1.1 400 Bad Request\r\n", 26) == 0);
+    assert(http_closed(server, fd));
+    close(fd);
+
+    consumption_http_stats_t stats;
+    consumption_http_get_stats(server, &stats);
+    assert(stats.requests == 8);
+    assert(stats.connections == 0);
+
+    consumption_http_stop(server);
+    consumption_deinit();
+
+    printf("✓ HTTP query endpoint tests passed\n");
+}
+
+void test_storage_sealing(void) {
+    printf("Testing storage sealing...\n");
+
+    consumption_config_t config = {
+        .machine_id = 66666,
+        .ring_buffer_size = 20,
+    };
+    uint8_t key[CONSUMPTION_STORAGE_KEY_SIZE];
+    for (int i = 0; i < CONSUMPTION_STORAGE_KEY_SIZE; i++) {
+        key[i] = (uint8_t)(0x80 + i);
+    }
+
+    assert(consumption_set_storage_key(key) == CONSUMPTION_SUCCESS);
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+    assert(consumption_on_dispense(66666, 5) == CONSUMPTION_SUCCESS);
+    assert(consumption_on_dispense(66666, 5) == CONSUMPTION_SUCCESS);
+    consumption_deinit();
+
+    /* Sealed record: no plaintext magic */
+    assert(memcmp(mock_storage, "USNC", 4) != 0);
+
+    uint32_t total_events;
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+    consumption_get_stats(&total_events, NULL, NULL);
+    assert(total_events == 2);
+    consumption_deinit();
+
+    /* A modified record is refused */
+    unsigned char saved[4096];
+    memcpy(saved, mock_storage, sizeof(saved));
+    mock_storage[100] ^= 1;
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+    consumption_get_stats(&total_events, NULL, NULL);
+    assert(total_events == 0);
+    consumption_deinit();
+
+    /* So is one sealed with another key */
+    memcpy(mock_storage, saved, sizeof(saved));
+    key[0] ^= 1;
+    consumption_set_storage_key(key);
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+    consumption_get_stats(&total_events, NULL, NULL);
+    assert(total_events == 0);
+    consumption_deinit();
+
+    assert(consumption_set_storage_key(NULL) == CONSUMPTION_SUCCESS);
+
+    /* RFC 8439 2.5.2: Poly1305 */
+    static const uint8_t mac_key[32] = {
+        0x85, 0xd6, 0xbe, 0x78, 0x57, 0x55, 0x6d, 0x33, 0x7f, 0x44, 0x52, 0xfe, 0x42, 0xd5, 0x06, 0xa8,
+        0x01, 0x03, 0x80, 0x8a, 0xfb, 0x0d, 0xb2, 0xfd, 0x4a, 0xbf, 0xf6, 0xaf, 0x41, 0x49, 0xf5, 0x1b,
+    };
+    static const uint8_t mac_tag[16] = {
+        0xa8, 0x06, 0x1d, 0xc1, 0x30, 0x51, 0x36, 0xc6, 0xc2, 0x2b, 0x8b, 0xaf, 0x0c, 0x01, 0x27, 0xa9,
+    };
+    const char* mac_message = "Cryptographic Forum Research Group";
+    uint8_t tag[16];
+    consumption_poly1305(mac_key, (const uint8_t*)mac_message, strlen(mac_message), tag);
+    assert(memcmp(tag, mac_tag, sizeof(tag)) == 0);
+
+    /* RFC 8439 2.8.2: AEAD_CHACHA20_POLY1305 */
+    static const uint8_t nonce[12] = {0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47};
+    static const uint8_t aad[12] = {0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7};
+    static const uint8_t sealed[114] = {
+        0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e, 0xc2,
+        0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe, 0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee, 0x62, 0xd6,
+        0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9, 0x67, 0x12, 0x82, 0xfa, 0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b,
+        0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29, 0x05, 0xd6, 0xa5, 0xb6, 0x7e, 0xcd, 0x3b, 0x36,
+        0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c, 0x98, 0x03, 0xae, 0xe3, 0x28, 0x09, 0x1b, 0x58,
+        0xfa, 0xb3, 0x24, 0xe4, 0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc,
+        0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5, 0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b,
+        0x61, 0x16,
+    };
+    static const uint8_t sealed_tag[16] = {
+        0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a, 0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91,
+    };
+    const char* plaintext = "Ladies and Gentlemen of the class of '99: If I could offer you only one "
+                            "tip for the future, sunscreen would be it.";
+    assert(strlen(plaintext) == sizeof(sealed));
+    for (int i = 0; i < CONSUMPTION_STORAGE_KEY_SIZE; i++) {
+        key[i] = (uint8_t)(0x80 + i);
+    }
+    uint8_t ciphertext[sizeof(sealed)];
+    consumption_aead_seal(key, nonce, aad, sizeof(aad), (const uint8_t*)plaintext, sizeof(sealed),
+                          ciphertext, tag);
+    assert(memcmp(ciphertext, sealed, sizeof(sealed)) == 0);
+    assert(memcmp(tag, sealed_tag, sizeof(tag)) == 0);
+
+    printf("✓ Storage sealing tests passed\n");
+}
+
+void test_heartbeat_frames(void) {
+    printf("Testing heartbeat frames...\n");
+
+    consumption_config_t config = {
+        .machine_id = 77777,
+        .ring_buffer_size = 20,
+        .enable_external_api = true,
+        .aggregation_interval = 3600,
+        .heartbeat_frames = true,
+    };
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+
+    consumption_on_dispense(77777, 3);
+    consumption_on_dispense(77777, 3);
+    mock_timestamp += 3600;
+    assert(consumption_force_sync() == CONSUMPTION_SUCCESS);
+    assert(strstr(mock_payload, "\"seq\":1,") != NULL);
+    assert(strstr(mock_payload, "\"total_events\":2") != NULL);
+
+    /* Idle period: liveness without counts */
+    mock_timestamp += 3600;
+    mock_payload[0] = '\0';
+    assert(consumption_force_sync() == CONSUMPTION_SUCCESS);
+    assert(strstr(mock_payload, "\"seq\":2,") != NULL);
+    assert(strstr(mock_payload, "\"digest\":\"") != NULL);
+    assert(strstr(mock_payload, "products") == NULL);
+
+    /* Same counts as the last aggregate */
+    consumption_on_dispense(77777, 3);
+    consumption_on_dispense(77777, 3);
+    mock_timestamp += 3600;
+    assert(consumption_force_sync() == CONSUMPTION_SUCCESS);
+    assert(strstr(mock_payload, "\"repeat\":1,") != NULL);
+    assert(strstr(mock_payload, "products") == NULL);
+
+    consumption_on_dispense(77777, 4);
+    mock_timestamp += 3600;
+    assert(consumption_force_sync() == CONSUMPTION_SUCCESS);
+    assert(strstr(mock_payload, "\"seq\":4,") != NULL);
+    assert(strstr(mock_payload, "\"4\":1") != NULL);
+
+    uint32_t total_events;
+    consumption_get_stats(&total_events, NULL, NULL);
+    assert(total_events == 5);
+    consumption_deinit();
+
+    /* Without heartbeat frames idle periods send nothing */
+    config.heartbeat_frames = false;
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+    mock_timestamp += 3600;
+    mock_payload[0] = '\0';
+    assert(consumption_force_sync() == CONSUMPTION_SUCCESS);
+    assert(mock_payload[0] == '\0');
+    consumption_deinit();
+
+    printf("✓ Heartbeat frame tests passed\n");
+}
+
+void test_rollup_cube(void) {
+    printf("Testing rollup cube...\n");
+
+    consumption_rollup_config_t config;
+    consumption_rollup_config_default(&config);
+    config.buckets = 2;
+    consumption_rollup_t* cube = consumption_rollup_create(&config);
+    assert(cube != NULL);
+
+    /* Two sites in region 1, one in region 2 */
+    assert(consumption_rollup_add_machine(cube, 101, 10, 1) == CONSUMPTION_SUCCESS);
+    assert(consumption_rollup_add_machine(cube, 102, 10, 1) == CONSUMPTION_SUCCESS);
+    assert(consumption_rollup_add_machine(cube, 201, 20, 1) == CONSUMPTION_SUCCESS);
+    assert(consumption_rollup_add_machine(cube, 301, 30, 2) == CONSUMPTION_SUCCESS);
+    assert(consumption_rollup_add_machine(cube, 101, 10, 1) == CONSUMPTION_SUCCESS);
+    assert(consumption_rollup_add_machine(cube, 101, 20, 1) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_rollup_add_machine(cube, 401, 10, 2) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    static consumption_aggregate_t aggregate;
+    const uint32_t hour = 3600 * 400000;
+    const uint32_t machines[] = {101, 102, 201, 301};
+    for (int i = 0; i < 4; i++) {
+        memset(&aggregate, 0, sizeof(aggregate));
+        aggregate.machine_id = machines[i];
+        aggregate.period_start = hour;
+        aggregate.period_end = hour + 3600;
+        aggregate.product_counts[7] = (uint32_t)(i + 1);
+        aggregate.product_counts[9] = 10;
+        aggregate.total_events = (uint32_t)(i + 11);
+        assert(consumption_rollup_add(cube, &aggregate) == CONSUMPTION_SUCCESS);
+    }
+    /* A retried aggregate is not counted twice */
+    assert(consumption_rollup_add(cube, &aggregate) == CONSUMPTION_SUCCESS);
+
+    uint64_t units;
+    assert(consumption_rollup_query(cube, CONSUMPTION_ROLLUP_SITE, 10, hour + 5, 7, &units) ==
+           CONSUMPTION_SUCCESS);
+    assert(units == 3);
+    assert(consumption_rollup_query(cube, CONSUMPTION_ROLLUP_REGION, 1, hour, 7, &units) ==
+           CONSUMPTION_SUCCESS);
+    assert(units == 6);
+    assert(consumption_rollup_query(cube, CONSUMPTION_ROLLUP_REGION, 2, hour, 0, &units) ==
+           CONSUMPTION_SUCCESS);
+    assert(units == 14);
+    assert(consumption_rollup_query(cube, CONSUMPTION_ROLLUP_MACHINE, 999, hour, 7, &units) ==
+           CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    uint32_t counts[256];
+    assert(consumption_rollup_get_products(cube, CONSUMPTION_ROLLUP_REGION, 1, hour, counts) ==
+           CONSUMPTION_SUCCESS);
+    assert(counts[0] == 11 + 12 + 13 && counts[9] == 30);
+
+    /* Two buckets later the first one is evicted */
+    memset(&aggregate, 0, sizeof(aggregate));
+    aggregate.machine_id = 101;
+    aggregate.period_start = hour + 2 * 3600;
+    aggregate.period_end = hour + 3 * 3600;
+    aggregate.product_counts[7] = 1;
+    aggregate.total_events = 1;
+    assert(consumption_rollup_add(cube, &aggregate) == CONSUMPTION_SUCCESS);
+    assert(consumption_rollup_query(cube, CONSUMPTION_ROLLUP_REGION, 1, hour, 7, &units) ==
+           CONSUMPTION_SUCCESS);
+    assert(units == 0);
+    assert(consumption_rollup_query(cube, CONSUMPTION_ROLLUP_REGION, 1, hour + 2 * 3600, 7,
+                                    &units) == CONSUMPTION_SUCCESS);
+    assert(units == 1);
+
+    aggregate.machine_id = 102;
+    aggregate.period_start = hour - 3600;
+    aggregate.period_end = hour + 7200;
+    assert(consumption_rollup_add(cube, &aggregate) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    consumption_rollup_stats_t stats;
+    consumption_rollup_get_stats(cube, &stats);
+    assert(stats.nodes[CONSUMPTION_ROLLUP_MACHINE] == 4);
+    assert(stats.nodes[CONSUMPTION_ROLLUP_SITE] == 3);
+    assert(stats.nodes[CONSUMPTION_ROLLUP_REGION] == 2);
+    assert(stats.aggregates == 5 && stats.duplicates == 1 && stats.late == 1);
+
+    consumption_rollup_destroy(cube);
+
+    printf("✓ Rollup cube tests passed\n");
+}
+
+void test_bitmap_index(void) {
+    printf("Testing bitmap index...\n");
+
+    consumption_bitmap_t* a = consumption_bitmap_create();
+    consumption_bitmap_t* b = consumption_bitmap_create();
+    assert(a != NULL && b != NULL);
+
+    /* Evens below 20000 outgrow an array container; 70000+ lands in a second one */
+    for (uint32_t v = 0; v < 20000; v += 2) {
+        assert(consumption_bitmap_add(a, v));
+    }
+    assert(consumption_bitmap_add(a, 70001));
+    assert(consumption_bitmap_add(a, 70001));
+    assert(consumption_bitmap_cardinality(a) == 10001);
+    assert(consumption_bitmap_contains(a, 19998) && !consumption_bitmap_contains(a, 19999));
+    assert(consumption_bitmap_contains(a, 70001));
+
+    for (uint32_t v = 0; v < 30; v++) {
+        consumption_bitmap_add(b, v * 3);
+    }
+    consumption_bitmap_add(b, 70001);
+    consumption_bitmap_add(b, 131072);
+
+    consumption_bitmap_t* c = consumption_bitmap_create();
+    assert(consumption_bitmap_copy(c, a));
+    assert(consumption_bitmap_and(c, b));
+    uint32_t values[32];
+    assert(consumption_bitmap_to_array(c, values, 32) == 16);
+    assert(values[0] == 0 && values[1] == 6 && values[14] == 84 && values[15] == 70001);
+
+    assert(consumption_bitmap_copy(c, a));
+    assert(consumption_bitmap_andnot(c, b));
+    assert(consumption_bitmap_cardinality(c) == 10001 - 16);
+    assert(!consumption_bitmap_contains(c, 6) && consumption_bitmap_contains(c, 8));
+
+    assert(consumption_bitmap_copy(c, a));
+    assert(consumption_bitmap_or(c, b));
+    assert(consumption_bitmap_cardinality(c) == 10001 + 15 + 1);
+    assert(consumption_bitmap_contains(c, 3) && consumption_bitmap_contains(c, 131072));
+
+    /* Shrinking below the array limit and back to empty */
+    for (uint32_t v = 0; v < 20000; v += 2) {
+        consumption_bitmap_remove(a, v);
+    }
+    assert(consumption_bitmap_cardinality(a) == 1 && consumption_bitmap_contains(a, 70001));
+
+    /* Serialize round trip; corrupt input is rejected */
+    size_t size = consumption_bitmap_serialize(c, NULL, 0);
+    uint8_t* buffer = (uint8_t*)malloc(size);
+    assert(consumption_bitmap_serialize(c, buffer, size) == size);
+    consumption_bitmap_t* d = consumption_bitmap_deserialize(buffer, size);
+    assert(d != NULL && consumption_bitmap_cardinality(d) == consumption_bitmap_cardinality(c));
+    assert(consumption_bitmap_andnot(d, c) && consumption_bitmap_cardinality(d) == 0);
+    assert(consumption_bitmap_deserialize(buffer, size - 1) == NULL);
+    buffer[0] ^= 1;
+    assert(consumption_bitmap_deserialize(buffer, size) == NULL);
+    buffer[0] ^= 1;
+
+    /* A container count the input cannot hold is rejected up front */
+    uint32_t forged[3] = {0, 65536, 0};
+    memcpy(forged, buffer, sizeof(uint32_t));
+    assert(consumption_bitmap_deserialize(forged, sizeof(forged)) == NULL);
+    free(buffer);
+
+    /* Rollup index: which machines sold product 7 but not product 9 */
+    consumption_rollup_config_t config;
+    consumption_rollup_config_default(&config);
+    config.buckets = 2;
+    config.index_machines = true;
+    consumption_rollup_t* cube = consumption_rollup_create(&config);
+    assert(cube != NULL);
+
+    static consumption_aggregate_t aggregate;
+    const uint32_t hour = 3600 * 400000;
+    for (uint32_t i = 0; i < 6; i++) {
+        assert(consumption_rollup_add_machine(cube, 500 + i, 50, 5) == CONSUMPTION_SUCCESS);
+        memset(&aggregate, 0, sizeof(aggregate));
+        aggregate.machine_id = 500 + i;
+        aggregate.period_start = hour;
+        aggregate.period_end = hour + 3600;
+        aggregate.product_counts[7] = (i % 2) ? 1 : 0;
+        aggregate.product_counts[9] = (i % 3) ? 0 : 1;
+        aggregate.total_events = aggregate.product_counts[7] + aggregate.product_counts[9];
+        assert(consumption_rollup_add(cube, &aggregate) == CONSUMPTION_SUCCESS);
+    }
+
+    assert(consumption_rollup_machines(cube, 7, hour, a) == CONSUMPTION_SUCCESS);
+    assert(consumption_rollup_machines(cube, 9, hour + 60, b) == CONSUMPTION_SUCCESS);
+    assert(consumption_bitmap_andnot(a, b));
+    assert(consumption_bitmap_to_array(a, values, 32) == 2);
+    uint32_t machine_id;
+    assert(consumption_rollup_machine_id(cube, values[0], &machine_id) == CONSUMPTION_SUCCESS);
+    assert(machine_id == 501);
+    assert(consumption_rollup_machine_id(cube, values[1], &machine_id) == CONSUMPTION_SUCCESS);
+    assert(machine_id == 505);
+    assert(consumption_rollup_machines(cube, 0, hour, a) == CONSUMPTION_SUCCESS);
+    assert(consumption_bitmap_cardinality(a) == 4);
+    assert(consumption_rollup_machines(cube, 7, hour + 3600, a) == CONSUMPTION_SUCCESS);
+    assert(consumption_bitmap_cardinality(a) == 0);
+
+    consumption_rollup_destroy(cube);
+    consumption_bitmap_destroy(a);
+    consumption_bitmap_destroy(b);
+    consumption_bitmap_destroy(c);
+    consumption_bitmap_destroy(d);
+
+    printf("✓ Bitmap index tests passed\n");
+}
+
+typedef struct {
+    consumption_query_row_t rows[600];
+    uint32_t count;
+} query_rows_t;
+
+static void collect_row(const consumption_query_row_t* row, void* user) {
+    query_rows_t* rows = (query_rows_t*)user;
+    if (rows->count < 600) rows->rows[rows->count++] = *row;
+}
+
+void test_archive_query(void) {
+    printf("Testing archive queries...\n");
+
+    /* 5000 events over 3 hours from 50 machines; quantities 1-3 */
+    enum { EVENTS = 5000 };
+    static consumption_event_t events[EVENTS];
+    const uint32_t base = 3600 * 400000;
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        events[i].timestamp = base + i * 2;
+        events[i].machine_id = 100 + (i * 7) % 50;
+        events[i].product_id = (uint8_t)(1 + (i * 13) % 20);
+        events[i].quantity = (uint16_t)(1 + i % 3);
+    }
+
+    for (uint32_t threads = 1; threads <= 3; threads += 2) {
+        consumption_archive_config_t config;
+        consumption_archive_config_default(&config);
+        config.segment_rows = 2048;
+        config.threads = threads;
+        consumption_archive_t* archive = consumption_archive_create(&config);
+        assert(archive != NULL);
+        assert(consumption_archive_append(archive, events, 3000) == CONSUMPTION_SUCCESS);
+        assert(consumption_archive_append(archive, events + 3000, EVENTS - 3000) == CONSUMPTION_SUCCESS);
+
+        consumption_archive_stats_t archive_stats;
+        consumption_archive_get_stats(archive, &archive_stats);
+        assert(archive_stats.rows == EVENTS && archive_stats.segments == 3);
+
+        /* Filtered sum against a plain loop */
+        consumption_query_t query;
+        consumption_query_default(&query);
+        query.time_from = base + 1000;
+        query.time_to = base + 7001;
+        query.machine_from = 110;
+        query.machine_to = 120;
+        query.product_id = 5;
+        uint64_t events_expected = 0, units_expected = 0;
+        for (uint32_t i = 0; i < EVENTS; i++) {
+            if (events[i].timestamp >= query.time_from && events[i].timestamp < query.time_to &&
+                events[i].machine_id >= 110 && events[i].machine_id <= 120 &&
+                events[i].product_id == 5) {
+                events_expected++;
+                units_expected += events[i].quantity;
+            }
+        }
+        static query_rows_t result;
+        consumption_query_stats_t stats;
+        result.count = 0;
+        assert(consumption_archive_query(archive, &query, collect_row, &result, &stats) ==
+               CONSUMPTION_SUCCESS);
+        assert(result.count == 1 && events_expected > 0);
+        assert(result.rows[0].events == events_expected && result.rows[0].units == units_expected);
+        assert(stats.blocks == 5 && stats.blocks_pruned >= 1);
+
+        /* Whole archive is answered from block statistics */
+        consumption_query_default(&query);
+        result.count = 0;
+        assert(consumption_archive_query(archive, &query, collect_row, &result, &stats) ==
+               CONSUMPTION_SUCCESS);
+        assert(result.rows[0].events == EVENTS && result.rows[0].units == 10000 - 1);
+        assert(stats.blocks_covered == 5 && stats.rows_scanned == 0);
+
+        /* Group by product and hour: groups add up, rows in key order */
+        query.time_from = base;
+        query.time_to = base + 3 * 3600;
+        query.group_by = CONSUMPTION_QUERY_GROUP_PRODUCT_HOUR;
+        result.count = 0;
+        assert(consumption_archive_query(archive, &query, collect_row, &result, NULL) ==
+               CONSUMPTION_SUCCESS);
+        assert(result.count == 20 * 3);
+        uint64_t sum = 0;
+        for (uint32_t r = 0; r < result.count; r++) {
+            sum += result.rows[r].units;
+            assert(r == 0 || result.rows[r].product_id > result.rows[r - 1].product_id ||
+                   result.rows[r].hour_start > result.rows[r - 1].hour_start);
+        }
+        assert(sum == 10000 - 1);
+        assert(result.rows[1].product_id == 1 && result.rows[1].hour_start == base + 3600);
+
+        /* Top 3 products by units */
+        query.group_by = CONSUMPTION_QUERY_GROUP_PRODUCT;
+        query.top_n = 3;
+        result.count = 0;
+        assert(consumption_archive_query(archive, &query, collect_row, &result, NULL) ==
+               CONSUMPTION_SUCCESS);
+        assert(result.count == 3);
+        assert(result.rows[0].units >= result.rows[1].units &&
+               result.rows[1].units >= result.rows[2].units);
+        uint64_t top = 0;
+        for (uint32_t i = 0; i < EVENTS; i++) {
+            if (events[i].product_id == result.rows[0].product_id) top += events[i].quantity;
+        }
+        assert(top == result.rows[0].units);
+
+        /* Hour grouping needs a bounded range */
+        query.time_to = 0;
+        query.group_by = CONSUMPTION_QUERY_GROUP_HOUR;
+        assert(consumption_archive_query(archive, &query, collect_row, &result, NULL) ==
+               CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+        consumption_archive_destroy(archive);
+    }
+
+    printf("✓ Archive query tests passed\n");
+}
+
+/* Replication records captured by the log handler, checkpoints copied */
+typedef struct {
+    consumption_log_record_t records[16];
+    uint8_t states[2][2048];
+    uint32_t count;
+    uint32_t checkpoints;
+} log_capture_t;
+
+static void capture_record(const consumption_log_record_t* record, void* ctx) {
+    log_capture_t* log = (log_capture_t*)ctx;
+    assert(log->count < 16);
+    consumption_log_record_t* copy = &log->records[log->count++];
+    *copy = *record;
+    if (record->type == CONSUMPTION_LOG_CHECKPOINT) {
+        assert(log->checkpoints < 2 && record->state_size <= sizeof(log->states[0]));
+        memcpy(log->states[log->checkpoints], record->state, record->state_size);
+        copy->state = log->states[log->checkpoints++];
+    }
+}
+
+void test_replication(void) {
+    printf("Testing replication...\n");
+
+    consumption_config_t config = {
+        .machine_id = 12121,
+        .ring_buffer_size = 32,
+    };
+    static log_capture_t log;
+    memset(&log, 0, sizeof(log));
+
+    /* Primary: every dispense is logged, checkpoints carry the stored record */
+    assert(consumption_log_checkpoint() == CONSUMPTION_ERROR_INVALID_CONFIG);
+    consumption_set_log_handler(capture_record, &log);
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+    assert(consumption_log_checkpoint() == CONSUMPTION_SUCCESS);
+    consumption_on_dispense(12121, 4);
+    consumption_on_dispense(12121, 4);
+    consumption_dispense_t batch[2] = {{0, 9, 3}, {0, 11, 1}};
+    assert(consumption_on_dispense_batch(12121, batch, 2) == CONSUMPTION_SUCCESS);
+    assert(log.count == 5 && log.checkpoints == 1);
+    assert(log.records[0].type == CONSUMPTION_LOG_CHECKPOINT);
+    assert(log.records[1].type == CONSUMPTION_LOG_DISPENSE);
+    assert(log.records[3].event.product_id == 9 && log.records[3].event.quantity == 3);
+
+    consumption_snapshot_t primary;
+    consumption_get_snapshot(&primary);
+    consumption_set_log_handler(NULL, NULL);
+    consumption_deinit();
+
+    /* Standby: fresh storage, same machine, replays the log */
+    memset(mock_storage, 0, sizeof(mock_storage));
+    assert(consumption_init(&config) == CONSUMPTION_SUCCESS);
+    for (uint32_t i = 0; i < log.count; i++) {
+        assert(consumption_log_apply(&log.records[i]) == CONSUMPTION_SUCCESS);
+    }
+    consumption_snapshot_t standby;
+    consumption_get_snapshot(&standby);
+    assert(standby.total_events == primary.total_events);
+    assert(standby.period_events == 6);
+    assert(standby.buffered_events == primary.buffered_events);
+    assert(memcmp(standby.product_counts, primary.product_counts, sizeof(primary.product_counts)) == 0);
+
+    /* Records for another machine or damaged checkpoints are refused */
+    consumption_log_record_t bad = log.records[1];
+    bad.event.machine_id = 1;
+    assert(consumption_log_apply(&bad) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    bad = log.records[0];
+    bad.state_size -= 1;
+    assert(consumption_log_apply(&bad) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_log_apply(NULL) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    /* Socket transport, both ends in this process: the standby end rewinds the
+     * counters to the checkpoint sent at start and replays the dispenses */
+    consumption_replica_config_t replica_config;
+    consumption_replica_config_default(&replica_config);
+    strcpy(replica_config.path, "/tmp/consumption_test.wal");
+    replica_config.batch_delay_ms = 0;
+
+    consumption_replica_t* standby_replica = consumption_replica_standby_start(&replica_config);
+    assert(standby_replica != NULL);
+    consumption_replica_t* primary_replica = consumption_replica_primary_start(&replica_config);
+    assert(primary_replica != NULL);
+    assert(consumption_replica_get_fd(standby_replica) >= 0);
+
+    consumption_on_dispense(12121, 7);
+    consumption_on_dispense(12121, 7);
+    consumption_replica_poll(primary_replica, 0);
+    assert(consumption_replica_poll(standby_replica, 100) == 3);
+    assert(consumption_replica_poll(primary_replica, 100) == 3);
+
+    consumption_replica_stats_t stats;
+    consumption_replica_get_stats(primary_replica, &stats);
+    assert(stats.records == 3 && stats.acked == 3 && stats.dropped == 0);
+    consumption_get_snapshot(&standby);
+    assert(standby.product_counts[7] == 2);
+
+    /* The standby notices the primary going away, then takes over */
+    assert(consumption_replica_promote(primary_replica) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    consumption_replica_stop(primary_replica);
+    consumption_on_dispense(12121, 7);              /* No handler any more */
+    consumption_replica_poll(standby_replica, 100);
+    consumption_replica_get_stats(standby_replica, &stats);
+    assert(stats.records == 3 && stats.gaps == 0 && stats.rejected == 0);
+    assert(stats.connected == 0 && stats.disconnects == 1);
+    assert(consumption_replica_promote(standby_replica) == CONSUMPTION_SUCCESS);
+    consumption_replica_stop(standby_replica);
+    consumption_get_snapshot(&standby);
+    assert(standby.product_counts[7] == 3);
+
+    /* A standby going away must not take the primary down with it */
+    standby_replica = consumption_replica_standby_start(&replica_config);
+    assert(standby_replica != NULL);
+    primary_replica = consumption_replica_primary_start(&replica_config);
+    assert(primary_replica != NULL);
+    consumption_replica_poll(standby_replica, 100);
+    consumption_replica_stop(standby_replica);
+    consumption_on_dispense(12121, 8);
+    consumption_on_dispense(12121, 8);
+    consumption_replica_poll(primary_replica, 0);
+    consumption_replica_get_stats(primary_replica, &stats);
+    assert(stats.connected == 0 && stats.disconnects == 1);
+    consumption_replica_stop(primary_replica);
+    consumption_get_snapshot(&standby);
+    assert(standby.product_counts[8] == 2);
+
+    consumption_deinit();
+
+    printf("✓ Replication tests passed\n");
+}
+
+static void count_aggregate(const consumption_aggregate_t* aggregate, void* user) {
+    *(uint64_t*)user += aggregate->total_events;
+}
+
+void test_mergeable_counters(void) {
+    printf("Testing mergeable counters...\n");
+
+    consumption_crdt_config_t config;
+    consumption_crdt_config_default(&config);
+    config.max_entries = 64;
+    config.products = 32;
+    consumption_crdt_t* a = consumption_crdt_create(&config);
+    consumption_crdt_t* b = consumption_crdt_create(&config);
+    consumption_crdt_t* c = consumption_crdt_create(&config);
+    assert(a && b && c);
+    config.products = 1;
+    assert(consumption_crdt_create(&config) == NULL);
+
+    const uint32_t period = 7200;
+    consumption_aggregate_t agg;
+    memset(&agg, 0, sizeof(agg));
+    agg.machine_id = 501;
+    agg.period_start = period;
+    agg.period_end = period + 3600;
+    agg.total_events = 12;
+    agg.product_counts[3] = 10;
+    agg.product_counts[200] = 2;     /* Beyond config.products: total only */
+
+    /* Both gateways receive the same upload, A twice; A also counts on its own */
+    assert(consumption_crdt_observe(a, 0, &agg) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_observe(a, 0, &agg) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_observe(b, 0, &agg) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_add(a, 501, period, 1001, 3, 5) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_add(a, 501, period, 1001, 0, 5) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    agg.machine_id = 502;
+    agg.total_events = 4;
+    agg.product_counts[3] = 4;
+    agg.product_counts[200] = 0;
+    assert(consumption_crdt_observe(b, 0, &agg) == CONSUMPTION_SUCCESS);
+
+    /* Exchange deltas both ways; the third gateway hears only from B */
+    uint8_t delta_a[CONSUMPTION_CRDT_DELTA_MIN], delta_b[CONSUMPTION_CRDT_DELTA_MIN];
+    size_t len_a = consumption_crdt_delta(a, delta_a, sizeof(delta_a));
+    size_t len_b = consumption_crdt_delta(b, delta_b, sizeof(delta_b));
+    assert(len_a > 0 && len_b > 0 && len_a < 64);
+    assert(consumption_crdt_delta(a, delta_a + len_a, sizeof(delta_a) - len_a) == 0);
+    assert(consumption_crdt_merge(b, delta_a, len_a) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_merge(a, delta_b, len_b) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_merge(a, delta_b, len_b) == CONSUMPTION_SUCCESS);   /* Idempotent */
+
+    consumption_crdt_stats_t stats;
+    consumption_crdt_get_stats(b, &stats);
+    assert(stats.entries == 3 && stats.pending == 1 && stats.raised == 2);
+    uint8_t forward[CONSUMPTION_CRDT_DELTA_MIN];
+    size_t len_f = consumption_crdt_delta(b, forward, sizeof(forward));
+    assert(consumption_crdt_merge(c, delta_b, len_b) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_merge(c, forward, len_f) == CONSUMPTION_SUCCESS);
+
+    /* Same counters everywhere; the duplicated upload counts once */
+    consumption_crdt_t* sets[3] = {a, b, c};
+    for (int i = 0; i < 3; i++) {
+        consumption_aggregate_t merged;
+        assert(consumption_crdt_read(sets[i], 501, period, &merged) == CONSUMPTION_SUCCESS);
+        assert(merged.total_events == 17 && merged.product_counts[3] == 15);
+        assert(merged.period_end == period + 3600);
+        assert(consumption_crdt_read(sets[i], 502, period, &merged) == CONSUMPTION_SUCCESS);
+        assert(merged.total_events == 4);
+        uint64_t total = 0;
+        assert(consumption_crdt_collect(sets[i], period + 1, count_aggregate, &total) == 2);
+        assert(total == 21);
+    }
+    consumption_aggregate_t merged;
+    assert(consumption_crdt_read(a, 503, period, &merged) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    /* Merged in the other order, the counters are the same */
+    consumption_crdt_t* d = consumption_crdt_create(NULL);
+    assert(consumption_crdt_merge(d, forward, len_f) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_merge(d, delta_a, len_a) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_merge(d, delta_b, len_b) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_read(d, 501, period, &merged) == CONSUMPTION_SUCCESS);
+    assert(merged.total_events == 17 && merged.product_counts[3] == 15);
+
+    /* Malformed deltas change nothing */
+    delta_a[len_a - 1] ^= 0x80;
+    assert(consumption_crdt_merge(d, delta_a, len_a) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_crdt_merge(d, delta_b, len_b - 1) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_crdt_merge(d, delta_b, 4) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    /* A rejoining gateway gets the full state; small buffers split it */
+    consumption_crdt_t* e = consumption_crdt_create(&(consumption_crdt_config_t){64, 32});
+    consumption_crdt_mark_all(a);
+    uint8_t small[48];
+    size_t len;
+    int deltas = 0;
+    while ((len = consumption_crdt_delta(a, small, sizeof(small))) > 0) {
+        assert(consumption_crdt_merge(e, small, len) == CONSUMPTION_SUCCESS);
+        deltas++;
+    }
+    assert(deltas == 3);
+    assert(consumption_crdt_read(e, 501, period, &merged) == CONSUMPTION_SUCCESS);
+    assert(merged.total_events == 17);
+
+    /* Evicted periods stay evicted */
+    assert(consumption_crdt_add(e, 501, period + 3600, 1001, 3, 1) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_evict(e, period + 3600) == 3);
+    assert(consumption_crdt_read(e, 501, period, &merged) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_crdt_read(e, 501, period + 3600, &merged) == CONSUMPTION_SUCCESS);
+    assert(merged.total_events == 1);
+    assert(consumption_crdt_merge(e, forward, len_f) == CONSUMPTION_SUCCESS);
+    assert(consumption_crdt_add(e, 501, period, 1001, 3, 1) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    consumption_crdt_get_stats(e, &stats);
+    assert(stats.entries == 1 && stats.late == 2 && stats.horizon == period + 3600);
+
+    consumption_crdt_destroy(a);
+    consumption_crdt_destroy(b);
+    consumption_crdt_destroy(c);
+    consumption_crdt_destroy(d);
+    consumption_crdt_destroy(e);
+
+    printf("✓ Mergeable counter tests passed\n");
+}
+
+void test_sync_scheduler(void) {
+    printf("Testing sync scheduler...\n");
+
+    consumption_scheduler_config_t config;
+    consumption_scheduler_config_default(&config);
+    config.max_contexts = 300;
+    consumption_scheduler_t* sched = consumption_scheduler_create(&config);
+    assert(sched != NULL);
+    int a = consumption_scheduler_add_destination(sched, 3, 0);
+    int b = consumption_scheduler_add_destination(sched, 1, 2);
+    assert(a == 0 && b == 1);
+    assert(consumption_scheduler_add_destination(sched, 0, 0) == -1);
+
+    for (uint32_t i = 1; i <= 8; i++) {
+        assert(consumption_scheduler_add(sched, i, (uint32_t)a, 3600, 100) == CONSUMPTION_SUCCESS);
+        assert(consumption_scheduler_add(sched, 100 + i, (uint32_t)b, 3600, 100 + i) == CONSUMPTION_SUCCESS);
+    }
+    assert(consumption_scheduler_add(sched, 200, (uint32_t)a, 60, 500) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_add(sched, 200, (uint32_t)b, 60, 500) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_scheduler_add(sched, 201, 5, 60, 500) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    /* Nothing due yet */
+    uint32_t due[32];
+    uint32_t next;
+    assert(consumption_scheduler_poll(sched, 50, due, 32) == 0);
+    assert(consumption_scheduler_next_due(sched, 50, &next) == CONSUMPTION_SUCCESS && next == 100);
+
+    /* B stops at its cap of two in flight, most overdue first */
+    assert(consumption_scheduler_poll(sched, 200, due, 32) == 10);
+    consumption_scheduler_destination_stats_t dest_stats;
+    consumption_scheduler_get_destination_stats(sched, (uint32_t)b, &dest_stats);
+    assert(dest_stats.in_flight == 2 && dest_stats.contexts == 6);
+    bool b_first = false, b_second = false;
+    for (int i = 0; i < 10; i++) {
+        b_first = b_first || due[i] == 101;
+        b_second = b_second || due[i] == 102;
+    }
+    assert(b_first && b_second);
+    consumption_scheduler_stats_t stats;
+    consumption_scheduler_get_stats(sched, &stats);
+    assert(stats.in_flight == 10 && stats.capped == 1 && stats.max_lateness == 100);
+
+    /* Completion reschedules: on time one interval later, failures back off */
+    assert(consumption_scheduler_complete(sched, 101, true, 210) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_complete(sched, 101, true, 210) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_scheduler_complete(sched, 102, false, 210) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_poll(sched, 215, due, 32) == 2);   /* B's next two */
+    assert(due[0] == 103 && due[1] == 104);
+    assert(consumption_scheduler_complete(sched, 103, true, 216) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_complete(sched, 104, true, 216) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_poll(sched, 216, due, 32) == 2);
+    assert(due[0] == 105 && due[1] == 106);
+    assert(consumption_scheduler_complete(sched, 105, true, 216) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_complete(sched, 106, true, 216) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_poll(sched, 219, due, 32) == 2);
+    assert(due[0] == 107 && due[1] == 108);
+    assert(consumption_scheduler_complete(sched, 107, true, 219) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_complete(sched, 108, true, 219) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_poll(sched, 220, due, 32) == 1 && due[0] == 102);  /* Retry at 210 + 10 */
+    assert(consumption_scheduler_complete(sched, 102, false, 220) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_poll(sched, 239, due, 32) == 0);
+    assert(consumption_scheduler_poll(sched, 240, due, 32) == 1 && due[0] == 102);  /* Then 20 */
+    assert(consumption_scheduler_next_due(sched, 240, &next) == CONSUMPTION_SUCCESS && next == 500);
+
+    /* Removal, also while in flight */
+    assert(consumption_scheduler_remove(sched, 200) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_remove(sched, 102) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_remove(sched, 102) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_scheduler_complete(sched, 102, true, 241) == CONSUMPTION_SUCCESS);
+    assert(consumption_scheduler_remove(sched, 999) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    consumption_scheduler_get_stats(sched, &stats);
+    assert(stats.contexts == 15 && stats.failed == 2);
+    assert(consumption_scheduler_add(sched, 102, (uint32_t)b, 60, 500) == CONSUMPTION_SUCCESS);
+    consumption_scheduler_destroy(sched);
+
+    /* An overdue backlog drains at the configured rate, shared 3:1 */
+    config.rate = 4;
+    config.burst = 4;
+    sched = consumption_scheduler_create(&config);
+    a = consumption_scheduler_add_destination(sched, 3, 0);
+    b = consumption_scheduler_add_destination(sched, 1, 0);
+    for (uint32_t i = 0; i < 100; i++) {
+        consumption_scheduler_add(sched, i, (uint32_t)a, 3600, i);
+        consumption_scheduler_add(sched, 1000 + i, (uint32_t)b, 3600, i);
+    }
+    for (uint32_t now = 1000; now < 1010; now++) {
+        uint32_t n = consumption_scheduler_poll(sched, now, due, 32);
+        assert(n == 4);
+        for (uint32_t i = 0; i < n; i++) {
+            assert(consumption_scheduler_complete(sched, due[i], true, now) == CONSUMPTION_SUCCESS);
+        }
+    }
+    assert(consumption_scheduler_next_due(sched, 1009, &next) == CONSUMPTION_SUCCESS && next == 1010);
+    consumption_scheduler_get_destination_stats(sched, (uint32_t)a, &dest_stats);
+    assert(dest_stats.dispatched == 30);
+    consumption_scheduler_get_stats(sched, &stats);
+    assert(stats.dispatched == 40 && stats.throttled == 10);
+    consumption_scheduler_destroy(sched);
+
+    printf("✓ Sync scheduler tests passed\n");
+}
+
+typedef struct {
+    uint32_t count;
+    uint32_t ids[64];
+    uint32_t units;
+} fleet_capture_t;
+
+static void capture_fleet_aggregate(const consumption_aggregate_t* aggregate, void* user) {
+    fleet_capture_t* capture = (fleet_capture_t*)user;
+    capture->ids[capture->count++] = aggregate->machine_id;
+    capture->units += aggregate->total_events;
+}
+
+void test_fleet(void) {
+    printf("Testing fleet counters...\n");
+
+    consumption_fleet_config_t config;
+    consumption_fleet_config_default(&config);
+    config.max_machines = 40;
+    config.products = 16;
+    consumption_fleet_t* fleet = consumption_fleet_create(&config);
+    assert(fleet != NULL);
+
+    /* Even machines close every minute, odd ones hourly */
+    consumption_config_t machine = {
+        .api_endpoint = "https://fleet.example.com/consumption"
+    };
+    for (uint32_t i = 0; i < 40; i++) {
+        machine.machine_id = 500 + i;
+        machine.aggregation_interval = (i % 2) ? 3600 : 60;
+        assert(consumption_fleet_add(fleet, &machine, 1000) == (int32_t)i);
+    }
+    assert(consumption_fleet_add(fleet, &machine, 1000) == -1);     /* Duplicate */
+    machine.machine_id = 999;
+    assert(consumption_fleet_add(fleet, &machine, 1000) == -1);     /* Full */
+    assert(consumption_fleet_find(fleet, 537) == 37);
+    assert(consumption_fleet_find(fleet, 999) == -1);
+    consumption_config_t stored;
+    assert(consumption_fleet_get_config(fleet, 37, &stored) == CONSUMPTION_SUCCESS);
+    assert(stored.machine_id == 537 && stored.aggregation_interval == 3600);
+    assert(strcmp(stored.api_endpoint, machine.api_endpoint) == 0);
+    assert(consumption_fleet_get_config(fleet, 40, &stored) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_fleet_get_profile(fleet, 2) == consumption_fleet_get_profile(fleet, 0));
+    assert(consumption_fleet_get_profile(fleet, 1) != consumption_fleet_get_profile(fleet, 0));
+
+    for (int32_t i = 0; i < 40; i++) {
+        assert(consumption_fleet_dispense(fleet, i, (uint8_t)(1 + i % 15), (uint16_t)(i + 1)) == CONSUMPTION_SUCCESS);
+        assert(consumption_fleet_dispense(fleet, i, 200, 1) == CONSUMPTION_SUCCESS);  /* Total only */
+    }
+    assert(consumption_fleet_dispense(fleet, 40, 1, 1) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_fleet_dispense(fleet, 0, 0, 1) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    consumption_aggregate_t aggregate;
+    assert(consumption_fleet_get_open(fleet, 33, &aggregate) == CONSUMPTION_SUCCESS);
+    assert(aggregate.machine_id == 533 && aggregate.period_start == 1000 && aggregate.period_end == 0);
+    assert(aggregate.product_counts[4] == 34 && aggregate.total_events == 35);
+    assert(aggregate.product_counts[200] == 0);
+    assert(consumption_fleet_get_closed(fleet, 33, &aggregate) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    /* One minute: the even machines close */
+    fleet_capture_t capture;
+    assert(consumption_fleet_close(fleet, 1059) == 0);
+    assert(consumption_fleet_close(fleet, 1060) == 20);
+    memset(&capture, 0, sizeof(capture));
+    assert(consumption_fleet_collect(fleet, capture_fleet_aggregate, &capture) == 20);
+    for (uint32_t i = 0; i < 20; i++) {
+        assert(capture.ids[i] == 500 + 2 * i);
+    }
+    assert(capture.units == 420);                   /* Sum of i + 2 over even i */
+    assert(consumption_fleet_get_closed(fleet, 32, &aggregate) == CONSUMPTION_SUCCESS);
+    assert(aggregate.period_start == 1000 && aggregate.period_end == 1060);
+    assert(aggregate.product_counts[3] == 33 && aggregate.total_events == 34);
+    assert(consumption_fleet_get_open(fleet, 32, &aggregate) == CONSUMPTION_SUCCESS);
+    assert(aggregate.period_start == 1060 && aggregate.total_events == 0 && aggregate.product_counts[3] == 0);
+    assert(consumption_fleet_get_open(fleet, 33, &aggregate) == CONSUMPTION_SUCCESS);
+    assert(aggregate.product_counts[4] == 34);      /* Odd machines untouched */
+
+    /* The closed copy survives until the machine's next close */
+    assert(consumption_fleet_dispense(fleet, 32, 3, 5) == CONSUMPTION_SUCCESS);
+    assert(consumption_fleet_close(fleet, 1100) == 0);
+    assert(consumption_fleet_collect(fleet, capture_fleet_aggregate, &capture) == 0);
+    assert(consumption_fleet_close(fleet, 1120) == 20);
+    assert(consumption_fleet_get_closed(fleet, 32, &aggregate) == CONSUMPTION_SUCCESS);
+    assert(aggregate.period_start == 1060 && aggregate.product_counts[3] == 5 && aggregate.total_events == 5);
+
+    /* The top of the hour closes everyone */
+    assert(consumption_fleet_close(fleet, 4600) == 40);
+    assert(consumption_fleet_get_closed(fleet, 33, &aggregate) == CONSUMPTION_SUCCESS);
+    assert(aggregate.period_start == 1000 && aggregate.period_end == 4600);
+    assert(aggregate.product_counts[4] == 34 && aggregate.total_events == 35);
+
+    /* A late close shortens the next period but keeps the phase */
+    assert(consumption_fleet_close(fleet, 4685) == 20);
+    assert(consumption_fleet_get_closed(fleet, 32, &aggregate) == CONSUMPTION_SUCCESS);
+    assert(aggregate.period_start == 4600 && aggregate.period_end == 4685);
+    assert(consumption_fleet_close(fleet, 4719) == 0);
+    assert(consumption_fleet_close(fleet, 4720) == 20);
+    assert(consumption_fleet_close(fleet, 4779) == 0);
+    assert(consumption_fleet_close(fleet, 4780) == 20);
+
+    consumption_fleet_stats_t stats;
+    consumption_fleet_get_stats(fleet, &stats);
+    assert(stats.machines == 40 && stats.last_closed == 20 && stats.periods_closed == 140);
+    assert(stats.hot_bytes > stats.cold_bytes / 4);
+    consumption_fleet_destroy(fleet);
+
+    config.products = 1;
+    assert(consumption_fleet_create(&config) == NULL);
+    consumption_fleet_destroy(NULL);
+
+    printf("✓ Fleet counter tests passed\n");
+}
+
+/**
+ * @brief Set a string with garbage after its terminator
+ */
+static void poison_string(char* field, size_t size, const char* value) {
+    memset(field, 0xAB, size);
+    strcpy(field, value);
+}
+
+void test_config_profiles(void) {
+    printf("Testing config profiles...\n");
+
+    consumption_profiles_t* profiles = consumption_profiles_create(2);
+    assert(profiles != NULL);
+    consumption_config_t config;
+    memset(&config, 0, sizeof(config));
+    poison_string(config.api_endpoint, sizeof(config.api_endpoint), "https://api.example.com/consumption");
+    poison_string(config.api_key, sizeof(config.api_key), "key-1");
+    config.machine_id = 1;
+    config.enable_external_api = true;
+    config.ring_buffer_size = 100;
+    config.aggregation_interval = 60;
+    config.max_retry_attempts = 3;
+    config.retention = CONSUMPTION_RETENTION_UNIFORM;
+    config.upload_events = true;
+    consumption_network_config_t network;
+    memset(&network, 0, sizeof(network));
+    poison_string(network.server, sizeof(network.server), "api.example.com");
+    poison_string(network.username, sizeof(network.username), "gateway");
+    poison_string(network.password, sizeof(network.password), "");
+    poison_string(network.client_id, sizeof(network.client_id), "machine-1");
+    poison_string(network.ca_cert_path, sizeof(network.ca_cert_path), "/etc/ssl/ca.pem");
+    poison_string(network.client_cert_path, sizeof(network.client_cert_path), "");
+    poison_string(network.client_key_path, sizeof(network.client_key_path), "");
+    network.port = 443;
+    network.use_ssl = true;
+
+    /* Same settings, different machine and trailing bytes: one profile */
+    consumption_profile_t* a = consumption_profile_intern(profiles, &config, &network);
+    consumption_config_t other;
+    memset(&other, 0, sizeof(other));
+    other = config;
+    memset(other.api_key, 0, sizeof(other.api_key));
+    strcpy(other.api_key, "key-1");
+    other.machine_id = 2;
+    assert(consumption_profile_intern(profiles, &other, &network) == a);
+    assert(consumption_profile_config(a)->machine_id == 0);
+    assert(strcmp(consumption_profile_network(a)->server, "api.example.com") == 0);
+
+    consumption_profile_t* b = consumption_profile_intern(profiles, &config, NULL);
+    assert(b != NULL && b != a);
+    assert(consumption_profile_intern(profiles, &config, &(consumption_network_config_t){.port = 1}) == NULL);
+
+    consumption_profiles_stats_t stats;
+    consumption_profiles_get_stats(profiles, &stats);
+    assert(stats.profiles == 2 && stats.references == 3 && stats.interned == 1);
+
+    /* Updates reach every holder; the old version lives until reclaimed */
+    const consumption_config_t* before = consumption_profile_config(a);
+    strcpy(other.api_key, "key-2");
+    assert(consumption_profile_update(a, &other, &network) == CONSUMPTION_SUCCESS);
+    assert(strcmp(consumption_profile_config(a)->api_key, "key-2") == 0);
+    assert(strcmp(before->api_key, "key-1") == 0);
+    assert(consumption_profile_intern(profiles, &other, &network) == a);
+    consumption_profiles_get_stats(profiles, &stats);
+    assert(stats.retired == 1 && stats.references == 4);
+    consumption_profile_release(a);
+    assert(consumption_profiles_reclaim(profiles) == 1);
+
+    /* The last release frees the slot */
+    consumption_profile_release(b);
+    consumption_profiles_get_stats(profiles, &stats);
+    assert(stats.profiles == 1);
+    b = consumption_profile_intern(profiles, &config, NULL);
+    assert(b != NULL);
+    consumption_profile_release(b);
+
+    /* Fleet members share a caller's profile, phases spread the closes */
+    consumption_fleet_config_t fleet_config;
+    consumption_fleet_config_default(&fleet_config);
+    fleet_config.max_machines = 4;
+    fleet_config.products = 8;
+    consumption_fleet_t* fleet = consumption_fleet_create(&fleet_config);
+    assert(consumption_fleet_add_member(fleet, 10, a, 0, 1000) == 0);
+    assert(consumption_fleet_add_member(fleet, 11, a, 30, 1000) == 1);
+    assert(consumption_fleet_add_member(fleet, 11, a, 30, 1000) == -1);
+    assert(consumption_fleet_close(fleet, 1019) == 0);
+    assert(consumption_fleet_close(fleet, 1020) == 1);      /* 17 * 60 */
+    assert(consumption_fleet_close(fleet, 1050) == 1);      /* 17 * 60 + 30 */
+    consumption_config_t stored;
+    assert(consumption_fleet_get_config(fleet, 1, &stored) == CONSUMPTION_SUCCESS);
+    assert(stored.machine_id == 11 && strcmp(stored.api_key, "key-2") == 0);
+
+    other.aggregation_interval = 10;
+    assert(consumption_fleet_update_profile(fleet, a, &other, &network) == CONSUMPTION_SUCCESS);
+    assert(consumption_fleet_close(fleet, 1080) == 1);      /* Machine 10, old interval */
+    assert(consumption_fleet_close(fleet, 1090) == 1);      /* Then every 10 s */
+    consumption_fleet_stats_t fleet_stats;
+    consumption_fleet_get_stats(fleet, &fleet_stats);
+    assert(fleet_stats.cold_bytes < 4 * sizeof(consumption_config_t));
+    consumption_fleet_destroy(fleet);
+
+    consumption_profiles_get_stats(profiles, &stats);
+    assert(stats.references == 2);
+    consumption_profile_release(a);
+    consumption_profile_release(a);
+    consumption_profiles_get_stats(profiles, &stats);
+    assert(stats.profiles == 0);
+    consumption_profiles_destroy(profiles);
+    assert(consumption_profiles_create(0) == NULL);
+
+    printf("✓ Config profile tests passed\n");
+}
+
+void test_upload_batching(void) {
+    printf("Testing upload batching...\n");
+
+    consumption_batch_config_t config;
+    consumption_batch_config_default(&config);
+    config.gateway_id = 7;
+    config.max_bytes = CONSUMPTION_BATCH_MIN_BYTES;
+    config.max_in_flight = 2;
+    config.max_attempts = 2;
+    consumption_batch_t* batch = consumption_batch_create(&config);
+    assert(batch != NULL);
+
+    static consumption_aggregate_t aggregate;
+    static char payload[CONSUMPTION_BATCH_MIN_BYTES + 1];
+    memset(&aggregate, 0, sizeof(aggregate));
+    aggregate.period_start = 3600;
+    aggregate.period_end = 7200;
+    aggregate.total_events = 5;
+    aggregate.product_counts[3] = 2;
+    aggregate.product_counts[200] = 3;
+    for (uint32_t m = 1; m <= 3; m++) {
+        aggregate.machine_id = m;
+        assert(consumption_batch_add(batch, &aggregate, 100) == CONSUMPTION_SUCCESS);
+    }
+
+    /* Latency bound: the oldest entry waits at most max_delay */
+    uint32_t due, id;
+    assert(!consumption_batch_ready(batch, 101));
+    assert(consumption_batch_next_due(batch, 101, &due) == CONSUMPTION_SUCCESS && due == 102);
+    assert(consumption_batch_ready(batch, 102));
+    size_t len = consumption_batch_take(batch, payload, sizeof(payload), &id);
+    assert(len == strlen(payload));
+    assert(strncmp(payload, "{\"gateway\":7,\"batch\":1,\"entries\":[{\"machine_id\":1,", 48) == 0);
+    assert(strstr(payload, "\"total_events\":5,\"products\":{\"3\":2,\"200\":3}},{\"machine_id\":2,") != NULL);
+    assert(strcmp(payload + len - 3, "}]}") == 0);
+    assert(consumption_batch_take(batch, payload, sizeof(payload), &id) == 0);  /* Nothing queued */
+
+    /* Per-entry results: only the rejected machine is sent again */
+    const bool partial[3] = {true, false, true};
+    assert(consumption_batch_complete(batch, id, partial, 2, 103) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(consumption_batch_complete(batch, id, partial, 3, 103) == CONSUMPTION_SUCCESS);
+    assert(consumption_batch_complete(batch, id, partial, 3, 103) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(!consumption_batch_ready(batch, 104) && consumption_batch_ready(batch, 105));
+    len = consumption_batch_take(batch, payload, sizeof(payload), &id);
+    assert(strstr(payload, "\"machine_id\":2,") != NULL && strstr(payload, "\"machine_id\":1,") == NULL);
+
+    /* A failed request holds off for retry_delay, then resends as is */
+    assert(consumption_batch_complete(batch, id, NULL, 0, 105) == CONSUMPTION_SUCCESS);
+    assert(!consumption_batch_ready(batch, 114) && consumption_batch_ready(batch, 115));
+    assert(consumption_batch_next_due(batch, 105, &due) == CONSUMPTION_SUCCESS && due == 115);
+    len = consumption_batch_take(batch, payload, sizeof(payload), &id);
+    assert(strstr(payload, "\"machine_id\":2,") != NULL);
+
+    /* The second rejection drops it */
+    const bool rejected[1] = {false};
+    assert(consumption_batch_complete(batch, id, rejected, 1, 115) == CONSUMPTION_SUCCESS);
+    consumption_batch_stats_t stats;
+    consumption_batch_get_stats(batch, &stats);
+    assert(stats.queued == 0 && stats.in_flight == 0 && stats.entries_acked == 2);
+    assert(stats.entries_rejected == 2 && stats.entries_dropped == 1 && stats.failed_batches == 1);
+
+    /* Size bound: a full payload is ready at once and never exceeds max_bytes */
+    for (uint32_t m = 0; m < 200; m++) {
+        aggregate.machine_id = 1000 + m;
+        assert(consumption_batch_add(batch, &aggregate, 200) == CONSUMPTION_SUCCESS);
+    }
+    assert(consumption_batch_ready(batch, 200));
+    uint32_t first_id, second_id;
+    size_t first = consumption_batch_take(batch, payload, sizeof(payload), &first_id);
+    assert(first > config.max_bytes - 200 && first <= config.max_bytes);
+    assert(consumption_batch_take(batch, payload, sizeof(payload), &second_id) > 0);
+    assert(!consumption_batch_ready(batch, 300));    /* Both batches in flight */
+    assert(consumption_batch_take(batch, payload, sizeof(payload), &id) == 0);
+    assert(consumption_batch_complete(batch, first_id, NULL, 0, 200) == CONSUMPTION_SUCCESS);
+    consumption_batch_get_stats(batch, &stats);
+    assert(stats.queued + stats.in_flight == 200 && stats.batches == 5);
+    consumption_batch_destroy(batch);
+
+    config.max_bytes = 1024;
+    assert(consumption_batch_create(&config) == NULL);
+    consumption_batch_destroy(NULL);
+
+    printf("✓ Upload batching tests passed\n");
+}
+
+static void count_ingested(const consumption_sparse_aggregate_t* entry, void* user) {
+    uint32_t* units = (uint32_t*)user;
+    for (uint32_t i = 0; i < entry->count; i++) {
+        *units += entry->counts[i];
+    }
+}
+
+void test_payload_ingest(void) {
+    printf("Testing payload ingest...\n");
+
+    static consumption_aggregate_t aggregate;
+    consumption_sparse_aggregate_t entry;
+
+    /* The core's upload, with whitespace, an unknown member and raw events */
+    const char* upload =
+        "{\"machine_id\":4294967295,\"seq\":12,\"period_start\":1700000000,"
+        "\"period_end\":1700003600,\"total_events\":123456789,"
+        "\"products\": { \"1\" : 7 , \"42\":123456789,\"255\":0 },"
+        "\"note\":\"a \\\"quoted\\\" [value] {with} brackets, long enough to scan\","
+        "\"events\":[[1700000001,1,1,1],[1700000002,42,2,0.5]]}\n";
+    assert(consumption_ingest_parse_sparse(upload, strlen(upload), &entry) == CONSUMPTION_SUCCESS);
+    assert(entry.machine_id == 4294967295u && entry.seq == 12 && entry.period_start == 1700000000);
+    assert(entry.period_end == 1700003600 && entry.total_events == 123456789);
+    assert(entry.count == 3 && entry.product_ids[1] == 42 && entry.counts[1] == 123456789);
+    assert(consumption_ingest_parse(upload, strlen(upload), &aggregate) == CONSUMPTION_SUCCESS);
+    assert(aggregate.product_counts[1] == 7 && aggregate.product_counts[42] == 123456789);
+    assert(aggregate.product_counts[2] == 0 && aggregate.machine_id == 4294967295u);
+
+    /* Heartbeat frame: no products; short input takes the scalar paths */
+    const char* heartbeat = "{\"machine_id\":9,\"seq\":3,\"period_start\":1,\"period_end\":2,\"digest\":\"0badf00d\"}";
+    assert(consumption_ingest_parse_sparse(heartbeat, strlen(heartbeat), &entry) == CONSUMPTION_SUCCESS);
+    assert(entry.count == 0 && entry.total_events == 0);
+    const char* tiny = "{\"machine_id\":1,\"period_start\":2,\"period_end\":3}";
+    assert(consumption_ingest_parse_sparse(tiny, strlen(tiny), &entry) == CONSUMPTION_SUCCESS);
+    assert(entry.machine_id == 1 && entry.period_end == 3);
+    /* Not NUL-terminated: the length bounds the parse */
+    assert(consumption_ingest_parse_sparse(tiny, strlen(tiny) - 1, &entry) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    /* Two products objects of 200 IDs each: more entries than product_ids holds */
+    static char repeated[4096];
+    size_t used = (size_t)sprintf(repeated, "{\"machine_id\":1,\"period_start\":2,\"period_end\":3");
+    for (int object = 0; object < 2; object++) {
+        used += (size_t)sprintf(repeated + used, ",\"products\":{");
+        for (int id = 1; id <= 200; id++) {
+            used += (size_t)sprintf(repeated + used, "%s\"%d\":1", id > 1 ? "," : "", id);
+        }
+        used += (size_t)sprintf(repeated + used, "}");
+    }
+    sprintf(repeated + used, "}");
+
+    const char* const bad[] = {
+        "{\"machine_id\":1,\"period_start\":2}",                                            /* Missing field */
+        "{\"machine_id\":4294967296,\"period_start\":2,\"period_end\":3}",                /* Overflow */
+        "{\"machine_id\":-1,\"period_start\":2,\"period_end\":3}",
+        "{\"machine_id\":1,\"period_start\":2,\"period_end\":3,\"products\":{\"0\":1}}",
+        "{\"machine_id\":1,\"period_start\":2,\"period_end\":3,\"products\":{\"256\":1}}",
+        "{\"machine_id\":1,\"period_start\":2,\"period_end\":3,\"products\":{\"5\":1,\"5\":2}}",
+        "{\"machine_id\":1,\"period_start\":2,\"period_end\":3,\"events\":[[1,2],{]}",
+        "{\"machine_id\":1,\"period_start\":2,\"period_end\":3} trailing",
+        "{\"machine_id\":1,\"period_start\":2,\"period_end\":3,\"note\":\"unterminated",
+        "{\"machine_id\":1,\"period_start\":2,\"period_end\":3,\"products\":{\"5\":1},\"products\":{\"6\":1}}",
+        repeated,
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        assert(consumption_ingest_parse_sparse(bad[i], strlen(bad[i]), &entry) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    }
+
+    /* Round trip through the batcher */
+    consumption_batch_t* batch = consumption_batch_create(NULL);
+    static char payload[65536 + 1];
+    uint32_t sent = 0;
+    memset(&aggregate, 0, sizeof(aggregate));
+    aggregate.period_start = 3600;
+    aggregate.period_end = 7200;
+    for (uint32_t m = 0; m < 100; m++) {
+        aggregate.machine_id = m;
+        aggregate.product_counts[1 + m % 255] = m * 1000003u;
+        aggregate.product_counts[255 - m % 100] = 1;
+        sent += m * 1000003u + 1;
+        assert(consumption_batch_add(batch, &aggregate, 0) == CONSUMPTION_SUCCESS);
+        aggregate.product_counts[1 + m % 255] = 0;
+        aggregate.product_counts[255 - m % 100] = 0;
+    }
+    uint32_t id, gateway, batch_id, entries, units = 0;
+    size_t len = consumption_batch_take(batch, payload, sizeof(payload), &id);
+    assert(consumption_ingest_parse_batch(payload, len, &gateway, &batch_id, count_ingested, &units,
+                                          &entries) == CONSUMPTION_SUCCESS);
+    assert(gateway == 0 && batch_id == id && entries == 100 && units == sent);
+    assert(consumption_ingest_parse_batch(payload, len - 1, NULL, NULL, count_ingested, &units,
+                                          &entries) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    assert(entries == 100);
+    consumption_batch_destroy(batch);
+
+    printf("✓ Payload ingest tests passed\n");
+}
+
+typedef struct {
+    uint32_t count;
+    consumption_aggregate_t aggregates[8 * 13];
+} reprocess_capture_t;
+
+static void capture_reprocessed(const consumption_aggregate_t* aggregate, void* user) {
+    reprocess_capture_t* capture = (reprocess_capture_t*)user;
+    assert(capture->count < 8 * 13);
+    capture->aggregates[capture->count++] = *aggregate;
+}
+
+static void count_scanned_rows(const consumption_archive_rows_t* rows, void* user) {
+    *(uint32_t*)user += rows->count;
+}
+
+static void reprocess_log_record(const consumption_log_record_t* record, void* ctx) {
+    assert(consumption_reprocess_add_log((consumption_reprocess_t*)ctx, record) == CONSUMPTION_SUCCESS);
+}
+
+void test_reprocessing(void) {
+    printf("Testing reprocessing...\n");
+
+    /* 15-minute periods starting at :05, over three hours starting at 01:00 */
+    enum { MACHINES = 8, PERIODS = 13, EVENTS = 20000 };
+    const uint32_t hour = 1000000000u - 1000000000u % 3600;
+    consumption_reprocess_config_t config;
+    consumption_reprocess_config_default(&config);
+    config.interval = 900;
+    config.alignment = 300;
+    config.time_from = hour;
+    config.time_to = hour + 3 * 3600;
+    config.threads = 4;
+    const uint32_t first_start = hour - 600;
+
+    static consumption_event_t events[EVENTS];
+    static uint32_t expected[MACHINES][PERIODS][256];
+    memset(expected, 0, sizeof(expected));
+    uint32_t rng = 99, in_range = 0;
+    uint64_t in_range_units = 0;
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        events[i].timestamp = hour - 1800 + rng % (4 * 3600);
+        events[i].machine_id = 700 + (rng >> 12) % MACHINES;
+        events[i].product_id = (uint8_t)(1 + (rng >> 16) % 255);
+        events[i].quantity = (uint16_t)(1 + (rng >> 24) % 3);
+        if (events[i].timestamp >= config.time_from && events[i].timestamp < config.time_to) {
+            uint32_t period = (events[i].timestamp - first_start) / 900;
+            expected[events[i].machine_id - 700][period][events[i].product_id] += events[i].quantity;
+            in_range++;
+            in_range_units += events[i].quantity;
+        }
+    }
+
+    /* From an archive, in parallel, and from a plain event list on one thread */
+    consumption_archive_t* archive = consumption_archive_create(NULL);
+    assert(consumption_archive_append(archive, events, EVENTS) == CONSUMPTION_SUCCESS);
+    consumption_reprocess_t* from_archive = consumption_reprocess_create(&config);
+    config.threads = 1;
+    consumption_reprocess_t* from_events = consumption_reprocess_create(&config);
+    assert(from_archive != NULL && from_events != NULL);
+    assert(consumption_reprocess_add_archive(from_archive, archive) == CONSUMPTION_SUCCESS);
+    assert(consumption_reprocess_add(from_events, events, EVENTS / 2) == CONSUMPTION_SUCCESS);
+    assert(consumption_reprocess_add(from_events, events + EVENTS / 2, EVENTS / 2) == CONSUMPTION_SUCCESS);
+
+    static reprocess_capture_t a, b;
+    a.count = b.count = 0;
+    assert(consumption_reprocess_emit(from_archive, capture_reprocessed, &a) == CONSUMPTION_SUCCESS);
+    assert(consumption_reprocess_emit(from_events, capture_reprocessed, &b) == CONSUMPTION_SUCCESS);
+    assert(a.count == MACHINES * PERIODS && b.count == a.count);
+    assert(memcmp(a.aggregates, b.aggregates, a.count * sizeof(consumption_aggregate_t)) == 0);
+
+    uint64_t units = 0;
+    for (uint32_t i = 0; i < a.count; i++) {
+        const consumption_aggregate_t* aggregate = &a.aggregates[i];
+        uint32_t period = (aggregate->period_start - first_start) / 900;
+        assert(aggregate->period_start == first_start + period * 900);
+        assert(aggregate->period_end == aggregate->period_start + 900);
+        assert(aggregate->machine_id == 700 + i % MACHINES && period == i / MACHINES);
+        assert(memcmp(aggregate->product_counts, expected[i % MACHINES][period],
+                      sizeof(aggregate->product_counts)) == 0);
+        units += aggregate->total_events;
+    }
+    assert(units == in_range_units);
+
+    consumption_reprocess_stats_t stats;
+    consumption_reprocess_get_stats(from_events, &stats);
+    assert(stats.events == in_range && stats.skipped == EVENTS - in_range);
+    assert(stats.aggregates == a.count && stats.cells == 0);
+    consumption_reprocess_get_stats(from_archive, &stats);
+    assert(stats.events == in_range && stats.partitions == PERIODS);
+
+    /* Emptied by emit: the next round starts from zero */
+    a.count = 0;
+    assert(consumption_reprocess_add(from_archive, events, 1) == CONSUMPTION_SUCCESS);
+    assert(consumption_reprocess_emit(from_archive, capture_reprocessed, &a) == CONSUMPTION_SUCCESS);
+    assert(a.count == (events[0].timestamp - config.time_from < config.time_to - config.time_from));
+    uint32_t scanned = 0;
+    assert(consumption_archive_scan(archive, 0, 0, count_scanned_rows, &scanned) == CONSUMPTION_SUCCESS);
+    assert(scanned == EVENTS);
+    assert(consumption_archive_scan(archive, 10, 10, count_scanned_rows, &scanned) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+    consumption_reprocess_destroy(from_archive);
+    consumption_reprocess_destroy(from_events);
+    consumption_archive_destroy(archive);
+
+    /* From a replication log file: dispenses counted, checkpoints ignored */
+    consumption_config_t core = {
+        .machine_id = 4321,
+        .ring_buffer_size = 32,
+    };
+    assert(consumption_init(&core) == CONSUMPTION_SUCCESS);
+    consumption_replica_config_t replica_config;
+    consumption_replica_config_default(&replica_config);
+    replica_config.transport = CONSUMPTION_REPLICA_FILE;
+    strcpy(replica_config.path, "/tmp/consumption_reprocess_test.wal");
+    consumption_replica_t* primary = consumption_replica_primary_start(&replica_config);
+    assert(primary != NULL);
+    const uint32_t logged_from = mock_timestamp;
+    consumption_on_dispense(4321, 5);
+    consumption_dispense_t batch[2] = {{0, 5, 4}, {0, 6, 2}};
+    assert(consumption_on_dispense_batch(4321, batch, 2) == CONSUMPTION_SUCCESS);
+    consumption_replica_stop(primary);
+    consumption_deinit();
+
+    config.interval = 86400;
+    config.alignment = 0;
+    config.time_from = logged_from;
+    config.time_to = mock_timestamp;
+    consumption_reprocess_t* from_log = consumption_reprocess_create(&config);
+    uint64_t records = 0;
+    assert(consumption_replica_read_log(replica_config.path, reprocess_log_record, from_log,
+                                        &records) == CONSUMPTION_SUCCESS);
+    assert(records == 4);
+    a.count = 0;
+    assert(consumption_reprocess_emit(from_log, capture_reprocessed, &a) == CONSUMPTION_SUCCESS);
+    assert(a.count == 1 && a.aggregates[0].machine_id == 4321 && a.aggregates[0].total_events == 7);
+    assert(a.aggregates[0].product_counts[5] == 5 && a.aggregates[0].product_counts[6] == 2);
+    assert(a.aggregates[0].period_start % 86400 == 0);
+    consumption_reprocess_destroy(from_log);
+    remove(replica_config.path);
+    assert(consumption_replica_read_log(replica_config.path, reprocess_log_record, NULL,
+                                        &records) == CONSUMPTION_ERROR_INVALID_PARAMETER);
+
+    /* Invalid configurations */
+    consumption_reprocess_config_default(&config);
+    assert(consumption_reprocess_create(&config) == NULL);           /* No range */
+    config.time_to = 3600;
+    config.interval = 0;
+    assert(consumption_reprocess_create(&config) == NULL);
+    config.interval = 1;
+    config.time_to = UINT32_MAX;
+    assert(consumption_reprocess_create(&config) == NULL);           /* 2^26 periods per thread */
+    config.threads = 64;
+    consumption_reprocess_t* wide = consumption_reprocess_create(&config);
+    assert(wide != NULL);
+    consumption_reprocess_destroy(wide);
+    consumption_reprocess_destroy(NULL);
+
+    printf("✓ Reprocessing tests passed\n");
+}
+
 int main(void) {
     printf("Consumption Counter Module - Basic Tests\n");
     printf("========================================\n\n");
@@ -230,6 +2636,30 @@ int main(void) {
     test_ring_buffer_overflow();
     test_error_handling();
     test_configuration_update();
+    test_memory_footprint();
+    test_state_restore();
+    test_counter_only_mode();
+    test_concurrent_dispense();
+    test_batch_dispense();
+    test_reservoir_retention();
+    test_streaming_upload();
+    test_snapshot();
+    test_async_upload();
+    test_event_driver();
+    test_http_endpoint();
+    test_storage_sealing();
+    test_heartbeat_frames();
+    test_rollup_cube();
+    test_bitmap_index();
+    test_archive_query();
+    test_replication();
+    test_mergeable_counters();
+    test_sync_scheduler();
+    test_fleet();
+    test_config_profiles();
+    test_upload_batching();
+    test_payload_ingest();
+    test_reprocessing();
 
     printf("\n✓ All basic tests passed!\n");
     return 0;
@@ -0,0 +1,1011 @@
+/**
+ * @file ingest_stub.c
+ * @brief Reference ingest server for offline transport benchmarks
+ *
+ * A local receiver for everything the module uploads:
+ *
+ * - HTTP/1.1 (the HTTPS path without TLS, loopback only): POST with
+ *   Content-Length or chunked transfer encoding, keep-alive
+ * - MQTT-lite: MQTT 3.1.1 subset (CONNECT, PUBLISH QoS 0-2, SUBSCRIBE,
+ *   PINGREQ, DISCONNECT), including consumption_mqtt_publish_stream()
+ *   chunk reassembly ("<topic>/<upload_id>/<index>" and ".../end")
+ * - TCP: frames of a 4-byte big-endian length followed by the payload,
+ *   answered with one byte, 0x06 (ACK) or 0x15 (NAK)
+ *
+ * Every payload is validated (required fields, products summing to
+ * total_events, period order) and tracked per machine to detect duplicate
+ * and missing periods. Heartbeat and repeat frames (heartbeat_frames) are
+ * accepted; a repeat counts the units of the aggregate it refers to.
+ * Requests/s, bytes/s and p50/p99 latency (first byte in to response out)
+ * are reported per interval and at exit. Slow responses and errors
+ * (HTTP 503, MQTT disconnect, TCP NAK) can be injected at a given rate.
+ *
+ * Build:
+ *   gcc -std=gnu99 -O2 -o ingest_stub tools/ingest_stub.c
+ *
+ * Usage:
+ *   ingest_stub [--http PORT] [--mqtt PORT] [--tcp PORT] [--bind ADDR]
+ *               [--delay-ms MS] [--delay-rate P] [--error-rate P]
+ *               [--duration S] [--report S] [--seed N]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define STUB_MAX_EVENTS 64
+#define STUB_MAX_MESSAGE (16u * 1024u * 1024u)  /* Largest accepted payload */
+#define STUB_MAX_MACHINES 65536                 /* Tracked machines (power of 2) */
+#define STUB_LATENCY_SAMPLES 100000             /* Per report window */
+#define STUB_READ_CHUNK 16384
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef enum {
+    PROTO_HTTP = 0,
+    PROTO_MQTT,
+    PROTO_TCP,
+    PROTO_COUNT
+} proto_t;
+
+static const char* const g_proto_names[PROTO_COUNT] = {"http", "mqtt", "tcp"};
+
+typedef enum {
+    VERDICT_OK = 0,
+    VERDICT_INVALID,
+    VERDICT_INJECTED_ERROR,
+} verdict_t;
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} buffer_t;
+
+typedef struct {
+    int fd;                         /* -1 for listeners' placeholder */
+    proto_t proto;
+    bool listener;
+    buffer_t in;
+    buffer_t out;                   /* Response waiting for its due time */
+    size_t out_off;
+    uint64_t first_byte_ns;         /* Arrival of the current message */
+    uint64_t due_ns;                /* When out may be sent (0 = now) */
+    bool close_after;
+    bool delayed;                   /* Listed in g_delayed */
+    buffer_t upload;                /* MQTT chunk reassembly */
+    char upload_prefix[256];
+    uint32_t upload_next;
+} conn_t;
+
+typedef struct {
+    uint32_t machine_id;            /* 0 = empty slot */
+    uint32_t last_start;
+    uint32_t last_end;
+    uint64_t units;
+    uint32_t periods;
+    uint32_t last_full_seq;         /* Last aggregate with a "seq", for repeats */
+    uint32_t last_full_units;
+} machine_t;
+
+typedef struct {
+    uint64_t requests;
+    uint64_t bytes;
+    uint64_t valid;
+    uint64_t invalid;
+    uint64_t duplicates;
+    uint64_t compact;               /* Heartbeat and repeat frames */
+    uint64_t gaps;
+    uint64_t gap_seconds;
+    uint64_t injected_errors;
+    uint64_t injected_delays;
+    uint64_t units;
+    uint64_t events;
+    uint64_t per_proto[PROTO_COUNT];
+} counters_t;
+
+typedef struct {
+    const char* bind;
+    int ports[PROTO_COUNT];
+    uint32_t delay_ms;
+    double delay_rate;
+    double error_rate;
+    uint32_t duration_s;
+    uint32_t report_s;
+    uint32_t seed;
+} options_t;
+
+/* ============================================================================
+ * GLOBALS
+ * ============================================================================ */
+
+static options_t g_opt = {
+    .bind = "127.0.0.1",
+    .ports = {8081, 1884, 8082},
+    .report_s = 5,
+    .seed = 1,
+};
+
+static volatile sig_atomic_t g_stop = 0;
+static int g_epoll = -1;
+static machine_t g_machines[STUB_MAX_MACHINES];
+static counters_t g_total;
+static counters_t g_window;
+static uint64_t g_latency[STUB_LATENCY_SAMPLES];
+static uint32_t g_latency_count;
+static uint64_t g_latency_all[STUB_LATENCY_SAMPLES];
+static uint64_t g_latency_all_seen;
+static uint32_t g_rng;
+
+/* ============================================================================
+ * HELPERS
+ * ============================================================================ */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static double random_unit(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return (double)g_rng / 4294967296.0;
+}
+
+/* Buffers stay NUL-terminated so headers can be searched as strings */
+static bool buffer_append(buffer_t* buf, const void* data, size_t len) {
+    if (buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 4096;
+        while (cap < buf->len + len + 1) cap *= 2;
+        char* grown = (char*)realloc(buf->data, cap);
+        if (!grown) return false;
+        buf->data = grown;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return true;
+}
+
+static void buffer_consume(buffer_t* buf, size_t len) {
+    memmove(buf->data, buf->data + len, buf->len - len);
+    buf->len -= len;
+    buf->data[buf->len] = '\0';
+}
+
+static void buffer_free(buffer_t* buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = buf->cap = 0;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(uint64_t* values, uint32_t count, double p) {
+    if (count == 0) return 0;
+    qsort(values, count, sizeof(uint64_t), compare_u64);
+    uint32_t index = (uint32_t)(p * (count - 1) + 0.5);
+    return values[index];
+}
+
+static void record_latency(uint64_t ns) {
+    if (g_latency_count < STUB_LATENCY_SAMPLES) {
+        g_latency[g_latency_count++] = ns;
+    }
+    /* Reservoir over the whole run for the final report */
+    g_latency_all_seen++;
+    if (g_latency_all_seen <= STUB_LATENCY_SAMPLES) {
+        g_latency_all[g_latency_all_seen - 1] = ns;
+    } else {
+        uint64_t slot = (uint64_t)(random_unit() * (double)g_latency_all_seen);
+        if (slot < STUB_LATENCY_SAMPLES) g_latency_all[slot] = ns;
+    }
+}
+
+/* ============================================================================
+ * PAYLOAD VALIDATION
+ * ============================================================================ */
+
+/**
+ * @brief Find "key": and parse the unsigned number after it
+ */
+static bool json_uint(const char* body, size_t len, const char* key, uint32_t* value) {
+    const char* p = memmem(body, len, key, strlen(key));
+    if (!p) return false;
+    p += strlen(key);
+    const char* end = body + len;
+    if (p >= end || *p < '0' || *p > '9') return false;
+    uint64_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (uint64_t)(*p - '0');
+        if (v > UINT32_MAX) return false;
+        p++;
+    }
+    *value = (uint32_t)v;
+    return true;
+}
+
+/**
+ * @brief Sum a {"id":count,...} object
+ * @return false if malformed
+ */
+static bool json_products(const char* body, size_t len, uint64_t* sum) {
+    const char* p = memmem(body, len, "\"products\":{", 12);
+    if (!p) return false;
+    const char* end = body + len;
+    p += 12;
+    *sum = 0;
+    while (p < end && *p != '}') {
+        uint32_t id = 0, count = 0;
+        if (*p == ',') p++;
+        if (p >= end || *p++ != '"') return false;
+        while (p < end && *p >= '0' && *p <= '9') id = id * 10 + (uint32_t)(*p++ - '0');
+        if (p + 1 >= end || p[0] != '"' || p[1] != ':') return false;
+        p += 2;
+        if (p >= end || *p < '0' || *p > '9') return false;
+        while (p < end && *p >= '0' && *p <= '9') count = count * 10 + (uint32_t)(*p++ - '0');
+        if (id == 0 || id > 255) return false;
+        *sum += count;
+    }
+    return p < end;
+}
+
+static machine_t* machine_slot(uint32_t machine_id) {
+    uint32_t h = (machine_id * 2654435761u) & (STUB_MAX_MACHINES - 1);
+    for (uint32_t i = 0; i < STUB_MAX_MACHINES; i++) {
+        machine_t* m = &g_machines[(h + i) & (STUB_MAX_MACHINES - 1)];
+        if (m->machine_id == machine_id || m->machine_id == 0) {
+            m->machine_id = machine_id;
+            return m;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Validate an aggregate payload and account for it
+ */
+static verdict_t process_payload(proto_t proto, const char* body, size_t len) {
+    uint32_t machine_id, period_start, period_end, total_events = 0, seq = 0, repeat = 0;
+    uint64_t product_sum;
+
+    g_total.requests++;
+    g_window.requests++;
+    g_total.per_proto[proto]++;
+    g_window.per_proto[proto]++;
+
+    bool valid = len > 2 && body[0] == '{' && body[len - 1] == '}' &&
+                 json_uint(body, len, "\"machine_id\":", &machine_id) &&
+                 json_uint(body, len, "\"period_start\":", &period_start) &&
+                 json_uint(body, len, "\"period_end\":", &period_end) &&
+                 period_end >= period_start;
+
+    bool compact = valid && !memmem(body, len, "\"products\":", 11);
+    bool has_seq = valid && json_uint(body, len, "\"seq\":", &seq);
+    machine_t* m = valid ? machine_slot(machine_id) : NULL;
+    if (compact) {
+        /* Heartbeat (no units) or repeat of an acknowledged aggregate */
+        valid = has_seq && memmem(body, len, "\"digest\":\"", 10) != NULL;
+        if (valid && json_uint(body, len, "\"repeat\":", &repeat)) {
+            valid = m && m->last_full_seq == repeat;
+            if (valid) total_events = m->last_full_units;
+        }
+    } else {
+        valid = valid &&
+                json_uint(body, len, "\"total_events\":", &total_events) &&
+                json_products(body, len, &product_sum) &&
+                product_sum == total_events;
+    }
+
+    if (!valid) {
+        g_total.invalid++;
+        g_window.invalid++;
+        return VERDICT_INVALID;
+    }
+
+    if (random_unit() < g_opt.error_rate) {
+        g_total.injected_errors++;
+        g_window.injected_errors++;
+        return VERDICT_INJECTED_ERROR; /* Not accounted: the client must retry */
+    }
+
+    g_total.valid++;
+    g_window.valid++;
+
+    const char* events = memmem(body, len, "\"events\":[", 10);
+    if (events) {
+        uint64_t n = 0;
+        for (const char* p = events + 10; p < body + len; p++) {
+            if (*p == '[') n++;
+        }
+        g_total.events += n;
+        g_window.events += n;
+    }
+
+    if (compact) {
+        g_total.compact++;
+        g_window.compact++;
+    }
+
+    if (!m) {
+        return VERDICT_OK;
+    }
+    if (!compact && has_seq) {
+        m->last_full_seq = seq;
+        m->last_full_units = total_events;
+    }
+
+    if (m->periods > 0) {
+        if (period_start == m->last_start && period_end == m->last_end) {
+            g_total.duplicates++;
+            g_window.duplicates++;
+            return VERDICT_OK; /* Acknowledge, but don't count twice */
+        }
+        if (period_start < m->last_end) {
+            g_total.duplicates++; /* Overlaps an acknowledged period */
+            g_window.duplicates++;
+        } else if (period_start > m->last_end) {
+            g_total.gaps++;
+            g_window.gaps++;
+            g_total.gap_seconds += period_start - m->last_end;
+            g_window.gap_seconds += period_start - m->last_end;
+        }
+    }
+
+    m->last_start = period_start;
+    m->last_end = period_end;
+    m->periods++;
+    m->units += total_events;
+    g_total.units += total_events;
+    g_window.units += total_events;
+    return VERDICT_OK;
+}
+
+/* ============================================================================
+ * CONNECTIONS
+ * ============================================================================ */
+
+/*
+ * Delayed responses are few and short-lived; connections with one pending
+ * are kept in a small array and scanned on every loop iteration.
+ */
+#define STUB_MAX_DELAYED 4096
+static conn_t* g_delayed[STUB_MAX_DELAYED];
+static uint32_t g_delayed_count;
+
+static void delayed_remove(conn_t* conn) {
+    for (uint32_t i = 0; i < g_delayed_count; i++) {
+        if (g_delayed[i] == conn) {
+            g_delayed[i] = g_delayed[--g_delayed_count];
+            break;
+        }
+    }
+    conn->delayed = false;
+}
+
+static void conn_close(conn_t* conn) {
+    if (conn->delayed) {
+        delayed_remove(conn);
+    }
+    epoll_ctl(g_epoll, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    buffer_free(&conn->in);
+    buffer_free(&conn->out);
+    buffer_free(&conn->upload);
+    free(conn);
+}
+
+/**
+ * @brief Queue a response, delayed by the injection settings
+ */
+static void conn_respond(conn_t* conn, const void* data, size_t len, bool close_after) {
+    buffer_append(&conn->out, data, len);
+    conn->out_off = 0;
+    conn->close_after = close_after;
+    conn->due_ns = 0;
+    if (g_opt.delay_ms > 0 && random_unit() < g_opt.delay_rate) {
+        conn->due_ns = now_ns() + (uint64_t)g_opt.delay_ms * 1000000u;
+        g_total.injected_delays++;
+        g_window.injected_delays++;
+    }
+}
+
+/**
+ * @brief Send a due response
+ * @return false if the connection was closed
+ */
+static bool conn_flush(conn_t* conn) {
+    while (conn->out_off < conn->out.len) {
+        ssize_t n = send(conn->fd, conn->out.data + conn->out_off,
+                         conn->out.len - conn->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.ptr = conn };
+                epoll_ctl(g_epoll, EPOLL_CTL_MOD, conn->fd, &ev);
+                return true;
+            }
+            conn_close(conn);
+            return false;
+        }
+        conn->out_off += (size_t)n;
+    }
+
+    if (conn->out.len > 0) {
+        record_latency(now_ns() - conn->first_byte_ns);
+        conn->out.len = 0;
+        conn->out_off = 0;
+        conn->first_byte_ns = (conn->in.len > 0) ? now_ns() : 0; /* Pipelined */
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = conn };
+        epoll_ctl(g_epoll, EPOLL_CTL_MOD, conn->fd, &ev);
+    }
+    if (conn->close_after) {
+        conn_close(conn);
+        return false;
+    }
+    return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * HTTP
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Parse one HTTP request
+ * @return Bytes consumed, 0 if incomplete, -1 if malformed
+ */
+static long http_parse(conn_t* conn, buffer_t* body, bool* close_after) {
+    const char* data = conn->in.data;
+    const char* head_end = memmem(data, conn->in.len, "\r\n\r\n", 4);
+    if (!head_end) {
+        return (conn->in.len > 8192) ? -1 : 0;
+    }
+    size_t head_len = (size_t)(head_end - data) + 4;
+
+    *close_after = (memmem(data, head_len, "HTTP/1.0", 8) != NULL) ||
+                   (strcasestr(data, "\r\nConnection: close") &&
+                    strcasestr(data, "\r\nConnection: close") < head_end);
+
+    const char* cl = strcasestr(data, "\r\nContent-Length:");
+    bool chunked = strcasestr(data, "\r\nTransfer-Encoding: chunked") &&
+                   strcasestr(data, "\r\nTransfer-Encoding: chunked") < head_end;
+
+    if (chunked) {
+        size_t pos = head_len;
+        for (;;) {
+            const char* line_end = memmem(data + pos, conn->in.len - pos, "\r\n", 2);
+            if (!line_end) return 0;
+            size_t size = strtoul(data + pos, NULL, 16);
+            pos = (size_t)(line_end - data) + 2;
+            if (size == 0) {
+                if (conn->in.len < pos + 2) return 0;
+                return (long)(pos + 2); /* No trailers expected */
+            }
+            if (body->len + size > STUB_MAX_MESSAGE) return -1;
+            if (conn->in.len < pos + size + 2) {
+                body->len = 0; /* Incomplete, decode again later */
+                return 0;
+            }
+            buffer_append(body, data + pos, size);
+            pos += size + 2;
+        }
+    }
+
+    size_t content_length = 0;
+    if (cl && cl < head_end) {
+        content_length = strtoul(cl + 17, NULL, 10);
+    }
+    if (content_length > STUB_MAX_MESSAGE) return -1;
+    if (conn->in.len < head_len + content_length) return 0;
+    buffer_append(body, data + head_len, content_length);
+    return (long)(head_len + content_length);
+}
+
+static bool http_process(conn_t* conn) {
+    while (conn->out.len == 0 && conn->in.len > 0) {
+        buffer_t body = {0};
+        bool close_after = false;
+        long consumed = http_parse(conn, &body, &close_after);
+        if (consumed == 0) {
+            buffer_free(&body);
+            break;
+        }
+        if (consumed < 0) {
+            buffer_free(&body);
+            static const char bad[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            conn_respond(conn, bad, sizeof(bad) - 1, true);
+            conn->in.len = 0;
+            break;
+        }
+
+        verdict_t verdict = process_payload(PROTO_HTTP, body.data ? body.data : "", body.len);
+        buffer_free(&body);
+        buffer_consume(&conn->in, (size_t)consumed);
+
+        char response[160];
+        int n;
+        switch (verdict) {
+            case VERDICT_OK:
+                n = snprintf(response, sizeof(response),
+                    "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 15\r\n%s\r\n{\"status\":\"ok\"}",
+                    close_after ? "Connection: close\r\n" : "");
+                break;
+            case VERDICT_INVALID:
+                n = snprintf(response, sizeof(response),
+                    "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n%s\r\n",
+                    close_after ? "Connection: close\r\n" : "");
+                break;
+            default:
+                n = snprintf(response, sizeof(response),
+                    "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n%s\r\n",
+                    close_after ? "Connection: close\r\n" : "");
+                break;
+        }
+        conn_respond(conn, response, (size_t)n, close_after);
+    }
+    return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * MQTT-lite
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Handle a PUBLISH payload, reassembling streamed uploads
+ */
+static verdict_t mqtt_payload(conn_t* conn, const char* topic, size_t topic_len,
+                              const char* payload, size_t len) {
+    /* Chunked upload: <prefix>/<index> or <prefix>/end */
+    const char* slash = memrchr(topic, '/', topic_len);
+    if (slash) {
+        size_t prefix_len = (size_t)(slash - topic);
+        const char* last = slash + 1;
+        size_t last_len = topic_len - prefix_len - 1;
+        bool is_end = (last_len == 3 && memcmp(last, "end", 3) == 0);
+        bool is_index = last_len > 0 && last_len < 10 && strspn(last, "0123456789") >= last_len;
+        const char* id_slash = memrchr(topic, '/', prefix_len);
+        /* The upload ID segment must be numeric too, so ".../consumption/42" stays a plain publish */
+        size_t id_len = id_slash ? prefix_len - (size_t)(id_slash - topic) - 1 : 0;
+        bool is_chunk = id_len > 0 && id_len < 11 && strspn(id_slash + 1, "0123456789") >= id_len;
+
+        if ((is_end || is_index) && is_chunk && prefix_len < sizeof(conn->upload_prefix)) {
+            uint32_t index = is_index ? (uint32_t)strtoul(last, NULL, 10) : 0;
+            bool same = strlen(conn->upload_prefix) == prefix_len &&
+                        memcmp(conn->upload_prefix, topic, prefix_len) == 0;
+
+            if (is_index) {
+                if (index == 0) {
+                    memcpy(conn->upload_prefix, topic, prefix_len);
+                    conn->upload_prefix[prefix_len] = '\0';
+                    conn->upload.len = 0;
+                    conn->upload_next = 0;
+                    same = true;
+                }
+                if (!same || index != conn->upload_next ||
+                    conn->upload.len + len > STUB_MAX_MESSAGE) {
+                    conn->upload_prefix[0] = '\0';
+                    g_total.gaps++; /* Lost or reordered chunk */
+                    g_window.gaps++;
+                    return VERDICT_OK;
+                }
+                buffer_append(&conn->upload, payload, len);
+                conn->upload_next++;
+                return VERDICT_OK;
+            }
+
+            uint32_t expected = (uint32_t)strtoul(payload, NULL, 10);
+            if (!same || expected != conn->upload_next) {
+                conn->upload_prefix[0] = '\0';
+                return process_payload(PROTO_MQTT, "", 0);
+            }
+            conn->upload_prefix[0] = '\0';
+            return process_payload(PROTO_MQTT, conn->upload.data, conn->upload.len);
+        }
+    }
+
+    return process_payload(PROTO_MQTT, payload, len);
+}
+
+static bool mqtt_process(conn_t* conn) {
+    while (conn->out.len == 0 && conn->in.len >= 2) {
+        const uint8_t* p = (const uint8_t*)conn->in.data;
+        uint32_t remaining = 0, multiplier = 1;
+        size_t pos = 1;
+        do {
+            if (pos >= conn->in.len) return true; /* Incomplete length */
+            remaining += (p[pos] & 0x7F) * multiplier;
+            multiplier *= 128;
+        } while ((p[pos++] & 0x80) && pos < 5);
+        if (remaining > STUB_MAX_MESSAGE) {
+            conn_close(conn);
+            return false;
+        }
+        if (conn->in.len < pos + remaining) return true;
+
+        uint8_t type = p[0] >> 4;
+        const uint8_t* var = p + pos;
+        uint8_t reply[5];
+        size_t reply_len = 0;
+        bool drop = false;
+
+        switch (type) {
+            case 1: /* CONNECT */
+                reply[0] = 0x20; reply[1] = 0x02; reply[2] = 0x00; reply[3] = 0x00;
+                reply_len = 4;
+                break;
+            case 3: { /* PUBLISH */
+                uint8_t qos = (p[0] >> 1) & 0x03;
+                if (remaining < 2) { drop = true; break; }
+                size_t topic_len = ((size_t)var[0] << 8) | var[1];
+                size_t header = 2 + topic_len + (qos ? 2 : 0);
+                if (header > remaining) { drop = true; break; }
+                uint16_t packet_id = qos ? (uint16_t)((var[2 + topic_len] << 8) | var[3 + topic_len]) : 0;
+
+                verdict_t verdict = mqtt_payload(conn, (const char*)var + 2, topic_len,
+                                                 (const char*)var + header, remaining - header);
+                if (verdict == VERDICT_INJECTED_ERROR) {
+                    drop = true; /* No ack: the publisher sees a lost connection */
+                } else if (qos == 1) {
+                    reply[0] = 0x40; reply[1] = 0x02;
+                    reply[2] = (uint8_t)(packet_id >> 8); reply[3] = (uint8_t)packet_id;
+                    reply_len = 4;
+                } else if (qos == 2) {
+                    reply[0] = 0x50; reply[1] = 0x02;
+                    reply[2] = (uint8_t)(packet_id >> 8); reply[3] = (uint8_t)packet_id;
+                    reply_len = 4;
+                }
+                break;
+            }
+            case 6: /* PUBREL -> PUBCOMP */
+                reply[0] = 0x70; reply[1] = 0x02;
+                reply[2] = remaining >= 2 ? var[0] : 0; reply[3] = remaining >= 2 ? var[1] : 0;
+                reply_len = 4;
+                break;
+            case 8: /* SUBSCRIBE -> SUBACK granting QoS 0 */
+                reply[0] = 0x90; reply[1] = 0x03;
+                reply[2] = remaining >= 2 ? var[0] : 0; reply[3] = remaining >= 2 ? var[1] : 0;
+                reply[4] = 0x00;
+                reply_len = 5;
+                break;
+            case 12: /* PINGREQ */
+                reply[0] = 0xD0; reply[1] = 0x00;
+                reply_len = 2;
+                break;
+            case 14: /* DISCONNECT */
+                drop = true;
+                break;
+            default:
+                break; /* PUBACK etc. from the client: ignore */
+        }
+
+        buffer_consume(&conn->in, pos + remaining);
+        if (drop) {
+            conn_close(conn);
+            return false;
+        }
+        if (reply_len > 0) {
+            if (conn->first_byte_ns == 0) conn->first_byte_ns = now_ns();
+            conn_respond(conn, reply, reply_len, false);
+        } else {
+            conn->first_byte_ns = 0;
+        }
+    }
+    return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * TCP framing
+ * ------------------------------------------------------------------------- */
+
+static bool tcp_process(conn_t* conn) {
+    while (conn->out.len == 0 && conn->in.len >= 4) {
+        const uint8_t* p = (const uint8_t*)conn->in.data;
+        uint32_t len = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                       ((uint32_t)p[2] << 8) | p[3];
+        if (len > STUB_MAX_MESSAGE) {
+            conn_close(conn);
+            return false;
+        }
+        if (conn->in.len < 4 + (size_t)len) break;
+
+        verdict_t verdict = process_payload(PROTO_TCP, conn->in.data + 4, len);
+        buffer_consume(&conn->in, 4 + (size_t)len);
+
+        const char reply = (verdict == VERDICT_OK) ? 0x06 : 0x15;
+        conn_respond(conn, &reply, 1, false);
+    }
+    return true;
+}
+
+static bool conn_process(conn_t* conn) {
+    switch (conn->proto) {
+        case PROTO_HTTP: return http_process(conn);
+        case PROTO_MQTT: return mqtt_process(conn);
+        default:         return tcp_process(conn);
+    }
+}
+
+static void delayed_collect(conn_t* conn) {
+    if (!conn->delayed && conn->out.len > 0 && conn->due_ns > 0 &&
+        g_delayed_count < STUB_MAX_DELAYED) {
+        /* Stop reading until the response is out, keeping replies in order */
+        struct epoll_event ev = { .events = 0, .data.ptr = conn };
+        epoll_ctl(g_epoll, EPOLL_CTL_MOD, conn->fd, &ev);
+        g_delayed[g_delayed_count++] = conn;
+        conn->delayed = true;
+    }
+}
+
+/**
+ * @brief Answer complete messages until one is delayed or blocked on write
+ * @return false if the connection was closed
+ */
+static bool conn_pump(conn_t* conn) {
+    while (!conn->delayed && conn->out.len == 0) {
+        if (!conn_process(conn)) return false;
+        if (conn->out.len == 0) return true;        /* Waiting for more input */
+        if (conn->due_ns > 0) {
+            delayed_collect(conn);
+            return true;
+        }
+        if (!conn_flush(conn)) return false;
+    }
+    return true;
+}
+
+/**
+ * @return false if the connection was closed
+ */
+static bool conn_readable(conn_t* conn) {
+    char chunk[STUB_READ_CHUNK];
+    for (;;) {
+        ssize_t n = recv(conn->fd, chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            if (conn->first_byte_ns == 0) conn->first_byte_ns = now_ns();
+            g_total.bytes += (uint64_t)n;
+            g_window.bytes += (uint64_t)n;
+            if (!buffer_append(&conn->in, chunk, (size_t)n)) {
+                conn_close(conn);
+                return false;
+            }
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        conn_close(conn);
+        return false;
+    }
+
+    /* With a reply pending, the rest is answered in order once it is out */
+    return conn_pump(conn);
+}
+
+static void accept_all(conn_t* listener) {
+    for (;;) {
+        int fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        conn_t* conn = (conn_t*)calloc(1, sizeof(conn_t));
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->proto = listener->proto;
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = conn };
+        epoll_ctl(g_epoll, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+/* ============================================================================
+ * DELAYED RESPONSES
+ * ============================================================================ */
+
+static int delayed_timeout_ms(uint64_t now) {
+    uint64_t next = UINT64_MAX;
+    for (uint32_t i = 0; i < g_delayed_count; i++) {
+        if (g_delayed[i]->due_ns < next) next = g_delayed[i]->due_ns;
+    }
+    if (next == UINT64_MAX) return -1;
+    return (next <= now) ? 0 : (int)((next - now) / 1000000u) + 1;
+}
+
+static void delayed_run(uint64_t now) {
+    for (uint32_t i = 0; i < g_delayed_count;) {
+        conn_t* conn = g_delayed[i];
+        if (conn->due_ns > now) {
+            i++;
+            continue;
+        }
+        g_delayed[i] = g_delayed[--g_delayed_count];
+        conn->delayed = false;
+        conn->due_ns = 0;
+        if (conn_flush(conn)) {
+            conn_pump(conn);
+        }
+    }
+}
+
+/* ============================================================================
+ * REPORTING
+ * ============================================================================ */
+
+static void report(const char* label, const counters_t* c, uint64_t* latency,
+                   uint32_t latency_count, double seconds) {
+    if (seconds <= 0) seconds = 1e-9;
+    printf("[%s] %.1fs req=%llu (%.0f/s) bytes=%llu (%.0f B/s) "
+           "p50=%.2fms p99=%.2fms valid=%llu invalid=%llu dup=%llu compact=%llu gaps=%llu (%llus) "
+           "units=%llu events=%llu injected: err=%llu delay=%llu "
+           "[http=%llu mqtt=%llu tcp=%llu]\n",
+           label, seconds,
+           (unsigned long long)c->requests, c->requests / seconds,
+           (unsigned long long)c->bytes, c->bytes / seconds,
+           percentile(latency, latency_count, 0.50) / 1e6,
+           percentile(latency, latency_count, 0.99) / 1e6,
+           (unsigned long long)c->valid, (unsigned long long)c->invalid,
+           (unsigned long long)c->duplicates, (unsigned long long)c->compact,
+           (unsigned long long)c->gaps,
+           (unsigned long long)c->gap_seconds,
+           (unsigned long long)c->units, (unsigned long long)c->events,
+           (unsigned long long)c->injected_errors, (unsigned long long)c->injected_delays,
+           (unsigned long long)c->per_proto[PROTO_HTTP],
+           (unsigned long long)c->per_proto[PROTO_MQTT],
+           (unsigned long long)c->per_proto[PROTO_TCP]);
+    fflush(stdout);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+static void on_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static int listen_on(proto_t proto, int port) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, g_opt.bind, &addr.sin_addr) != 1) {
+        fprintf(stderr, "invalid bind address %s\n", g_opt.bind);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "%s: cannot listen on %s:%d: %s\n",
+                g_proto_names[proto], g_opt.bind, port, strerror(errno));
+        return -1;
+    }
+
+    conn_t* listener = (conn_t*)calloc(1, sizeof(conn_t));
+    listener->fd = fd;
+    listener->proto = proto;
+    listener->listener = true;
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = listener };
+    epoll_ctl(g_epoll, EPOLL_CTL_ADD, fd, &ev);
+
+    printf("%s listening on %s:%d\n", g_proto_names[proto], g_opt.bind, port);
+    return 0;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --http PORT        HTTP port (default 8081, 0 = off)\n"
+        "  --mqtt PORT        MQTT-lite port (default 1884, 0 = off)\n"
+        "  --tcp PORT         Length-prefixed TCP port (default 8082, 0 = off)\n"
+        "  --bind ADDR        Listen address (default 127.0.0.1)\n"
+        "  --delay-ms MS      Injected response delay\n"
+        "  --delay-rate P     Fraction of responses delayed (0-1)\n"
+        "  --error-rate P     Fraction of payloads answered with an error (0-1)\n"
+        "  --duration S       Exit after S seconds (default: until SIGINT)\n"
+        "  --report S         Report interval in seconds (default 5, 0 = final only)\n"
+        "  --seed N           Injection random seed (default 1)\n",
+        argv0);
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!val) { usage(argv[0]); return 2; }
+        if (strcmp(arg, "--http") == 0) g_opt.ports[PROTO_HTTP] = atoi(val);
+        else if (strcmp(arg, "--mqtt") == 0) g_opt.ports[PROTO_MQTT] = atoi(val);
+        else if (strcmp(arg, "--tcp") == 0) g_opt.ports[PROTO_TCP] = atoi(val);
+        else if (strcmp(arg, "--bind") == 0) g_opt.bind = val;
+        else if (strcmp(arg, "--delay-ms") == 0) g_opt.delay_ms = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--delay-rate") == 0) g_opt.delay_rate = atof(val);
+        else if (strcmp(arg, "--error-rate") == 0) g_opt.error_rate = atof(val);
+        else if (strcmp(arg, "--duration") == 0) g_opt.duration_s = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--report") == 0) g_opt.report_s = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--seed") == 0) g_opt.seed = (uint32_t)strtoul(val, NULL, 10);
+        else { usage(argv[0]); return 2; }
+        i++;
+    }
+    g_rng = g_opt.seed ? g_opt.seed : 1;
+    if (g_opt.delay_ms > 0 && g_opt.delay_rate == 0) g_opt.delay_rate = 1.0;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    g_epoll = epoll_create1(EPOLL_CLOEXEC);
+    for (int p = 0; p < PROTO_COUNT; p++) {
+        if (g_opt.ports[p] > 0 && listen_on((proto_t)p, g_opt.ports[p]) != 0) {
+            return 1;
+        }
+    }
+
+    const uint64_t started = now_ns();
+    uint64_t window_start = started;
+
+    while (!g_stop) {
+        uint64_t now = now_ns();
+        if (g_opt.duration_s > 0 && now - started >= (uint64_t)g_opt.duration_s * 1000000000u) {
+            break;
+        }
+
+        int timeout = delayed_timeout_ms(now);
+        if (timeout < 0 || timeout > 100) timeout = 100;
+
+        struct epoll_event events[STUB_MAX_EVENTS];
+        int n = epoll_wait(g_epoll, events, STUB_MAX_EVENTS, timeout);
+        for (int i = 0; i < n; i++) {
+            conn_t* conn = (conn_t*)events[i].data.ptr;
+            if (conn->listener) {
+                accept_all(conn);
+                continue;
+            }
+            bool alive = true;
+            if (events[i].events & EPOLLOUT) {
+                alive = conn_flush(conn) && conn_pump(conn);
+            }
+            if (alive && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                conn_readable(conn);
+            }
+        }
+        delayed_run(now_ns());
+
+        now = now_ns();
+        if (g_opt.report_s > 0 && now - window_start >= (uint64_t)g_opt.report_s * 1000000000u) {
+            report("window", &g_window, g_latency, g_latency_count, (now - window_start) / 1e9);
+            memset(&g_window, 0, sizeof(g_window));
+            g_latency_count = 0;
+            window_start = now;
+        }
+    }
+
+    uint32_t all = (g_latency_all_seen < STUB_LATENCY_SAMPLES) ?
+                   (uint32_t)g_latency_all_seen : STUB_LATENCY_SAMPLES;
+    report("total", &g_total, g_latency_all, all, (now_ns() - started) / 1e9);
+    return 0;
+}
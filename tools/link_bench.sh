@@ -0,0 +1,71 @@
+#!/bin/sh
+# Uplink benchmark under emulated cellular links.
+#
+# Builds ingest_stub, link_proxy and link_client, then uploads PERIODS
+# aggregation periods for every link profile x transport x encoding and
+# prints one result line each (time to deliver, bytes on the wire and
+# radio-on time per period).
+#
+# Usage: tools/link_bench.sh [profiles] [transports] [encodings]
+#   defaults: "lan lte 3g 2g" "http mqtt tcp" "aggregate events"
+# Environment: PERIODS (10), EVENTS (200), RADIO_TAIL_MS (5000), SEED (1),
+#   BUILD_DIR (a temporary directory), BASE_PORT (19000)
+
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+PROFILES=${1:-"lan lte 3g 2g"}
+TRANSPORTS=${2:-"http mqtt tcp"}
+ENCODINGS=${3:-"aggregate events"}
+PERIODS=${PERIODS:-10}
+EVENTS=${EVENTS:-200}
+RADIO_TAIL_MS=${RADIO_TAIL_MS:-5000}
+SEED=${SEED:-1}
+BASE_PORT=${BASE_PORT:-19000}
+BUILD_DIR=${BUILD_DIR:-$(mktemp -d)}
+CC=${CC:-gcc}
+
+HTTP_PORT=$((BASE_PORT + 1))
+MQTT_PORT=$((BASE_PORT + 2))
+TCP_PORT=$((BASE_PORT + 3))
+PROXY_PORT=$((BASE_PORT + 10))
+
+$CC -std=gnu99 -O2 -o "$BUILD_DIR/ingest_stub" "$ROOT/tools/ingest_stub.c"
+$CC -std=gnu99 -O2 -o "$BUILD_DIR/link_proxy" "$ROOT/tools/link_proxy.c"
+$CC -std=gnu99 -O2 -I"$ROOT/include" -o "$BUILD_DIR/link_client" \
+    "$ROOT/tools/link_client.c" "$ROOT/src/consumption.c"
+
+"$BUILD_DIR/ingest_stub" --http "$HTTP_PORT" --mqtt "$MQTT_PORT" --tcp "$TCP_PORT" \
+    --report 0 > "$BUILD_DIR/stub.log" 2>&1 &
+STUB_PID=$!
+PROXY_PID=
+trap 'kill $STUB_PID $PROXY_PID 2>/dev/null || true' EXIT INT TERM
+sleep 0.3
+
+for profile in $PROFILES; do
+    for transport in $TRANSPORTS; do
+        case $transport in
+            http) target=$HTTP_PORT ;;
+            mqtt) target=$MQTT_PORT ;;
+            tcp)  target=$TCP_PORT ;;
+            *) echo "unknown transport: $transport" >&2; exit 2 ;;
+        esac
+        "$BUILD_DIR/link_proxy" --listen "$PROXY_PORT" --target "127.0.0.1:$target" \
+            --profile "$profile" --seed "$SEED" > "$BUILD_DIR/proxy.log" 2>&1 &
+        PROXY_PID=$!
+        sleep 0.2
+        for encoding in $ENCODINGS; do
+            "$BUILD_DIR/link_client" --transport "$transport" --port "$PROXY_PORT" \
+                --encoding "$encoding" --periods "$PERIODS" --events "$EVENTS" \
+                --radio-tail-ms "$RADIO_TAIL_MS" --timeout-ms 10000 \
+                --label "$(printf '%-4s ' "$profile")" 2>/dev/null || true
+        done
+        kill "$PROXY_PID" 2>/dev/null || true
+        wait "$PROXY_PID" 2>/dev/null || true
+        PROXY_PID=
+    done
+done
+
+kill "$STUB_PID" 2>/dev/null || true
+wait "$STUB_PID" 2>/dev/null || true
+tail -n 1 "$BUILD_DIR/stub.log"
@@ -0,0 +1,633 @@
+/**
+ * @file link_client.c
+ * @brief Uplink benchmark driver for link_proxy and ingest_stub
+ *
+ * Runs the module on a simulated clock and uploads one aggregation period
+ * at a time over a real socket, usually through tools/link_proxy.c to
+ * tools/ingest_stub.c. The platform network hooks speak the same wire
+ * formats as the library transports, without TLS:
+ *
+ * - http: POST with Content-Length, or chunked encoding for streamed
+ *   payloads, on a keep-alive connection
+ * - mqtt: MQTT 3.1.1 CONNECT once, PUBLISH QoS 1 per payload; streamed
+ *   payloads use the consumption_mqtt_publish_stream() chunk topics
+ * - tcp: 4-byte big-endian length prefix, one-byte ACK/NAK
+ *
+ * Per period it reports:
+ *
+ * - time to deliver: first byte of the first attempt to the final ack,
+ *   across reconnects and retries
+ * - bytes on the wire: payload bytes both ways plus 40 bytes of TCP/IPv4
+ *   headers per segment and per handshake/teardown packet (estimate)
+ * - radio-on time: union of [activity, activity + tail] over every socket
+ *   operation, i.e. an RRC-style inactivity timer; promotions count how
+ *   often the radio had to wake up
+ *
+ * Build:
+ *   gcc -std=gnu99 -O2 -Iinclude -o link_client tools/link_client.c src/consumption.c
+ *
+ * Usage:
+ *   link_client --transport http|mqtt|tcp --port PORT [--host ADDR]
+ *               [--encoding aggregate|events] [--periods N] [--events N]
+ *               [--products N] [--radio-tail-ms MS] [--retries N]
+ *               [--timeout-ms MS] [--label TEXT]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "consumption.h"
+
+#define CLIENT_SEGMENT 1448         /* Payload per segment with timestamps */
+#define CLIENT_HEADER_BYTES 40      /* IPv4 + TCP header */
+#define CLIENT_IO_CHUNK 1024
+#define CLIENT_MAX_PERIODS 1024
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef enum {
+    TRANSPORT_HTTP = 0,
+    TRANSPORT_MQTT,
+    TRANSPORT_TCP,
+} transport_t;
+
+/**
+ * @brief Counters of the period being uploaded
+ */
+typedef struct {
+    uint64_t bytes_up;
+    uint64_t bytes_down;
+    uint64_t segments;
+    uint64_t radio_on_ns;
+    uint32_t promotions;
+    uint32_t attempts;
+    uint32_t connects;
+} link_usage_t;
+
+/* ============================================================================
+ * GLOBALS
+ * ============================================================================ */
+
+static transport_t g_transport = TRANSPORT_HTTP;
+static struct sockaddr_in g_server;
+static uint32_t g_timeout_ms = 30000;
+static uint64_t g_radio_tail_ns = 5000000000ull;
+
+static int g_fd = -1;
+static char g_rx[4096];
+static size_t g_rx_pos = 0;
+static size_t g_rx_len = 0;
+static uint16_t g_packet_id = 0;
+static uint32_t g_upload_id = 0;
+static uint32_t g_sim_time = 1700000000;
+
+static link_usage_t g_usage;
+static uint64_t g_radio_from = 0;
+static uint64_t g_radio_until = 0;
+
+/* ============================================================================
+ * ACCOUNTING
+ * ============================================================================ */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Keep the emulated radio on for one tail after any activity
+ */
+static void radio_activity(void) {
+    uint64_t now = now_ns();
+    if (now > g_radio_until) {
+        if (g_radio_until > 0) {
+            g_usage.radio_on_ns += g_radio_until - g_radio_from;
+        }
+        g_radio_from = now;
+        g_usage.promotions++;
+    }
+    g_radio_until = now + g_radio_tail_ns;
+}
+
+/**
+ * @brief Close the radio interval of the period (its tail included)
+ */
+static void radio_flush(void) {
+    if (g_radio_until > 0) {
+        g_usage.radio_on_ns += g_radio_until - g_radio_from;
+    }
+    g_radio_from = g_radio_until = 0;
+}
+
+static uint64_t segments_for(size_t bytes) {
+    return (bytes + CLIENT_SEGMENT - 1) / CLIENT_SEGMENT;
+}
+
+/* ============================================================================
+ * SOCKET I/O
+ * ============================================================================ */
+
+static void link_close(void) {
+    if (g_fd >= 0) {
+        close(g_fd);
+        g_fd = -1;
+        g_rx_pos = g_rx_len = 0;
+        g_usage.segments += 4; /* FIN/ACK both ways */
+        radio_activity();
+    }
+}
+
+static bool link_write(const void* data, size_t len) {
+    const char* p = (const char*)data;
+    size_t left = len;
+    while (left > 0) {
+        ssize_t n = send(g_fd, p, left, MSG_NOSIGNAL);
+        if (n <= 0) {
+            link_close();
+            return false;
+        }
+        p += n;
+        left -= (size_t)n;
+    }
+    g_usage.bytes_up += len;
+    g_usage.segments += segments_for(len);
+    radio_activity();
+    return true;
+}
+
+/**
+ * @brief Read exactly len bytes within the reply timeout
+ */
+static bool link_read(void* data, size_t len) {
+    char* p = (char*)data;
+    while (len > 0) {
+        if (g_rx_pos == g_rx_len) {
+            struct pollfd pfd = { .fd = g_fd, .events = POLLIN };
+            if (poll(&pfd, 1, (int)g_timeout_ms) <= 0) {
+                link_close();
+                return false;
+            }
+            ssize_t n = recv(g_fd, g_rx, sizeof(g_rx), 0);
+            if (n <= 0) {
+                link_close();
+                return false;
+            }
+            g_rx_pos = 0;
+            g_rx_len = (size_t)n;
+            g_usage.bytes_down += (uint64_t)n;
+            g_usage.segments += segments_for((size_t)n);
+            radio_activity();
+        }
+        size_t take = g_rx_len - g_rx_pos;
+        if (take > len) take = len;
+        memcpy(p, g_rx + g_rx_pos, take);
+        g_rx_pos += take;
+        p += take;
+        len -= take;
+    }
+    return true;
+}
+
+static bool mqtt_handshake(void);
+
+static bool link_connect(void) {
+    if (g_fd >= 0) {
+        return true;
+    }
+    g_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (g_fd < 0) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(g_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval tv = { .tv_sec = g_timeout_ms / 1000, .tv_usec = (g_timeout_ms % 1000) * 1000 };
+    setsockopt(g_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    radio_activity();
+    g_usage.segments += 3; /* SYN, SYN/ACK, ACK */
+    g_usage.connects++;
+    if (connect(g_fd, (struct sockaddr*)&g_server, sizeof(g_server)) != 0) {
+        close(g_fd);
+        g_fd = -1;
+        return false;
+    }
+    radio_activity();
+
+    if (g_transport == TRANSPORT_MQTT) {
+        return mqtt_handshake();
+    }
+    return true;
+}
+
+/* ============================================================================
+ * HTTP
+ * ============================================================================ */
+
+/**
+ * @brief Read a response and return its status code (0 on error)
+ */
+static int http_response(void) {
+    char head[2048];
+    size_t len = 0;
+    while (len < 4 || memcmp(head + len - 4, "\r\n\r\n", 4) != 0) {
+        if (len == sizeof(head) - 1 || !link_read(head + len, 1)) {
+            return 0;
+        }
+        len++;
+    }
+    head[len] = '\0';
+
+    int status = 0;
+    if (sscanf(head, "HTTP/1.%*d %d", &status) != 1) {
+        link_close();
+        return 0;
+    }
+    size_t body = 0;
+    const char* cl = strcasestr(head, "\r\nContent-Length:");
+    if (cl) {
+        body = (size_t)strtoul(cl + 17, NULL, 10);
+    }
+    char sink[256];
+    while (body > 0) {
+        size_t n = body < sizeof(sink) ? body : sizeof(sink);
+        if (!link_read(sink, n)) return 0;
+        body -= n;
+    }
+    if (strcasestr(head, "\r\nConnection: close")) {
+        link_close();
+    }
+    return status;
+}
+
+static bool http_send(const char* path, const char* data, size_t len) {
+    char head[512];
+    int head_len = snprintf(head, sizeof(head),
+        "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+        "Content-Length: %zu\r\n\r\n",
+        path, inet_ntoa(g_server.sin_addr), len);
+    return link_write(head, (size_t)head_len) && link_write(data, len) &&
+           http_response() == 200;
+}
+
+static bool http_send_stream(const char* path,
+                             size_t (*read_cb)(char*, size_t, void*), void* ctx) {
+    char head[512];
+    int head_len = snprintf(head, sizeof(head),
+        "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+        "Transfer-Encoding: chunked\r\n\r\n",
+        path, inet_ntoa(g_server.sin_addr));
+    if (!link_write(head, (size_t)head_len)) return false;
+
+    char chunk[CLIENT_IO_CHUNK + 16];
+    for (;;) {
+        size_t n = read_cb(chunk + 8, CLIENT_IO_CHUNK, ctx);
+        if (n == 0) break;
+        /* Fixed-width size line keeps the chunk in one write */
+        char size_line[16];
+        snprintf(size_line, sizeof(size_line), "%06x\r\n", (unsigned)n);
+        memcpy(chunk, size_line, 8);
+        memcpy(chunk + 8 + n, "\r\n", 2);
+        if (!link_write(chunk, n + 10)) return false;
+    }
+    return link_write("0\r\n\r\n", 5) && http_response() == 200;
+}
+
+/* ============================================================================
+ * MQTT
+ * ============================================================================ */
+
+static size_t mqtt_length(uint8_t* out, size_t remaining) {
+    size_t pos = 0;
+    do {
+        uint8_t byte = (uint8_t)(remaining % 128);
+        remaining /= 128;
+        if (remaining > 0) byte |= 0x80;
+        out[pos++] = byte;
+    } while (remaining > 0);
+    return pos;
+}
+
+static bool mqtt_handshake(void) {
+    char client_id[32];
+    int id_len = snprintf(client_id, sizeof(client_id), "link-client-%d", (int)getpid());
+    uint8_t packet[64];
+    size_t var_len = 10 + 2 + (size_t)id_len;
+    size_t pos = 0;
+    packet[pos++] = 0x10;
+    pos += mqtt_length(packet + pos, var_len);
+    memcpy(packet + pos, "\x00\x04MQTT\x04\x02\x00\x3C", 10); /* Clean session, 60 s keep-alive */
+    pos += 10;
+    packet[pos++] = 0;
+    packet[pos++] = (uint8_t)id_len;
+    memcpy(packet + pos, client_id, (size_t)id_len);
+    pos += (size_t)id_len;
+
+    uint8_t connack[4];
+    if (!link_write(packet, pos) || !link_read(connack, sizeof(connack))) {
+        return false;
+    }
+    if (connack[0] != 0x20 || connack[3] != 0) {
+        link_close();
+        return false;
+    }
+    return true;
+}
+
+static bool mqtt_publish(const char* topic, const char* data, size_t len) {
+    size_t topic_len = strlen(topic);
+    uint16_t id = ++g_packet_id ? g_packet_id : ++g_packet_id;
+    uint8_t head[8 + 256];
+    if (topic_len > 255) return false;
+
+    size_t pos = 0;
+    head[pos++] = 0x32; /* PUBLISH, QoS 1 */
+    pos += mqtt_length(head + pos, 2 + topic_len + 2 + len);
+    head[pos++] = 0;
+    head[pos++] = (uint8_t)topic_len;
+    memcpy(head + pos, topic, topic_len);
+    pos += topic_len;
+    head[pos++] = (uint8_t)(id >> 8);
+    head[pos++] = (uint8_t)id;
+
+    uint8_t puback[4];
+    if (!link_write(head, pos) || !link_write(data, len) ||
+        !link_read(puback, sizeof(puback))) {
+        return false;
+    }
+    return puback[0] == 0x40 && puback[2] == (uint8_t)(id >> 8) && puback[3] == (uint8_t)id;
+}
+
+static bool mqtt_publish_stream(const char* topic,
+                                size_t (*read_cb)(char*, size_t, void*), void* ctx) {
+    char chunk_topic[256];
+    char chunk[CLIENT_IO_CHUNK];
+    uint32_t upload_id = ++g_upload_id;
+    uint32_t index = 0;
+
+    for (;;) {
+        size_t n = read_cb(chunk, sizeof(chunk), ctx);
+        if (n == 0) break;
+        snprintf(chunk_topic, sizeof(chunk_topic), "%s/%u/%u", topic, upload_id, index++);
+        if (!mqtt_publish(chunk_topic, chunk, n)) return false;
+    }
+    char count[16];
+    int count_len = snprintf(count, sizeof(count), "%u", index);
+    snprintf(chunk_topic, sizeof(chunk_topic), "%s/%u/end", topic, upload_id);
+    return mqtt_publish(chunk_topic, count, (size_t)count_len);
+}
+
+/* ============================================================================
+ * TCP FRAMING
+ * ============================================================================ */
+
+static bool tcp_send(const char* data, size_t len) {
+    uint8_t prefix[4] = {
+        (uint8_t)(len >> 24), (uint8_t)(len >> 16), (uint8_t)(len >> 8), (uint8_t)len
+    };
+    char reply;
+    return link_write(prefix, sizeof(prefix)) && link_write(data, len) &&
+           link_read(&reply, 1) && reply == 0x06;
+}
+
+/**
+ * @brief The length prefix needs the whole payload: collect it first
+ */
+static bool tcp_send_stream(size_t (*read_cb)(char*, size_t, void*), void* ctx) {
+    size_t cap = 4 * CLIENT_IO_CHUNK, len = 0;
+    char* data = (char*)malloc(cap);
+    if (!data) return false;
+    for (;;) {
+        if (cap - len < CLIENT_IO_CHUNK) {
+            char* grown = (char*)realloc(data, cap * 2);
+            if (!grown) {
+                free(data);
+                return false;
+            }
+            data = grown;
+            cap *= 2;
+        }
+        size_t n = read_cb(data + len, CLIENT_IO_CHUNK, ctx);
+        if (n == 0) break;
+        len += n;
+    }
+    bool ok = tcp_send(data, len);
+    free(data);
+    return ok;
+}
+
+/* ============================================================================
+ * PLATFORM FUNCTIONS
+ * ============================================================================ */
+
+uint32_t consumption_platform_get_timestamp(void) {
+    return g_sim_time;
+}
+
+bool consumption_platform_storage_read(void* data, size_t size) {
+    (void)data; (void)size;
+    return false;
+}
+
+bool consumption_platform_storage_write(const void* data, size_t size) {
+    (void)data; (void)size;
+    return true;
+}
+
+bool consumption_platform_network_send(const char* endpoint, const char* data, size_t data_len) {
+    g_usage.attempts++;
+    if (!link_connect()) return false;
+    switch (g_transport) {
+        case TRANSPORT_HTTP: return http_send(endpoint, data, data_len);
+        case TRANSPORT_MQTT: return mqtt_publish(endpoint, data, data_len);
+        default:             return tcp_send(data, data_len);
+    }
+}
+
+bool consumption_platform_network_send_stream(const char* endpoint,
+                                              size_t (*read_cb)(char* buffer, size_t size, void* ctx),
+                                              void* ctx) {
+    g_usage.attempts++;
+    if (!link_connect()) return false;
+    switch (g_transport) {
+        case TRANSPORT_HTTP: return http_send_stream(endpoint, read_cb, ctx);
+        case TRANSPORT_MQTT: return mqtt_publish_stream(endpoint, read_cb, ctx);
+        default:             return tcp_send_stream(read_cb, ctx);
+    }
+}
+
+void consumption_platform_log(int level, const char* message) {
+    if (level == 0) {
+        fprintf(stderr, "[module] %s\n", message);
+    }
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "Usage: %s --transport http|mqtt|tcp --port PORT [options]\n"
+        "  --host ADDR             Server (proxy) address (default 127.0.0.1)\n"
+        "  --encoding NAME         aggregate (counters only) or events (with raw events)\n"
+        "  --periods N             Aggregation periods to upload (default 10)\n"
+        "  --events N              Dispenses per period (default 200)\n"
+        "  --products N            Distinct product IDs (default 8)\n"
+        "  --radio-tail-ms MS      Radio inactivity timer (default 5000)\n"
+        "  --retries N             Attempts per period (default 5)\n"
+        "  --timeout-ms MS         Reply timeout per attempt (default 30000)\n"
+        "  --label TEXT            Prefix of the result line\n",
+        argv0);
+}
+
+int main(int argc, char* argv[]) {
+    const char* host = "127.0.0.1";
+    const char* label = "";
+    int port = 0;
+    bool events = false;
+    uint32_t periods = 10, per_period = 200, products = 8, retries = 5;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* arg = argv[i];
+        const char* val = argv[i + 1];
+        if (strcmp(arg, "--transport") == 0) {
+            if (strcmp(val, "http") == 0) g_transport = TRANSPORT_HTTP;
+            else if (strcmp(val, "mqtt") == 0) g_transport = TRANSPORT_MQTT;
+            else if (strcmp(val, "tcp") == 0) g_transport = TRANSPORT_TCP;
+            else { usage(argv[0]); return 2; }
+        }
+        else if (strcmp(arg, "--encoding") == 0) {
+            if (strcmp(val, "events") == 0) events = true;
+            else if (strcmp(val, "aggregate") != 0) { usage(argv[0]); return 2; }
+        }
+        else if (strcmp(arg, "--host") == 0) host = val;
+        else if (strcmp(arg, "--port") == 0) port = atoi(val);
+        else if (strcmp(arg, "--periods") == 0) periods = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--events") == 0) per_period = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--products") == 0) products = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--radio-tail-ms") == 0) g_radio_tail_ns = strtoull(val, NULL, 10) * 1000000u;
+        else if (strcmp(arg, "--retries") == 0) retries = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--timeout-ms") == 0) g_timeout_ms = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--label") == 0) label = val;
+        else { usage(argv[0]); return 2; }
+    }
+    if (port <= 0 || periods == 0 || periods > CLIENT_MAX_PERIODS ||
+        products == 0 || products > 255 || per_period == 0 || retries == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    memset(&g_server, 0, sizeof(g_server));
+    g_server.sin_family = AF_INET;
+    g_server.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &g_server.sin_addr) != 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Start from the module defaults */
+    consumption_config_t config;
+    if (consumption_init(NULL) != CONSUMPTION_SUCCESS ||
+        consumption_get_config(&config) != CONSUMPTION_SUCCESS) {
+        fprintf(stderr, "module init failed\n");
+        return 1;
+    }
+    consumption_deinit();
+    config.machine_id = (uint32_t)getpid();
+    config.enable_external_api = true;
+    config.aggregation_interval = 3600;
+    config.ring_buffer_size = per_period;
+    if (events) {
+        config.retention = CONSUMPTION_RETENTION_UNIFORM;
+        config.upload_events = true;
+    }
+    if (g_transport == TRANSPORT_MQTT) {
+        snprintf(config.api_endpoint, sizeof(config.api_endpoint),
+                 "bench/consumption/%u", config.machine_id);
+    } else {
+        snprintf(config.api_endpoint, sizeof(config.api_endpoint), "/ingest");
+    }
+    if (consumption_init(&config) != CONSUMPTION_SUCCESS) {
+        fprintf(stderr, "module init failed\n");
+        return 1;
+    }
+
+    static uint64_t deliver_ns[CLIENT_MAX_PERIODS];
+    link_usage_t total = {0};
+    uint32_t delivered = 0;
+
+    for (uint32_t p = 0; p < periods; p++) {
+        /* Spread the dispenses over the period on the simulated clock */
+        uint32_t step = config.aggregation_interval / per_period;
+        for (uint32_t e = 0; e < per_period; e++) {
+            consumption_on_dispense(config.machine_id, (uint8_t)(1 + e % products));
+            g_sim_time += step ? step : 1;
+        }
+        g_sim_time += config.aggregation_interval;
+
+        /* Previous period's connection stays open (keep-alive), but idle */
+        memset(&g_usage, 0, sizeof(g_usage));
+        uint64_t started = now_ns();
+        bool ok = false;
+        for (uint32_t attempt = 0; attempt < retries && !ok; attempt++) {
+            ok = consumption_force_sync() == CONSUMPTION_SUCCESS;
+        }
+        uint64_t elapsed = now_ns() - started;
+        radio_flush();
+
+        if (ok) {
+            deliver_ns[delivered++] = elapsed;
+        } else {
+            /* Give the module a clean slate for the next period */
+            link_close();
+            radio_flush();
+        }
+        total.bytes_up += g_usage.bytes_up;
+        total.bytes_down += g_usage.bytes_down;
+        total.segments += g_usage.segments;
+        total.radio_on_ns += g_usage.radio_on_ns;
+        total.promotions += g_usage.promotions;
+        total.attempts += g_usage.attempts;
+        total.connects += g_usage.connects;
+    }
+    link_close();
+    consumption_deinit();
+
+    qsort(deliver_ns, delivered, sizeof(deliver_ns[0]), compare_u64);
+    double p50 = delivered ? deliver_ns[delivered / 2] / 1e6 : 0.0;
+    double p99 = delivered ? deliver_ns[(delivered * 99) / 100 < delivered ?
+                                        (delivered * 99) / 100 : delivered - 1] / 1e6 : 0.0;
+    uint64_t wire = total.bytes_up + total.bytes_down + total.segments * CLIENT_HEADER_BYTES;
+
+    printf("%s%s %s delivered=%u/%u ttd_p50=%.1fms ttd_p99=%.1fms "
+           "payload=%.0fB/period wire=%.0fB/period radio_on=%.2fs/period promotions=%.1f/period "
+           "attempts=%u connects=%u\n",
+           label, (g_transport == TRANSPORT_HTTP) ? "http" :
+                  (g_transport == TRANSPORT_MQTT) ? "mqtt" : "tcp",
+           events ? "events" : "aggregate", delivered, periods, p50, p99,
+           (double)(total.bytes_up + total.bytes_down) / periods, (double)wire / periods,
+           total.radio_on_ns / 1e9 / periods, (double)total.promotions / periods,
+           total.attempts, total.connects);
+    return delivered == periods ? 0 : 1;
+}
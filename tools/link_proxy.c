@@ -0,0 +1,626 @@
+/**
+ * @file link_proxy.c
+ * @brief Link-emulation proxy for benchmarking transports under cellular conditions
+ *
+ * Forwards TCP connections (or UDP datagrams with --udp) from a local port
+ * to a target, shaping each direction independently:
+ *
+ * - latency and jitter: every chunk is delivered latency +/- jitter after it
+ *   leaves the emulated radio, never before the previous chunk (TCP keeps
+ *   order; UDP may reorder)
+ * - bandwidth: chunks are serialized at the configured rate, so large
+ *   payloads queue behind each other
+ * - loss: UDP datagrams are dropped; for TCP a loss stalls the chunk for one
+ *   retransmission timeout (max(200 ms, 2 x latency)) as the kernel would
+ * - resets: with the given probability per chunk both sides of the TCP
+ *   connection are closed with RST
+ *
+ * Build:
+ *   gcc -std=gnu99 -O2 -o link_proxy tools/link_proxy.c
+ *
+ * Usage:
+ *   link_proxy --listen PORT --target HOST:PORT [--udp]
+ *              [--latency-ms MS] [--jitter-ms MS] [--loss P]
+ *              [--bandwidth-kbps KBPS] [--reset-rate P]
+ *              [--profile lan|lte|3g|2g] [--duration S] [--seed N]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define PROXY_MAX_EVENTS 64
+#define PROXY_CHUNK 1460            /* One TCP segment worth of payload */
+#define PROXY_MAX_QUEUED 4096       /* Chunks in flight per direction */
+#define PROXY_UDP_FLOWS 64
+#define PROXY_MIN_RTO_MS 200
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t latency_ms;
+    uint32_t jitter_ms;
+    double loss;
+    uint32_t bandwidth_kbps;        /* 0 = unlimited */
+    double reset_rate;
+} link_profile_t;
+
+typedef struct {
+    const char* name;
+    link_profile_t link;
+} named_profile_t;
+
+/* Typical one-way figures for a loaded cell */
+static const named_profile_t g_profiles[] = {
+    {"lan", {1, 0, 0.0, 0, 0.0}},
+    {"lte", {40, 15, 0.005, 5000, 0.0}},
+    {"3g", {150, 50, 0.01, 384, 0.0005}},
+    {"2g", {400, 150, 0.03, 40, 0.002}},
+};
+
+typedef struct {
+    uint64_t due_ns;
+    uint16_t len;
+    char data[PROXY_CHUNK];
+} chunk_t;
+
+/**
+ * @brief One shaped direction (queue from src to dst)
+ */
+typedef struct {
+    chunk_t* queue;                 /* Ring of PROXY_MAX_QUEUED */
+    uint32_t head;
+    uint32_t count;
+    uint64_t tx_free_ns;            /* Emulated radio busy until */
+    uint64_t last_due_ns;           /* Keeps TCP delivery in order */
+    uint64_t bytes;
+} direction_t;
+
+typedef struct pipe_s pipe_t;
+
+typedef struct {
+    pipe_t* pipe;
+    int side;                       /* 0 = client, 1 = target */
+} endpoint_t;
+
+struct pipe_s {
+    int fd[2];
+    endpoint_t ep[2];
+    direction_t dir[2];             /* dir[0]: client -> target, dir[1]: target -> client */
+    bool eof[2];                    /* Side finished sending */
+    bool closed;
+    pipe_t* next;
+};
+
+typedef struct {
+    struct sockaddr_in client;
+    int upstream;                   /* Socket towards the target, -1 = free */
+    direction_t dir[2];
+    endpoint_t ep;
+} udp_flow_t;
+
+typedef struct {
+    uint64_t segments[2];
+    uint64_t bytes[2];
+    uint64_t losses;
+    uint64_t drops;
+    uint64_t resets;
+    uint64_t connections;
+} proxy_stats_t;
+
+/* ============================================================================
+ * GLOBALS
+ * ============================================================================ */
+
+static link_profile_t g_link;
+static int g_listen_port = 0;
+static struct sockaddr_in g_target;
+static bool g_udp = false;
+static uint32_t g_duration_s = 0;
+static uint32_t g_rng = 1;
+
+static volatile sig_atomic_t g_stop = 0;
+static int g_epoll = -1;
+static int g_listen_fd = -1;
+static pipe_t* g_pipes = NULL;
+static udp_flow_t g_flows[PROXY_UDP_FLOWS];
+static proxy_stats_t g_stats;
+static const int g_listener_tag = 0;
+
+/* ============================================================================
+ * HELPERS
+ * ============================================================================ */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static double random_unit(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return (double)g_rng / 4294967296.0;
+}
+
+/**
+ * @brief Compute when a chunk sent now arrives at the other side
+ */
+static uint64_t schedule(direction_t* dir, size_t len, bool ordered) {
+    uint64_t now = now_ns();
+
+    /* Serialization on the emulated radio */
+    uint64_t start = (dir->tx_free_ns > now) ? dir->tx_free_ns : now;
+    uint64_t tx_ns = g_link.bandwidth_kbps ?
+        (uint64_t)len * 8u * 1000000u / g_link.bandwidth_kbps : 0;
+    dir->tx_free_ns = start + tx_ns;
+
+    int64_t jitter = 0;
+    if (g_link.jitter_ms > 0) {
+        jitter = (int64_t)((random_unit() * 2.0 - 1.0) * g_link.jitter_ms * 1e6);
+    }
+    int64_t delay = (int64_t)g_link.latency_ms * 1000000 + jitter;
+    if (delay < 0) delay = 0;
+    uint64_t due = dir->tx_free_ns + (uint64_t)delay;
+
+    if (ordered && due < dir->last_due_ns) {
+        due = dir->last_due_ns;
+    }
+    dir->last_due_ns = due;
+    return due;
+}
+
+static chunk_t* enqueue(direction_t* dir) {
+    if (!dir->queue) {
+        dir->queue = (chunk_t*)malloc(PROXY_MAX_QUEUED * sizeof(chunk_t));
+        if (!dir->queue) return NULL;
+    }
+    if (dir->count == PROXY_MAX_QUEUED) {
+        return NULL;
+    }
+    chunk_t* chunk = &dir->queue[(dir->head + dir->count) % PROXY_MAX_QUEUED];
+    dir->count++;
+    return chunk;
+}
+
+static void epoll_set(int fd, void* ptr, uint32_t events, int op) {
+    struct epoll_event ev = { .events = events, .data.ptr = ptr };
+    epoll_ctl(g_epoll, op, fd, &ev);
+}
+
+/* ============================================================================
+ * TCP
+ * ============================================================================ */
+
+static void pipe_close(pipe_t* pipe, bool reset) {
+    if (pipe->closed) return;
+    for (int s = 0; s < 2; s++) {
+        if (reset) {
+            struct linger lg = {1, 0}; /* RST instead of FIN */
+            setsockopt(pipe->fd[s], SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        }
+        epoll_ctl(g_epoll, EPOLL_CTL_DEL, pipe->fd[s], NULL);
+        close(pipe->fd[s]);
+        free(pipe->dir[s].queue);
+        pipe->dir[s].queue = NULL;
+        pipe->dir[s].count = 0;
+    }
+    pipe->closed = true;
+}
+
+/**
+ * @brief Read from one side and queue the data for the other
+ */
+static void pipe_read(pipe_t* pipe, int side) {
+    direction_t* dir = &pipe->dir[side];
+
+    while (!pipe->closed) {
+        if (dir->count == PROXY_MAX_QUEUED) {
+            /* Queue full: stop reading, the sender sees backpressure */
+            epoll_set(pipe->fd[side], &pipe->ep[side], 0, EPOLL_CTL_MOD);
+            return;
+        }
+
+        char buf[PROXY_CHUNK];
+        ssize_t n = recv(pipe->fd[side], buf, sizeof(buf), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            pipe->eof[side] = true;
+            epoll_set(pipe->fd[side], &pipe->ep[side], 0, EPOLL_CTL_MOD);
+            if (n < 0) pipe_close(pipe, true);
+            return;
+        }
+
+        if (g_link.reset_rate > 0 && random_unit() < g_link.reset_rate) {
+            g_stats.resets++;
+            pipe_close(pipe, true);
+            return;
+        }
+
+        chunk_t* chunk = enqueue(dir);
+        chunk->len = (uint16_t)n;
+        memcpy(chunk->data, buf, (size_t)n);
+        chunk->due_ns = schedule(dir, (size_t)n, true);
+        if (g_link.loss > 0 && random_unit() < g_link.loss) {
+            uint64_t rto = (uint64_t)g_link.latency_ms * 2u;
+            if (rto < PROXY_MIN_RTO_MS) rto = PROXY_MIN_RTO_MS;
+            chunk->due_ns += rto * 1000000u;
+            dir->last_due_ns = chunk->due_ns;
+            g_stats.losses++;
+        }
+        g_stats.segments[side]++;
+        g_stats.bytes[side] += (uint64_t)n;
+    }
+}
+
+/**
+ * @brief Deliver due chunks of one direction
+ */
+static void pipe_deliver(pipe_t* pipe, int side, uint64_t now) {
+    direction_t* dir = &pipe->dir[side];
+    int out = pipe->fd[1 - side];
+
+    while (!pipe->closed && dir->count > 0) {
+        chunk_t* chunk = &dir->queue[dir->head];
+        if (chunk->due_ns > now) break;
+
+        ssize_t n = send(out, chunk->data, chunk->len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            pipe_close(pipe, true);
+            return;
+        }
+        if ((size_t)n < chunk->len) {
+            memmove(chunk->data, chunk->data + n, chunk->len - (size_t)n);
+            chunk->len = (uint16_t)(chunk->len - (size_t)n);
+            return;
+        }
+        bool was_full = (dir->count == PROXY_MAX_QUEUED);
+        dir->head = (dir->head + 1) % PROXY_MAX_QUEUED;
+        dir->count--;
+        if (was_full && !pipe->eof[side]) {
+            epoll_set(pipe->fd[side], &pipe->ep[side], EPOLLIN, EPOLL_CTL_MOD);
+        }
+    }
+
+    /* Forward a half-close once everything before it arrived */
+    if (!pipe->closed && pipe->eof[side] && dir->count == 0) {
+        shutdown(out, SHUT_WR);
+        if (pipe->eof[1 - side] && pipe->dir[1 - side].count == 0) {
+            pipe_close(pipe, false);
+        }
+    }
+}
+
+static void accept_tcp(void) {
+    for (;;) {
+        int fd = accept4(g_listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        int up = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (up < 0) {
+            close(fd);
+            continue;
+        }
+        if (connect(up, (struct sockaddr*)&g_target, sizeof(g_target)) != 0 &&
+            errno != EINPROGRESS) {
+            close(fd);
+            close(up);
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(up, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        pipe_t* pipe = (pipe_t*)calloc(1, sizeof(pipe_t));
+        pipe->fd[0] = fd;
+        pipe->fd[1] = up;
+        for (int s = 0; s < 2; s++) {
+            pipe->ep[s].pipe = pipe;
+            pipe->ep[s].side = s;
+            epoll_set(pipe->fd[s], &pipe->ep[s], EPOLLIN, EPOLL_CTL_ADD);
+        }
+        pipe->next = g_pipes;
+        g_pipes = pipe;
+        g_stats.connections++;
+    }
+}
+
+/* ============================================================================
+ * UDP
+ * ============================================================================ */
+
+static udp_flow_t* udp_flow(const struct sockaddr_in* client) {
+    udp_flow_t* free_slot = NULL;
+    for (int i = 0; i < PROXY_UDP_FLOWS; i++) {
+        udp_flow_t* f = &g_flows[i];
+        if (f->upstream >= 0 && f->client.sin_addr.s_addr == client->sin_addr.s_addr &&
+            f->client.sin_port == client->sin_port) {
+            return f;
+        }
+        if (f->upstream < 0 && !free_slot) free_slot = f;
+    }
+    if (!free_slot) return NULL;
+
+    free_slot->upstream = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (free_slot->upstream < 0) return NULL;
+    connect(free_slot->upstream, (struct sockaddr*)&g_target, sizeof(g_target));
+    free_slot->client = *client;
+    free_slot->ep.side = 1;
+    epoll_set(free_slot->upstream, free_slot, EPOLLIN, EPOLL_CTL_ADD);
+    g_stats.connections++;
+    return free_slot;
+}
+
+static void udp_queue(direction_t* dir, int side, const char* data, size_t len) {
+    g_stats.segments[side]++;
+    g_stats.bytes[side] += len;
+    if (g_link.loss > 0 && random_unit() < g_link.loss) {
+        g_stats.drops++;
+        return;
+    }
+    chunk_t* chunk = enqueue(dir);
+    if (!chunk) {
+        g_stats.drops++; /* Queue overflow: tail drop */
+        return;
+    }
+    chunk->len = (uint16_t)len;
+    memcpy(chunk->data, data, len);
+    chunk->due_ns = schedule(dir, len, false);
+}
+
+static void udp_read_client(void) {
+    for (;;) {
+        char buf[PROXY_CHUNK];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(g_listen_fd, buf, sizeof(buf), 0,
+                             (struct sockaddr*)&from, &from_len);
+        if (n < 0) return;
+        udp_flow_t* flow = udp_flow(&from);
+        if (flow) udp_queue(&flow->dir[0], 0, buf, (size_t)n);
+    }
+}
+
+static void udp_read_target(udp_flow_t* flow) {
+    for (;;) {
+        char buf[PROXY_CHUNK];
+        ssize_t n = recv(flow->upstream, buf, sizeof(buf), 0);
+        if (n < 0) return;
+        udp_queue(&flow->dir[1], 1, buf, (size_t)n);
+    }
+}
+
+/**
+ * @brief Send due datagrams; UDP may deliver out of order
+ */
+static void udp_deliver(udp_flow_t* flow, uint64_t now) {
+    for (int side = 0; side < 2; side++) {
+        direction_t* dir = &flow->dir[side];
+        uint32_t remaining = dir->count;
+        for (uint32_t i = 0; i < remaining; i++) {
+            chunk_t chunk = dir->queue[dir->head];
+            dir->head = (dir->head + 1) % PROXY_MAX_QUEUED;
+            dir->count--;
+            if (chunk.due_ns > now) {
+                *enqueue(dir) = chunk; /* Not yet: rotate to the back */
+                continue;
+            }
+            if (side == 0) {
+                send(flow->upstream, chunk.data, chunk.len, 0);
+            } else {
+                sendto(g_listen_fd, chunk.data, chunk.len, 0,
+                       (struct sockaddr*)&flow->client, sizeof(flow->client));
+            }
+        }
+    }
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+static void on_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static uint64_t next_due(void) {
+    uint64_t next = UINT64_MAX;
+    for (pipe_t* p = g_pipes; p; p = p->next) {
+        for (int s = 0; s < 2 && !p->closed; s++) {
+            if (p->dir[s].count > 0 && p->dir[s].queue[p->dir[s].head].due_ns < next) {
+                next = p->dir[s].queue[p->dir[s].head].due_ns;
+            }
+        }
+    }
+    for (int i = 0; i < PROXY_UDP_FLOWS; i++) {
+        for (int s = 0; s < 2; s++) {
+            direction_t* dir = &g_flows[i].dir[s];
+            for (uint32_t c = 0; c < dir->count; c++) {
+                uint64_t due = dir->queue[(dir->head + c) % PROXY_MAX_QUEUED].due_ns;
+                if (due < next) next = due;
+            }
+        }
+    }
+    return next;
+}
+
+static void reap_pipes(void) {
+    pipe_t** link = &g_pipes;
+    while (*link) {
+        pipe_t* p = *link;
+        if (p->closed) {
+            *link = p->next;
+            free(p);
+        } else {
+            link = &p->next;
+        }
+    }
+}
+
+static bool parse_target(const char* spec) {
+    char host[256];
+    const char* colon = strrchr(spec, ':');
+    if (!colon || (size_t)(colon - spec) >= sizeof(host)) return false;
+    memcpy(host, spec, (size_t)(colon - spec));
+    host[colon - spec] = '\0';
+    memset(&g_target, 0, sizeof(g_target));
+    g_target.sin_family = AF_INET;
+    g_target.sin_port = htons((uint16_t)atoi(colon + 1));
+    return inet_pton(AF_INET, host, &g_target.sin_addr) == 1;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "Usage: %s --listen PORT --target HOST:PORT [options]\n"
+        "  --udp                 Forward UDP datagrams instead of TCP\n"
+        "  --profile NAME        Start from lan, lte, 3g or 2g\n"
+        "  --latency-ms MS       One-way latency\n"
+        "  --jitter-ms MS        Uniform jitter (+/-)\n"
+        "  --loss P              Loss probability per segment/datagram\n"
+        "  --bandwidth-kbps K    Rate per direction (0 = unlimited)\n"
+        "  --reset-rate P        TCP reset probability per segment\n"
+        "  --duration S          Exit after S seconds\n"
+        "  --seed N              Random seed (default 1)\n",
+        argv0);
+}
+
+int main(int argc, char* argv[]) {
+    bool have_target = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--udp") == 0) {
+            g_udp = true;
+            continue;
+        }
+        const char* val = (i + 1 < argc) ? argv[++i] : NULL;
+        if (!val) { usage(argv[0]); return 2; }
+        if (strcmp(arg, "--listen") == 0) g_listen_port = atoi(val);
+        else if (strcmp(arg, "--target") == 0) have_target = parse_target(val);
+        else if (strcmp(arg, "--latency-ms") == 0) g_link.latency_ms = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--jitter-ms") == 0) g_link.jitter_ms = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--loss") == 0) g_link.loss = atof(val);
+        else if (strcmp(arg, "--bandwidth-kbps") == 0) g_link.bandwidth_kbps = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--reset-rate") == 0) g_link.reset_rate = atof(val);
+        else if (strcmp(arg, "--duration") == 0) g_duration_s = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--seed") == 0) g_rng = (uint32_t)strtoul(val, NULL, 10);
+        else if (strcmp(arg, "--profile") == 0) {
+            bool found = false;
+            for (size_t p = 0; p < sizeof(g_profiles) / sizeof(g_profiles[0]); p++) {
+                if (strcmp(g_profiles[p].name, val) == 0) {
+                    g_link = g_profiles[p].link;
+                    found = true;
+                }
+            }
+            if (!found) { usage(argv[0]); return 2; }
+        }
+        else { usage(argv[0]); return 2; }
+    }
+    if (!have_target || g_listen_port <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    /* Spread small seeds over the state so the first draws are not tiny */
+    g_rng = g_rng * 2654435761u ^ 0x9E3779B9u;
+    if (g_rng == 0) g_rng = 1;
+    for (int i = 0; i < 16; i++) random_unit();
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    g_epoll = epoll_create1(EPOLL_CLOEXEC);
+    for (int i = 0; i < PROXY_UDP_FLOWS; i++) g_flows[i].upstream = -1;
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)g_listen_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    g_listen_fd = socket(AF_INET, (g_udp ? SOCK_DGRAM : SOCK_STREAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(g_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(g_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        (!g_udp && listen(g_listen_fd, SOMAXCONN) != 0)) {
+        fprintf(stderr, "cannot listen on port %d: %s\n", g_listen_port, strerror(errno));
+        return 1;
+    }
+    epoll_set(g_listen_fd, (void*)&g_listener_tag, EPOLLIN, EPOLL_CTL_ADD);
+
+    printf("%s proxy 127.0.0.1:%d -> %s:%u latency=%ums jitter=%ums loss=%.3f "
+           "bandwidth=%ukbps resets=%.4f\n",
+           g_udp ? "udp" : "tcp", g_listen_port, inet_ntoa(g_target.sin_addr),
+           ntohs(g_target.sin_port), g_link.latency_ms, g_link.jitter_ms, g_link.loss,
+           g_link.bandwidth_kbps, g_link.reset_rate);
+    fflush(stdout);
+
+    const uint64_t started = now_ns();
+    while (!g_stop) {
+        uint64_t now = now_ns();
+        if (g_duration_s > 0 && now - started >= (uint64_t)g_duration_s * 1000000000u) {
+            break;
+        }
+
+        uint64_t due = next_due();
+        int timeout = 100;
+        if (due != UINT64_MAX) {
+            timeout = (due <= now) ? 0 : (int)((due - now) / 1000000u) + 1;
+            if (timeout > 100) timeout = 100;
+        }
+
+        struct epoll_event events[PROXY_MAX_EVENTS];
+        int n = epoll_wait(g_epoll, events, PROXY_MAX_EVENTS, timeout);
+        for (int i = 0; i < n; i++) {
+            void* ptr = events[i].data.ptr;
+            if (ptr == &g_listener_tag) {
+                if (g_udp) udp_read_client(); else accept_tcp();
+            } else if (g_udp) {
+                udp_read_target((udp_flow_t*)ptr);
+            } else {
+                endpoint_t* ep = (endpoint_t*)ptr;
+                if (!ep->pipe->closed) pipe_read(ep->pipe, ep->side);
+            }
+        }
+
+        now = now_ns();
+        if (g_udp) {
+            for (int i = 0; i < PROXY_UDP_FLOWS; i++) {
+                if (g_flows[i].upstream >= 0) udp_deliver(&g_flows[i], now);
+            }
+        } else {
+            for (pipe_t* p = g_pipes; p; p = p->next) {
+                pipe_deliver(p, 0, now);
+                pipe_deliver(p, 1, now);
+            }
+            reap_pipes();
+        }
+    }
+
+    printf("[proxy] connections=%llu up: %llu segments %llu bytes, down: %llu segments %llu bytes, "
+           "losses=%llu drops=%llu resets=%llu\n",
+           (unsigned long long)g_stats.connections,
+           (unsigned long long)g_stats.segments[0], (unsigned long long)g_stats.bytes[0],
+           (unsigned long long)g_stats.segments[1], (unsigned long long)g_stats.bytes[1],
+           (unsigned long long)g_stats.losses, (unsigned long long)g_stats.drops,
+           (unsigned long long)g_stats.resets);
+    return 0;
+}
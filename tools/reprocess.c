@@ -0,0 +1,248 @@
+/**
+ * @file reprocess.c
+ * @brief Rebuild aggregates from replication log files
+ *
+ * Reads log files written by the replica FILE transport
+ * (consumption_replica.h), counts their dispenses over a time range with
+ * any period length and alignment (consumption_reprocess.h) and prints
+ * the rebuilt aggregates as batch upload payloads (consumption_batch.h),
+ * one JSON document per line on stdout, ready to POST to the batch
+ * endpoint or to hand to an outbox. Statistics go to stderr.
+ *
+ * Build:
+ *   gcc -std=gnu99 -O2 -Iinclude -o reprocess tools/reprocess.c src/consumption.c \
+ *       src/consumption_replica.c src/consumption_archive.c \
+ *       src/consumption_reprocess.c src/consumption_batch.c -lpthread
+ *
+ * Usage:
+ *   reprocess --to TIME [--from TIME] [--interval SECONDS] [--align SECONDS]
+ *             [--threads N] [--gateway ID] [--max-bytes N] LOG...
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "consumption.h"
+#include "consumption_replica.h"
+#include "consumption_reprocess.h"
+#include "consumption_batch.h"
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/**
+ * @brief State shared with the log and aggregate callbacks
+ */
+typedef struct {
+    consumption_reprocess_t* reprocess;
+    consumption_batch_t* batch;
+    char* buffer;
+    size_t buffer_size;
+    uint32_t now;
+    consumption_error_t error;      /* First failure in a callback */
+    uint64_t payloads;
+    uint64_t bytes;
+} reprocess_run_t;
+
+/* ============================================================================
+ * PLATFORM FUNCTIONS
+ * ============================================================================ */
+
+uint32_t consumption_platform_get_timestamp(void) {
+    return (uint32_t)time(NULL);
+}
+
+bool consumption_platform_storage_read(void* data, size_t size) {
+    (void)data; (void)size;
+    return false;
+}
+
+bool consumption_platform_storage_write(const void* data, size_t size) {
+    (void)data; (void)size;
+    return true;
+}
+
+bool consumption_platform_network_send(const char* endpoint, const char* data, size_t data_len) {
+    (void)endpoint; (void)data; (void)data_len;
+    return false;
+}
+
+bool consumption_platform_network_send_stream(const char* endpoint,
+                                              size_t (*read_cb)(char* buffer, size_t size, void* ctx),
+                                              void* ctx) {
+    (void)endpoint; (void)read_cb; (void)ctx;
+    return false;
+}
+
+void consumption_platform_log(int level, const char* message) {
+    if (level == 0) {
+        fprintf(stderr, "[module] %s\n", message);
+    }
+}
+
+/* ============================================================================
+ * OUTPUT
+ * ============================================================================ */
+
+/**
+ * @brief Print every queued entry as batches; nothing is sent, so all are acked
+ */
+static bool flush_batches(reprocess_run_t* run) {
+    uint32_t id;
+    size_t len;
+
+    while ((len = consumption_batch_take(run->batch, run->buffer, run->buffer_size, &id)) > 0) {
+        consumption_batch_stats_t stats;
+        consumption_batch_get_stats(run->batch, &stats);
+
+        bool* accepted = malloc(stats.in_flight * sizeof(bool));
+        if (!accepted) {
+            return false;
+        }
+        for (uint32_t i = 0; i < stats.in_flight; i++) {
+            accepted[i] = true;
+        }
+        fwrite(run->buffer, 1, len, stdout);
+        fputc('\n', stdout);
+        consumption_batch_complete(run->batch, id, accepted, stats.in_flight, run->now);
+        free(accepted);
+
+        run->payloads++;
+        run->bytes += len;
+    }
+    return true;
+}
+
+static void on_aggregate(const consumption_aggregate_t* aggregate, void* user) {
+    reprocess_run_t* run = (reprocess_run_t*)user;
+    if (run->error != CONSUMPTION_SUCCESS) {
+        return;
+    }
+
+    consumption_error_t err = consumption_batch_add(run->batch, aggregate, run->now);
+    if (err == CONSUMPTION_ERROR_STORAGE_FULL) {
+        if (!flush_batches(run)) {
+            run->error = CONSUMPTION_ERROR_MEMORY_ERROR;
+            return;
+        }
+        err = consumption_batch_add(run->batch, aggregate, run->now);
+    }
+    if (err != CONSUMPTION_SUCCESS) {
+        run->error = err;
+    }
+    else if (consumption_batch_ready(run->batch, run->now) && !flush_batches(run)) {
+        run->error = CONSUMPTION_ERROR_MEMORY_ERROR;
+    }
+}
+
+static void on_record(const consumption_log_record_t* record, void* ctx) {
+    reprocess_run_t* run = (reprocess_run_t*)ctx;
+    if (run->error == CONSUMPTION_SUCCESS) {
+        run->error = consumption_reprocess_add_log(run->reprocess, record);
+    }
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "Usage: %s --to TIME [options] LOG...\n"
+        "  --from TIME             First timestamp reprocessed (default 0)\n"
+        "  --to TIME               First timestamp excluded\n"
+        "  --interval SECONDS      Period length (default 3600)\n"
+        "  --align SECONDS         Periods start at align + k * interval (default 0)\n"
+        "  --threads N             Sort threads, 1-64 (default 1)\n"
+        "  --gateway ID            Gateway reported in each payload (default 0)\n"
+        "  --max-bytes N           Payload size limit (default 65536)\n",
+        argv0);
+}
+
+int main(int argc, char* argv[]) {
+    consumption_reprocess_config_t config;
+    consumption_batch_config_t batch_config;
+    consumption_reprocess_config_default(&config);
+    consumption_batch_config_default(&batch_config);
+
+    int first_log = argc;
+    for (int i = 1; i < argc; i += 2) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0) {
+            first_log = i;
+            break;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        uint32_t val = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        if (strcmp(arg, "--from") == 0) config.time_from = val;
+        else if (strcmp(arg, "--to") == 0) config.time_to = val;
+        else if (strcmp(arg, "--interval") == 0) config.interval = val;
+        else if (strcmp(arg, "--align") == 0) config.alignment = val;
+        else if (strcmp(arg, "--threads") == 0) config.threads = val;
+        else if (strcmp(arg, "--gateway") == 0) batch_config.gateway_id = val;
+        else if (strcmp(arg, "--max-bytes") == 0) batch_config.max_bytes = val;
+        else { usage(argv[0]); return 2; }
+    }
+    if (first_log >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    reprocess_run_t run;
+    memset(&run, 0, sizeof(run));
+    run.now = consumption_platform_get_timestamp();
+    run.reprocess = consumption_reprocess_create(&config);
+    run.batch = consumption_batch_create(&batch_config);
+    run.buffer_size = (size_t)batch_config.max_bytes + 1;
+    run.buffer = malloc(run.buffer_size);
+    if (!run.reprocess || !run.batch || !run.buffer) {
+        fprintf(stderr, "invalid options or out of memory\n");
+        consumption_reprocess_destroy(run.reprocess);
+        consumption_batch_destroy(run.batch);
+        free(run.buffer);
+        return 2;
+    }
+
+    int status = 0;
+    for (int i = first_log; i < argc && status == 0; i++) {
+        uint64_t records = 0;
+        consumption_error_t err = consumption_replica_read_log(argv[i], on_record, &run, &records);
+        if (err == CONSUMPTION_SUCCESS) {
+            err = run.error;
+        }
+        if (err != CONSUMPTION_SUCCESS) {
+            fprintf(stderr, "%s: error %d after %llu records\n", argv[i], (int)err,
+                    (unsigned long long)records);
+            status = 1;
+        }
+    }
+
+    if (status == 0) {
+        consumption_reprocess_emit(run.reprocess, on_aggregate, &run);
+        if (run.error != CONSUMPTION_SUCCESS || !flush_batches(&run)) {
+            fprintf(stderr, "batching failed\n");
+            status = 1;
+        }
+    }
+
+    consumption_reprocess_stats_t stats;
+    consumption_reprocess_get_stats(run.reprocess, &stats);
+    fprintf(stderr, "%llu events counted, %llu outside the range, %llu aggregates in %llu payloads (%llu bytes)\n",
+            (unsigned long long)stats.events, (unsigned long long)stats.skipped,
+            (unsigned long long)stats.aggregates, (unsigned long long)run.payloads,
+            (unsigned long long)run.bytes);
+
+    consumption_reprocess_destroy(run.reprocess);
+    consumption_batch_destroy(run.batch);
+    free(run.buffer);
+    return status;
+}